@@ -0,0 +1,24 @@
+#!/bin/bash
+
+# Compare the event schedulers on the work scenario.
+# Usage: ./benchmark-schedulers.sh [simulationTime]
+# Configure ns-3 with --build-profile=optimized first, logging would
+# otherwise dominate the run time.
+
+time="${1:-10}"
+
+echo "scheduler,devices,events,seconds" > schedulers.csv
+for devices in 29 1000 10000; do
+  for scheduler in map heap list calendar wheel; do
+    echo "Executing ${scheduler} scheduler with ${devices} devices..."
+    ./waf --run "scratch/work-simulator --nNodes=${devices} \
+      --scheduler=${scheduler} --simulationTime=${time} \
+      --startInterval=0.0001" > "log-${scheduler}-${devices}.txt" 2>&1
+    events=$(grep -o "simulator events [0-9]*" "log-${scheduler}-${devices}.txt" |
+      awk '{print $3}')
+    seconds=$(grep -o ": [0-9.e+-]* s of run time" "log-${scheduler}-${devices}.txt" |
+      awk '{print $2}')
+    echo "${scheduler},${devices},${events},${seconds}" >> schedulers.csv
+  done
+done
+cat schedulers.csv
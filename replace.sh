@@ -11,9 +11,13 @@ cp -avr "data" "${root}/ns-${version}"
 
 echo "Copying simulation work file..."
 cp -f "work-simulator.cc" "${root}/ns-${version}/scratch/work-simulator.cc"
+cp -f "work-benchmark.cc" "${root}/ns-${version}/scratch/work-benchmark.cc"
+cp -f "work-sweep.cc" "${root}/ns-${version}/scratch/work-sweep.cc"
+cp -f "work-saturation.cc" "${root}/ns-${version}/scratch/work-saturation.cc"
 
 echo "Copying run work file..."
 cp -f "run.sh" "${root}/ns-${version}/run.sh"
+cp -f "benchmark-schedulers.sh" "${root}/ns-${version}/benchmark-schedulers.sh"
 
 echo "Building ns-3..."
 cd $root
@@ -0,0 +1,378 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+// Wall-clock benchmark of the work scenario.
+//
+// Every combination of the --devices and --durations lists runs the
+// scenario of work-simulator in a child process, so each case starts from
+// a fresh simulator and reports its own peak memory. For each phase
+// (topology build, application install, Simulator::Run, result export and
+// Simulator::Destroy) the wall time, the events executed, the events per
+// second and the peak RSS are written to a JSON file.
+//
+// With --baseline, the results are compared with the cases of a previous
+// JSON file run with the same scenario options: a phase slower than the
+// baseline by more than --tolerance (and by more than --minDelta seconds,
+// to ignore the noise of the short phases), a larger peak RSS or a
+// different number of events is reported as a regression and the program
+// exits with status 1. Cases without a baseline are listed.
+//
+// Built with --enable-work-memory-hooks, each case also reports its heap
+// usage (see WorkMemoryAccounting) and a growth of the bytes per station,
+// after the build or at the peak of the run, is a regression too.
+//
+// ./waf --run "scratch/work-benchmark --devices=29,1000 --durations=10"
+// ./waf --run "scratch/work-benchmark --baseline=benchmark-main.json"
+
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/work-event-counters.h"
+#include "ns3/work-json.h"
+#include "ns3/work-memory-accounting.h"
+#include "ns3/work-runner.h"
+#include "ns3/work-scenario.h"
+#include "ns3/work-stats-collector.h"
+
+using namespace ns3;
+using namespace std;
+
+NS_LOG_COMPONENT_DEFINE("WorkBenchmark");
+
+/**
+ * \brief Parse a comma separated list of numbers
+ * \param list the list, e.g. "29,1000"
+ * \return the numbers
+ */
+vector<double> parseList(const string &list) {
+  vector<double> values;
+  stringstream items(list);
+  string item;
+  while (getline(items, item, ',')) {
+    if (!item.empty()) {
+      values.push_back(stod(item));
+    }
+  }
+  return values;
+}
+
+/**
+ * \return the peak resident set size of the process in KiB
+ */
+uint64_t peakRss(void) {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss; // KiB on Linux
+}
+
+/**
+ * \brief Run and measure a phase of a case
+ * \param name the phase
+ * \param body the work of the phase
+ * \param destroy true if the phase destroys the simulator, whose event
+ *        count is then no longer available
+ * \return the measures of the phase
+ */
+WorkJson measurePhase(const string &name, function<void(void)> body,
+                      bool destroy = false) {
+  uint64_t events = Simulator::GetEventCount();
+  auto start = chrono::steady_clock::now();
+  body();
+  chrono::duration<double> wall = chrono::steady_clock::now() - start;
+  uint64_t executed = destroy ? 0 : Simulator::GetEventCount() - events;
+  WorkJson phase = WorkJson::Object();
+  phase.Set("name", name);
+  phase.Set("wall", wall.count());
+  phase.Set("events", executed);
+  phase.Set("eventsPerSecond", wall.count() > 0 ? executed / wall.count() : 0);
+  phase.Set("peakRss", peakRss());
+  return phase;
+}
+
+/**
+ * \brief Run a case of the benchmark in this process
+ * \param config the scenario parameters
+ * \param statsFile the per-device statistics written by the export phase
+ * \return the measures of the case
+ */
+WorkJson runCase(const WorkScenarioConfig &config, const string &statsFile) {
+  WorkScenario scenario(config);
+  WorkEventCounters eventCounters;
+  WorkStatsCollector statsCollector;
+  WorkMemoryAccounting memory;
+  WorkJson phases = WorkJson::Array();
+
+  scenario.Configure();
+  memory.Snapshot("start");
+  phases.Append(measurePhase("build", [&]() { scenario.BuildTopology(); }));
+  phases.Append(measurePhase("install", [&]() {
+    scenario.InstallApplications();
+    eventCounters.Install();
+    statsCollector.Install(config.nDevices);
+    Simulator::Stop(scenario.GetStopTime());
+  }));
+  memory.Snapshot("build");
+  memory.Install();
+  phases.Append(measurePhase("run", [&]() { Simulator::Run(); }));
+  WorkJson memoryReport;
+  // The global send driver runs the devices under the wrong nodes, the run
+  // bytes per station would be wrong
+  if (WorkMemoryAccounting::IsEnabled() && config.sendDriver != "global") {
+    memoryReport = memory.GetReport(scenario.GetStaNodes());
+  }
+  // The applications are alive until Destroy, so the results are exported
+  // before it
+  phases.Append(measurePhase("export", [&]() {
+    statsCollector.Export(statsFile, WorkStatsCollector::CSV);
+    statsCollector.Close();
+  }));
+  uint64_t responses = eventCounters.GetTotal(WORK_TRACE_DEVICE_RESPONSE);
+  uint64_t sent = eventCounters.GetTotal(WORK_TRACE_DEVICE_SEND);
+  phases.Append(
+      measurePhase("destroy", [&]() { Simulator::Destroy(); }, true));
+
+  double wall = 0;
+  uint64_t events = 0;
+  for (size_t i = 0; i < phases.GetSize(); ++i) {
+    wall += phases[i]["wall"].GetNumber();
+    events += phases[i]["events"].GetNumber();
+  }
+  WorkJson result = WorkJson::Object();
+  result.Set("devices", config.nDevices);
+  result.Set("duration", config.simulationTime);
+  result.Set("scenario", config.GetKey());
+  result.Set("wall", wall);
+  result.Set("events", events);
+  result.Set("eventsPerSecond", wall > 0 ? events / wall : 0);
+  result.Set("peakRss", peakRss());
+  result.Set("requests", sent);
+  result.Set("responses", responses);
+  result.Set("phases", phases);
+  if (!memoryReport.IsNull()) {
+    result.Set("memory", memoryReport);
+  }
+  return result;
+}
+
+/**
+ * \brief Run a case of the benchmark in a child process
+ * \param config the scenario parameters
+ * \param statsFile the per-device statistics written by the export phase
+ * \return the measures of the case, with an "error" member on failure
+ */
+WorkJson forkCase(const WorkScenarioConfig &config, const string &statsFile) {
+  // One case at a time, concurrent cases would disturb the timings
+  WorkProcessPool pool(1);
+  pool.Submit([&]() { return runCase(config, statsFile); });
+  WorkJson result;
+  pool.Run([&](uint32_t index, const WorkJson &value) { result = value; });
+  if (result.Has("error")) {
+    result.Set("devices", config.nDevices);
+    result.Set("duration", config.simulationTime);
+    result.Set("scenario", config.GetKey());
+  }
+  return result;
+}
+
+/**
+ * \brief Find the case of a baseline run with the same scenario options
+ * \param baseline the baseline results
+ * \param current a case of the current results
+ * \return the matching case, a null value if missing
+ */
+const WorkJson &findCase(const WorkJson &baseline, const WorkJson &current) {
+  static const WorkJson missing;
+  const WorkJson &cases = baseline["cases"];
+  for (size_t i = 0; i < cases.GetSize(); ++i) {
+    if (cases[i]["scenario"].GetString() == current["scenario"].GetString()) {
+      return cases[i];
+    }
+  }
+  return missing;
+}
+
+/**
+ * \brief Compare the results with a baseline
+ * \param results the current results
+ * \param baseline the baseline results
+ * \param tolerance the relative slowdown accepted
+ * \param minDelta the absolute slowdown accepted, in seconds
+ * \param os the report stream
+ * \return the comparison, with the list of regressions
+ */
+WorkJson compare(const WorkJson &results, const WorkJson &baseline,
+                 double tolerance, double minDelta, ostream &os) {
+  WorkJson regressions = WorkJson::Array();
+  auto flag = [&](const WorkJson &current, const string &phase,
+                  const string &metric, double before, double after) {
+    WorkJson regression = WorkJson::Object();
+    regression.Set("devices", current["devices"]);
+    regression.Set("duration", current["duration"]);
+    regression.Set("phase", phase);
+    regression.Set("metric", metric);
+    regression.Set("baseline", before);
+    regression.Set("current", after);
+    regressions.Append(regression);
+    os << "REGRESSION " << current["devices"].GetNumber() << " devices, "
+       << current["duration"].GetNumber() << " s, " << phase << " " << metric
+       << ": " << before << " -> " << after << endl;
+  };
+
+  const WorkJson &cases = results["cases"];
+  for (size_t i = 0; i < cases.GetSize(); ++i) {
+    const WorkJson &current = cases[i];
+    const WorkJson &before = findCase(baseline, current);
+    if (before.IsNull()) {
+      os << "No baseline for " << current["devices"].GetNumber()
+         << " devices, " << current["duration"].GetNumber()
+         << " s with these options" << endl;
+      continue;
+    }
+    if (before.Has("error") || current.Has("error")) {
+      continue;
+    }
+    if (current["peakRss"].GetNumber() >
+        before["peakRss"].GetNumber() * (1 + tolerance)) {
+      flag(current, "all", "peakRss", before["peakRss"].GetNumber(),
+           current["peakRss"].GetNumber());
+    }
+    // Deterministic as well, but the tolerance leaves room for the
+    // allocators of other platforms
+    if (current.Has("memory") && before.Has("memory")) {
+      for (const char *metric :
+           {"bytesPerStationBuild", "bytesPerStationPeak"}) {
+        double old = before["memory"][metric].GetNumber();
+        double bytes = current["memory"][metric].GetNumber();
+        if (bytes > old * (1 + tolerance)) {
+          flag(current, "all", metric, old, bytes);
+        }
+      }
+    }
+    const WorkJson &phases = current["phases"];
+    for (size_t j = 0; j < phases.GetSize(); ++j) {
+      string name = phases[j]["name"].GetString();
+      const WorkJson *old = 0;
+      for (size_t k = 0; k < before["phases"].GetSize(); ++k) {
+        if (before["phases"][k]["name"].GetString() == name) {
+          old = &before["phases"][k];
+        }
+      }
+      if (!old) {
+        continue;
+      }
+      double oldWall = (*old)["wall"].GetNumber();
+      double wall = phases[j]["wall"].GetNumber();
+      if (wall > oldWall * (1 + tolerance) && wall - oldWall > minDelta) {
+        flag(current, name, "wall", oldWall, wall);
+      }
+      // The simulation is deterministic, a different number of events is a
+      // change of behavior rather than noise
+      if ((*old)["events"].GetNumber() != phases[j]["events"].GetNumber()) {
+        flag(current, name, "events", (*old)["events"].GetNumber(),
+             phases[j]["events"].GetNumber());
+      }
+    }
+  }
+  WorkJson comparison = WorkJson::Object();
+  comparison.Set("tolerance", tolerance);
+  comparison.Set("minDelta", minDelta);
+  comparison.Set("regressions", regressions);
+  return comparison;
+}
+
+int main(int argc, char *argv[]) {
+  WorkScenarioConfig config;        /* Scenario, as in work-simulator. */
+  string devices = "29,1000";       /* Device counts of the cases. */
+  string durations = "10";          /* Simulated seconds of the cases. */
+  string output = "benchmark.json"; /* Results file. */
+  string baseline = "";             /* Results to compare with. */
+  double tolerance = 0.1;           /* Relative slowdown accepted. */
+  double minDelta = 0.05;           /* Absolute slowdown accepted in s. */
+  string statsFile = "stats.csv";   /* Written by the export phase. */
+
+  CommandLine cmd(__FILE__);
+  config.AddCommandLine(cmd);
+  cmd.AddValue("devices", "Comma separated device counts", devices);
+  cmd.AddValue("durations", "Comma separated simulated seconds", durations);
+  cmd.AddValue("output", "JSON results file", output);
+  cmd.AddValue("baseline", "JSON results to compare with, empty for none",
+               baseline);
+  cmd.AddValue("tolerance", "Relative slowdown accepted, e.g. 0.1 for 10%",
+               tolerance);
+  cmd.AddValue("minDelta", "Slowdown in seconds ignored as noise", minDelta);
+  cmd.AddValue("statsFile", "Per-device statistics of the export phase",
+               statsFile);
+  WorkScenarioFile scenarioFile; // --scenario, read before the options
+  scenarioFile.Parse(cmd, argc, argv, false);
+
+  WorkJson cases = WorkJson::Array();
+  bool failed = false;
+  cout << setw(8) << "devices" << setw(10) << "duration" << setw(10)
+       << "phase" << setw(12) << "wall (s)" << setw(12) << "events"
+       << setw(14) << "events/s" << setw(12) << "RSS (KiB)" << endl;
+  for (double count : parseList(devices)) {
+    for (double duration : parseList(durations)) {
+      config.nDevices = count;
+      config.simulationTime = duration;
+      config.stop = duration;
+      WorkJson result = forkCase(config, statsFile);
+      if (result.Has("error")) {
+        cout << count << " devices, " << duration
+             << " s: " << result["error"].GetString() << endl;
+        failed = true;
+      }
+      const WorkJson &phases = result["phases"];
+      for (size_t i = 0; i < phases.GetSize(); ++i) {
+        cout << setw(8) << count << setw(10) << duration << setw(10)
+             << phases[i]["name"].GetString() << setw(12)
+             << phases[i]["wall"].GetNumber() << setw(12)
+             << phases[i]["events"].GetNumber() << setw(14)
+             << phases[i]["eventsPerSecond"].GetNumber() << setw(12)
+             << phases[i]["peakRss"].GetNumber() << endl;
+      }
+      if (result.Has("memory")) {
+        cout << setw(8) << count << setw(10) << duration << "  memory: "
+             << result["memory"]["bytesPerStationBuild"].GetNumber()
+             << " bytes per station after the build, "
+             << result["memory"]["bytesPerStationPeak"].GetNumber()
+             << " at the peak" << endl;
+      }
+      cases.Append(result);
+    }
+  }
+
+  WorkJson results = WorkJson::Object();
+  results.Set("scheduler", config.scheduler);
+  results.Set("protocol", config.protocol);
+  results.Set("sendDriver", config.sendDriver);
+  results.Set("cases", cases);
+
+  bool regressed = false;
+  if (!baseline.empty()) {
+    WorkJson before;
+    string error;
+    NS_ABORT_MSG_IF(!WorkJson::ParseFile(baseline, before, error), error);
+    WorkJson comparison = compare(results, before, tolerance, minDelta, cout);
+    regressed = comparison["regressions"].GetSize() > 0;
+    comparison.Set("baseline", baseline);
+    results.Set("comparison", comparison);
+    cout << comparison["regressions"].GetSize() << " regressions against "
+         << baseline << endl;
+  }
+
+  ofstream file(output);
+  NS_ABORT_MSG_IF(!file, "Cannot open " << output);
+  results.Dump(file);
+  file << endl;
+  return failed || regressed ? 1 : 0;
+}
@@ -0,0 +1,322 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+// Saturation finder of the work scenario.
+//
+// For every PHY configuration of --phyRates, the device count (--axis=
+// nNodes) or the per-device rate (--axis=dataRate, in bit/s) is doubled
+// from --min until a run breaks the SLO, then bisected between the last
+// passing and the first failing value down to --precision. A run breaks
+// the SLO when its p99 RTT is above --sloP99 ms, or when the share of the
+// requests refused, unanswered or never connected is above --sloFailure.
+// The device profiles of --profiles set their own rates, so only the device
+// count can be searched with them.
+//
+// The PHY configurations are searched in parallel, one run of each at a
+// time. Every run is appended to the --cache file and reused by the next
+// searches with the same scenario, so widening the bounds or refining the
+// precision only runs the new points. The probed points of every PHY
+// configuration, the capacity curve, are written to --output with the knee,
+// the highest passing value.
+//
+// With --runBatch, a run stops once its metrics converged, and fails the
+// SLO as soon as a batch breaks --runMaxFailure or --runMaxRtt, e.g. set
+// to the SLO: overloaded runs are the longest ones.
+//
+// ./waf --run "scratch/work-saturation --axis=nNodes --min=10 --max=2000
+//   --phyRates=HtMcs7,HtMcs3,HtMcs0 --sloP99=100"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/work-json.h"
+#include "ns3/work-run-controller.h"
+#include "ns3/work-runner.h"
+#include "ns3/work-scenario.h"
+
+using namespace ns3;
+using namespace std;
+
+NS_LOG_COMPONENT_DEFINE("WorkSaturation");
+
+/**
+ * Search of the knee of a PHY configuration.
+ */
+struct Search {
+  string phyRate;               //!< PHY configuration
+  double pass{0};               //!< Highest passing value, 0 if none
+  double fail{0};               //!< Lowest failing value, 0 if none
+  bool done{false};             //!< True once the knee is located
+  map<double, WorkJson> probes; //!< Metrics of the probed values
+};
+
+/**
+ * \param metrics the metrics of a run
+ * \return the share of the requests refused, never answered (abandoned or
+ *         still waiting at the end) or never sent
+ */
+double failureRate(const WorkJson &metrics) {
+  double sent = metrics["sent"].GetNumber();
+  double unanswered = max(sent - metrics["responses"].GetNumber(), 0.0);
+  double failures = metrics["refused"].GetNumber() + unanswered +
+                    metrics["connectFailures"].GetNumber();
+  return failures / max(sent, 1.0);
+}
+
+/**
+ * \param metrics the metrics of a run
+ * \param sloP99 the objective of the p99 RTT in ms
+ * \param sloFailure the share of failed requests allowed
+ * \return true if the run meets the SLO, false if it was stopped on a
+ *         failure condition
+ */
+bool meetsSlo(const WorkJson &metrics, double sloP99, double sloFailure) {
+  // Without response the p99 RTT is 0, a collapsed run must not pass
+  return metrics["outcome"].GetString() != "failed" &&
+         metrics["responses"].GetNumber() > 0 &&
+         metrics["rttP99"].GetNumber() <= sloP99 &&
+         failureRate(metrics) <= sloFailure;
+}
+
+/**
+ * \param axis the searched parameter, nNodes or dataRate
+ * \param value the value
+ * \return the "name=value" parameter
+ */
+string axisParameter(const string &axis, double value) {
+  ostringstream parameter;
+  parameter << axis << "=" << uint64_t(value)
+            << (axis == "dataRate" ? "bps" : "");
+  return parameter.str();
+}
+
+/**
+ * \brief Choose the next value to probe
+ * \param search the search
+ * \param axis the searched parameter
+ * \param minimum the lowest value
+ * \param maximum the highest value
+ * \param precision the relative width at which the search stops
+ * \return the next value, 0 when the search is over
+ */
+double nextValue(Search &search, const string &axis, double minimum,
+                 double maximum, double precision) {
+  if (search.fail == 0) {
+    // Doubling until the SLO breaks
+    if (search.pass >= maximum) {
+      return 0;
+    }
+    return search.pass == 0 ? minimum : min(search.pass * 2, maximum);
+  }
+  if (search.pass == 0) {
+    return 0; // Already failing at the lowest value
+  }
+  double width = search.fail - search.pass;
+  double step = axis == "nNodes" ? max(1.0, search.pass * precision)
+                                 : search.pass * precision;
+  if (width <= step || (axis == "nNodes" && width <= 1)) {
+    return 0;
+  }
+  double middle = (search.pass + search.fail) / 2;
+  return axis == "nNodes" ? floor(middle) : middle;
+}
+
+/**
+ * \param filename a file
+ * \return the hash of its contents, of nothing if it cannot be read
+ */
+uint64_t fileHash(const string &filename) {
+  ifstream file(filename, ios::binary);
+  ostringstream contents;
+  if (file) {
+    contents << file.rdbuf();
+  }
+  return Hash64(contents.str());
+}
+
+int main(int argc, char *argv[]) {
+  WorkScenarioConfig config;         /* Parameters outside of the search. */
+  WorkRunController controller;      /* Early stop of the runs. */
+  string axis = "nNodes";            /* Searched parameter. */
+  double minimum = 10;               /* Lowest value of the search. */
+  double maximum = 1000;             /* Highest value of the search. */
+  double precision = 0.05;           /* Relative width of the knee. */
+  string phyRates = "HtMcs7";        /* PHY configurations. */
+  double sloP99 = 100;               /* p99 RTT objective in ms. */
+  double sloFailure = 0.01;          /* Share of failed requests allowed. */
+  uint32_t rngRun = 1;               /* RngRun of the runs. */
+  uint32_t jobs = 0;                 /* Runs at a time, 0 for all cores. */
+  string cache = "saturation.jsonl"; /* Runs reused by the searches. */
+  string output = "saturation.csv";  /* Capacity curves. */
+
+  CommandLine cmd(__FILE__);
+  config.AddCommandLine(cmd);
+  controller.AddCommandLine(cmd);
+  cmd.AddValue("axis", "Searched parameter, nNodes or dataRate (bit/s)",
+               axis);
+  cmd.AddValue("min", "Lowest value of the search", minimum);
+  cmd.AddValue("max", "Highest value of the search", maximum);
+  cmd.AddValue("precision", "Relative width at which the search stops",
+               precision);
+  cmd.AddValue("phyRates", "Comma separated PHY configurations", phyRates);
+  cmd.AddValue("sloP99", "Objective of the p99 RTT in ms", sloP99);
+  cmd.AddValue("sloFailure",
+               "Share of the requests refused, unanswered or never connected "
+               "allowed",
+               sloFailure);
+  cmd.AddValue("rngRun", "RngRun of the runs", rngRun);
+  cmd.AddValue("jobs", "Runs at a time, 0 for the number of cores", jobs);
+  cmd.AddValue("cache", "Runs reused by the next searches", cache);
+  cmd.AddValue("output", "Probed points and knee of each PHY configuration",
+               output);
+  WorkScenarioFile scenarioFile; // --scenario, read before the options
+  scenarioFile.Parse(cmd, argc, argv, false);
+
+  NS_ABORT_MSG_IF(axis != "nNodes" && axis != "dataRate",
+                  "Unknown search axis " << axis);
+  NS_ABORT_MSG_IF(minimum <= 0 || maximum < minimum,
+                  "Bad search bounds " << minimum << " " << maximum);
+  // The profiles set the rate and the inter-arrival time of the devices,
+  // the searched rate would not change the offered load
+  NS_ABORT_MSG_IF(axis == "dataRate" && !config.profiles.empty(),
+                  "--axis=dataRate cannot be searched with --profiles, "
+                  "search --axis=nNodes instead");
+
+  // The cache is only valid for the same scenario: the key holds every
+  // scenario option besides the PHY configuration and the searched value,
+  // and the run controller settings
+  ostringstream scenario;
+  scenario << config.GetKey({"phyRate", axis}) << ";rngRun=" << rngRun;
+  if (!config.profiles.empty()) {
+    // The files may be edited under the same names
+    scenario << ";profilesHash=" << fileHash(config.profiles);
+    WorkJson profiles;
+    string error;
+    if (WorkJson::ParseFile(config.profiles, profiles, error) &&
+        profiles.Has("assignment")) {
+      scenario << ";assignmentHash="
+               << fileHash(profiles["assignment"].GetString());
+    }
+  }
+  if (controller.IsEnabled()) {
+    scenario << ";" << controller.GetSettings(); // Early stops differ
+  }
+  map<string, WorkJson> cached;
+  {
+    ifstream previous(cache);
+    string line;
+    while (getline(previous, line)) {
+      WorkJson record;
+      string error;
+      if (WorkJson::Parse(line, record, error) &&
+          record["scenario"].GetString() == scenario.str() &&
+          !record["metrics"].Has("error")) {
+        cached[record["point"].GetString()] = record["metrics"];
+      }
+    }
+  }
+  ofstream out(cache, ios::app);
+  NS_ABORT_MSG_IF(!out, "Cannot open " << cache);
+  out << endl; // After an interrupted line, if any
+
+  vector<Search> searches;
+  stringstream phyList(phyRates);
+  string phyRate;
+  while (getline(phyList, phyRate, ',')) {
+    searches.push_back(Search());
+    searches.back().phyRate = phyRate;
+  }
+
+  // One run per PHY configuration at a time, the configurations searched
+  // in parallel
+  while (true) {
+    WorkProcessPool pool(jobs);
+    vector<pair<Search *, double>> probes;
+    for (Search &search : searches) {
+      while (!search.done) {
+        double value = nextValue(search, axis, minimum, maximum, precision);
+        if (value == 0) {
+          search.done = true;
+          break;
+        }
+        vector<string> point = {"phyRate=" + search.phyRate,
+                                axisParameter(axis, value)};
+        string key = point[0] + ";" + point[1];
+        if (!cached.count(key)) {
+          pool.Submit([config, controller, point, rngRun]() {
+            WorkScenarioConfig pointConfig = config;
+            WorkRunner::Apply(pointConfig, point);
+            return WorkRunner::Run(pointConfig, rngRun, controller);
+          });
+          probes.push_back(make_pair(&search, value));
+          break; // Wait for the run
+        }
+        // Classified right away, the next value is chosen in this round
+        search.probes[value] = cached[key];
+        bool passed = meetsSlo(cached[key], sloP99, sloFailure);
+        (passed ? search.pass : search.fail) = value;
+      }
+    }
+    if (probes.empty()) {
+      break;
+    }
+    pool.Run([&](uint32_t index, const WorkJson &metrics) {
+      Search &search = *probes[index].first;
+      double value = probes[index].second;
+      string key = "phyRate=" + search.phyRate + ";" +
+                   axisParameter(axis, value);
+      WorkJson record = WorkJson::Object();
+      record.Set("scenario", scenario.str());
+      record.Set("point", key);
+      record.Set("metrics", metrics);
+      record.Dump(out, 0);
+      out << endl;
+      NS_ABORT_MSG_IF(metrics.Has("error"),
+                      key << ": " << metrics["error"].GetString());
+      cached[key] = metrics;
+      search.probes[value] = metrics;
+      bool passed = meetsSlo(metrics, sloP99, sloFailure);
+      (passed ? search.pass : search.fail) = value;
+      cout << search.phyRate << " " << axis << "=" << value << ": p99 "
+           << metrics["rttP99"].GetNumber() << " ms, failures "
+           << failureRate(metrics) * 100 << "%, "
+           << (passed ? "pass" : "FAIL") << endl;
+    });
+  }
+
+  ofstream csv(output);
+  NS_ABORT_MSG_IF(!csv, "Cannot open " << output);
+  csv << "phyRate," << axis
+      << ",rttP50,rttP99,failureRate,goodput,pass,knee" << endl;
+  for (const Search &search : searches) {
+    for (const auto &probe : search.probes) {
+      const WorkJson &metrics = probe.second;
+      csv << search.phyRate << "," << probe.first << ","
+          << metrics["rttP50"].GetNumber() << ","
+          << metrics["rttP99"].GetNumber() << "," << failureRate(metrics)
+          << "," << metrics["goodput"].GetNumber() << ","
+          << meetsSlo(metrics, sloP99, sloFailure) << ","
+          << (probe.first == search.pass ? 1 : 0) << endl;
+    }
+    cout << search.phyRate << ": ";
+    if (search.pass == 0) {
+      cout << "SLO broken at the lowest " << axis << " " << minimum << endl;
+    } else if (search.fail == 0) {
+      cout << "SLO met up to the highest " << axis << " " << search.pass
+           << endl;
+    } else {
+      cout << "knee at " << axis << " " << search.pass << ", SLO broken at "
+           << search.fail << endl;
+    }
+  }
+  return 0;
+}
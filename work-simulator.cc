@@ -32,8 +32,12 @@
 #include "sys/stat.h"
 #include "sys/types.h"
 #include <cassert>
+#include <chrono>
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <set>
 #include <sstream>
 #include <stdint.h>
 #include <stdio.h>
@@ -56,215 +60,264 @@
 #include "ns3/network-module.h"
 #include "ns3/point-to-point-module.h"
 #include "ns3/ssid.h"
+#include "ns3/wifi-phy-state.h"
 #include "ns3/yans-wifi-channel.h"
 #include "ns3/yans-wifi-helper.h"
+#include "ns3/work-aggregator.h"
+#include "ns3/work-anim-writer.h"
 #include "ns3/work-device-enforcer.h"
+#include "ns3/work-event-counters.h"
+#include "ns3/work-flow-exporter.h"
+#include "ns3/work-event-trace.h"
+#include "ns3/work-memory-accounting.h"
+#include "ns3/work-pcapng-writer.h"
+#include "ns3/work-profiling-scheduler.h"
+#include "ns3/work-run-controller.h"
+#include "ns3/work-scenario.h"
+#include "ns3/work-send-driver.h"
 #include "ns3/work-server.h"
+#include "ns3/work-stats-collector.h"
+#include "ns3/work-trace-writer.h"
 #include "ns3/work-utils.h"
 
-#define NUMBER_OF_DEVICES 29
-#define ACTIVITY_COL 29
-#define DATE_COL 30
-
 using namespace ns3;
 using namespace std;
 
 NS_LOG_COMPONENT_DEFINE("EXAMPLE");
 
-void appsConfiguration(Ipv4InterfaceContainer serverApInterface, double start,
-                       double stop, NodeContainer serverNode,
-                       NodeContainer staNodes,
-                       Ipv4InterfaceContainer staInterface, string dataRate) {
-  // Create a server to receive these packets
-  // Start at 0s
-  // Stop at final
-  Address serverAddress(
-      InetSocketAddress(serverApInterface.GetAddress(0, 0), 50000));
-  Ptr<WorkServer> WorkServerApp = CreateObject<WorkServer>();
-  WorkServerApp->SetAttribute("Protocol",
-                              TypeIdValue(TcpSocketFactory::GetTypeId()));
-  WorkServerApp->SetAttribute("Local", AddressValue(serverAddress));
-  WorkServerApp->SetStartTime(Seconds(start));
-  WorkServerApp->SetStopTime(Seconds(stop));
-  serverNode.Get(0)->AddApplication(WorkServerApp);
-
-  // Start at 1s
-  // Each start 0.2s apart
-  // Stop at final
-  double startDevice = start + 1.0;
-  for (uint32_t i = 0; i < staNodes.GetN(); ++i) {
-    Address nodeAddress(
-        InetSocketAddress(staInterface.GetAddress(i, 0), 50000));
-    Ptr<DeviceEnforcer> DeviceEnforcerApp = CreateObject<DeviceEnforcer>();
-    DeviceEnforcerApp->SetAttribute("Protocol",
-                                    TypeIdValue(TcpSocketFactory::GetTypeId()));
-    DeviceEnforcerApp->SetAttribute("Local", AddressValue(nodeAddress));
-    DeviceEnforcerApp->SetAttribute("Remote", AddressValue(serverAddress));
-    DeviceEnforcerApp->SetAttribute("DataRate",
-                                    DataRateValue(DataRate(dataRate)));
-    DeviceEnforcerApp->SetStartTime(Seconds(startDevice));
-    DeviceEnforcerApp->SetStopTime(Seconds(stop));
-    startDevice += 0.2;
+// Run summary, filled by the trace sinks below
+vector<double> g_rtts; /* Request round-trip times in milliseconds. */
+map<string, vector<double>> g_classRtts; /* The same, by message class. */
+map<string, vector<double>> g_profileRtts; /* The same, by device profile. */
+Time g_airtime; /* Time spent transmitting by the Wi-Fi PHYs. */
+
+void RttTrace(Time rtt) { g_rtts.push_back(rtt.GetSeconds() * 1000.0); }
+
+void ClassRttTrace(string messageClass, Time rtt) {
+  g_classRtts[messageClass].push_back(rtt.GetSeconds() * 1000.0);
+}
+
+void ProfileRttTrace(string profile, Time rtt) {
+  g_profileRtts[profile].push_back(rtt.GetSeconds() * 1000.0);
+}
+
+void RateTrace(Ptr<OutputStreamWrapper> stream, string context,
+               DataRate oldRate, DataRate newRate) {
+  *stream->GetStream() << Simulator::Now().GetSeconds() << " " << context
+                       << " " << newRate.GetBitRate() << endl;
+}
+
+void PhyStateTrace(Time start, Time duration, WifiPhyState state) {
+  if (state == WifiPhyState::TX) {
+    g_airtime += duration;
+  }
+}
+
+// Capture triggers
+void PcapEventTrigger(WorkPcapngWriter *writer, const WorkEvent &event) {
+  if (event.code == WORK_TRACE_DEVICE_CONNECT_FAILED) {
+    writer->Trigger("connection failure of device " +
+                    to_string(event.device));
+  }
+}
 
+void PcapRttTrigger(WorkPcapngWriter *writer, Time threshold, Time rtt) {
+  if (rtt > threshold) {
+    writer->Trigger("round-trip time " + to_string(rtt.GetMilliSeconds()) +
+                    " ms");
+  }
+}
+
+// Labels, colors and sizes of the nodes, for AnimationInterface and
+// WorkAnimWriter
+template <typename Animation>
+void annotateNodes(Animation &anim, NodeContainer serverNode,
+                   NodeContainer apNode, NodeContainer staNodes) {
+  for (uint32_t i = 0; i < staNodes.GetN(); ++i) {
     Ptr<Node> node = staNodes.Get(i);
-    node->AddApplication(DeviceEnforcerApp);
-    NS_LOG_INFO("Installed device " << i);
+    anim.UpdateNodeDescription(node, to_string(i)); // Optional
+    anim.UpdateNodeColor(node, 255, 0, 0);          // Optional
+    anim.UpdateNodeSize(node->GetId(), 0.8, 0.8);
+  }
+  for (uint32_t i = 0; i < apNode.GetN(); ++i) {
+    Ptr<Node> node = apNode.Get(i);
+    anim.UpdateNodeDescription(node, "AP"); // Optional
+    anim.UpdateNodeColor(node, 0, 255, 0);  // Optional
+    anim.UpdateNodeSize(node->GetId(), 0.8, 0.8);
+  }
+  for (uint32_t i = 0; i < serverNode.GetN(); ++i) {
+    Ptr<Node> node = serverNode.Get(i);
+    anim.UpdateNodeDescription(node, "Local Server"); // Optional
+    anim.UpdateNodeColor(node, 0, 0, 255);            // Optional
+    anim.UpdateNodeSize(node->GetId(), 1.2, 1.2);
   }
 }
 
+set<uint32_t> parseNodeList(const string &list) {
+  set<uint32_t> nodes;
+  stringstream nodeList(list);
+  string nodeId;
+  while (getline(nodeList, nodeId, ',')) {
+    nodes.insert(stoul(nodeId));
+  }
+  return nodes;
+}
+
 int main(int argc, char *argv[]) {
   //----------------------------------------------------------------------------------
   // Simulation logs
   //----------------------------------------------------------------------------------
-  // Users may find it convenient to turn on explicit debugging
-  // for selected modules; the below lines suggest how to do this
-  LogComponentEnable("EXAMPLE", LOG_LEVEL_ALL);
-  LogComponentEnable("DeviceEnforcer", LOG_LEVEL_ALL);
-  LogComponentEnable("WorkServer", LOG_LEVEL_ALL);
-  // LogComponentEnable("ArpL3Protocol", LOG_LEVEL_INFO);
+  // Logs are enabled with --verbose, the binary event trace (--trace) is
+  // the cheap way to follow the applications in large runs
 
   //----------------------------------------------------------------------------------
   // Simulation variables
   //----------------------------------------------------------------------------------
-  // Set up some default values for the simulation.
-  // The below value configures the default behavior of global routing.
-  // By default, it is disabled.  To respond to interface events, set to true
-  Config::SetDefault("ns3::Ipv4GlobalRouting::RespondToInterfaceEvents",
-                     BooleanValue(true));
-  double start = 0.0;
-  // double stop = 86400.0;
-  double stop = 200.0;
-  uint32_t N = NUMBER_OF_DEVICES; // number of nodes in the star
-  uint32_t payloadSize = 1448;    /* Transport layer payload size in bytes. */
-  string dataRate = "100Mbps";    /* Application layer datarate. */
-  string phyRate = "HtMcs7";      /* Physical layer bitrate. */
-  double simulationTime = stop;   /* Simulation time in seconds. */
+  // Scenario parameters, see WorkScenarioConfig for the defaults
+  WorkScenarioConfig config;
+  // Early stop on convergence or failure, see WorkRunController
+  WorkRunController runController;
   bool pcapTracing = false;       /* PCAP Tracing is enabled or not. */
+  string pcapOut = "work.pcapng"; /* Merged capture file. */
+  uint32_t pcapSnaplen = 128;     /* Bytes captured per packet. */
+  string pcapNodes = "";          /* Captured node ids, empty for all. */
+  string pcapTrigger = "";        /* Capture trigger, connect or rtt. */
+  double pcapRtt = 100;           /* RTT trigger threshold in ms. */
+  double pcapPreTrigger = 1;      /* Capture kept before a trigger in s. */
+  double pcapPostTrigger = 2;     /* Capture written after a trigger in s. */
+  bool verbose = false;           /* Enable the application logs. */
+  string traceFile = "";          /* Binary event trace file. */
+  uint32_t traceCapacity = 65536; /* Records buffered by the event trace. */
+  bool traceRing = false;         /* Keep only the last trace records. */
+  string statsFile = "";          /* Per-device statistics file. */
+  string statsFormat = "csv";     /* Statistics format, csv or binary. */
+  double statsInterval = 0;       /* Time between statistics snapshots. */
+  string flowFile = "flow.csv";   /* Flow statistics file. */
+  string flowFormat = "csv";      /* Flow statistics format, csv or json. */
+  double flowInterval = 1.0;      /* Time between flow statistics in s. */
+  uint16_t flowPort = 0;          /* Export only this port, 0 for all. */
+  string asciiTrace = "";         /* CSMA trace file, empty to disable. */
+  /* CSMA trace compression, gzip when the module is built with zlib. */
+  string asciiCompress = WorkTraceWriter::HasCompression() ? "gzip" : "none";
+  string asciiNodes = "";         /* Traced node ids, empty for all. */
+  string asciiEvents = "+-dr";    /* Traced event types. */
+  double asciiStart = 0;          /* Start of the traced interval in s. */
+  double asciiStop = 0;           /* End of the traced interval, 0 for all. */
+  string animMode = "light";      /* Animation, off, light or full. */
+  string animBackground = "";     /* Animation background image. */
+  string animSampler = "packets"; /* Drawn packets, packets or flows. */
+  uint32_t animSample = 100;      /* One packet or flow in animSample. */
+  double animSnapshot = 1.0;      /* Time between position snapshots. */
+  string memoryReport = "";       /* Heap usage report, empty to disable. */
+  uint32_t eventProfileTop = 10;  /* Callback types and nodes profiled. */
 
   // Allow the user to override any of the defaults and the above
   // Config::SetDefault()s at run-time, via command-line arguments
   CommandLine cmd(__FILE__);
-  cmd.AddValue("nNodes", "Number of nodes to place in the star", N);
-  cmd.AddValue("payloadSize", "Payload size in bytes", payloadSize);
-  cmd.AddValue("dataRate", "Application data ate", dataRate);
-  cmd.AddValue("phyRate", "Physical layer bitrate", phyRate);
-  cmd.AddValue("simulationTime", "Simulation time in seconds", simulationTime);
+  config.AddCommandLine(cmd);
+  runController.AddCommandLine(cmd);
   cmd.AddValue("pcap", "Enable/disable PCAP Tracing", pcapTracing);
-  cmd.Parse(argc, argv);
-
-  // Config::SetDefault("ns3::TcpL4Protocol::SocketType",
-  //                    TypeIdValue(TypeId::LookupByName("ns3::TcpNewReno")));
+  cmd.AddValue("pcapFile", "Merged pcapng capture file", pcapOut);
+  cmd.AddValue("pcapSnaplen", "Bytes captured per packet", pcapSnaplen);
+  cmd.AddValue("pcapNodes", "Comma separated captured node ids, empty for all",
+               pcapNodes);
+  cmd.AddValue("pcapTrigger",
+               "Capture only around triggers: connect (failed connection) "
+               "or rtt (round-trip time above pcapRtt), empty for everything",
+               pcapTrigger);
+  cmd.AddValue("pcapRtt", "Round-trip time trigger threshold in ms", pcapRtt);
+  cmd.AddValue("pcapPreTrigger", "Capture kept before a trigger in seconds",
+               pcapPreTrigger);
+  cmd.AddValue("pcapPostTrigger", "Capture written after a trigger in seconds",
+               pcapPostTrigger);
+  cmd.AddValue("verbose", "Enable the application logs", verbose);
+  cmd.AddValue("trace", "Binary event trace file, see work-trace-decoder",
+               traceFile);
+  cmd.AddValue("traceCapacity", "Records buffered by the event trace",
+               traceCapacity);
+  cmd.AddValue("traceRing", "Keep only the last traceCapacity records",
+               traceRing);
+  cmd.AddValue("stats", "Per-device statistics file", statsFile);
+  cmd.AddValue("statsFormat", "Statistics format, csv or binary",
+               statsFormat);
+  cmd.AddValue("statsInterval",
+               "Seconds between statistics snapshots, 0 for the end only",
+               statsInterval);
+  cmd.AddValue("flowFile", "Flow statistics file, empty to disable",
+               flowFile);
+  cmd.AddValue("flowFormat", "Flow statistics format, csv or json",
+               flowFormat);
+  cmd.AddValue("flowInterval", "Seconds between two flow statistics",
+               flowInterval);
+  cmd.AddValue("flowPort", "Export only the flows of this port, e.g. 50000",
+               flowPort);
+  cmd.AddValue("asciiTrace", "CSMA ASCII trace file, empty to disable",
+               asciiTrace);
+  cmd.AddValue("asciiCompression",
+               "CSMA trace compression, gzip (the default with zlib) or none",
+               asciiCompress);
+  cmd.AddValue("asciiNodes", "Comma separated traced node ids, empty for all",
+               asciiNodes);
+  cmd.AddValue("asciiEvents",
+               "Traced events: + enqueue, - dequeue, d drop, r receive",
+               asciiEvents);
+  cmd.AddValue("asciiStart", "Start of the traced interval in seconds",
+               asciiStart);
+  cmd.AddValue("asciiStop", "End of the traced interval in seconds, 0 for all",
+               asciiStop);
+  cmd.AddValue("anim", "Animation: off, light (sampled) or full", animMode);
+  cmd.AddValue("animBackground", "Animation background image", animBackground);
+  cmd.AddValue("animSampling",
+               "Light animation sampling, packets (1 in animSample) or flows "
+               "(address pairs)",
+               animSampler);
+  cmd.AddValue("animSample", "Light animation: draw one in animSample",
+               animSample);
+  cmd.AddValue("animSnapshot",
+               "Light animation: seconds between position snapshots",
+               animSnapshot);
+  cmd.AddValue("memoryReport",
+               "JSON heap usage report by component, node and object, "
+               "empty to disable (bytes need --enable-work-memory-hooks)",
+               memoryReport);
+  cmd.AddValue("eventProfileTop",
+               "Callback types and nodes printed by --eventProfile, by wall "
+               "time",
+               eventProfileTop);
+  WorkScenarioFile scenarioFile; // --scenario, read before the options
+  scenarioFile.Parse(cmd, argc, argv);
 
-  /* Configure TCP Options */
-  Config::SetDefault("ns3::TcpSocket::SegmentSize", UintegerValue(payloadSize));
+  // Users may find it convenient to turn on explicit debugging
+  // for selected modules; the below lines suggest how to do this
+  if (verbose) {
+    LogComponentEnable("EXAMPLE", LOG_LEVEL_ALL);
+    LogComponentEnable("DeviceEnforcer", LOG_LEVEL_ALL);
+    LogComponentEnable("WorkServer", LOG_LEVEL_ALL);
+    // LogComponentEnable("ArpL3Protocol", LOG_LEVEL_INFO);
+  }
+  NS_ABORT_MSG_IF(config.sendDriver == "global" &&
+                      (!traceFile.empty() || !memoryReport.empty()),
+                  "The global send driver misattributes the events to "
+                  "nodes, trace and report the memory without it");
+  if (!traceFile.empty()) {
+    WorkEventTrace::Enable(traceFile, traceCapacity, traceRing);
+  }
 
-  // Config::SetDefault("ns3::ArpCache::DeadTimeout",
-  //                    TimeValue(MilliSeconds(500)));
-  // Config::SetDefault("ns3::ArpCache::WaitReplyTimeout",
-  //                    TimeValue(MilliSeconds(200)));
-  // Config::SetDefault("ns3::ArpCache::MaxRetries", UintegerValue(10));
-  // Config::SetDefault("ns3::ArpCache::PendingQueueSize",
-  //                    UintegerValue(NUMBER_OF_DEVICES));
+  WorkScenario scenario(config);
+  scenario.Configure();
+  WorkMemoryAccounting memory;
+  memory.Snapshot("start");
 
   //----------------------------------------------------------------------------------
   // Topology configuration
   //----------------------------------------------------------------------------------
 
-  WifiMacHelper wifiMac;
-  WifiHelper wifiHelper;
-  WifiStandard wifiStandard = WIFI_STANDARD_80211n_2_4GHZ;
-  wifiHelper.SetStandard(wifiStandard);
-  Config::SetDefault("ns3::LogDistancePropagationLossModel::ReferenceLoss",
-                     DoubleValue(40.046));
-
-  /* Set up Legacy Channel */
-  YansWifiChannelHelper wifiChannel = YansWifiChannelHelper::Default();
-  // wifiChannel.SetPropagationDelay("ns3::ConstantSpeedPropagationDelayModel");
-  // wifiChannel.AddPropagationLoss("ns3::FriisPropagationLossModel",
-  // "Frequency",
-  //                                DoubleValue(5e9));
-
-  /* Setup Physical Layer */
-  YansWifiPhyHelper wifiPhy;
-  wifiPhy.SetChannel(wifiChannel.Create());
-  // Set MIMO capabilities
-  // wifiPhy.Set("Antennas", UintegerValue(4));
-  // wifiPhy.Set("MaxSupportedTxSpatialStreams", UintegerValue(4));
-  // wifiPhy.Set("MaxSupportedRxSpatialStreams", UintegerValue(4));
-  // wifiPhy.SetErrorRateModel("ns3::YansErrorRateModel");
-  // wifiHelper.SetRemoteStationManager("ns3::AarfWifiManager");
-  // wifiHelper.SetRemoteStationManager("ns3::IdealWifiManager");
-  wifiHelper.SetRemoteStationManager("ns3::ConstantRateWifiManager", "DataMode",
-                                     StringValue(phyRate), "ControlMode",
-                                     StringValue("ErpOfdmRate24Mbps"));
-
-  // Here, we will create N nodes in a star.
-  NS_LOG_INFO("Create nodes.");
-  uint32_t nServers = 1;
-  uint32_t nAps = 1;
-  NodeContainer serverNode;
-  serverNode.Create(nServers);
-  NodeContainer apNode;
-  apNode.Create(nAps);
-  NodeContainer staNodes;
-  staNodes.Create(N);
-  NodeContainer allNodes = NodeContainer(serverNode, apNode, staNodes);
-
-  NodeContainer serverAp = NodeContainer(serverNode.Get(0), apNode.Get(0));
-  CsmaHelper csma;
-  csma.SetChannelAttribute("DataRate", StringValue("100Mbps"));
-  csma.SetChannelAttribute("Delay", StringValue("1ms"));
-  NetDeviceContainer serverApDevice = csma.Install(serverAp);
-
-  /* Configure AP */
-  NS_LOG_INFO("Configure AP");
-  Ssid ssid = Ssid("network");
-  wifiMac.SetType("ns3::ApWifiMac", "Ssid", SsidValue(ssid));
-
-  NetDeviceContainer apDevice;
-  apDevice = wifiHelper.Install(wifiPhy, wifiMac, apNode);
-
-  /* Configure STA */
-  NS_LOG_INFO("Configure STA");
-  wifiMac.SetType("ns3::StaWifiMac", "Ssid", SsidValue(ssid));
-
-  NetDeviceContainer staDevices;
-  staDevices = wifiHelper.Install(wifiPhy, wifiMac, staNodes);
-
-  Config::Set("/NodeList//DeviceList//$ns3::WifiNetDevice/HtConfiguration/"
-              "ShortGuardIntervalSupported",
-              BooleanValue(true));
-
-  NS_LOG_INFO("Configure Bridge");
-  BridgeHelper bridge;
-  NetDeviceContainer bridgeDev;
-  bridgeDev =
-      bridge.Install(apNode.Get(0), NetDeviceContainer(apDevice.Get(0),
-                                                       serverApDevice.Get(1)));
-
-  /* Mobility model */
-  NS_LOG_INFO("Configure mobility");
-  MobilityHelper mobility;
-  Ptr<ListPositionAllocator> positionAlloc =
-      CreateObject<ListPositionAllocator>();
-  positionAlloc->Add("data/positions.csv");
-
-  mobility.SetPositionAllocator(positionAlloc);
-  mobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
-  mobility.Install(allNodes);
-
-  // Install network stacks on the nodes
-  InternetStackHelper internet;
-  internet.Install(allNodes);
-
-  // Later, we add IP addresses.
-  NS_LOG_INFO("Assign IP Addresses.");
-  Ipv4AddressHelper address;
-  address.SetBase("192.168.0.0", "255.255.255.0");
-  Ipv4InterfaceContainer serverApInterface =
-      address.Assign(serverApDevice.Get(0));
-  Ipv4InterfaceContainer apInterface = address.Assign(bridgeDev);
-  Ipv4InterfaceContainer staInterface = address.Assign(staDevices);
+  // Here, we will create nNodes devices in a star.
+  scenario.BuildTopology();
+  NodeContainer serverNode = scenario.GetServerNode();
+  NodeContainer apNode = scenario.GetApNode();
+  NodeContainer staNodes = scenario.GetStaNodes();
+  NetDeviceContainer serverApDevice = scenario.GetServerApDevices();
 
   // Turn on global static routing
   // Ipv4GlobalRoutingHelper::PopulateRoutingTables();
@@ -273,60 +326,129 @@ int main(int argc, char *argv[]) {
   // Applications configuration
   //----------------------------------------------------------------------------------
 
-  appsConfiguration(serverApInterface, start, stop, serverNode, staNodes,
-                    staInterface, dataRate);
+  scenario.InstallApplications();
+  Ptr<WorkAggregator> aggregatorApp = scenario.GetAggregator();
+  for (uint32_t i = 0; i < scenario.GetDevices().size(); ++i) {
+    scenario.GetDevices()[i]->TraceConnectWithoutContext(
+        "Rtt", MakeBoundCallback(&ClassRttTrace, scenario.GetDeviceClass(i)));
+    scenario.GetDevices()[i]->TraceConnectWithoutContext(
+        "Rtt",
+        MakeBoundCallback(&ProfileRttTrace, scenario.GetDeviceProfile(i)));
+  }
+  memory.Snapshot("build");
 
   //----------------------------------------------------------------------------------
   // Output configuration
   //----------------------------------------------------------------------------------
 
   /* Enable Traces */
+  // One time-ordered capture of the selected nodes, optionally only around
+  // the triggers
+  WorkPcapngWriter pcapWriter;
   if (pcapTracing) {
-    wifiPhy.SetPcapDataLinkType(WifiPhyHelper::DLT_IEEE802_11_RADIO);
-    wifiPhy.EnablePcap("AccessPoint", apDevice);
-    wifiPhy.EnablePcap("Station", staDevices);
-    csma.EnablePcap("Server", serverApDevice);
+    set<uint32_t> nodes = parseNodeList(pcapNodes);
+    NetDeviceContainer devices(serverApDevice, scenario.GetApDevices());
+    devices.Add(scenario.GetStaDevices());
+    pcapWriter.Open(pcapOut, pcapSnaplen);
+    for (uint32_t i = 0; i < devices.GetN(); ++i) {
+      Ptr<NetDevice> device = devices.Get(i);
+      uint32_t node = device->GetNode()->GetId();
+      if (nodes.empty() || nodes.count(node)) {
+        pcapWriter.AddDevice(device, "node" + to_string(node) + "-dev" +
+                                         to_string(device->GetIfIndex()));
+      }
+    }
+    if (pcapTrigger == "connect") {
+      pcapWriter.SetTrigger(Seconds(pcapPreTrigger), Seconds(pcapPostTrigger));
+      Config::ConnectWithoutContext(
+          "/NodeList/*/ApplicationList/*/$ns3::DeviceEnforcer/Event",
+          MakeBoundCallback(&PcapEventTrigger, &pcapWriter));
+    } else if (pcapTrigger == "rtt") {
+      pcapWriter.SetTrigger(Seconds(pcapPreTrigger), Seconds(pcapPostTrigger));
+      Config::ConnectWithoutContext(
+          "/NodeList/*/ApplicationList/*/$ns3::DeviceEnforcer/Rtt",
+          MakeBoundCallback(&PcapRttTrigger, &pcapWriter,
+                            MilliSeconds(pcapRtt)));
+    } else {
+      NS_ABORT_MSG_IF(!pcapTrigger.empty(),
+                      "Unknown capture trigger " << pcapTrigger);
+    }
   }
 
   // configure tracing
   AsciiTraceHelper ascii;
   // mobility.EnableAsciiAll(ascii.CreateFileStream("trace.tr"));
-  csma.EnableAsciiAll(ascii.CreateFileStream("trace.tr"));
+  // Filtered CSMA trace, compressed on a background thread
+  WorkTraceWriter traceWriter;
+  if (!asciiTrace.empty()) {
+    NS_ABORT_MSG_IF(asciiCompress != "gzip" && asciiCompress != "none",
+                    "Unknown trace compression " << asciiCompress);
+    uint32_t events = 0;
+    const string eventTags = "+-dr";
+    for (uint32_t i = 0; i < eventTags.size(); ++i) {
+      if (asciiEvents.find(eventTags[i]) != string::npos) {
+        events |= 1 << i; // WorkTraceWriter::EventType
+      }
+    }
+    traceWriter.Open(asciiTrace, asciiCompress == "gzip"
+                                     ? WorkTraceWriter::GZIP
+                                     : WorkTraceWriter::NONE);
+    traceWriter.SetNodes(parseNodeList(asciiNodes));
+    traceWriter.SetEvents(events);
+    traceWriter.SetTimeWindow(Seconds(asciiStart), Seconds(asciiStop));
+    traceWriter.Install(serverApDevice);
+  }
 
   /* Stop Simulation */
-  Simulator::Stop(Seconds(simulationTime + 1));
-
-  // 40mx28m
-  AnimationInterface anim("animation.xml");
-  anim.SetBackgroundImage(
-      "/home/grosa/Dev/ns-allinone-3.35/ns-3.35/data/home-design.png", 0, 0,
-      0.07, 0.07, 1.0);
-  for (uint32_t i = 0; i < staNodes.GetN(); ++i) {
-    Ptr<Node> node = staNodes.Get(i);
-    anim.UpdateNodeDescription(node, to_string(i)); // Optional
-    anim.UpdateNodeColor(node, 255, 0, 0);          // Optional
-    anim.UpdateNodeSize(node->GetId(), 0.8, 0.8);
-  }
-  for (uint32_t i = 0; i < apNode.GetN(); ++i) {
-    Ptr<Node> node = apNode.Get(i);
-    anim.UpdateNodeDescription(node, "AP"); // Optional
-    anim.UpdateNodeColor(node, 0, 255, 0);  // Optional
-    anim.UpdateNodeSize(node->GetId(), 0.8, 0.8);
-  }
-  for (uint32_t i = 0; i < serverNode.GetN(); ++i) {
-    Ptr<Node> node = serverNode.Get(i);
-    anim.UpdateNodeDescription(node, "Local Server"); // Optional
-    anim.UpdateNodeColor(node, 0, 0, 255);            // Optional
-    anim.UpdateNodeSize(node->GetId(), 1.2, 1.2);
+  Simulator::Stop(scenario.GetStopTime());
+
+  // Animation: off costs nothing, light samples packets and positions,
+  // full records every packet with AnimationInterface
+  // 40mx28m background: e.g. --animBackground=data/home-design.png
+  unique_ptr<AnimationInterface> anim;
+  WorkAnimWriter animWriter;
+  if (animMode == "full") {
+    anim.reset(new AnimationInterface("animation.xml"));
+    if (!animBackground.empty()) {
+      anim->SetBackgroundImage(animBackground, 0, 0, 0.07, 0.07, 1.0);
+    }
+    annotateNodes(*anim, serverNode, apNode, staNodes);
+    anim->EnablePacketMetadata();
+    anim->EnableIpv4RouteTracking("anim.txt", Seconds(0),
+                                  scenario.GetStopTime(), Seconds(5));
+  } else if (animMode == "light") {
+    NS_ABORT_MSG_IF(animSampler != "packets" && animSampler != "flows",
+                    "Unknown animation sampling " << animSampler);
+    animWriter.Open("animation.xml");
+    if (!animBackground.empty()) {
+      animWriter.SetBackgroundImage(animBackground, 0, 0, 0.07, 0.07, 1.0);
+    }
+    animWriter.SetSampling(animSampler == "flows"
+                               ? WorkAnimWriter::SAMPLE_FLOWS
+                               : WorkAnimWriter::SAMPLE_PACKETS,
+                           animSample);
+    animWriter.Install(NodeContainer(serverNode, apNode, staNodes));
+    animWriter.SetSnapshotInterval(Seconds(animSnapshot));
+    annotateNodes(animWriter, serverNode, apNode, staNodes);
+  } else {
+    NS_ABORT_MSG_IF(animMode != "off", "Unknown animation mode " << animMode);
   }
-  anim.EnablePacketMetadata();
-  anim.EnableIpv4RouteTracking("anim.txt", Seconds(0), Seconds(200),
-                               Seconds(5));
 
-  // Flow monitor
-  Ptr<FlowMonitor> flowMonitor;
+  // Flow monitor, exported and reset every flowInterval
   FlowMonitorHelper flowHelper;
-  flowMonitor = flowHelper.InstallAll();
+  WorkFlowExporter flowExporter;
+  if (!flowFile.empty()) {
+    NS_ABORT_MSG_IF(flowFormat != "csv" && flowFormat != "json",
+                    "Unknown flow statistics format " << flowFormat);
+    Ptr<FlowMonitor> flowMonitor = flowHelper.InstallAll();
+    Ptr<Ipv4FlowClassifier> classifier =
+        DynamicCast<Ipv4FlowClassifier>(flowHelper.GetClassifier());
+    flowExporter.SetPortFilter(flowPort);
+    flowExporter.Start(
+        flowMonitor, classifier, flowFile,
+        flowFormat == "json" ? WorkFlowExporter::JSON : WorkFlowExporter::CSV,
+        Seconds(flowInterval));
+  }
 
   // Trace routing tables
   // Ipv4GlobalRoutingHelper g;
@@ -338,12 +460,180 @@ int main(int argc, char *argv[]) {
   // Call simulation
   //----------------------------------------------------------------------------------
 
+  // Request latency and airtime, to compare the transports
+  Config::ConnectWithoutContext(
+      "/NodeList/*/ApplicationList/*/$ns3::DeviceEnforcer/Rtt",
+      MakeCallback(&RttTrace));
+  Config::ConnectWithoutContext(
+      "/NodeList/*/DeviceList/*/$ns3::WifiNetDevice/Phy/State/State",
+      MakeCallback(&PhyStateTrace));
+  // Rate trajectory of every device, "time context bitrate" lines
+  if (config.rateControl != "None") {
+    Config::Connect(
+        "/NodeList/*/ApplicationList/*/$ns3::DeviceEnforcer/RateChange",
+        MakeBoundCallback(&RateTrace, ascii.CreateFileStream("rate.tr")));
+  }
+
+  // Per-device event counters
+  WorkEventCounters eventCounters;
+  eventCounters.Install();
+  WorkStatsCollector statsCollector;
+  if (!statsFile.empty()) {
+    NS_ABORT_MSG_IF(statsFormat != "csv" && statsFormat != "binary",
+                    "Unknown statistics format " << statsFormat);
+    statsCollector.Install(config.nDevices);
+    statsCollector.Export(statsFile,
+                          statsFormat == "binary" ? WorkStatsCollector::BINARY
+                                                  : WorkStatsCollector::CSV,
+                          Seconds(statsInterval));
+  }
+  // Batches start with the devices, one second after the server
+  runController.Install(Seconds(config.start + 1.0));
+  memory.Install();
+
   NS_LOG_INFO("Run Simulation.");
+  auto runStart = chrono::steady_clock::now();
   Simulator::Run();
+  chrono::duration<double> runTime = chrono::steady_clock::now() - runStart;
+
+  uint64_t retransmissions = 0;
+  uint64_t timeouts = 0;
+  uint64_t offeredLoad = 0;
+  set<Ptr<WorkSendDriver>> drivers;
+  for (Ptr<DeviceEnforcer> app : scenario.GetDevices()) {
+    retransmissions += app->m_retransmissions;
+    timeouts += app->m_timeouts;
+    offeredLoad += app->m_cbrRate.GetBitRate();
+    if (app->m_sendDriver) {
+      drivers.insert(app->m_sendDriver);
+    }
+  }
+  double meanRtt = 0.0;
+  for (double rtt : g_rtts) {
+    meanRtt += rtt / g_rtts.size();
+  }
+  cout << "Protocol " << config.protocol << ": " << g_rtts.size()
+       << " responses, RTT mean " << meanRtt << " ms, p50 "
+       << percentile(g_rtts, 50) << " ms, p99 " << percentile(g_rtts, 99)
+       << " ms" << endl;
+  for (auto &classRtts : g_classRtts) {
+    cout << "  " << classRtts.first << ": " << classRtts.second.size()
+         << " responses, RTT p50 " << percentile(classRtts.second, 50)
+         << " ms, p99 " << percentile(classRtts.second, 99) << " ms, p99.9 "
+         << percentile(classRtts.second, 99.9) << " ms" << endl;
+  }
+  // Load and latency of every kind of device
+  for (const WorkDeviceProfile &profile : scenario.GetProfiles()) {
+    uint32_t devices = 0;
+    uint64_t sent = 0;
+    uint64_t failures = 0;
+    for (uint32_t i = 0; i < scenario.GetDevices().size(); ++i) {
+      if (scenario.GetDeviceProfile(i) == profile.name) {
+        devices++;
+        sent += eventCounters.Get(i, WORK_TRACE_DEVICE_SEND);
+        failures += eventCounters.Get(i, WORK_TRACE_DEVICE_ABANDON) +
+                    eventCounters.Get(i, WORK_TRACE_DEVICE_CONNECT_FAILED);
+      }
+    }
+    vector<double> &rtts = g_profileRtts[profile.name];
+    cout << "  Profile " << profile.name << ": " << devices << " devices, "
+         << sent << " requests, " << rtts.size() << " responses, "
+         << failures << " failures, RTT p50 " << percentile(rtts, 50)
+         << " ms, p99 " << percentile(rtts, 99) << " ms" << endl;
+  }
+  cout << "Retransmissions " << retransmissions << ", abandoned requests "
+       << timeouts << endl;
+  cout << "Final offered load " << DataRate(offeredLoad) << endl;
+  eventCounters.Print(cout);
+  if (runController.IsEnabled()) {
+    cout << "Run " << runController.GetOutcomeName() << " at "
+         << Simulator::Now().GetSeconds() << " s after "
+         << runController.GetBatches() << " batches, warm-up "
+         << runController.GetWarmup() << " batches";
+    if (runController.GetOutcome() == WorkRunController::FAILED) {
+      cout << ": " << runController.GetReason();
+    }
+    cout << endl;
+    cout << "  throughput "
+         << runController.GetMean(WorkRunController::THROUGHPUT) << " +- "
+         << runController.GetHalfWidth(WorkRunController::THROUGHPUT)
+         << " responses/s, RTT mean "
+         << runController.GetMean(WorkRunController::RTT_MEAN) << " +- "
+         << runController.GetHalfWidth(WorkRunController::RTT_MEAN)
+         << " ms, p99 " << runController.GetMean(WorkRunController::RTT_P99)
+         << " +- " << runController.GetHalfWidth(WorkRunController::RTT_P99)
+         << " ms" << endl;
+  }
+  if (!drivers.empty()) {
+    uint64_t fired = 0;
+    uint64_t dispatched = 0;
+    for (Ptr<WorkSendDriver> driver : drivers) {
+      fired += driver->GetFired();
+      dispatched += driver->GetDispatched();
+    }
+    cout << "Send driver " << config.sendDriver << ": " << dispatched
+         << " sends in " << fired << " events, occupancy "
+         << (fired ? double(dispatched) / fired : 0.0) << endl;
+  }
+  cout << "Wi-Fi airtime " << g_airtime.As(Time::S) << ", simulator events "
+       << Simulator::GetEventCount() << endl;
+  cout << "Scheduler " << config.scheduler << ": " << runTime.count()
+       << " s of run time for " << config.nDevices << " devices" << endl;
+
+  if (aggregatorApp) {
+    const WorkDecisionCache &cache = aggregatorApp->GetCache();
+    uint64_t lookups = cache.GetHits() + cache.GetMisses();
+    cout << "Aggregator forwarded " << aggregatorApp->GetForwarded()
+         << " requests in " << aggregatorApp->GetBatches()
+         << " batches, relayed " << aggregatorApp->GetRelayed()
+         << " responses" << endl;
+    cout << "Mean upstream latency "
+         << aggregatorApp->GetMeanUpstreamLatency().As(Time::MS) << endl;
+    if (cache.IsEnabled()) {
+      cout << "Cache hits " << cache.GetHits() << " ("
+           << percentage(cache.GetHits(), lookups) << "), misses "
+           << cache.GetMisses() << ", expirations " << cache.GetExpirations()
+           << ", evictions " << cache.GetEvictions() << ", invalidations "
+           << cache.GetInvalidations() << endl;
+    }
+  }
+  if (config.eventProfile) {
+    ProfilingScheduler::Print(cout, eventProfileTop);
+  }
+  if (!memoryReport.empty()) {
+    WorkJson report = memory.GetReport(staNodes);
+    WorkMemoryAccounting::Print(report, cout);
+    ofstream reportFile(memoryReport);
+    NS_ABORT_MSG_IF(!reportFile, "Cannot open " << memoryReport);
+    report.Dump(reportFile);
+    reportFile << endl;
+  }
+  if (WorkEventTrace::IsEnabled()) {
+    cout << "Event trace " << traceFile << ": "
+         << WorkEventTrace::GetRecorded() << " records, "
+         << WorkEventTrace::GetOverwritten() << " overwritten" << endl;
+  }
   Simulator::Destroy();
   NS_LOG_INFO("Done.");
-
-  flowMonitor->SerializeToXmlFile("flow.xml", true, true);
+  if (animMode == "light") {
+    cout << "Animation: " << animWriter.GetPackets() << " packets, "
+         << animWriter.GetBytes() << " bytes, " << animWriter.GetOverhead()
+         << " s in the writer" << endl;
+  }
+  if (pcapTracing) {
+    cout << "Capture " << pcapOut << ": " << pcapWriter.GetPackets()
+         << " packets, " << pcapWriter.GetTriggers() << " triggers" << endl;
+  }
+  if (!asciiTrace.empty()) {
+    cout << "CSMA trace " << asciiTrace << ": " << traceWriter.GetLines()
+         << " lines, " << traceWriter.GetBytesTraced() << " bytes traced, "
+         << traceWriter.GetBytesWritten() << " bytes written, writer stalls "
+         << traceWriter.GetStallTime() << " s" << endl;
+  }
+  if (!flowFile.empty()) {
+    cout << "Flow statistics " << flowFile << ": "
+         << flowExporter.GetRecords() << " records" << endl;
+  }
 
   return 0;
 }
@@ -0,0 +1,247 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+// Parameter sweep of the work scenario over all the cores.
+//
+// The grid lists the values of the scenario options, e.g.
+//   --grid="nNodes=29,100,500;dataRate=1Mbps,10Mbps;phyRate=HtMcs7"
+// Every point of the grid is run --replications times with RngRun
+// runBase, runBase + 1, ... Each run is an independent process, --jobs at
+// a time (all the cores by default).
+//
+// Each completed run is appended to the --results file as a JSON line with
+// its point, run number and metrics (see WorkRunner), and the options
+// outside of the grid. When the sweep is started again with the same
+// results file and options, the runs already there are skipped, so an
+// interrupted sweep resumes where it stopped. At the end the
+// runs of each point are merged in the --summary CSV file: mean and
+// half-width of the 95% confidence interval of every metric.
+//
+// With --runBatch, each run stops as soon as its metrics converged or a
+// failure condition is hit, see WorkRunController and the run* options.
+//
+// ./waf --run "scratch/work-sweep --grid=nNodes=29,100 --replications=10"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/work-json.h"
+#include "ns3/work-run-controller.h"
+#include "ns3/work-runner.h"
+#include "ns3/work-scenario.h"
+#include "ns3/work-utils.h"
+
+using namespace ns3;
+using namespace std;
+
+NS_LOG_COMPONENT_DEFINE("WorkSweep");
+
+/**
+ * \brief Split a string
+ * \param text the string
+ * \param separator the separator
+ * \return the non-empty parts
+ */
+vector<string> split(const string &text, char separator) {
+  vector<string> parts;
+  stringstream items(text);
+  string item;
+  while (getline(items, item, separator)) {
+    if (!item.empty()) {
+      parts.push_back(item);
+    }
+  }
+  return parts;
+}
+
+/**
+ * \brief Expand a grid in its points
+ * \param grid the grid, "name=v1,v2;name=v1"
+ * \return the points, each a list of "name=value" parameters
+ */
+vector<vector<string>> expandGrid(const string &grid) {
+  vector<vector<string>> points(1);
+  for (const string &axis : split(grid, ';')) {
+    size_t equal = axis.find('=');
+    NS_ABORT_MSG_IF(equal == string::npos, "Bad grid axis " << axis);
+    string name = axis.substr(0, equal);
+    vector<vector<string>> expanded;
+    for (const vector<string> &point : points) {
+      for (const string &value : split(axis.substr(equal + 1), ',')) {
+        expanded.push_back(point);
+        expanded.back().push_back(name + "=" + value);
+      }
+    }
+    points = expanded;
+  }
+  return points;
+}
+
+/**
+ * \param point the parameters of a point
+ * \return the key of the point, its parameters joined
+ */
+string pointKey(const vector<string> &point) {
+  string key;
+  for (const string &parameter : point) {
+    key += (key.empty() ? "" : ";") + parameter;
+  }
+  return key;
+}
+
+int main(int argc, char *argv[]) {
+  WorkScenarioConfig config;       /* Parameters outside of the grid. */
+  WorkRunController controller;    /* Early stop of the runs. */
+  string grid = "";                /* Swept parameters. */
+  uint32_t replications = 5;       /* Runs per point. */
+  uint32_t runBase = 1;            /* RngRun of the first replication. */
+  uint32_t jobs = 0;               /* Runs at a time, 0 for all cores. */
+  string results = "sweep.jsonl";  /* Completed runs, one per line. */
+  string summary = "sweep.csv";    /* Confidence intervals per point. */
+
+  CommandLine cmd(__FILE__);
+  config.AddCommandLine(cmd);
+  controller.AddCommandLine(cmd);
+  cmd.AddValue("grid", "Swept parameters, e.g. nNodes=29,100;dataRate=1Mbps",
+               grid);
+  cmd.AddValue("replications", "Runs of each point", replications);
+  cmd.AddValue("runBase", "RngRun of the first replication", runBase);
+  cmd.AddValue("jobs", "Runs at a time, 0 for the number of cores", jobs);
+  cmd.AddValue("results", "Completed runs, read again to resume", results);
+  cmd.AddValue("summary", "Mean and 95% confidence interval per point",
+               summary);
+  WorkScenarioFile scenarioFile; // --scenario, read before the options
+  scenarioFile.Parse(cmd, argc, argv, false);
+
+  vector<vector<string>> points = expandGrid(grid);
+  for (const vector<string> &point : points) {
+    WorkScenarioConfig checked = config;
+    WorkRunner::Apply(checked, point); // Unknown options abort here
+  }
+
+  // The runs are only reused for the same options outside of the grid and
+  // the same run controller settings
+  set<string> axes;
+  for (const string &axis : split(grid, ';')) {
+    axes.insert(axis.substr(0, axis.find('=')));
+  }
+  ostringstream scenario;
+  scenario << config.GetKey(axes);
+  if (controller.IsEnabled()) {
+    scenario << ";" << controller.GetSettings(); // Early stops differ
+  }
+
+  // Runs completed by a previous sweep
+  map<string, map<uint32_t, WorkJson>> done;
+  bool partialLine = false;
+  {
+    ifstream previous(results);
+    string line;
+    while (getline(previous, line)) {
+      WorkJson record;
+      string error;
+      partialLine = previous.eof();
+      if (WorkJson::Parse(line, record, error) &&
+          record["scenario"].GetString() == scenario.str() &&
+          !record["metrics"].Has("error")) {
+        uint32_t run = record["run"].GetNumber();
+        done[record["point"].GetString()][run] = record["metrics"];
+      }
+    }
+  }
+
+  WorkProcessPool pool(jobs);
+  vector<pair<string, uint32_t>> submitted;
+  for (const vector<string> &point : points) {
+    for (uint32_t run = runBase; run < runBase + replications; ++run) {
+      if (done[pointKey(point)].count(run)) {
+        continue;
+      }
+      pool.Submit([config, controller, point, run]() {
+        WorkScenarioConfig pointConfig = config;
+        WorkRunner::Apply(pointConfig, point);
+        return WorkRunner::Run(pointConfig, run, controller);
+      });
+      submitted.push_back(make_pair(pointKey(point), run));
+    }
+  }
+  cout << points.size() << " points, " << submitted.size() << " runs to do ("
+       << points.size() * replications - submitted.size()
+       << " already done), " << pool.GetJobs() << " at a time" << endl;
+
+  ofstream out(results, ios::app);
+  NS_ABORT_MSG_IF(!out, "Cannot open " << results);
+  if (partialLine) {
+    out << endl; // The interrupted line stays unreadable, alone
+  }
+  uint32_t completed = 0;
+  uint32_t failed = 0;
+  pool.Run([&](uint32_t index, const WorkJson &metrics) {
+    const string &key = submitted[index].first;
+    uint32_t run = submitted[index].second;
+    WorkJson record = WorkJson::Object();
+    record.Set("scenario", scenario.str());
+    record.Set("point", key);
+    record.Set("run", run);
+    record.Set("metrics", metrics);
+    record.Dump(out, 0);
+    out << endl; // Flushed, a completed run survives an interruption
+    completed++;
+    cout << "[" << completed << "/" << submitted.size() << "] " << key
+         << " run " << run << ": ";
+    if (metrics.Has("error")) {
+      cout << metrics["error"].GetString() << endl;
+      failed++;
+      return;
+    }
+    done[key][run] = metrics;
+    cout << metrics["wall"].GetNumber() << " s" << endl;
+  });
+
+  // Confidence intervals of every metric, per point
+  ofstream csv(summary);
+  NS_ABORT_MSG_IF(!csv, "Cannot open " << summary);
+  vector<string> metrics;
+  for (const vector<string> &point : points) {
+    for (auto &run : done[pointKey(point)]) {
+      for (auto &member : run.second.GetMembers()) {
+        if (member.second.IsNumber() &&
+            find(metrics.begin(), metrics.end(), member.first) ==
+                metrics.end()) {
+          metrics.push_back(member.first);
+        }
+      }
+    }
+  }
+  csv << "point,replications";
+  for (const string &metric : metrics) {
+    csv << "," << metric << "," << metric << "Ci";
+  }
+  csv << endl;
+  for (const vector<string> &point : points) {
+    string key = pointKey(point);
+    const map<uint32_t, WorkJson> &runs = done[key];
+    csv << "\"" << key << "\"," << runs.size();
+    for (const string &metric : metrics) {
+      vector<double> values;
+      for (auto &run : runs) {
+        values.push_back(run.second[metric].GetNumber());
+      }
+      double mean = 0.0;
+      double ci = confidenceInterval(values, mean);
+      csv << "," << mean << "," << ci;
+    }
+    csv << endl;
+  }
+  cout << "Summary of " << points.size() << " points in " << summary << endl;
+  return failed ? 1 : 0;
+}
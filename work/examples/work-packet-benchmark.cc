@@ -0,0 +1,166 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+// Count the heap allocations needed to send a request.
+//
+// The first part builds requests the way DeviceEnforcer used to, a fresh
+// zero-padded string copied in a new packet, and the way it does now, a
+// copy of a payload template with the message header added in front. The
+// template is framed with its padding written in the buffer and kept as a
+// virtual zero area: every copy but the first reallocates the bytes of the
+// buffer to write its header, so only the zero area avoids copying the
+// padding for each request.
+// The second part runs a DeviceEnforcer and a WorkServer over a simple
+// channel and reports the allocations of the whole simulation per request
+// sent.
+
+#include "ns3/core-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/network-module.h"
+#include "ns3/work-device-enforcer.h"
+#include "ns3/work-message.h"
+#include "ns3/work-server.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+using namespace ns3;
+using namespace std;
+
+// Allocation counters, updated by the replaced global operator new
+static uint64_t g_allocations = 0; /* Number of allocations. */
+static uint64_t g_bytes = 0;       /* Bytes allocated. */
+
+void *operator new(size_t size) {
+  g_allocations++;
+  g_bytes += size;
+  void *p = malloc(size ? size : 1);
+  if (!p) {
+    throw bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+uint64_t g_sent = 0; /* Requests sent in the simulation. */
+
+void TxTrace(Ptr<const Packet> packet) { g_sent++; }
+
+/**
+ * \brief Report the allocations of a packet building loop
+ * \param name the name of the method
+ * \param count the number of packets built
+ * \param allocations the allocations before the loop
+ * \param bytes the bytes allocated before the loop
+ * \param start the time the loop started
+ */
+void Report(string name, uint32_t count, uint64_t allocations, uint64_t bytes,
+            chrono::steady_clock::time_point start) {
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+  cout << name << ": " << double(g_allocations - allocations) / count
+       << " allocations and " << double(g_bytes - bytes) / count
+       << " bytes per packet, " << elapsed.count() * 1e9 / count
+       << " ns per packet" << endl;
+}
+
+int main(int argc, char *argv[]) {
+  uint32_t count = 1000000;   /* Packets built per method. */
+  uint32_t packetSize = 1448; /* Request size in bytes. */
+  double simulationTime = 10; /* Simulated seconds of the send path. */
+  string dataRate = "10Mbps"; /* Device data rate. */
+
+  CommandLine cmd(__FILE__);
+  cmd.AddValue("count", "Packets built per method", count);
+  cmd.AddValue("packetSize", "Request size in bytes", packetSize);
+  cmd.AddValue("simulationTime", "Simulated seconds of the send path",
+               simulationTime);
+  cmd.AddValue("dataRate", "Device data rate", dataRate);
+  cmd.Parse(argc, argv);
+
+  WorkMessageHeader messageHeader;
+  uint32_t padding = packetSize - messageHeader.GetSerializedSize();
+
+  // Fresh string and buffer for every packet
+  uint64_t allocations = g_allocations;
+  uint64_t bytes = g_bytes;
+  auto start = chrono::steady_clock::now();
+  for (uint32_t i = 0; i < count; ++i) {
+    string message = "[Message!]";
+    Ptr<Packet> packet = WorkMessageFramer::Frame(WorkMessageHeader::REQUEST,
+                                                  i, message, padding);
+  }
+  Report("Fresh payload", count, allocations, bytes, start);
+
+  // Copy on write of a payload template with the padding in its bytes
+  string padded = "[Message!]";
+  padded.resize(padding, '\0');
+  Ptr<Packet> payload = Create<Packet>(
+      reinterpret_cast<const uint8_t *>(padded.data()), padded.size());
+  allocations = g_allocations;
+  bytes = g_bytes;
+  start = chrono::steady_clock::now();
+  for (uint32_t i = 0; i < count; ++i) {
+    Ptr<Packet> packet =
+        WorkMessageFramer::Frame(WorkMessageHeader::REQUEST, i, payload);
+  }
+  Report("Payload template, padding in the buffer", count, allocations,
+         bytes, start);
+
+  // Copy on write of a payload template with a virtual zero padding
+  payload = WorkMessageFramer::MakePayload("[Message!]", padding);
+  allocations = g_allocations;
+  bytes = g_bytes;
+  start = chrono::steady_clock::now();
+  for (uint32_t i = 0; i < count; ++i) {
+    Ptr<Packet> packet =
+        WorkMessageFramer::Frame(WorkMessageHeader::REQUEST, i, payload);
+  }
+  Report("Payload template", count, allocations, bytes, start);
+
+  // Whole send path, one device and the server on a simple channel
+  NodeContainer nodes;
+  nodes.Create(2);
+  SimpleNetDeviceHelper simple;
+  NetDeviceContainer devices = simple.Install(nodes);
+  InternetStackHelper internet;
+  internet.Install(nodes);
+  Ipv4AddressHelper address;
+  address.SetBase("10.0.0.0", "255.255.255.0");
+  Ipv4InterfaceContainer interfaces = address.Assign(devices);
+
+  Address serverAddress(InetSocketAddress(interfaces.GetAddress(0), 50000));
+  Ptr<WorkServer> server = CreateObject<WorkServer>();
+  server->SetAttribute("Protocol",
+                       TypeIdValue(UdpSocketFactory::GetTypeId()));
+  server->SetAttribute("Local", AddressValue(serverAddress));
+  nodes.Get(0)->AddApplication(server);
+
+  Ptr<DeviceEnforcer> device = CreateObject<DeviceEnforcer>();
+  device->SetAttribute("Protocol",
+                       TypeIdValue(UdpSocketFactory::GetTypeId()));
+  device->SetAttribute("Local", AddressValue(InetSocketAddress(
+                                    interfaces.GetAddress(1), 50000)));
+  device->SetAttribute("Remote", AddressValue(serverAddress));
+  device->SetAttribute("DataRate", DataRateValue(DataRate(dataRate)));
+  device->SetAttribute("PacketSize", UintegerValue(packetSize));
+  device->SetStartTime(Seconds(1));
+  device->TraceConnectWithoutContext("Tx", MakeCallback(&TxTrace));
+  nodes.Get(1)->AddApplication(device);
+
+  Simulator::Stop(Seconds(1 + simulationTime));
+  allocations = g_allocations;
+  bytes = g_bytes;
+  start = chrono::steady_clock::now();
+  Simulator::Run();
+  Report("Send path (request, response and events)", max<uint64_t>(g_sent, 1),
+         allocations, bytes, start);
+  cout << g_sent << " requests sent" << endl;
+  Simulator::Destroy();
+  return 0;
+}
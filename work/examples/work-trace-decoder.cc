@@ -0,0 +1,96 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+// Print a binary event trace written by WorkEventTrace as text, one line
+// per record: time in seconds, node, event and named arguments.
+//
+// ./waf --run "work-trace-decoder --input=work-trace.bin --node=3"
+
+#include "ns3/core-module.h"
+#include "ns3/ipv4-address.h"
+#include "ns3/work-event-trace.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+using namespace ns3;
+using namespace std;
+
+/**
+ * \brief Format an argument of a record
+ * \param event the event of the record
+ * \param arg the argument index
+ * \param value the argument
+ * \return the formatted argument
+ */
+string FormatArg(uint16_t event, uint32_t arg, uint64_t value) {
+  ostringstream os;
+  os << WorkEventTrace::GetArgName(event, arg) << "=";
+  if (WorkEventTrace::IsAddressArg(event, arg)) {
+    os << Ipv4Address(static_cast<uint32_t>(value >> 16)) << ":"
+       << (value & 0xffff);
+  } else {
+    os << value;
+  }
+  return os.str();
+}
+
+int main(int argc, char *argv[]) {
+  string input = "work-trace.bin"; /* Trace file. */
+  int64_t node = -1;               /* Only this node, -1 for all. */
+  string event = "";               /* Only this event, empty for all. */
+  bool summary = false;            /* Print counts per event only. */
+
+  CommandLine cmd(__FILE__);
+  cmd.AddValue("input", "Trace file written by WorkEventTrace", input);
+  cmd.AddValue("node", "Print only the events of this node", node);
+  cmd.AddValue("event", "Print only this event, e.g. DeviceSend", event);
+  cmd.AddValue("summary", "Print the number of records of each event",
+               summary);
+  cmd.Parse(argc, argv);
+
+  ifstream file(input, ios::binary);
+  NS_ABORT_MSG_IF(!file, "Cannot open " << input);
+  char magic[sizeof(WorkEventTrace::MAGIC)];
+  uint32_t header[2];
+  file.read(magic, sizeof(magic));
+  file.read(reinterpret_cast<char *>(header), sizeof(header));
+  NS_ABORT_MSG_IF(!file || memcmp(magic, WorkEventTrace::MAGIC, sizeof(magic)),
+                  input << " is not a work event trace");
+  NS_ABORT_MSG_IF(header[0] != WorkEventTrace::VERSION,
+                  "Unsupported trace version " << header[0]);
+  NS_ABORT_MSG_IF(header[1] != sizeof(WorkTraceRecord),
+                  "Unexpected record size " << header[1]);
+
+  vector<uint64_t> counts(WORK_TRACE_EVENT_COUNT + 1, 0);
+  WorkTraceRecord record;
+  while (file.read(reinterpret_cast<char *>(&record), sizeof(record))) {
+    if (node >= 0 && record.node != node) {
+      continue;
+    }
+    if (!event.empty() && event != WorkEventTrace::GetEventName(record.event)) {
+      continue;
+    }
+    if (summary) {
+      counts[std::min<uint16_t>(record.event, WORK_TRACE_EVENT_COUNT)]++;
+      continue;
+    }
+    cout << TimeStep(record.time).GetSeconds() << " " << record.node << " "
+         << WorkEventTrace::GetEventName(record.event) << " "
+         << FormatArg(record.event, 0, record.args[0]) << " "
+         << FormatArg(record.event, 1, record.args[1]) << endl;
+  }
+
+  if (summary) {
+    for (uint16_t i = 0; i <= WORK_TRACE_EVENT_COUNT; ++i) {
+      if (counts[i] > 0) {
+        cout << WorkEventTrace::GetEventName(i) << " " << counts[i] << endl;
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,231 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#include "work-anim-writer.h"
+#include "ns3/callback.h"
+#include "ns3/ipv4-header.h"
+#include "ns3/log.h"
+#include "ns3/mobility-model.h"
+#include "ns3/node.h"
+#include "ns3/simulator.h"
+#include <chrono>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE("WorkAnimWriter");
+
+/// Packets in flight kept at most, older ones are dropped
+static const size_t MAX_IN_FLIGHT = 1 << 16;
+
+/**
+ * \brief Measure the wall clock time of a scope
+ */
+class OverheadTimer {
+public:
+  /**
+   * \param total the time accumulator, in seconds
+   */
+  OverheadTimer(double &total)
+      : m_total(total), m_start(std::chrono::steady_clock::now()) {}
+
+  ~OverheadTimer() {
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - m_start;
+    m_total += elapsed.count();
+  }
+
+private:
+  double &m_total;                               //!< Accumulator
+  std::chrono::steady_clock::time_point m_start; //!< Scope start
+};
+
+/**
+ * \param node the node
+ * \return the position of the node, the origin if it has no mobility
+ */
+static Vector GetPosition(Ptr<Node> node) {
+  Ptr<MobilityModel> mobility = node->GetObject<MobilityModel>();
+  return mobility ? mobility->GetPosition() : Vector();
+}
+
+WorkAnimWriter::WorkAnimWriter()
+    : m_sampling(SAMPLE_PACKETS), m_sampleRate(100), m_sent(0), m_packets(0),
+      m_bytes(0), m_overhead(0) {
+  NS_LOG_FUNCTION(this);
+}
+
+WorkAnimWriter::~WorkAnimWriter() {
+  NS_LOG_FUNCTION(this);
+  Close();
+}
+
+void WorkAnimWriter::Open(const string &filename, uint32_t bufferSize) {
+  NS_LOG_FUNCTION(this << filename << bufferSize);
+  OverheadTimer timer(m_overhead);
+  Close();
+  // The buffer must be set before the file is opened
+  m_buffer.resize(bufferSize);
+  m_file.rdbuf()->pubsetbuf(m_buffer.data(), m_buffer.size());
+  m_file.open(filename);
+  NS_ABORT_MSG_IF(!m_file, "Cannot open animation file " << filename);
+  m_file << "<anim ver=\"netanim-3.108\" filetype=\"animation\" >\n";
+  Simulator::ScheduleDestroy(&WorkAnimWriter::Close, this);
+}
+
+void WorkAnimWriter::SetSampling(Sampling sampling, uint32_t n) {
+  NS_LOG_FUNCTION(this << sampling << n);
+  m_sampling = sampling;
+  m_sampleRate = n;
+}
+
+void WorkAnimWriter::SetSnapshotInterval(Time interval) {
+  NS_LOG_FUNCTION(this << interval);
+  m_snapshotInterval = interval;
+  Simulator::Cancel(m_snapshotEvent);
+  if (interval.IsStrictlyPositive()) {
+    m_snapshotEvent =
+        Simulator::Schedule(interval, &WorkAnimWriter::Snapshot, this);
+  }
+}
+
+void WorkAnimWriter::SetBackgroundImage(const string &filename, double x,
+                                        double y, double scaleX,
+                                        double scaleY, double opacity) {
+  m_file << "<bg f=\"" << filename << "\" x=\"" << x << "\" y=\"" << y
+         << "\" sx=\"" << scaleX << "\" sy=\"" << scaleY << "\" o=\""
+         << opacity << "\"/>\n";
+}
+
+void WorkAnimWriter::Install(const NodeContainer &nodes) {
+  NS_LOG_FUNCTION(this);
+  OverheadTimer timer(m_overhead);
+  for (auto it = nodes.Begin(); it != nodes.End(); ++it) {
+    Ptr<Node> node = *it;
+    uint32_t id = node->GetId();
+    Vector position = GetPosition(node);
+    m_file << "<node id=\"" << id << "\" sysId=\"0\" locX=\"" << position.x
+           << "\" locY=\"" << position.y << "\" />\n";
+    if (id >= m_positions.size()) {
+      m_positions.resize(id + 1);
+    }
+    m_positions[id] = position;
+    m_nodes.Add(node);
+
+    Ptr<Ipv4> ipv4 = node->GetObject<Ipv4>();
+    if (ipv4 && m_sampleRate > 0) {
+      ipv4->TraceConnectWithoutContext(
+          "Tx", MakeCallback(&WorkAnimWriter::Tx, this));
+      ipv4->TraceConnectWithoutContext(
+          "Rx", MakeCallback(&WorkAnimWriter::Rx, this));
+    }
+  }
+}
+
+void WorkAnimWriter::UpdateNodeDescription(Ptr<Node> node,
+                                           const string &description) {
+  m_file << "<nu p=\"d\" t=\"" << Simulator::Now().GetSeconds() << "\" id=\""
+         << node->GetId() << "\" descr=\"" << description << "\"/>\n";
+}
+
+void WorkAnimWriter::UpdateNodeColor(Ptr<Node> node, uint8_t r, uint8_t g,
+                                     uint8_t b) {
+  m_file << "<nu p=\"c\" t=\"" << Simulator::Now().GetSeconds() << "\" id=\""
+         << node->GetId() << "\" r=\"" << uint32_t(r) << "\" g=\""
+         << uint32_t(g) << "\" b=\"" << uint32_t(b) << "\"/>\n";
+}
+
+void WorkAnimWriter::UpdateNodeSize(uint32_t nodeId, double width,
+                                    double height) {
+  m_file << "<nu p=\"s\" t=\"" << Simulator::Now().GetSeconds() << "\" id=\""
+         << nodeId << "\" w=\"" << width << "\" h=\"" << height << "\"/>\n";
+}
+
+void WorkAnimWriter::Tx(Ptr<const Packet> packet, Ptr<Ipv4> ipv4,
+                        uint32_t interface) {
+  OverheadTimer timer(m_overhead);
+  bool sampled;
+  if (m_sampling == SAMPLE_FLOWS) {
+    Ipv4Header header;
+    packet->PeekHeader(header);
+    uint64_t pair = (uint64_t(header.GetSource().Get()) << 32) ^
+                    header.GetDestination().Get();
+    sampled = std::hash<uint64_t>()(pair) % m_sampleRate == 0;
+  } else {
+    sampled = m_sent++ % m_sampleRate == 0;
+  }
+  if (!sampled) {
+    return;
+  }
+  if (m_inFlight.size() >= MAX_IN_FLIGHT) {
+    // Lost packets are never received, forget them
+    m_inFlight.clear();
+  }
+  Transmission &transmission = m_inFlight[packet->GetUid()];
+  transmission.node = ipv4->GetObject<Node>()->GetId();
+  transmission.time = Simulator::Now();
+}
+
+void WorkAnimWriter::Rx(Ptr<const Packet> packet, Ptr<Ipv4> ipv4,
+                        uint32_t interface) {
+  if (m_inFlight.empty()) {
+    return;
+  }
+  OverheadTimer timer(m_overhead);
+  auto it = m_inFlight.find(packet->GetUid());
+  if (it == m_inFlight.end()) {
+    return;
+  }
+  uint32_t node = ipv4->GetObject<Node>()->GetId();
+  if (node == it->second.node) {
+    return;
+  }
+  double tx = it->second.time.GetSeconds();
+  double rx = Simulator::Now().GetSeconds();
+  m_file << "<p fId=\"" << it->second.node << "\" fbTx=\"" << tx
+         << "\" lbTx=\"" << tx << "\" tId=\"" << node << "\" fbRx=\"" << rx
+         << "\" lbRx=\"" << rx << "\"/>\n";
+  m_packets++;
+  m_inFlight.erase(it);
+}
+
+void WorkAnimWriter::Snapshot(void) {
+  {
+    OverheadTimer timer(m_overhead);
+    double now = Simulator::Now().GetSeconds();
+    for (auto it = m_nodes.Begin(); it != m_nodes.End(); ++it) {
+      Ptr<Node> node = *it;
+      Vector position = GetPosition(node);
+      Vector &last = m_positions[node->GetId()];
+      if (position.x == last.x && position.y == last.y) {
+        continue;
+      }
+      last = position;
+      m_file << "<nu p=\"p\" t=\"" << now << "\" id=\"" << node->GetId()
+             << "\" x=\"" << position.x << "\" y=\"" << position.y
+             << "\"/>\n";
+    }
+  }
+  m_snapshotEvent =
+      Simulator::Schedule(m_snapshotInterval, &WorkAnimWriter::Snapshot, this);
+}
+
+void WorkAnimWriter::Close(void) {
+  if (!m_file.is_open()) {
+    return;
+  }
+  NS_LOG_FUNCTION(this);
+  Simulator::Cancel(m_snapshotEvent);
+  m_file << "</anim>\n";
+  m_bytes = m_file.tellp();
+  m_file.close();
+}
+
+uint64_t WorkAnimWriter::GetPackets(void) const { return m_packets; }
+
+uint64_t WorkAnimWriter::GetBytes(void) const { return m_bytes; }
+
+double WorkAnimWriter::GetOverhead(void) const { return m_overhead; }
+
+} // Namespace ns3
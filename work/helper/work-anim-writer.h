@@ -0,0 +1,179 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#ifndef WORK_ANIM_WRITER_H
+#define WORK_ANIM_WRITER_H
+
+#include "ns3/event-id.h"
+#include "ns3/ipv4.h"
+#include "ns3/node-container.h"
+#include "ns3/nstime.h"
+#include "ns3/packet.h"
+#include "ns3/vector.h"
+#include <fstream>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+namespace ns3 {
+
+/**
+ * \ingroup applications
+ *
+ * \brief Lightweight NetAnim animation of the work simulations.
+ *
+ * AnimationInterface records every packet with its metadata and keeps the
+ * whole animation in memory. This writer produces a NetAnim file with the
+ * nodes, their positions and attributes, sampled position snapshots and
+ * a sample of the IP packets, written incrementally through a large
+ * buffer. Packets are sampled 1 in N, or per flow: every packet between a
+ * sampled pair of addresses, which gives whole conversations.
+ *
+ * A packet is drawn from the node that sent it to the next node that
+ * receives it at the IP layer. The wall clock time spent in the writer is
+ * measured and reported by GetOverhead.
+ */
+class WorkAnimWriter {
+public:
+  /// Packet sampling modes
+  enum Sampling {
+    SAMPLE_PACKETS, //!< One packet in N
+    SAMPLE_FLOWS    //!< Every packet of one address pair in N
+  };
+
+  WorkAnimWriter();
+
+  virtual ~WorkAnimWriter();
+
+  /**
+   * \brief Create the animation file
+   * \param filename the animation file, e.g. "animation.xml"
+   * \param bufferSize the size of the write buffer
+   */
+  void Open(const string &filename, uint32_t bufferSize = 1 << 20);
+
+  /**
+   * \brief Set the packets drawn, to be called before Install
+   * \param sampling the sampling mode
+   * \param n one packet or flow in n is drawn, zero for none
+   */
+  void SetSampling(Sampling sampling, uint32_t n);
+
+  /**
+   * \brief Write the position of the moving nodes periodically
+   * \param interval the time between snapshots, zero for none
+   */
+  void SetSnapshotInterval(Time interval);
+
+  /**
+   * \brief Set the background image
+   * \param filename the image file
+   * \param x the X coordinate of the image
+   * \param y the Y coordinate of the image
+   * \param scaleX the X scale of the image
+   * \param scaleY the Y scale of the image
+   * \param opacity the opacity of the image, in [0, 1]
+   */
+  void SetBackgroundImage(const string &filename, double x, double y,
+                          double scaleX, double scaleY, double opacity);
+
+  /**
+   * \brief Add nodes to the animation and trace their IP packets
+   * \param nodes the nodes
+   */
+  void Install(const NodeContainer &nodes);
+
+  /**
+   * \param node the node
+   * \param description the label of the node
+   */
+  void UpdateNodeDescription(Ptr<Node> node, const string &description);
+
+  /**
+   * \param node the node
+   * \param r the red component
+   * \param g the green component
+   * \param b the blue component
+   */
+  void UpdateNodeColor(Ptr<Node> node, uint8_t r, uint8_t g, uint8_t b);
+
+  /**
+   * \param nodeId the node id
+   * \param width the width of the node
+   * \param height the height of the node
+   */
+  void UpdateNodeSize(uint32_t nodeId, double width, double height);
+
+  /**
+   * \brief Close the animation and the file
+   */
+  void Close(void);
+
+  /**
+   * \return number of packets drawn
+   */
+  uint64_t GetPackets(void) const;
+
+  /**
+   * \return number of bytes written, known once closed
+   */
+  uint64_t GetBytes(void) const;
+
+  /**
+   * \return wall clock seconds spent in the writer
+   */
+  double GetOverhead(void) const;
+
+private:
+  /// A sampled packet in flight
+  struct Transmission {
+    uint32_t node; //!< Sending node
+    Time time;     //!< Transmission time
+  };
+
+  /**
+   * \brief Sink of the Ipv4L3Protocol "Tx" trace source
+   * \param packet the packet
+   * \param ipv4 the IP stack of the node
+   * \param interface the interface
+   */
+  void Tx(Ptr<const Packet> packet, Ptr<Ipv4> ipv4, uint32_t interface);
+
+  /**
+   * \brief Sink of the Ipv4L3Protocol "Rx" trace source
+   * \param packet the packet
+   * \param ipv4 the IP stack of the node
+   * \param interface the interface
+   */
+  void Rx(Ptr<const Packet> packet, Ptr<Ipv4> ipv4, uint32_t interface);
+
+  /**
+   * \brief Write the position of the nodes that moved
+   */
+  void Snapshot(void);
+
+  std::ofstream m_file;       //!< Animation file
+  std::vector<char> m_buffer; //!< Write buffer of the file
+  Sampling m_sampling;        //!< Packet sampling mode
+  uint32_t m_sampleRate;      //!< One in m_sampleRate drawn
+  uint64_t m_sent;            //!< Packets seen by the sampler
+  /// Sampled packets in flight, by packet uid
+  std::unordered_map<uint64_t, Transmission> m_inFlight;
+  NodeContainer m_nodes;      //!< Animated nodes
+  /// Last written positions, by node id
+  std::vector<Vector> m_positions;
+  Time m_snapshotInterval;    //!< Time between snapshots
+  EventId m_snapshotEvent;    //!< Next snapshot
+  uint64_t m_packets;         //!< Packets drawn
+  uint64_t m_bytes;           //!< Bytes of the closed file
+  double m_overhead;          //!< Seconds spent in the writer
+};
+
+} // namespace ns3
+
+#endif /* WORK_ANIM_WRITER_H */
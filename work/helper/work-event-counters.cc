@@ -0,0 +1,74 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#include "work-event-counters.h"
+#include "ns3/callback.h"
+#include "ns3/config.h"
+#include "ns3/log.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE("WorkEventCounters");
+
+WorkEventCounters::WorkEventCounters() { NS_LOG_FUNCTION(this); }
+
+void WorkEventCounters::Install(void) {
+  NS_LOG_FUNCTION(this);
+  Config::ConnectWithoutContext(
+      "/NodeList/*/ApplicationList/*/$ns3::DeviceEnforcer/Event",
+      MakeCallback(&WorkEventCounters::Notify, this));
+}
+
+void WorkEventCounters::Notify(const WorkEvent &event) {
+  if (event.device >= m_counts.size()) {
+    m_counts.resize(event.device + 1, Row());
+  }
+  m_counts[event.device][event.code]++;
+  if (event.code == WORK_TRACE_DEVICE_RESPONSE) {
+    m_responses[event.message]++;
+  }
+}
+
+uint64_t WorkEventCounters::Get(uint32_t device, WorkTraceEvent code) const {
+  return device < m_counts.size() ? m_counts[device][code] : 0;
+}
+
+uint64_t WorkEventCounters::GetTotal(WorkTraceEvent code) const {
+  uint64_t total = 0;
+  for (const Row &row : m_counts) {
+    total += row[code];
+  }
+  return total;
+}
+
+uint64_t WorkEventCounters::GetResponses(const string &message) const {
+  auto it = m_responses.find(WorkEventTrace::Intern(message));
+  return it == m_responses.end() ? 0 : it->second;
+}
+
+uint32_t WorkEventCounters::GetNDevices(void) const { return m_counts.size(); }
+
+void WorkEventCounters::Print(ostream &os) const {
+  os << "Events of " << m_counts.size() << " devices:";
+  for (uint16_t code = 0; code < WORK_TRACE_EVENT_COUNT; ++code) {
+    uint64_t total = GetTotal(WorkTraceEvent(code));
+    if (total > 0) {
+      os << " " << WorkEventTrace::GetEventName(code) << " " << total;
+    }
+  }
+  os << endl;
+  for (auto &responses : m_responses) {
+    os << "  " << WorkEventTrace::GetMessage(responses.first) << " "
+       << responses.second << endl;
+  }
+}
+
+void WorkEventCounters::Reset(void) {
+  NS_LOG_FUNCTION(this);
+  m_counts.clear();
+  m_responses.clear();
+}
+
+} // Namespace ns3
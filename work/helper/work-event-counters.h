@@ -0,0 +1,89 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#ifndef WORK_EVENT_COUNTERS_H
+#define WORK_EVENT_COUNTERS_H
+
+#include "ns3/work-event-trace.h"
+#include <array>
+#include <map>
+#include <ostream>
+#include <vector>
+
+using namespace std;
+
+namespace ns3 {
+
+/**
+ * \ingroup applications
+ *
+ * \brief Per-device counters of the DeviceEnforcer "Event" trace source.
+ *
+ * Every event increments the counter of its code in the row of its device,
+ * a plain array indexed by the device id, and the responses are also
+ * counted by interned message ("[Accepted]", "[Refused]", ...). Nothing
+ * is formatted before Print.
+ */
+class WorkEventCounters {
+public:
+  WorkEventCounters();
+
+  /**
+   * \brief Connect to the "Event" trace source of every DeviceEnforcer
+   */
+  void Install(void);
+
+  /**
+   * \brief Count an event, the sink of the "Event" trace source
+   * \param event the event
+   */
+  void Notify(const WorkEvent &event);
+
+  /**
+   * \param device the device id
+   * \param code the event
+   * \return number of events of the device
+   */
+  uint64_t Get(uint32_t device, WorkTraceEvent code) const;
+
+  /**
+   * \param code the event
+   * \return number of events of every device
+   */
+  uint64_t GetTotal(WorkTraceEvent code) const;
+
+  /**
+   * \param message the response message, e.g. "[Accepted]"
+   * \return number of responses with the message
+   */
+  uint64_t GetResponses(const string &message) const;
+
+  /**
+   * \return number of devices with events, the highest device id plus one
+   */
+  uint32_t GetNDevices(void) const;
+
+  /**
+   * \brief Print the totals of every event and the responses by message
+   * \param os the output stream
+   */
+  void Print(ostream &os) const;
+
+  /**
+   * \brief Clear the counters
+   */
+  void Reset(void);
+
+private:
+  /// Counters of a device, indexed by event
+  typedef std::array<uint64_t, WORK_TRACE_EVENT_COUNT> Row;
+
+  std::vector<Row> m_counts;                //!< Counters by device id
+  std::map<uint32_t, uint64_t> m_responses; //!< Responses by message id
+};
+
+} // namespace ns3
+
+#endif /* WORK_EVENT_COUNTERS_H */
@@ -0,0 +1,139 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#include "work-flow-exporter.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include <sstream>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE("WorkFlowExporter");
+
+/**
+ * \brief Format an endpoint of a flow
+ * \param address the IPv4 address
+ * \param port the port
+ * \return "address:port"
+ */
+static string FormatEndpoint(Ipv4Address address, uint16_t port) {
+  ostringstream os;
+  os << address << ":" << port;
+  return os.str();
+}
+
+WorkFlowExporter::WorkFlowExporter()
+    : m_file(0), m_format(CSV), m_port(0), m_records(0) {
+  NS_LOG_FUNCTION(this);
+}
+
+WorkFlowExporter::~WorkFlowExporter() {
+  NS_LOG_FUNCTION(this);
+  if (m_file) {
+    fclose(m_file);
+  }
+}
+
+void WorkFlowExporter::Start(Ptr<FlowMonitor> monitor,
+                             Ptr<Ipv4FlowClassifier> classifier,
+                             const string &filename, Format format,
+                             Time interval) {
+  NS_LOG_FUNCTION(this << monitor << classifier << filename << format
+                       << interval);
+  NS_ABORT_MSG_IF(!interval.IsStrictlyPositive(),
+                  "The flow export interval must be positive");
+  Stop();
+  m_file = fopen(filename.c_str(), "w");
+  NS_ABORT_MSG_IF(!m_file, "Cannot open flow file " << filename);
+  m_monitor = monitor;
+  m_classifier = classifier;
+  m_format = format;
+  m_interval = interval;
+  m_last = Simulator::Now();
+  if (format == CSV) {
+    fputs("time,flow,source,destination,protocol,txPackets,rxPackets,"
+          "txBytes,rxBytes,lostPackets,delay,jitter,throughput\n",
+          m_file);
+  }
+  m_event =
+      Simulator::Schedule(interval, &WorkFlowExporter::PeriodicExport, this);
+  // The last interval is exported when the simulation is destroyed
+  Simulator::ScheduleDestroy(&WorkFlowExporter::Stop, this);
+}
+
+void WorkFlowExporter::SetPortFilter(uint16_t port) {
+  NS_LOG_FUNCTION(this << port);
+  m_port = port;
+}
+
+void WorkFlowExporter::PeriodicExport(void) {
+  Export();
+  m_event =
+      Simulator::Schedule(m_interval, &WorkFlowExporter::PeriodicExport, this);
+}
+
+void WorkFlowExporter::Export(void) {
+  NS_LOG_FUNCTION(this);
+  if (!m_file) {
+    return;
+  }
+  Time now = Simulator::Now();
+  double duration = (now - m_last).GetSeconds();
+  m_last = now;
+
+  m_monitor->CheckForLostPackets();
+  const FlowMonitor::FlowStatsContainer &stats = m_monitor->GetFlowStats();
+  for (auto &flow : stats) {
+    const FlowMonitor::FlowStats &s = flow.second;
+    if (s.txPackets == 0 && s.rxPackets == 0 && s.lostPackets == 0) {
+      continue;
+    }
+    Ipv4FlowClassifier::FiveTuple t = m_classifier->FindFlow(flow.first);
+    if (m_port != 0 && t.sourcePort != m_port &&
+        t.destinationPort != m_port) {
+      continue;
+    }
+    string source = FormatEndpoint(t.sourceAddress, t.sourcePort);
+    string destination =
+        FormatEndpoint(t.destinationAddress, t.destinationPort);
+    double delay =
+        s.rxPackets > 0 ? s.delaySum.GetSeconds() * 1000 / s.rxPackets : 0;
+    double jitter = s.rxPackets > 1
+                        ? s.jitterSum.GetSeconds() * 1000 / (s.rxPackets - 1)
+                        : 0;
+    double throughput = duration > 0 ? s.rxBytes * 8.0 / duration : 0;
+    const char *format =
+        m_format == CSV
+            ? "%.6f,%u,%s,%s,%u,%u,%u,%llu,%llu,%u,%.3f,%.3f,%.0f\n"
+            : "{\"time\":%.6f,\"flow\":%u,\"source\":\"%s\","
+              "\"destination\":\"%s\",\"protocol\":%u,\"txPackets\":%u,"
+              "\"rxPackets\":%u,\"txBytes\":%llu,\"rxBytes\":%llu,"
+              "\"lostPackets\":%u,\"delay\":%.3f,\"jitter\":%.3f,"
+              "\"throughput\":%.0f}\n";
+    fprintf(m_file, format, now.GetSeconds(), flow.first, source.c_str(),
+            destination.c_str(), t.protocol, s.txPackets, s.rxPackets,
+            (unsigned long long)s.txBytes, (unsigned long long)s.rxBytes,
+            s.lostPackets, delay, jitter, throughput);
+    m_records++;
+  }
+  fflush(m_file);
+  // Only the flow identities are kept from one interval to the next
+  m_monitor->ResetAllStats();
+}
+
+void WorkFlowExporter::Stop(void) {
+  if (!m_file) {
+    return;
+  }
+  NS_LOG_FUNCTION(this);
+  Simulator::Cancel(m_event);
+  Export();
+  fclose(m_file);
+  m_file = 0;
+}
+
+uint64_t WorkFlowExporter::GetRecords(void) const { return m_records; }
+
+} // Namespace ns3
@@ -0,0 +1,108 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#ifndef WORK_FLOW_EXPORTER_H
+#define WORK_FLOW_EXPORTER_H
+
+#include "ns3/event-id.h"
+#include "ns3/flow-monitor.h"
+#include "ns3/ipv4-flow-classifier.h"
+#include "ns3/nstime.h"
+#include "ns3/ptr.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+using namespace std;
+
+namespace ns3 {
+
+/**
+ * \ingroup applications
+ *
+ * \brief Periodic export of the FlowMonitor statistics.
+ *
+ * Serializing the flow monitor to XML at the end of a run keeps the
+ * statistics, histograms and probes of every flow in memory for the whole
+ * simulation and shows nothing before it ends. The exporter instead
+ * appends, every interval, a record per flow active in the interval and
+ * resets the flow statistics, so the memory held by the monitor stays
+ * bounded by the number of flows and long runs give a time series.
+ *
+ * Records are CSV lines:
+ *
+ *   time,flow,source,destination,protocol,txPackets,rxPackets,txBytes,
+ *   rxBytes,lostPackets,delay,jitter,throughput
+ *
+ * or JSON lines with the same fields, where time is the end of the
+ * interval in seconds, delay and jitter are means in milliseconds and
+ * throughput is the received bitrate in bit/s. A port filter keeps only
+ * the flows from or to a port, e.g. the requests and responses of the
+ * work applications on port 50000.
+ */
+class WorkFlowExporter {
+public:
+  /// Export formats
+  enum Format {
+    CSV, //!< Comma separated values, with a header line
+    JSON //!< A JSON object per line
+  };
+
+  WorkFlowExporter();
+
+  virtual ~WorkFlowExporter();
+
+  /**
+   * \brief Start the periodic export
+   * \param monitor the flow monitor
+   * \param classifier the classifier of the monitor
+   * \param filename the output file
+   * \param format the file format
+   * \param interval the time between two records of a flow
+   */
+  void Start(Ptr<FlowMonitor> monitor, Ptr<Ipv4FlowClassifier> classifier,
+             const string &filename, Format format, Time interval);
+
+  /**
+   * \brief Export only the flows from or to a port
+   * \param port the port, zero for every flow
+   */
+  void SetPortFilter(uint16_t port);
+
+  /**
+   * \brief Append the statistics of the current interval and reset them
+   */
+  void Export(void);
+
+  /**
+   * \brief Export the last interval and close the file
+   */
+  void Stop(void);
+
+  /**
+   * \return number of records written
+   */
+  uint64_t GetRecords(void) const;
+
+private:
+  /**
+   * \brief Export and schedule the next export
+   */
+  void PeriodicExport(void);
+
+  Ptr<FlowMonitor> m_monitor;           //!< Monitor of the flows
+  Ptr<Ipv4FlowClassifier> m_classifier; //!< Five-tuples of the flows
+  FILE *m_file;                         //!< Output file
+  Format m_format;                      //!< Output format
+  Time m_interval;                      //!< Time between exports
+  Time m_last;                          //!< End of the previous interval
+  EventId m_event;                      //!< Next export
+  uint16_t m_port;                      //!< Exported port, zero for all
+  uint64_t m_records;                   //!< Records written
+};
+
+} // namespace ns3
+
+#endif /* WORK_FLOW_EXPORTER_H */
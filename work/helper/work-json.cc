@@ -0,0 +1,485 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#include "work-json.h"
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace ns3 {
+
+/// Shared null value, returned for missing elements and members
+static const WorkJson g_null;
+/// Shared empty string
+static const string g_empty;
+/// Shared empty member list
+static const vector<pair<string, WorkJson>> g_noMembers;
+
+WorkJson::WorkJson() : m_type(NUL), m_bool(false), m_number(0) {}
+
+WorkJson::WorkJson(bool value) : m_type(BOOL), m_bool(value), m_number(0) {}
+
+WorkJson::WorkJson(double value)
+    : m_type(NUMBER), m_bool(false), m_number(value) {}
+
+WorkJson::WorkJson(int value) : WorkJson(double(value)) {}
+
+WorkJson::WorkJson(uint32_t value) : WorkJson(double(value)) {}
+
+WorkJson::WorkJson(int64_t value) : WorkJson(double(value)) {}
+
+WorkJson::WorkJson(uint64_t value) : WorkJson(double(value)) {}
+
+WorkJson::WorkJson(const char *value) : WorkJson(string(value)) {}
+
+WorkJson::WorkJson(const string &value)
+    : m_type(STRING), m_bool(false), m_number(0), m_string(value) {}
+
+WorkJson WorkJson::Array(void) {
+  WorkJson value;
+  value.m_type = ARRAY;
+  return value;
+}
+
+WorkJson WorkJson::Object(void) {
+  WorkJson value;
+  value.m_type = OBJECT;
+  return value;
+}
+
+bool WorkJson::GetBool(void) const { return m_type == BOOL && m_bool; }
+
+double WorkJson::GetNumber(void) const {
+  return m_type == NUMBER ? m_number : 0;
+}
+
+const string &WorkJson::GetString(void) const {
+  return m_type == STRING ? m_string : g_empty;
+}
+
+size_t WorkJson::GetSize(void) const {
+  return m_type == ARRAY ? m_elements.size()
+                         : m_type == OBJECT ? m_members.size() : 0;
+}
+
+const WorkJson &WorkJson::operator[](size_t i) const {
+  return m_type == ARRAY && i < m_elements.size() ? m_elements[i] : g_null;
+}
+
+const WorkJson &WorkJson::operator[](const string &key) const {
+  if (m_type == OBJECT) {
+    for (const auto &member : m_members) {
+      if (member.first == key) {
+        return member.second;
+      }
+    }
+  }
+  return g_null;
+}
+
+bool WorkJson::Has(const string &key) const {
+  if (m_type == OBJECT) {
+    for (const auto &member : m_members) {
+      if (member.first == key) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+const vector<pair<string, WorkJson>> &WorkJson::GetMembers(void) const {
+  return m_type == OBJECT ? m_members : g_noMembers;
+}
+
+WorkJson &WorkJson::Append(const WorkJson &value) {
+  m_type = ARRAY;
+  m_elements.push_back(value);
+  return *this;
+}
+
+WorkJson &WorkJson::Set(const string &key, const WorkJson &value) {
+  m_type = OBJECT;
+  for (auto &member : m_members) {
+    if (member.first == key) {
+      member.second = value;
+      return *this;
+    }
+  }
+  m_members.emplace_back(key, value);
+  return *this;
+}
+
+/**
+ * \brief Write a string with the JSON escapes
+ * \param os the output stream
+ * \param value the string
+ */
+static void DumpString(ostream &os, const string &value) {
+  os << '"';
+  for (unsigned char c : value) {
+    switch (c) {
+    case '"':
+      os << "\\\"";
+      break;
+    case '\\':
+      os << "\\\\";
+      break;
+    case '\n':
+      os << "\\n";
+      break;
+    case '\r':
+      os << "\\r";
+      break;
+    case '\t':
+      os << "\\t";
+      break;
+    default:
+      if (c < 0x20) {
+        os << "\\u" << hex << setw(4) << setfill('0') << int(c) << dec
+           << setfill(' ');
+      } else {
+        os << c;
+      }
+    }
+  }
+  os << '"';
+}
+
+void WorkJson::Dump(ostream &os, uint32_t indent) const {
+  Dump(os, indent, 0);
+}
+
+string WorkJson::Dump(uint32_t indent) const {
+  ostringstream os;
+  Dump(os, indent, 0);
+  return os.str();
+}
+
+void WorkJson::Dump(ostream &os, uint32_t indent, uint32_t level) const {
+  string inner = indent ? "\n" + string((level + 1) * indent, ' ') : "";
+  string outer = indent ? "\n" + string(level * indent, ' ') : "";
+  switch (m_type) {
+  case NUL:
+    os << "null";
+    break;
+  case BOOL:
+    os << (m_bool ? "true" : "false");
+    break;
+  case NUMBER:
+    if (!std::isfinite(m_number)) {
+      os << "null";
+    } else if (m_number == std::floor(m_number) && std::fabs(m_number) < 1e15) {
+      os << int64_t(m_number);
+    } else {
+      ostringstream number;
+      number << setprecision(17) << m_number;
+      os << number.str();
+    }
+    break;
+  case STRING:
+    DumpString(os, m_string);
+    break;
+  case ARRAY:
+    os << '[';
+    for (size_t i = 0; i < m_elements.size(); ++i) {
+      os << (i ? "," : "") << inner;
+      m_elements[i].Dump(os, indent, level + 1);
+    }
+    os << (m_elements.empty() ? "" : outer) << ']';
+    break;
+  case OBJECT:
+    os << '{';
+    for (size_t i = 0; i < m_members.size(); ++i) {
+      os << (i ? "," : "") << inner;
+      DumpString(os, m_members[i].first);
+      os << (indent ? ": " : ":");
+      m_members[i].second.Dump(os, indent, level + 1);
+    }
+    os << (m_members.empty() ? "" : outer) << '}';
+    break;
+  }
+}
+
+/**
+ * \brief Recursive descent parser of a JSON document
+ */
+class WorkJsonParser {
+public:
+  /**
+   * \param text the document
+   */
+  WorkJsonParser(const string &text) : m_text(text), m_pos(0) {}
+
+  /**
+   * \brief Parse the whole document
+   * \param value the parsed value
+   * \param error the error message, if any
+   * \return true on success
+   */
+  bool Parse(WorkJson &value, string &error) {
+    if (!ParseValue(value, 0)) {
+      error = m_error;
+      return false;
+    }
+    SkipSpace();
+    if (m_pos != m_text.size()) {
+      Fail("trailing characters");
+      error = m_error;
+      return false;
+    }
+    return true;
+  }
+
+private:
+  /// Deepest nesting accepted
+  static const uint32_t MAX_DEPTH = 64;
+
+  /**
+   * \brief Record an error at the current offset
+   * \param message the error
+   * \return false
+   */
+  bool Fail(const string &message) {
+    m_error = message + " at offset " + to_string(m_pos);
+    return false;
+  }
+
+  /// Skip the white space
+  void SkipSpace(void) {
+    while (m_pos < m_text.size() &&
+           (m_text[m_pos] == ' ' || m_text[m_pos] == '\t' ||
+            m_text[m_pos] == '\n' || m_text[m_pos] == '\r')) {
+      m_pos++;
+    }
+  }
+
+  /**
+   * \param word a literal
+   * \return true if the literal follows, consumed
+   */
+  bool Match(const char *word) {
+    size_t length = string(word).size();
+    if (m_text.compare(m_pos, length, word) == 0) {
+      m_pos += length;
+      return true;
+    }
+    return false;
+  }
+
+  /**
+   * \param value the parsed value
+   * \param depth the nesting level
+   * \return true on success
+   */
+  bool ParseValue(WorkJson &value, uint32_t depth) {
+    if (depth > MAX_DEPTH) {
+      return Fail("nesting too deep");
+    }
+    SkipSpace();
+    if (m_pos == m_text.size()) {
+      return Fail("unexpected end");
+    }
+    char c = m_text[m_pos];
+    if (c == '{') {
+      return ParseObject(value, depth);
+    } else if (c == '[') {
+      return ParseArray(value, depth);
+    } else if (c == '"') {
+      string s;
+      if (!ParseString(s)) {
+        return false;
+      }
+      value = WorkJson(s);
+      return true;
+    } else if (Match("true")) {
+      value = WorkJson(true);
+      return true;
+    } else if (Match("false")) {
+      value = WorkJson(false);
+      return true;
+    } else if (Match("null")) {
+      value = WorkJson();
+      return true;
+    }
+    return ParseNumber(value);
+  }
+
+  /**
+   * \param value the parsed number
+   * \return true on success
+   */
+  bool ParseNumber(WorkJson &value) {
+    const char *begin = m_text.c_str() + m_pos;
+    char *end = 0;
+    double number = strtod(begin, &end);
+    if (end == begin || !(*begin == '-' || (*begin >= '0' && *begin <= '9'))) {
+      return Fail("unexpected character");
+    }
+    m_pos += end - begin;
+    value = WorkJson(number);
+    return true;
+  }
+
+  /**
+   * \param s the parsed string, the quotes removed
+   * \return true on success
+   */
+  bool ParseString(string &s) {
+    m_pos++; // Opening quote
+    while (m_pos < m_text.size()) {
+      char c = m_text[m_pos++];
+      if (c == '"') {
+        return true;
+      } else if (c != '\\') {
+        s += c;
+        continue;
+      }
+      if (m_pos == m_text.size()) {
+        break;
+      }
+      char e = m_text[m_pos++];
+      switch (e) {
+      case '"':
+      case '\\':
+      case '/':
+        s += e;
+        break;
+      case 'b':
+        s += '\b';
+        break;
+      case 'f':
+        s += '\f';
+        break;
+      case 'n':
+        s += '\n';
+        break;
+      case 'r':
+        s += '\r';
+        break;
+      case 't':
+        s += '\t';
+        break;
+      case 'u': {
+        if (m_pos + 4 > m_text.size()) {
+          return Fail("truncated escape");
+        }
+        uint32_t code = strtoul(m_text.substr(m_pos, 4).c_str(), 0, 16);
+        m_pos += 4;
+        // UTF-8, surrogate pairs are not combined
+        if (code < 0x80) {
+          s += char(code);
+        } else if (code < 0x800) {
+          s += char(0xc0 | (code >> 6));
+          s += char(0x80 | (code & 0x3f));
+        } else {
+          s += char(0xe0 | (code >> 12));
+          s += char(0x80 | ((code >> 6) & 0x3f));
+          s += char(0x80 | (code & 0x3f));
+        }
+        break;
+      }
+      default:
+        return Fail("invalid escape");
+      }
+    }
+    return Fail("unterminated string");
+  }
+
+  /**
+   * \param value the parsed array
+   * \param depth the nesting level
+   * \return true on success
+   */
+  bool ParseArray(WorkJson &value, uint32_t depth) {
+    m_pos++; // [
+    value = WorkJson::Array();
+    SkipSpace();
+    if (Match("]")) {
+      return true;
+    }
+    while (true) {
+      WorkJson element;
+      if (!ParseValue(element, depth + 1)) {
+        return false;
+      }
+      value.Append(element);
+      SkipSpace();
+      if (Match("]")) {
+        return true;
+      } else if (!Match(",")) {
+        return Fail("expected , or ]");
+      }
+    }
+  }
+
+  /**
+   * \param value the parsed object
+   * \param depth the nesting level
+   * \return true on success
+   */
+  bool ParseObject(WorkJson &value, uint32_t depth) {
+    m_pos++; // {
+    value = WorkJson::Object();
+    SkipSpace();
+    if (Match("}")) {
+      return true;
+    }
+    while (true) {
+      SkipSpace();
+      string key;
+      if (m_pos == m_text.size() || m_text[m_pos] != '"') {
+        return Fail("expected a key");
+      }
+      if (!ParseString(key)) {
+        return false;
+      }
+      SkipSpace();
+      if (!Match(":")) {
+        return Fail("expected :");
+      }
+      WorkJson member;
+      if (!ParseValue(member, depth + 1)) {
+        return false;
+      }
+      value.Set(key, member);
+      SkipSpace();
+      if (Match("}")) {
+        return true;
+      } else if (!Match(",")) {
+        return Fail("expected , or }");
+      }
+    }
+  }
+
+  const string &m_text; //!< Document
+  size_t m_pos;         //!< Offset of the next character
+  string m_error;       //!< Last error
+};
+
+bool WorkJson::Parse(const string &text, WorkJson &value, string &error) {
+  WorkJsonParser parser(text);
+  return parser.Parse(value, error);
+}
+
+bool WorkJson::ParseFile(const string &filename, WorkJson &value,
+                         string &error) {
+  ifstream file(filename);
+  if (!file) {
+    error = "cannot open " + filename;
+    return false;
+  }
+  stringstream text;
+  text << file.rdbuf();
+  if (!Parse(text.str(), value, error)) {
+    error = filename + ": " + error;
+    return false;
+  }
+  return true;
+}
+
+} // Namespace ns3
@@ -0,0 +1,160 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#ifndef WORK_JSON_H
+#define WORK_JSON_H
+
+#include <map>
+#include <ostream>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace ns3 {
+
+/**
+ * \ingroup applications
+ *
+ * \brief A JSON value, for the machine readable outputs and inputs of the
+ * work programs.
+ *
+ * Objects keep their keys in insertion order, so dumped files are stable
+ * and diffable. Numbers are doubles. Parse reports the first syntax error
+ * with its offset instead of aborting, the caller decides what to do.
+ */
+class WorkJson {
+public:
+  /// Type of a value
+  enum Type { NUL, BOOL, NUMBER, STRING, ARRAY, OBJECT };
+
+  WorkJson();                    //!< A null value
+  WorkJson(bool value);          //!< \param value a boolean
+  WorkJson(double value);        //!< \param value a number
+  WorkJson(int value);           //!< \param value a number
+  WorkJson(uint32_t value);      //!< \param value a number
+  WorkJson(int64_t value);       //!< \param value a number
+  WorkJson(uint64_t value);      //!< \param value a number
+  WorkJson(const char *value);   //!< \param value a string
+  WorkJson(const string &value); //!< \param value a string
+
+  /**
+   * \return an empty array
+   */
+  static WorkJson Array(void);
+
+  /**
+   * \return an empty object
+   */
+  static WorkJson Object(void);
+
+  /**
+   * \brief Parse a JSON document
+   * \param text the document
+   * \param value the parsed value
+   * \param error the error message, if any
+   * \return true on success
+   */
+  static bool Parse(const string &text, WorkJson &value, string &error);
+
+  /**
+   * \brief Parse a JSON file
+   * \param filename the file
+   * \param value the parsed value
+   * \param error the error message, if any
+   * \return true on success
+   */
+  static bool ParseFile(const string &filename, WorkJson &value,
+                        string &error);
+
+  Type GetType(void) const { return m_type; }            //!< \return the type
+  bool IsNull(void) const { return m_type == NUL; }      //!< \return null
+  bool IsNumber(void) const { return m_type == NUMBER; } //!< \return number
+  bool IsString(void) const { return m_type == STRING; } //!< \return string
+  bool IsArray(void) const { return m_type == ARRAY; }   //!< \return array
+  bool IsObject(void) const { return m_type == OBJECT; } //!< \return object
+
+  bool GetBool(void) const;            //!< \return the boolean, or false
+  double GetNumber(void) const;        //!< \return the number, or 0
+  const string &GetString(void) const; //!< \return the string, or ""
+
+  /**
+   * \return the number of elements of an array or members of an object
+   */
+  size_t GetSize(void) const;
+
+  /**
+   * \param i an index
+   * \return the element of an array
+   */
+  const WorkJson &operator[](size_t i) const;
+
+  /**
+   * \param key a key
+   * \return the member of an object, a null value if missing
+   */
+  const WorkJson &operator[](const string &key) const;
+
+  /**
+   * \param key a key
+   * \return true if the object has the member
+   */
+  bool Has(const string &key) const;
+
+  /**
+   * \return the members of an object, in insertion order
+   */
+  const vector<pair<string, WorkJson>> &GetMembers(void) const;
+
+  /**
+   * \brief Append an element to an array
+   * \param value the element
+   * \return the array
+   */
+  WorkJson &Append(const WorkJson &value);
+
+  /**
+   * \brief Set a member of an object, replacing the previous value
+   * \param key the key
+   * \param value the value
+   * \return the object
+   */
+  WorkJson &Set(const string &key, const WorkJson &value);
+
+  /**
+   * \brief Write the value
+   * \param os the output stream
+   * \param indent spaces per level, 0 for a single line
+   */
+  void Dump(ostream &os, uint32_t indent = 2) const;
+
+  /**
+   * \param indent spaces per level, 0 for a single line
+   * \return the value as text
+   */
+  string Dump(uint32_t indent = 2) const;
+
+private:
+  /**
+   * \brief Write the value at a nesting level
+   * \param os the output stream
+   * \param indent spaces per level
+   * \param level the nesting level
+   */
+  void Dump(ostream &os, uint32_t indent, uint32_t level) const;
+
+  Type m_type;                              //!< Type
+  bool m_bool;                              //!< Boolean value
+  double m_number;                          //!< Number value
+  string m_string;                          //!< String value
+  vector<WorkJson> m_elements;              //!< Array elements
+  vector<pair<string, WorkJson>> m_members; //!< Object members, in order
+};
+
+} // namespace ns3
+
+#endif /* WORK_JSON_H */
@@ -0,0 +1,473 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#include "work-memory-accounting.h"
+#include "ns3/log.h"
+#include "ns3/node-list.h"
+#include "ns3/object-ptr-container.h"
+#include "ns3/pointer.h"
+#include "ns3/simulator.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <set>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE("WorkMemoryAccounting");
+
+namespace {
+
+/// A counter of the allocator hooks
+typedef std::atomic<uint64_t> Counter;
+
+/**
+ * Counters of the allocator hooks, zero-initialized before the first
+ * allocation of the program. The simulation runs on one thread, but other
+ * threads, e.g. the trace writer, allocate and free too: the counters are
+ * atomic, without ordering since they are only read for the report.
+ */
+struct MemoryCounters {
+  Counter live; //!< Bytes allocated and not freed
+  Counter peak; //!< Highest live bytes
+  /// Live bytes of each component
+  Counter components[WorkMemoryAccounting::COMPONENT_COUNT];
+  /// Live bytes of each component at the peak
+  Counter peakComponents[WorkMemoryAccounting::COMPONENT_COUNT];
+  /// Live bytes of each node, the last entry for the others and no node
+  Counter nodes[WorkMemoryAccounting::MAX_NODES + 1];
+  /// Highest live bytes of each node
+  Counter nodePeaks[WorkMemoryAccounting::MAX_NODES + 1];
+  std::atomic<uint8_t> component; //!< Component of the next allocations
+};
+
+MemoryCounters g_memory;
+
+/// True on the simulation thread while its context is readable, the
+/// allocations of the other threads are not attributed to a node
+thread_local bool t_trackNodes;
+
+/**
+ * \param counters counters of the hooks
+ * \param n the number of counters
+ * \return their values
+ */
+std::vector<uint64_t> Load(const Counter *counters, uint32_t n) {
+  std::vector<uint64_t> values(n);
+  for (uint32_t i = 0; i < n; ++i) {
+    values[i] = counters[i].load(std::memory_order_relaxed);
+  }
+  return values;
+}
+
+/**
+ * \brief Copy counters
+ * \param to the copies
+ * \param from the counters copied
+ * \param n the number of counters
+ */
+void Copy(Counter *to, const Counter *from, uint32_t n) {
+  for (uint32_t i = 0; i < n; ++i) {
+    to[i].store(from[i].load(std::memory_order_relaxed),
+                std::memory_order_relaxed);
+  }
+}
+
+#ifdef WORK_MEMORY_HOOKS
+/// True while reading the context, which may allocate
+thread_local bool t_inContext;
+
+/**
+ * \brief Raise a peak, from any thread
+ * \param peak the peak
+ * \param value the current value
+ * \return true if the value is the new peak
+ */
+bool RaisePeak(Counter &peak, uint64_t value) {
+  uint64_t current = peak.load(std::memory_order_relaxed);
+  while (current < value) {
+    if (peak.compare_exchange_weak(current, value,
+                                   std::memory_order_relaxed)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/// Header of every block, keeps the default alignment of the payload
+struct alignas(16) BlockHeader {
+  uint64_t size;      //!< Bytes requested
+  uint32_t node;      //!< Node of the allocating event
+  uint16_t component; //!< Component of the allocation
+};
+
+/**
+ * \return the node of the current event, MAX_NODES for none
+ */
+uint32_t CurrentNode(void) {
+  if (!t_trackNodes || t_inContext) {
+    return WorkMemoryAccounting::MAX_NODES;
+  }
+  t_inContext = true;
+  uint32_t context = Simulator::GetContext();
+  t_inContext = false;
+  return std::min(context, WorkMemoryAccounting::MAX_NODES);
+}
+
+/**
+ * \param size the bytes requested
+ * \return the block, null if out of memory
+ */
+void *Allocate(std::size_t size) {
+  BlockHeader *header =
+      static_cast<BlockHeader *>(std::malloc(sizeof(BlockHeader) + size));
+  if (!header) {
+    return nullptr;
+  }
+  header->size = size;
+  header->node = CurrentNode();
+  header->component = g_memory.component.load(std::memory_order_relaxed);
+  uint64_t live = g_memory.live.fetch_add(size, std::memory_order_relaxed);
+  g_memory.components[header->component].fetch_add(
+      size, std::memory_order_relaxed);
+  uint64_t node = g_memory.nodes[header->node].fetch_add(
+      size, std::memory_order_relaxed);
+  RaisePeak(g_memory.nodePeaks[header->node], node + size);
+  if (RaisePeak(g_memory.peak, live + size)) {
+    Copy(g_memory.peakComponents, g_memory.components,
+         WorkMemoryAccounting::COMPONENT_COUNT);
+  }
+  return header + 1;
+}
+
+/**
+ * \param block a block of Allocate, or null
+ */
+void Release(void *block) {
+  if (!block) {
+    return;
+  }
+  BlockHeader *header = static_cast<BlockHeader *>(block) - 1;
+  g_memory.live.fetch_sub(header->size, std::memory_order_relaxed);
+  g_memory.components[header->component].fetch_sub(
+      header->size, std::memory_order_relaxed);
+  g_memory.nodes[header->node].fetch_sub(header->size,
+                                         std::memory_order_relaxed);
+  std::free(header);
+}
+#endif /* WORK_MEMORY_HOOKS */
+
+} // namespace
+
+const uint32_t WorkMemoryAccounting::MAX_NODES;
+
+WorkMemoryAccounting::WorkMemoryAccounting() { NS_LOG_FUNCTION(this); }
+
+bool WorkMemoryAccounting::IsEnabled(void) {
+#ifdef WORK_MEMORY_HOOKS
+  return true;
+#else
+  return false;
+#endif
+}
+
+WorkMemoryAccounting::Component
+WorkMemoryAccounting::SetComponent(Component component) {
+  return Component(
+      g_memory.component.exchange(component, std::memory_order_relaxed));
+}
+
+string WorkMemoryAccounting::GetComponentName(Component component) {
+  static const char *names[COMPONENT_COUNT] = {
+      "other",    "nodes",    "csma",         "wifi",
+      "mobility", "internet", "applications", "run"};
+  return component < COMPONENT_COUNT ? names[component] : "unknown";
+}
+
+uint64_t WorkMemoryAccounting::GetLive(void) {
+  return g_memory.live.load(std::memory_order_relaxed);
+}
+
+uint64_t WorkMemoryAccounting::GetLive(Component component) {
+  return g_memory.components[component].load(std::memory_order_relaxed);
+}
+
+uint64_t WorkMemoryAccounting::GetPeak(void) {
+  return g_memory.peak.load(std::memory_order_relaxed);
+}
+
+void WorkMemoryAccounting::ResetPeak(void) {
+  g_memory.peak.store(GetLive(), std::memory_order_relaxed);
+  Copy(g_memory.peakComponents, g_memory.components, COMPONENT_COUNT);
+  Copy(g_memory.nodePeaks, g_memory.nodes, MAX_NODES + 1);
+}
+
+void WorkMemoryAccounting::Snapshot(const string &name) {
+  NS_LOG_FUNCTION(this << name);
+  m_snapshots.push_back(
+      make_pair(name, Load(g_memory.components, COMPONENT_COUNT)));
+}
+
+void WorkMemoryAccounting::Install(void) {
+  NS_LOG_FUNCTION(this);
+  SetComponent(RUN);
+  ResetPeak();
+  // Install runs on the simulation thread
+  t_trackNodes = IsEnabled();
+  // Reading the context of a destroyed simulator would create a new one
+  Simulator::ScheduleDestroy(&WorkMemoryAccounting::Stop);
+}
+
+void WorkMemoryAccounting::Stop(void) {
+  t_trackNodes = false;
+  SetComponent(OTHER);
+}
+
+std::map<string, uint64_t> WorkMemoryAccounting::CountObjects(void) {
+  std::map<string, uint64_t> counts;
+  std::set<Object *> visited;
+  std::vector<Ptr<Object>> pending;
+  for (auto it = NodeList::Begin(); it != NodeList::End(); ++it) {
+    pending.push_back(*it);
+  }
+  while (!pending.empty()) {
+    Ptr<Object> object = pending.back();
+    pending.pop_back();
+    if (!visited.insert(PeekPointer(object)).second) {
+      continue;
+    }
+    counts[object->GetInstanceTypeId().GetName()]++;
+    Object::AggregateIterator aggregates = object->GetAggregateIterator();
+    while (aggregates.HasNext()) {
+      pending.push_back(ConstCast<Object>(aggregates.Next()));
+    }
+    // The objects held by the attributes, e.g. the devices of a node or the
+    // MAC of a Wi-Fi device, of the type and of its parents
+    TypeId tid = object->GetInstanceTypeId();
+    while (true) {
+      for (uint32_t i = 0; i < tid.GetAttributeN(); ++i) {
+        TypeId::AttributeInformation info = tid.GetAttribute(i);
+        if (!(info.flags & TypeId::ATTR_GET) || !info.accessor->HasGetter()) {
+          continue;
+        }
+        const AttributeChecker *checker = PeekPointer(info.checker);
+        if (dynamic_cast<const PointerChecker *>(checker)) {
+          PointerValue value;
+          if (object->GetAttributeFailSafe(info.name, value) &&
+              value.GetObject()) {
+            pending.push_back(value.GetObject());
+          }
+        } else if (dynamic_cast<const ObjectPtrContainerChecker *>(checker)) {
+          ObjectPtrContainerValue value;
+          if (object->GetAttributeFailSafe(info.name, value)) {
+            for (auto element = value.Begin(); element != value.End();
+                 ++element) {
+              pending.push_back(element->second);
+            }
+          }
+        }
+      }
+      TypeId parent = tid.GetParent();
+      if (parent == tid) {
+        break;
+      }
+      tid = parent;
+    }
+  }
+  return counts;
+}
+
+WorkJson WorkMemoryAccounting::GetReport(const NodeContainer &stations,
+                                         uint32_t top) const {
+  NS_LOG_FUNCTION(this << top);
+  auto components = [](const uint64_t *bytes) {
+    WorkJson object = WorkJson::Object();
+    for (uint32_t c = 0; c < COMPONENT_COUNT; ++c) {
+      object.Set(GetComponentName(Component(c)), bytes[c]);
+    }
+    return object;
+  };
+  auto total = [](const Usage &usage) {
+    uint64_t bytes = 0;
+    for (uint64_t value : usage) {
+      bytes += value;
+    }
+    return bytes;
+  };
+
+  WorkJson report = WorkJson::Object();
+  report.Set("hooks", IsEnabled());
+  report.Set("stations", stations.GetN());
+  // The bytes before the first snapshot, e.g. the ns-3 type registry, are
+  // not the cost of the stations
+  uint64_t base = m_snapshots.empty() ? 0 : total(m_snapshots[0].second);
+  uint64_t built = GetLive();
+  WorkJson snapshots = WorkJson::Object();
+  for (const auto &snapshot : m_snapshots) {
+    WorkJson entry = WorkJson::Object();
+    entry.Set("live", total(snapshot.second));
+    entry.Set("components", components(snapshot.second.data()));
+    snapshots.Set(snapshot.first, entry);
+    if (snapshot.first == "build") {
+      built = total(snapshot.second);
+    }
+  }
+  report.Set("snapshots", snapshots);
+  WorkJson peak = WorkJson::Object();
+  peak.Set("live", GetPeak());
+  Usage peakComponents = Load(g_memory.peakComponents, COMPONENT_COUNT);
+  peak.Set("components", components(peakComponents.data()));
+  report.Set("peak", peak);
+  double n = std::max(stations.GetN(), 1u);
+  report.Set("bytesPerStationBuild",
+             (built > base ? built - base : 0) / n);
+  report.Set("bytesPerStationPeak",
+             (GetPeak() > base ? GetPeak() - base : 0) / n);
+
+  // Run allocations of the stations, by the context of the events
+  std::vector<uint64_t> nodePeaks =
+      Load(g_memory.nodePeaks, MAX_NODES + 1);
+  uint64_t stationPeaks = 0;
+  uint64_t stationMax = 0;
+  for (uint32_t i = 0; i < stations.GetN(); ++i) {
+    uint32_t id = std::min(stations.Get(i)->GetId(), MAX_NODES);
+    stationPeaks += nodePeaks[id];
+    stationMax = std::max(stationMax, nodePeaks[id]);
+  }
+  report.Set("runBytesPerStation", stationPeaks / n);
+  report.Set("runBytesStationMax", stationMax);
+  std::vector<pair<uint64_t, uint32_t>> nodes;
+  for (uint32_t id = 0; id < std::min(NodeList::GetNNodes(), MAX_NODES);
+       ++id) {
+    nodes.push_back(make_pair(nodePeaks[id], id));
+  }
+  std::sort(nodes.rbegin(), nodes.rend());
+  WorkJson topNodes = WorkJson::Array();
+  for (uint32_t i = 0; i < std::min<size_t>(top, nodes.size()); ++i) {
+    WorkJson node = WorkJson::Object();
+    node.Set("node", nodes[i].second);
+    node.Set("runPeak", nodes[i].first);
+    node.Set("runLive", g_memory.nodes[nodes[i].second].load(
+                            std::memory_order_relaxed));
+    topNodes.Append(node);
+  }
+  report.Set("nodes", topNodes);
+
+  std::vector<pair<uint64_t, string>> types;
+  for (const auto &count : CountObjects()) {
+    types.push_back(make_pair(count.second, count.first));
+  }
+  std::sort(types.rbegin(), types.rend());
+  WorkJson objects = WorkJson::Array();
+  for (uint32_t i = 0; i < std::min<size_t>(top, types.size()); ++i) {
+    WorkJson type = WorkJson::Object();
+    type.Set("type", types[i].second);
+    type.Set("count", types[i].first);
+    objects.Append(type);
+  }
+  report.Set("objects", objects);
+  return report;
+}
+
+void WorkMemoryAccounting::Print(const WorkJson &report, ostream &os) {
+  uint32_t stations = report["stations"].GetNumber();
+  if (report["hooks"].GetBool()) {
+    os << "Memory of " << stations << " stations: "
+       << uint64_t(report["bytesPerStationBuild"].GetNumber())
+       << " bytes per station after the build, "
+       << uint64_t(report["bytesPerStationPeak"].GetNumber())
+       << " at the peak, " << uint64_t(report["peak"]["live"].GetNumber())
+       << " bytes at the peak" << endl;
+    for (const auto &snapshot : report["snapshots"].GetMembers()) {
+      os << "  " << snapshot.first << ":";
+      for (const auto &component :
+           snapshot.second["components"].GetMembers()) {
+        os << " " << component.first << " "
+           << uint64_t(component.second.GetNumber());
+      }
+      os << endl;
+    }
+    os << "  peak:";
+    for (const auto &component : report["peak"]["components"].GetMembers()) {
+      os << " " << component.first << " "
+         << uint64_t(component.second.GetNumber());
+    }
+    os << endl;
+    os << "  run bytes per station "
+       << uint64_t(report["runBytesPerStation"].GetNumber()) << ", nodes:";
+    const WorkJson &nodes = report["nodes"];
+    for (size_t i = 0; i < nodes.GetSize(); ++i) {
+      os << " " << nodes[i]["node"].GetNumber() << " "
+         << uint64_t(nodes[i]["runPeak"].GetNumber());
+    }
+    os << endl;
+  } else {
+    os << "Memory of " << stations
+       << " stations: allocator hooks not built, objects only" << endl;
+  }
+  os << "  objects:";
+  const WorkJson &objects = report["objects"];
+  for (size_t i = 0; i < objects.GetSize(); ++i) {
+    os << " " << objects[i]["type"].GetString() << " "
+       << objects[i]["count"].GetNumber();
+  }
+  os << endl;
+}
+
+WorkMemoryScope::WorkMemoryScope(WorkMemoryAccounting::Component component)
+    : m_previous(WorkMemoryAccounting::SetComponent(component)) {}
+
+WorkMemoryScope::~WorkMemoryScope() {
+  WorkMemoryAccounting::SetComponent(m_previous);
+}
+
+void WorkMemoryScope::Set(WorkMemoryAccounting::Component component) {
+  WorkMemoryAccounting::SetComponent(component);
+}
+
+} // Namespace ns3
+
+#ifdef WORK_MEMORY_HOOKS
+// Replacements of the global allocation functions, the aligned ones are
+// left to the standard library
+void *operator new(std::size_t size) {
+  void *block = ns3::Allocate(size);
+  if (!block) {
+    throw std::bad_alloc();
+  }
+  return block;
+}
+
+void *operator new[](std::size_t size) { return operator new(size); }
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  return ns3::Allocate(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+  return ns3::Allocate(size);
+}
+
+void operator delete(void *block) noexcept { ns3::Release(block); }
+
+void operator delete[](void *block) noexcept { ns3::Release(block); }
+
+void operator delete(void *block, std::size_t) noexcept {
+  ns3::Release(block);
+}
+
+void operator delete[](void *block, std::size_t) noexcept {
+  ns3::Release(block);
+}
+
+void operator delete(void *block, const std::nothrow_t &) noexcept {
+  ns3::Release(block);
+}
+
+void operator delete[](void *block, const std::nothrow_t &) noexcept {
+  ns3::Release(block);
+}
+#endif /* WORK_MEMORY_HOOKS */
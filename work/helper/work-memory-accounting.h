@@ -0,0 +1,194 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#ifndef WORK_MEMORY_ACCOUNTING_H
+#define WORK_MEMORY_ACCOUNTING_H
+
+#include "ns3/node-container.h"
+#include "ns3/work-json.h"
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace ns3 {
+
+/**
+ * \ingroup applications
+ *
+ * \brief Heap usage of the simulation, by component and by node.
+ *
+ * Built with the WORK_MEMORY_HOOKS define (./waf configure
+ * --enable-work-memory-hooks), the module replaces the global operator new
+ * and delete: every block carries a small header with its size, the
+ * component active when it was allocated and the node of the event that
+ * allocated it, so the live bytes of each are known when it is freed. The
+ * component is set by WorkMemoryScope around the steps of the scenario
+ * build (Wi-Fi devices, internet stacks, applications, ...); during the run
+ * everything is counted as "run" and attributed to the node of the current
+ * event, its simulator context.
+ *
+ * Without the define nothing is counted, only the census of the ns-3
+ * objects is available. The report holds the bytes per station after the
+ * build and at the peak of the run, and the most numerous ns-3 objects, so
+ * that the largest topology fitting a machine can be predicted and the
+ * growth of a station tracked as a regression metric:
+ *
+ *   WorkMemoryAccounting memory;
+ *   scenario.Configure();
+ *   memory.Snapshot("start");
+ *   scenario.BuildTopology();
+ *   scenario.InstallApplications();
+ *   memory.Snapshot("build");
+ *   memory.Install();
+ *   Simulator::Run();
+ *   WorkJson report = memory.GetReport(scenario.GetStaNodes());
+ *
+ * The simulation runs on one thread: the allocations of the other threads,
+ * e.g. the trace writer, are counted without node.
+ */
+class WorkMemoryAccounting {
+public:
+  /// Parts of the simulation the allocations are attributed to
+  enum Component {
+    OTHER = 0,    //!< Outside of any scope
+    NODES,        //!< Node objects
+    CSMA,         //!< CSMA link and bridge of the AP
+    WIFI,         //!< Wi-Fi channel, PHY, MAC and station managers
+    MOBILITY,     //!< Mobility models
+    INTERNET,     //!< IP, TCP and UDP stacks and addresses
+    APPLICATIONS, //!< Server, aggregator and devices
+    RUN,          //!< Everything allocated by the events
+    COMPONENT_COUNT
+  };
+
+  /// Nodes tracked one by one, the others are counted together
+  static const uint32_t MAX_NODES = 65536;
+
+  WorkMemoryAccounting();
+
+  /**
+   * \return true if the allocator hooks are built in
+   */
+  static bool IsEnabled(void);
+
+  /**
+   * \brief Set the component of the next allocations
+   * \param component the component
+   * \return the previous component
+   */
+  static Component SetComponent(Component component);
+
+  /**
+   * \param component a component
+   * \return the name of the component, e.g. "wifi"
+   */
+  static string GetComponentName(Component component);
+
+  /**
+   * \return the bytes allocated and not freed
+   */
+  static uint64_t GetLive(void);
+
+  /**
+   * \param component a component
+   * \return the bytes allocated by the component and not freed
+   */
+  static uint64_t GetLive(Component component);
+
+  /**
+   * \return the highest live bytes since the last ResetPeak
+   */
+  static uint64_t GetPeak(void);
+
+  /**
+   * \brief Restart the peak from the current live bytes
+   */
+  static void ResetPeak(void);
+
+  /**
+   * \brief Record the live bytes of every component
+   * \param name the name of the snapshot, e.g. "build"
+   */
+  void Snapshot(const string &name);
+
+  /**
+   * \brief Count the next allocations as the run, by node, and measure
+   *        the peak from now on
+   *
+   * The node attribution stops when the simulator is destroyed.
+   */
+  void Install(void);
+
+  /**
+   * \brief Count the ns-3 objects reachable from the nodes
+   *
+   * The aggregated objects, the devices, the applications and the objects
+   * held by their pointer attributes (the Wi-Fi MAC, PHY, queues, ...) are
+   * counted once each, by type.
+   *
+   * \return the number of objects by type name
+   */
+  static std::map<string, uint64_t> CountObjects(void);
+
+  /**
+   * \brief Build the report
+   * \param stations the nodes the bytes are divided by
+   * \param top the number of nodes and object types listed
+   * \return the report, with "bytesPerStationBuild" and
+   *         "bytesPerStationPeak" as regression metrics
+   */
+  WorkJson GetReport(const NodeContainer &stations, uint32_t top = 10) const;
+
+  /**
+   * \brief Print a report
+   * \param report the report of GetReport
+   * \param os the output stream
+   */
+  static void Print(const WorkJson &report, ostream &os);
+
+private:
+  /**
+   * \brief Stop the node attribution, before the simulator is destroyed
+   */
+  static void Stop(void);
+
+  /// Live bytes of every component
+  typedef std::vector<uint64_t> Usage;
+
+  /// Snapshots, in order
+  std::vector<pair<string, Usage>> m_snapshots;
+};
+
+/**
+ * \ingroup applications
+ *
+ * \brief Attribute the allocations of a scope to a component.
+ *
+ * The previous component is restored at the end of the scope.
+ */
+class WorkMemoryScope {
+public:
+  /**
+   * \param component the component of the allocations
+   */
+  WorkMemoryScope(WorkMemoryAccounting::Component component);
+  ~WorkMemoryScope();
+
+  /**
+   * \brief Change the component until the end of the scope
+   * \param component the component of the next allocations
+   */
+  void Set(WorkMemoryAccounting::Component component);
+
+private:
+  WorkMemoryAccounting::Component m_previous; //!< Restored at the end
+};
+
+} // namespace ns3
+
+#endif /* WORK_MEMORY_ACCOUNTING_H */
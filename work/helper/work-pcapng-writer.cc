@@ -0,0 +1,250 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#include "work-pcapng-writer.h"
+#include "ns3/callback.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/wifi-net-device.h"
+#include "ns3/wifi-phy.h"
+#include <cstring>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE("WorkPcapngWriter");
+
+/// pcapng block types
+enum PcapngBlock : uint32_t {
+  PCAPNG_SECTION_HEADER = 0x0a0d0d0a,  //!< Section header block
+  PCAPNG_INTERFACE = 0x00000001,       //!< Interface description block
+  PCAPNG_ENHANCED_PACKET = 0x00000006, //!< Enhanced packet block
+};
+
+static const uint16_t LINKTYPE_ETHERNET = 1;     //!< Ethernet frames
+static const uint16_t LINKTYPE_IEEE802_11 = 105; //!< 802.11 frames
+
+/**
+ * \brief Append a value to a block, in host byte order
+ * \param block the block
+ * \param value the value
+ */
+template <typename T>
+static void Put(std::vector<uint8_t> &block, T value) {
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&value);
+  block.insert(block.end(), bytes, bytes + sizeof(T));
+}
+
+/**
+ * \brief Pad a block to a multiple of 4 bytes
+ * \param block the block
+ */
+static void Pad(std::vector<uint8_t> &block) {
+  block.resize((block.size() + 3) & ~size_t(3), 0);
+}
+
+/**
+ * \brief Start a block, its total length is set by EndBlock
+ * \param type the block type
+ * \return the block
+ */
+static std::vector<uint8_t> StartBlock(PcapngBlock type) {
+  std::vector<uint8_t> block;
+  Put<uint32_t>(block, type);
+  Put<uint32_t>(block, 0);
+  return block;
+}
+
+/**
+ * \brief Write the total length at both ends of a block
+ * \param block the block
+ */
+static void EndBlock(std::vector<uint8_t> &block) {
+  uint32_t length = block.size() + sizeof(uint32_t);
+  memcpy(&block[4], &length, sizeof(length));
+  Put<uint32_t>(block, length);
+}
+
+/// Sink of the "Sniffer" trace source of a device
+static void SniffDevice(WorkPcapngWriter *writer, uint32_t interface,
+                        Ptr<const Packet> packet) {
+  writer->Capture(interface, packet);
+}
+
+/// Sink of the "MonitorSnifferRx" trace source of a Wi-Fi PHY
+static void SniffWifiRx(WorkPcapngWriter *writer, uint32_t interface,
+                        Ptr<const Packet> packet, uint16_t channelFreqMhz,
+                        WifiTxVector txVector, MpduInfo aMpdu,
+                        SignalNoiseDbm signalNoise, uint16_t staId) {
+  writer->Capture(interface, packet);
+}
+
+/// Sink of the "MonitorSnifferTx" trace source of a Wi-Fi PHY
+static void SniffWifiTx(WorkPcapngWriter *writer, uint32_t interface,
+                        Ptr<const Packet> packet, uint16_t channelFreqMhz,
+                        WifiTxVector txVector, MpduInfo aMpdu,
+                        uint16_t staId) {
+  writer->Capture(interface, packet);
+}
+
+WorkPcapngWriter::WorkPcapngWriter()
+    : m_file(0), m_snaplen(128), m_interfaces(0), m_triggerMode(false),
+      m_triggered(true), m_maxBuffered(0), m_packets(0), m_triggers(0) {
+  NS_LOG_FUNCTION(this);
+}
+
+WorkPcapngWriter::~WorkPcapngWriter() {
+  NS_LOG_FUNCTION(this);
+  Close();
+}
+
+void WorkPcapngWriter::Open(const string &filename, uint32_t snaplen) {
+  NS_LOG_FUNCTION(this << filename << snaplen);
+  NS_ABORT_MSG_IF(snaplen == 0, "The snap length must be positive");
+  Close();
+  m_file = fopen(filename.c_str(), "wb");
+  NS_ABORT_MSG_IF(!m_file, "Cannot open capture file " << filename);
+  m_snaplen = snaplen;
+  m_interfaces = 0;
+  m_packets = 0;
+  m_triggers = 0;
+
+  std::vector<uint8_t> block = StartBlock(PCAPNG_SECTION_HEADER);
+  Put<uint32_t>(block, 0x1a2b3c4d); // Byte order magic
+  Put<uint16_t>(block, 1);          // Version 1.0
+  Put<uint16_t>(block, 0);
+  Put<int64_t>(block, -1); // Section length not specified
+  EndBlock(block);
+  Write(block);
+  Simulator::ScheduleDestroy(&WorkPcapngWriter::Close, this);
+}
+
+void WorkPcapngWriter::SetTrigger(Time preTrigger, Time postTrigger,
+                                  uint32_t maxBuffered) {
+  NS_LOG_FUNCTION(this << preTrigger << postTrigger << maxBuffered);
+  m_triggerMode = true;
+  m_triggered = false;
+  m_preTrigger = preTrigger;
+  m_postTrigger = postTrigger;
+  m_maxBuffered = maxBuffered;
+}
+
+void WorkPcapngWriter::AddDevice(Ptr<NetDevice> device, const string &name) {
+  NS_LOG_FUNCTION(this << device << name);
+  NS_ABORT_MSG_IF(!m_file, "Open the capture before adding devices");
+  uint32_t interface = m_interfaces;
+  uint16_t linkType = LINKTYPE_ETHERNET;
+  Ptr<WifiNetDevice> wifi = DynamicCast<WifiNetDevice>(device);
+  if (wifi) {
+    linkType = LINKTYPE_IEEE802_11;
+    wifi->GetPhy()->TraceConnectWithoutContext(
+        "MonitorSnifferRx", MakeBoundCallback(&SniffWifiRx, this, interface));
+    wifi->GetPhy()->TraceConnectWithoutContext(
+        "MonitorSnifferTx", MakeBoundCallback(&SniffWifiTx, this, interface));
+  } else if (!device->TraceConnectWithoutContext(
+                 "Sniffer", MakeBoundCallback(&SniffDevice, this, interface))) {
+    NS_LOG_WARN("Device " << device << " has no sniffer, not captured");
+    return;
+  }
+  m_interfaces++;
+
+  std::vector<uint8_t> block = StartBlock(PCAPNG_INTERFACE);
+  Put<uint16_t>(block, linkType);
+  Put<uint16_t>(block, 0);
+  Put<uint32_t>(block, m_snaplen);
+  // if_name
+  Put<uint16_t>(block, 2);
+  Put<uint16_t>(block, name.size());
+  block.insert(block.end(), name.begin(), name.end());
+  Pad(block);
+  // if_tsresol: nanoseconds
+  Put<uint16_t>(block, 9);
+  Put<uint16_t>(block, 1);
+  Put<uint8_t>(block, 9);
+  Pad(block);
+  // opt_endofopt
+  Put<uint32_t>(block, 0);
+  EndBlock(block);
+  Write(block);
+}
+
+void WorkPcapngWriter::Capture(uint32_t interface, Ptr<const Packet> packet) {
+  if (!m_file) {
+    return;
+  }
+  int64_t now = Simulator::Now().GetNanoSeconds();
+  if (m_triggered && m_triggerMode && Simulator::Now() >= m_triggerEnd) {
+    NS_LOG_INFO("Trigger ended @" << Simulator::Now().As(Time::S));
+    m_triggered = false;
+  }
+
+  uint32_t size = packet->GetSize();
+  uint32_t captured = std::min(size, m_snaplen);
+  std::vector<uint8_t> block = StartBlock(PCAPNG_ENHANCED_PACKET);
+  Put<uint32_t>(block, interface);
+  Put<uint32_t>(block, uint64_t(now) >> 32);
+  Put<uint32_t>(block, uint64_t(now) & 0xffffffff);
+  Put<uint32_t>(block, captured);
+  Put<uint32_t>(block, size);
+  size_t offset = block.size();
+  block.resize(offset + captured);
+  packet->CopyData(&block[offset], captured);
+  Pad(block);
+  EndBlock(block);
+
+  if (m_triggered) {
+    Write(block);
+    m_packets++;
+    return;
+  }
+  // Keep only the last preTrigger of capture
+  int64_t oldest = now - m_preTrigger.GetNanoSeconds();
+  while (!m_ring.empty() &&
+         (m_ring.front().time < oldest || m_ring.size() >= m_maxBuffered)) {
+    m_ring.pop_front();
+  }
+  if (m_maxBuffered > 0) {
+    m_ring.push_back({now, std::move(block)});
+  }
+}
+
+void WorkPcapngWriter::Trigger(const string &reason) {
+  if (!m_file || !m_triggerMode) {
+    return;
+  }
+  NS_LOG_FUNCTION(this << reason);
+  if (!m_triggered) {
+    NS_LOG_INFO("Capture triggered by " << reason << " @"
+                                        << Simulator::Now().As(Time::S));
+    m_triggers++;
+    for (const Record &record : m_ring) {
+      Write(record.block);
+    }
+    m_packets += m_ring.size();
+    m_ring.clear();
+    m_triggered = true;
+  }
+  // A trigger during a capture extends it
+  m_triggerEnd = Simulator::Now() + m_postTrigger;
+}
+
+void WorkPcapngWriter::Write(const std::vector<uint8_t> &block) {
+  fwrite(block.data(), 1, block.size(), m_file);
+}
+
+void WorkPcapngWriter::Close(void) {
+  if (!m_file) {
+    return;
+  }
+  NS_LOG_FUNCTION(this);
+  fclose(m_file);
+  m_file = 0;
+  m_ring.clear();
+}
+
+uint64_t WorkPcapngWriter::GetPackets(void) const { return m_packets; }
+
+uint32_t WorkPcapngWriter::GetTriggers(void) const { return m_triggers; }
+
+} // Namespace ns3
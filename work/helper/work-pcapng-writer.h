@@ -0,0 +1,128 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#ifndef WORK_PCAPNG_WRITER_H
+#define WORK_PCAPNG_WRITER_H
+
+#include "ns3/net-device.h"
+#include "ns3/nstime.h"
+#include "ns3/packet.h"
+#include "ns3/ptr.h"
+#include <deque>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace ns3 {
+
+/**
+ * \ingroup applications
+ *
+ * \brief Single pcapng capture of several devices, with capture triggers.
+ *
+ * Every device added is an interface of the capture, described by an
+ * interface block with its name, link type and snap length: Ethernet for
+ * the devices with a "Sniffer" trace source (CSMA), IEEE 802.11 for the
+ * Wi-Fi devices (frames seen by the monitor sniffers of the PHY). The
+ * packets of every interface are written in a single file as the
+ * simulation produces them, so the capture is ordered by time, and are
+ * truncated to the snap length.
+ *
+ * Without a trigger every packet is written. With SetTrigger the packets
+ * are kept in a pre-trigger ring holding the last "preTrigger" of capture;
+ * a call to Trigger, e.g. on a failed connection or a round-trip time
+ * above a threshold, writes the ring and then every packet of the next
+ * "postTrigger", after which the writer goes back to the ring.
+ */
+class WorkPcapngWriter {
+public:
+  WorkPcapngWriter();
+
+  virtual ~WorkPcapngWriter();
+
+  /**
+   * \brief Create the capture file
+   * \param filename the capture file
+   * \param snaplen the bytes kept of each packet
+   */
+  void Open(const string &filename, uint32_t snaplen = 128);
+
+  /**
+   * \brief Capture only around triggers
+   * \param preTrigger the capture kept before a trigger
+   * \param postTrigger the capture written after a trigger
+   * \param maxBuffered the packets kept at most in the pre-trigger ring
+   */
+  void SetTrigger(Time preTrigger, Time postTrigger,
+                  uint32_t maxBuffered = 65536);
+
+  /**
+   * \brief Add a device to the capture
+   * \param device a Wi-Fi device or a device with a "Sniffer" trace source
+   * \param name the name of the interface
+   */
+  void AddDevice(Ptr<NetDevice> device, const string &name);
+
+  /**
+   * \brief Write the pre-trigger ring and the packets that follow
+   * \param reason the cause of the trigger, logged
+   */
+  void Trigger(const string &reason);
+
+  /**
+   * \brief Close the capture file, dropping the pre-trigger ring
+   */
+  void Close(void);
+
+  /**
+   * \return number of packets written
+   */
+  uint64_t GetPackets(void) const;
+
+  /**
+   * \return number of triggers
+   */
+  uint32_t GetTriggers(void) const;
+
+  /**
+   * \brief Capture a packet, called by the sniffer trace sinks
+   * \param interface the interface id
+   * \param packet the packet
+   */
+  void Capture(uint32_t interface, Ptr<const Packet> packet);
+
+private:
+  /// Enhanced packet block waiting for a trigger
+  struct Record {
+    int64_t time;               //!< Capture time, in nanoseconds
+    std::vector<uint8_t> block; //!< Enhanced packet block
+  };
+
+  /**
+   * \brief Write a block
+   * \param block the block
+   */
+  void Write(const std::vector<uint8_t> &block);
+
+  FILE *m_file;              //!< Capture file
+  uint32_t m_snaplen;        //!< Bytes kept of each packet
+  uint32_t m_interfaces;     //!< Number of interfaces
+  bool m_triggerMode;        //!< True to capture only around triggers
+  bool m_triggered;          //!< True while packets are written
+  Time m_preTrigger;         //!< Capture kept before a trigger
+  Time m_postTrigger;        //!< Capture written after a trigger
+  Time m_triggerEnd;         //!< End of the current trigger
+  uint32_t m_maxBuffered;    //!< Size limit of the ring
+  std::deque<Record> m_ring; //!< Pre-trigger ring
+  uint64_t m_packets;        //!< Packets written
+  uint32_t m_triggers;       //!< Number of triggers
+};
+
+} // namespace ns3
+
+#endif /* WORK_PCAPNG_WRITER_H */
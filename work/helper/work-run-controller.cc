@@ -0,0 +1,267 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#include "work-run-controller.h"
+#include "ns3/callback.h"
+#include "ns3/config.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/work-utils.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE("WorkRunController");
+
+/// Names of the metrics, by WorkRunController::Metric
+static const char *g_metricNames[WorkRunController::METRIC_COUNT] = {
+    "throughput", "rttMean", "rttP99"};
+
+WorkRunController::WorkRunController()
+    : m_batch(0), m_minBatches(10), m_metricNames("throughput,rttMean"),
+      m_precision(0.05), m_maxFailureRate(0), m_maxRtt(0), m_refused(0),
+      m_outcome(RUNNING), m_warmup(0), m_sent(0), m_responses(0),
+      m_failures(0) {
+  NS_LOG_FUNCTION(this);
+  for (uint32_t metric = 0; metric < METRIC_COUNT; ++metric) {
+    m_metrics[metric] = false;
+    m_mean[metric] = 0.0;
+    m_halfWidth[metric] = 0.0;
+  }
+}
+
+void WorkRunController::AddCommandLine(CommandLine &cmd) {
+  cmd.AddValue("runBatch",
+               "Batch length of the convergence test in s, 0 to run the "
+               "whole simulation time",
+               m_batch);
+  cmd.AddValue("runMinBatches", "Batches needed after the warm-up",
+               m_minBatches);
+  cmd.AddValue("runMetrics",
+               "Metrics that must converge: throughput, rttMean, rttP99",
+               m_metricNames);
+  cmd.AddValue("runPrecision",
+               "Half-width of the 95% confidence intervals, relative to the "
+               "mean",
+               m_precision);
+  cmd.AddValue("runMaxFailure",
+               "Share of failed requests of a batch that stops the run, 0 "
+               "to disable",
+               m_maxFailureRate);
+  cmd.AddValue("runMaxRtt",
+               "Mean RTT of a batch in ms that stops the run, 0 to disable",
+               m_maxRtt);
+}
+
+void WorkRunController::SetBatch(Time batch, uint32_t minBatches) {
+  m_batch = batch.GetSeconds();
+  m_minBatches = minBatches;
+}
+
+void WorkRunController::SetConvergence(const string &metrics,
+                                       double precision) {
+  m_metricNames = metrics;
+  m_precision = precision;
+}
+
+void WorkRunController::SetFailure(double maxFailureRate, Time maxRtt) {
+  m_maxFailureRate = maxFailureRate;
+  m_maxRtt = maxRtt.GetSeconds() * 1000.0;
+}
+
+void WorkRunController::Install(Time start) {
+  NS_LOG_FUNCTION(this << start);
+  if (!IsEnabled()) {
+    return;
+  }
+  NS_ABORT_MSG_IF(m_precision <= 0, "Bad run precision " << m_precision);
+  stringstream names(m_metricNames);
+  string name;
+  while (getline(names, name, ',')) {
+    uint32_t metric = 0;
+    while (metric < METRIC_COUNT && name != g_metricNames[metric]) {
+      metric++;
+    }
+    NS_ABORT_MSG_IF(metric == METRIC_COUNT, "Unknown run metric " << name);
+    m_metrics[metric] = true;
+  }
+  m_refused = WorkEventTrace::Intern("[Refused]");
+  Config::ConnectWithoutContext(
+      "/NodeList/*/ApplicationList/*/$ns3::DeviceEnforcer/Event",
+      MakeCallback(&WorkRunController::Notify, this));
+  // The events before the start are not part of the first batch
+  m_event = Simulator::Schedule(start, &WorkRunController::StartBatch, this);
+}
+
+void WorkRunController::Notify(const WorkEvent &event) {
+  switch (event.code) {
+  case WORK_TRACE_DEVICE_SEND:
+    m_sent++;
+    break;
+  case WORK_TRACE_DEVICE_RESPONSE:
+    m_responses++;
+    if (event.message == m_refused) {
+      m_failures++;
+    }
+    if (event.delay > 0) { // Not measured on retransmitted requests
+      m_rtts.push_back(Time(event.delay).GetSeconds() * 1000.0);
+    }
+    break;
+  case WORK_TRACE_DEVICE_ABANDON:
+  case WORK_TRACE_DEVICE_CONNECT_FAILED:
+    m_failures++;
+    break;
+  default:
+    break;
+  }
+}
+
+void WorkRunController::StartBatch(void) {
+  m_sent = 0;
+  m_responses = 0;
+  m_failures = 0;
+  m_rtts.clear();
+  m_event = Simulator::Schedule(Seconds(m_batch),
+                                &WorkRunController::Evaluate, this);
+}
+
+void WorkRunController::Evaluate(void) {
+  NS_LOG_FUNCTION(this);
+  double failureRate = double(m_failures) / std::max<uint64_t>(m_sent, 1);
+  double rttMean = 0.0;
+  for (double rtt : m_rtts) {
+    rttMean += rtt / m_rtts.size();
+  }
+  m_series[THROUGHPUT].push_back(m_responses / m_batch);
+  if (!m_rtts.empty()) { // No RTT in a batch without response
+    m_series[RTT_MEAN].push_back(rttMean);
+    m_series[RTT_P99].push_back(percentile(m_rtts, 99));
+  }
+  NS_LOG_LOGIC("Batch " << m_series[THROUGHPUT].size() << ": "
+                        << m_series[THROUGHPUT].back() << " responses/s, "
+                        << failureRate << " failed, RTT " << rttMean
+                        << " ms");
+
+  ostringstream reason;
+  if (m_maxFailureRate > 0 && m_failures > 0 &&
+      failureRate > m_maxFailureRate) {
+    reason << "failure rate " << failureRate << " above "
+           << m_maxFailureRate;
+  } else if (m_maxRtt > 0 && rttMean > m_maxRtt) {
+    reason << "mean RTT " << rttMean << " ms above " << m_maxRtt << " ms";
+  }
+  if (!reason.str().empty()) {
+    m_reason = reason.str();
+    Stop(FAILED);
+    return;
+  }
+
+  bool converged = true;
+  m_warmup = 0;
+  for (uint32_t metric = 0; metric < METRIC_COUNT; ++metric) {
+    const vector<double> &series = m_series[metric];
+    uint32_t warmup = Mser(series);
+    vector<double> batches(series.begin() + warmup, series.end());
+    m_halfWidth[metric] = confidenceInterval(batches, m_mean[metric]);
+    if (!m_metrics[metric]) {
+      continue;
+    }
+    m_warmup = std::max(m_warmup, warmup);
+    if (batches.size() < m_minBatches || m_mean[metric] == 0 ||
+        m_halfWidth[metric] > m_precision * std::fabs(m_mean[metric])) {
+      converged = false;
+    }
+  }
+  if (converged) {
+    Stop(CONVERGED);
+    return;
+  }
+  StartBatch();
+}
+
+void WorkRunController::Stop(Outcome outcome) {
+  NS_LOG_FUNCTION(this << outcome);
+  m_outcome = outcome;
+  NS_LOG_INFO("Run " << GetOutcomeName() << " after "
+                     << m_series[THROUGHPUT].size() << " batches at "
+                     << Simulator::Now().GetSeconds() << " s"
+                     << (m_reason.empty() ? "" : ": " + m_reason));
+  Simulator::Stop();
+}
+
+uint32_t WorkRunController::Mser(const vector<double> &series) {
+  uint32_t n = series.size();
+  uint32_t best = 0;
+  double bestStatistic = INFINITY;
+  // Sums of the tail series[d..n), grown from the end
+  double sum = 0.0;
+  double squares = 0.0;
+  for (uint32_t d = n; d-- > 0;) {
+    sum += series[d];
+    squares += series[d] * series[d];
+    uint32_t remaining = n - d;
+    if (d > n / 2 || remaining < 2) {
+      continue; // Truncating beyond half the series is not trusted
+    }
+    // Sum of the squared deviations over the squared count
+    double statistic =
+        (squares - sum * sum / remaining) / (double(remaining) * remaining);
+    if (statistic <= bestStatistic) {
+      bestStatistic = statistic;
+      best = d;
+    }
+  }
+  return best;
+}
+
+string WorkRunController::GetSettings(void) const {
+  if (!IsEnabled()) {
+    return "";
+  }
+  ostringstream settings;
+  settings << "runBatch=" << m_batch << ";runMinBatches=" << m_minBatches
+           << ";runMetrics=" << m_metricNames
+           << ";runPrecision=" << m_precision
+           << ";runMaxFailure=" << m_maxFailureRate
+           << ";runMaxRtt=" << m_maxRtt;
+  return settings.str();
+}
+
+bool WorkRunController::IsEnabled(void) const { return m_batch > 0; }
+
+WorkRunController::Outcome WorkRunController::GetOutcome(void) const {
+  return m_outcome;
+}
+
+string WorkRunController::GetOutcomeName(void) const {
+  switch (m_outcome) {
+  case CONVERGED:
+    return "converged";
+  case FAILED:
+    return "failed";
+  default:
+    return "running";
+  }
+}
+
+const string &WorkRunController::GetReason(void) const { return m_reason; }
+
+uint32_t WorkRunController::GetBatches(void) const {
+  return m_series[THROUGHPUT].size();
+}
+
+uint32_t WorkRunController::GetWarmup(void) const { return m_warmup; }
+
+double WorkRunController::GetMean(Metric metric) const {
+  return m_mean[metric];
+}
+
+double WorkRunController::GetHalfWidth(Metric metric) const {
+  return m_halfWidth[metric];
+}
+
+} // Namespace ns3
@@ -0,0 +1,203 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#ifndef WORK_RUN_CONTROLLER_H
+#define WORK_RUN_CONTROLLER_H
+
+#include "ns3/command-line.h"
+#include "ns3/event-id.h"
+#include "ns3/nstime.h"
+#include "ns3/work-event-trace.h"
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace ns3 {
+
+/**
+ * \ingroup applications
+ *
+ * \brief Stop a simulation once its metrics converged, or once it failed.
+ *
+ * The run is cut in batches of fixed length. At the end of each batch the
+ * controller computes the batch value of the chosen metrics (throughput in
+ * responses per second, mean and p99 RTT) from the DeviceEnforcer "Event"
+ * trace source. The warm-up is the prefix of batches removed by the MSER
+ * rule; the batch means after it give the confidence interval of each
+ * metric. The simulation is stopped when the half-width of every interval
+ * is below the precision, relative to its mean, with enough batches.
+ *
+ * The simulation is also stopped as soon as a batch breaks a failure
+ * condition: too many requests refused, abandoned or never connected, or a
+ * mean RTT too high. Nothing is done while the batch length is zero.
+ */
+class WorkRunController {
+public:
+  /// Metrics evaluated per batch
+  enum Metric {
+    THROUGHPUT = 0, //!< Responses per second
+    RTT_MEAN,       //!< Mean RTT in ms
+    RTT_P99,        //!< p99 RTT in ms
+    METRIC_COUNT    //!< Number of metrics
+  };
+
+  /// State of the run
+  enum Outcome {
+    RUNNING,   //!< Not converged yet, stopped by the simulation time
+    CONVERGED, //!< Stopped on convergence
+    FAILED     //!< Stopped on a failure condition
+  };
+
+  WorkRunController();
+
+  /**
+   * \brief Add the parameters of the controller to a command line
+   * \param cmd the command line
+   */
+  void AddCommandLine(CommandLine &cmd);
+
+  /**
+   * \brief Set the batches
+   * \param batch the length of a batch, zero to disable the controller
+   * \param minBatches the batches needed after the warm-up
+   */
+  void SetBatch(Time batch, uint32_t minBatches = 10);
+
+  /**
+   * \brief Set the convergence criterion
+   * \param metrics the metrics, comma separated: throughput, rttMean,
+   *        rttP99
+   * \param precision the half-width of the confidence intervals, relative
+   *        to their mean
+   */
+  void SetConvergence(const string &metrics, double precision);
+
+  /**
+   * \brief Set the failure conditions, zero to disable one
+   * \param maxFailureRate the share of the requests of a batch refused,
+   *        abandoned or never connected
+   * \param maxRtt the mean RTT of a batch
+   */
+  void SetFailure(double maxFailureRate, Time maxRtt);
+
+  /**
+   * \brief Connect to the devices and start the first batch
+   * \param start the time the devices start sending
+   */
+  void Install(Time start);
+
+  /**
+   * \brief Count an event, the sink of the "Event" trace source
+   * \param event the event
+   */
+  void Notify(const WorkEvent &event);
+
+  /**
+   * \return the parameters as "name=value" pairs joined by ';', empty
+   *         while disabled
+   */
+  string GetSettings(void) const;
+
+  /**
+   * \return true if a batch length is set
+   */
+  bool IsEnabled(void) const;
+
+  /**
+   * \return the state of the run
+   */
+  Outcome GetOutcome(void) const;
+
+  /**
+   * \return the name of the state, running, converged or failed
+   */
+  string GetOutcomeName(void) const;
+
+  /**
+   * \return why the run failed, empty otherwise
+   */
+  const string &GetReason(void) const;
+
+  /**
+   * \return the number of batches evaluated
+   */
+  uint32_t GetBatches(void) const;
+
+  /**
+   * \return the longest warm-up of the converging metrics, in batches
+   */
+  uint32_t GetWarmup(void) const;
+
+  /**
+   * \param metric the metric
+   * \return the mean of the batches after the warm-up
+   */
+  double GetMean(Metric metric) const;
+
+  /**
+   * \param metric the metric
+   * \return the half-width of the 95% confidence interval of the mean
+   */
+  double GetHalfWidth(Metric metric) const;
+
+  /**
+   * \brief Find the end of the warm-up of a series with the MSER rule
+   *
+   * The truncation point minimizes the variance of the remaining values
+   * divided by their number, searched in the first half of the series.
+   *
+   * \param series the batch values
+   * \return the number of values to remove
+   */
+  static uint32_t Mser(const vector<double> &series);
+
+private:
+  /**
+   * \brief Reset the counters and schedule the end of the batch
+   */
+  void StartBatch(void);
+
+  /**
+   * \brief Close a batch, then stop the simulation or start the next one
+   */
+  void Evaluate(void);
+
+  /**
+   * \brief Stop the simulation
+   * \param outcome the reason, converged or failed
+   */
+  void Stop(Outcome outcome);
+
+  // Parameters, plain values for the command line
+  double m_batch;          //!< Batch length in seconds, 0 disables
+  uint32_t m_minBatches;   //!< Batches needed after the warm-up
+  string m_metricNames;    //!< Metrics of the convergence criterion
+  double m_precision;      //!< Relative half-width of the intervals
+  double m_maxFailureRate; //!< Share of failed requests, 0 disables
+  double m_maxRtt;         //!< Mean RTT of a batch in ms, 0 disables
+
+  bool m_metrics[METRIC_COUNT]; //!< Metrics of the convergence criterion
+  uint32_t m_refused;           //!< Interned "[Refused]" message
+  EventId m_event;              //!< End of the current batch
+  Outcome m_outcome;            //!< State of the run
+  string m_reason;              //!< Failure condition hit
+  uint32_t m_warmup;            //!< Longest warm-up, in batches
+
+  // Current batch
+  uint64_t m_sent;       //!< Requests sent
+  uint64_t m_responses;  //!< Responses received
+  uint64_t m_failures;   //!< Requests refused, abandoned, not connected
+  vector<double> m_rtts; //!< Round-trip times in ms
+
+  /// Batch values, by metric
+  vector<double> m_series[METRIC_COUNT];
+  double m_mean[METRIC_COUNT];      //!< Means after the warm-up
+  double m_halfWidth[METRIC_COUNT]; //!< Half-widths after the warm-up
+};
+
+} // namespace ns3
+
+#endif /* WORK_RUN_CONTROLLER_H */
@@ -0,0 +1,246 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#include "work-runner.h"
+#include "ns3/log.h"
+#include "ns3/rng-seed-manager.h"
+#include "ns3/simulator.h"
+#include "ns3/work-event-counters.h"
+#include "ns3/work-utils.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE("WorkRunner");
+
+/**
+ * \brief Collect a round-trip time, the sink of the "Rtt" trace source
+ * \param rtts the round-trip times in ms
+ * \param rtt the round-trip time
+ */
+static void CollectRtt(std::vector<double> *rtts, Time rtt) {
+  rtts->push_back(rtt.GetSeconds() * 1000.0);
+}
+
+/**
+ * \brief Count the bytes received, the sink of the server "Rx" trace source
+ * \param bytes the byte counter
+ * \param packet the packet received
+ * \param from its source
+ */
+static void CountBytes(uint64_t *bytes, Ptr<const Packet> packet,
+                       const Address &from) {
+  *bytes += packet->GetSize();
+}
+
+WorkJson WorkRunner::Run(const WorkScenarioConfig &config, uint32_t rngRun,
+                         const WorkRunController &controller) {
+  NS_LOG_FUNCTION(rngRun);
+  auto start = std::chrono::steady_clock::now();
+  RngSeedManager::SetRun(rngRun);
+  WorkScenario scenario(config);
+  scenario.Configure();
+  scenario.BuildTopology();
+  scenario.InstallApplications();
+
+  std::vector<double> rtts;
+  std::map<string, std::vector<double>> profileRtts;
+  uint64_t serverBytes = 0;
+  const std::vector<Ptr<DeviceEnforcer>> &devices = scenario.GetDevices();
+  for (uint32_t i = 0; i < devices.size(); ++i) {
+    devices[i]->TraceConnectWithoutContext(
+        "Rtt", MakeBoundCallback(&CollectRtt, &rtts));
+    devices[i]->TraceConnectWithoutContext(
+        "Rtt", MakeBoundCallback(&CollectRtt,
+                                 &profileRtts[scenario.GetDeviceProfile(i)]));
+  }
+  scenario.GetServer()->TraceConnectWithoutContext(
+      "Rx", MakeBoundCallback(&CountBytes, &serverBytes));
+  WorkEventCounters counters;
+  counters.Install();
+  WorkRunController control = controller;
+  control.Install(Seconds(config.start + 1.0));
+
+  Simulator::Stop(scenario.GetStopTime());
+  Simulator::Run();
+  double simulated = Simulator::Now().GetSeconds();
+  uint64_t events = Simulator::GetEventCount();
+  Simulator::Destroy();
+  std::chrono::duration<double> wall =
+      std::chrono::steady_clock::now() - start;
+
+  // The devices start sending one second after the server
+  double sending =
+      std::max(std::min(config.stop, simulated) - config.start - 1.0, 1e-9);
+  double rttMean = 0.0;
+  for (double rtt : rtts) {
+    rttMean += rtt / rtts.size();
+  }
+  WorkJson metrics = WorkJson::Object();
+  metrics.Set("sent", counters.GetTotal(WORK_TRACE_DEVICE_SEND));
+  metrics.Set("responses", counters.GetTotal(WORK_TRACE_DEVICE_RESPONSE));
+  metrics.Set("accepted", counters.GetResponses("[Accepted]"));
+  metrics.Set("refused", counters.GetResponses("[Refused]"));
+  metrics.Set("retransmissions",
+              counters.GetTotal(WORK_TRACE_DEVICE_RETRANSMIT));
+  metrics.Set("timeouts", counters.GetTotal(WORK_TRACE_DEVICE_ABANDON));
+  metrics.Set("connectFailures",
+              counters.GetTotal(WORK_TRACE_DEVICE_CONNECT_FAILED));
+  metrics.Set("goodput", serverBytes * 8.0 / sending);
+  metrics.Set("rttMean", rttMean);
+  metrics.Set("rttP50", percentile(rtts, 50));
+  metrics.Set("rttP99", percentile(rtts, 99));
+  metrics.Set("events", events);
+  metrics.Set("wall", wall.count());
+  metrics.Set("simulated", simulated);
+  if (!scenario.GetProfiles().empty()) {
+    WorkJson profiles = WorkJson::Object();
+    for (const WorkDeviceProfile &profile : scenario.GetProfiles()) {
+      uint32_t nDevices = 0;
+      uint64_t sent = 0;
+      uint64_t responses = 0;
+      uint64_t failures = 0;
+      for (uint32_t i = 0; i < devices.size(); ++i) {
+        if (scenario.GetDeviceProfile(i) != profile.name) {
+          continue;
+        }
+        nDevices++;
+        sent += counters.Get(i, WORK_TRACE_DEVICE_SEND);
+        responses += counters.Get(i, WORK_TRACE_DEVICE_RESPONSE);
+        failures += counters.Get(i, WORK_TRACE_DEVICE_ABANDON) +
+                    counters.Get(i, WORK_TRACE_DEVICE_CONNECT_FAILED);
+      }
+      std::vector<double> &samples = profileRtts[profile.name];
+      WorkJson profileMetrics = WorkJson::Object();
+      profileMetrics.Set("devices", nDevices);
+      profileMetrics.Set("sent", sent);
+      profileMetrics.Set("responses", responses);
+      profileMetrics.Set("failures", failures);
+      profileMetrics.Set("rttP50", percentile(samples, 50));
+      profileMetrics.Set("rttP99", percentile(samples, 99));
+      profiles.Set(profile.name, profileMetrics);
+    }
+    metrics.Set("profiles", profiles);
+  }
+  if (control.IsEnabled()) {
+    metrics.Set("outcome", control.GetOutcomeName());
+    metrics.Set("batches", control.GetBatches());
+    metrics.Set("warmup", control.GetWarmup());
+    metrics.Set("reason", control.GetReason());
+  }
+  return metrics;
+}
+
+void WorkRunner::Apply(WorkScenarioConfig &config,
+                       const std::vector<string> &parameters) {
+  CommandLine cmd;
+  config.AddCommandLine(cmd);
+  std::vector<string> args(1, "work");
+  for (const string &parameter : parameters) {
+    args.push_back("--" + parameter);
+  }
+  cmd.Parse(args);
+}
+
+WorkProcessPool::WorkProcessPool(uint32_t jobs)
+    : m_jobs(jobs), m_submitted(0) {
+  NS_LOG_FUNCTION(this << jobs);
+  if (m_jobs == 0) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    m_jobs = cores > 0 ? cores : 1;
+  }
+}
+
+uint32_t WorkProcessPool::Submit(Job job) {
+  m_queue.push_back(std::make_pair(m_submitted, job));
+  return m_submitted++;
+}
+
+uint32_t WorkProcessPool::GetJobs(void) const { return m_jobs; }
+
+void WorkProcessPool::Start(void) {
+  uint32_t index = m_queue.front().first;
+  Job job = m_queue.front().second;
+  m_queue.pop_front();
+
+  int fds[2];
+  NS_ABORT_MSG_IF(pipe(fds) != 0, "Cannot create a pipe");
+  fflush(stdout);
+  std::cout.flush();
+  pid_t pid = fork();
+  NS_ABORT_MSG_IF(pid < 0, "Cannot fork job " << index);
+  if (pid == 0) {
+    close(fds[0]);
+    string text = job().Dump(0);
+    size_t written = 0;
+    while (written < text.size()) {
+      ssize_t n = write(fds[1], text.data() + written, text.size() - written);
+      if (n <= 0) {
+        _exit(1);
+      }
+      written += n;
+    }
+    close(fds[1]);
+    _exit(0);
+  }
+  close(fds[1]);
+  NS_LOG_LOGIC("Job " << index << " in process " << pid);
+  m_running[fds[0]] = Child{index, pid, ""};
+}
+
+void WorkProcessPool::Finish(int fd, Callback callback) {
+  Child child = m_running[fd];
+  m_running.erase(fd);
+  close(fd);
+  int status = 0;
+  waitpid(child.pid, &status, 0);
+
+  WorkJson result;
+  string error;
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    result = WorkJson::Object();
+    result.Set("error", "job failed with status " + std::to_string(status));
+  } else if (!WorkJson::Parse(child.output, result, error)) {
+    result = WorkJson::Object();
+    result.Set("error", "unreadable result, " + error);
+  }
+  callback(child.index, result);
+}
+
+void WorkProcessPool::Run(Callback callback) {
+  NS_LOG_FUNCTION(this);
+  char buffer[4096];
+  while (!m_queue.empty() || !m_running.empty()) {
+    while (!m_queue.empty() && m_running.size() < m_jobs) {
+      Start();
+    }
+    std::vector<struct pollfd> fds;
+    for (auto &running : m_running) {
+      fds.push_back({running.first, POLLIN, 0});
+    }
+    if (poll(fds.data(), fds.size(), -1) < 0) {
+      continue; // Interrupted by a signal
+    }
+    for (const struct pollfd &fd : fds) {
+      if (!(fd.revents & (POLLIN | POLLHUP | POLLERR))) {
+        continue;
+      }
+      ssize_t n = read(fd.fd, buffer, sizeof(buffer));
+      if (n > 0) {
+        m_running[fd.fd].output.append(buffer, n);
+      } else {
+        Finish(fd.fd, callback);
+      }
+    }
+  }
+}
+
+} // Namespace ns3
@@ -0,0 +1,141 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#ifndef WORK_RUNNER_H
+#define WORK_RUNNER_H
+
+#include "ns3/work-json.h"
+#include "ns3/work-run-controller.h"
+#include "ns3/work-scenario.h"
+#include <deque>
+#include <functional>
+#include <map>
+#include <sys/types.h>
+
+using namespace std;
+
+namespace ns3 {
+
+/**
+ * \ingroup applications
+ *
+ * \brief Run a whole work scenario and summarize it.
+ *
+ * The metrics of a run are returned as a JSON object:
+ * - sent, responses, accepted, refused: requests and their answers
+ * - retransmissions, timeouts, connectFailures: device failures
+ * - goodput: request bits received by the server per second of sending
+ * - rttMean, rttP50, rttP99: round-trip times in ms
+ * - events, wall, simulated: simulator events, seconds of run time and
+ *   simulated seconds
+ * - profiles: with device profiles, the devices, sent, responses,
+ *   failures, rttP50 and rttP99 of each profile
+ * - outcome, batches, warmup, reason: with a run controller, how the run
+ *   stopped (running if it reached the simulation time), see
+ *   WorkRunController
+ */
+class WorkRunner {
+public:
+  /**
+   * \brief Run the scenario in this process
+   *
+   * The simulator is destroyed at the end, so runs may follow each other.
+   *
+   * \param config the scenario parameters
+   * \param rngRun the run number of the random streams, see RngRun
+   * \param controller the settings of the run controller, copied before
+   *        the run; disabled by default
+   * \return the metrics of the run
+   */
+  static WorkJson Run(const WorkScenarioConfig &config, uint32_t rngRun,
+                      const WorkRunController &controller =
+                          WorkRunController());
+
+  /**
+   * \brief Apply "name=value" parameters to a scenario
+   *
+   * The names are the command line options of the scenario, e.g.
+   * "nNodes=100". An unknown name aborts the program.
+   *
+   * \param config the scenario parameters to update
+   * \param parameters the parameters
+   */
+  static void Apply(WorkScenarioConfig &config,
+                    const std::vector<string> &parameters);
+};
+
+/**
+ * \ingroup applications
+ *
+ * \brief Run jobs in child processes, as many at a time as cores.
+ *
+ * Each simulation is single-threaded and the simulator is a singleton, so
+ * independent runs are spread over forked processes. A job runs in its
+ * child and returns a JSON value, passed back through a pipe to the
+ * callback, in the parent, in completion order. A child that crashes or
+ * aborts yields an object with an "error" member.
+ *
+ * The parent must not run a simulation itself before Run, the children
+ * would inherit its state.
+ */
+class WorkProcessPool {
+public:
+  /// A job, run in a child process
+  typedef std::function<WorkJson(void)> Job;
+  /// Called in the parent with the index and the result of a job
+  typedef std::function<void(uint32_t, const WorkJson &)> Callback;
+
+  /**
+   * \param jobs the number of jobs run at a time, 0 for the number of cores
+   */
+  WorkProcessPool(uint32_t jobs = 0);
+
+  /**
+   * \brief Queue a job
+   * \param job the job
+   * \return the index of the job
+   */
+  uint32_t Submit(Job job);
+
+  /**
+   * \brief Run the queued jobs and wait for all of them
+   * \param callback the callback of each completed job
+   */
+  void Run(Callback callback);
+
+  /**
+   * \return the number of jobs run at a time
+   */
+  uint32_t GetJobs(void) const;
+
+private:
+  /// A running child
+  struct Child {
+    uint32_t index; //!< Index of the job
+    pid_t pid;      //!< Process id
+    string output;  //!< Output read so far
+  };
+
+  /**
+   * \brief Fork a child running the next queued job
+   */
+  void Start(void);
+
+  /**
+   * \brief Wait for a child whose output ended and report its result
+   * \param fd the read end of its pipe
+   * \param callback the callback of the job
+   */
+  void Finish(int fd, Callback callback);
+
+  uint32_t m_jobs;                              //!< Jobs run at a time
+  uint32_t m_submitted;                         //!< Jobs submitted
+  std::deque<std::pair<uint32_t, Job>> m_queue; //!< Jobs not started
+  std::map<int, Child> m_running;               //!< Children, by pipe
+};
+
+} // namespace ns3
+
+#endif /* WORK_RUNNER_H */
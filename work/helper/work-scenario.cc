@@ -0,0 +1,676 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#include "work-scenario.h"
+#include "ns3/boolean.h"
+#include "ns3/bridge-helper.h"
+#include "ns3/config.h"
+#include "ns3/csma-helper.h"
+#include "ns3/data-rate.h"
+#include "ns3/double.h"
+#include "ns3/internet-stack-helper.h"
+#include "ns3/ipv4-address-helper.h"
+#include "ns3/log.h"
+#include "ns3/mobility-helper.h"
+#include "ns3/object-factory.h"
+#include "ns3/pointer.h"
+#include "ns3/simulator.h"
+#include "ns3/ssid.h"
+#include "ns3/string.h"
+#include "ns3/tcp-socket-factory.h"
+#include "ns3/udp-socket-factory.h"
+#include "ns3/uinteger.h"
+#include "ns3/wifi-helper.h"
+#include "ns3/work-json.h"
+#include "ns3/work-memory-accounting.h"
+#include "ns3/work-profiling-scheduler.h"
+#include "ns3/work-send-driver.h"
+#include "ns3/yans-wifi-helper.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <set>
+#include <sstream>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE("WorkScenario");
+
+template <typename Config, typename Visitor>
+void WorkScenarioConfig::Visit(Config &config, Visitor visitor) {
+  visitor("nNodes", "Number of nodes to place in the star", config.nDevices);
+  visitor("payloadSize", "Payload size in bytes", config.payloadSize);
+  visitor("dataRate", "Application data ate", config.dataRate);
+  visitor("phyRate", "Physical layer bitrate", config.phyRate);
+  visitor("simulationTime", "Simulation time in seconds",
+          config.simulationTime);
+  visitor("aggregator", "Enable/disable the edge aggregator on the AP",
+          config.aggregator);
+  visitor("cacheSize",
+          "Number of decisions cached by the aggregator (0 disables)",
+          config.cacheSize);
+  visitor("cacheTtl", "Lifetime of a cached decision in seconds",
+          config.cacheTtl);
+  visitor("protocol", "Request transport, tcp or udp", config.protocol);
+  visitor("rateControl",
+          "Device send rate controller, None, Aimd or DelayGradient "
+          "(dataRate becomes the highest rate)",
+          config.rateControl);
+  visitor("targetLatency",
+          "Round-trip time in ms above which the devices slow down",
+          config.targetLatency);
+  visitor("urgentDevices",
+          "Number of devices sending urgent messages (AC_VO)",
+          config.urgentDevices);
+  visitor("bulkDevices",
+          "Number of devices sending bulk messages (AC_BK), the others "
+          "send normal messages (AC_BE)",
+          config.bulkDevices);
+  visitor("startInterval", "Time between two device starts in seconds",
+          config.startInterval);
+  visitor("scheduler", "Event scheduler, map, heap, list, calendar or wheel",
+          config.scheduler);
+  visitor("eventProfile",
+          "Profile the wall time of the events by callback type and node, "
+          "see ProfilingScheduler",
+          config.eventProfile);
+  visitor("sendDriver",
+          "Coalesce the device send events, none or global (events and "
+          "traces are not attributed to the right nodes)",
+          config.sendDriver);
+  visitor("lazy", "Connect the devices when their first request is due",
+          config.lazy);
+  visitor("idleTimeout",
+          "Close the idle device connections after this time in s, 0 keeps "
+          "them open",
+          config.idleTimeout);
+  visitor("positions",
+          "Node positions, x,y,z lines reused in a loop, empty for a grid",
+          config.positions);
+  visitor("profiles",
+          "JSON device profiles file, empty for identical devices",
+          config.profiles);
+  visitor("gridSpacing", "Distance between grid positions in m",
+          config.gridSpacing);
+  visitor("gridWidth", "Grid positions per row", config.gridWidth);
+  visitor("wifiStandard",
+          "Wi-Fi standard, e.g. 80211n_2_4GHZ, 80211n_5GHZ or 80211ac",
+          config.wifiStandard);
+  visitor("controlMode", "Wi-Fi mode of the control frames",
+          config.controlMode);
+  visitor("referenceLoss", "Propagation loss at 1 m in dB",
+          config.referenceLoss);
+  visitor("csmaRate", "Data rate of the server to AP link", config.csmaRate);
+  visitor("csmaDelay", "Delay of the server to AP link", config.csmaDelay);
+}
+
+void WorkScenarioConfig::AddCommandLine(CommandLine &cmd) {
+  Visit(*this, [&cmd](const string &name, const string &help, auto &value) {
+    cmd.AddValue(name, help, value);
+  });
+}
+
+string WorkScenarioConfig::GetKey(const std::set<string> &exclude) const {
+  ostringstream key;
+  bool first = true;
+  Visit(*this, [&](const string &name, const string &help,
+                   const auto &value) {
+    if (!exclude.count(name)) {
+      key << (first ? "" : ";") << name << "=" << value;
+      first = false;
+    }
+  });
+  return key.str();
+}
+
+void WorkScenarioFile::Parse(CommandLine &cmd, int argc, char *argv[],
+                             bool outputs) {
+  NS_LOG_FUNCTION(this);
+  cmd.AddValue("scenario",
+               "JSON scenario file, the options given here override it",
+               m_filename);
+  // The file is read before the other options, which take precedence
+  const string option = "--scenario=";
+  std::vector<string> args(argv, argv + argc);
+  for (int i = 1; i < argc; ++i) {
+    if (args[i].compare(0, option.size(), option) == 0) {
+      m_filename = args[i].substr(option.size());
+    }
+  }
+  if (!m_filename.empty()) {
+    std::vector<string> fileArgs;
+    string error;
+    NS_ABORT_MSG_IF(!Load(m_filename, fileArgs, error, outputs),
+                    "Bad scenario file " << m_filename << ": " << error);
+    args.insert(args.begin() + 1, fileArgs.begin(), fileArgs.end());
+  }
+  cmd.Parse(args);
+}
+
+const string &WorkScenarioFile::GetFilename(void) const { return m_filename; }
+
+bool WorkScenarioFile::Load(const string &filename, std::vector<string> &args,
+                            string &error, bool outputs) {
+  NS_LOG_FUNCTION(filename);
+  static const std::vector<string> sections = {
+      "topology", "traffic", "simulation", "tracing", "outputs"};
+  WorkJson scenario;
+  if (!WorkJson::ParseFile(filename, scenario, error)) {
+    return false;
+  }
+  if (!scenario.IsObject()) {
+    error = "the scenario is not an object";
+    return false;
+  }
+  for (const auto &section : scenario.GetMembers()) {
+    if (section.first == "description") {
+      continue;
+    }
+    if (std::find(sections.begin(), sections.end(), section.first) ==
+        sections.end()) {
+      error = "unknown section " + section.first;
+      return false;
+    }
+    if (!section.second.IsObject()) {
+      error = "section " + section.first + " is not an object";
+      return false;
+    }
+    bool skipped =
+        !outputs && (section.first == "tracing" || section.first == "outputs");
+    for (const auto &option : section.second.GetMembers()) {
+      const string name = section.first + "." + option.first;
+      const WorkJson &value = option.second;
+      std::ostringstream text;
+      text << "--" << option.first << "=";
+      if (option.first == "scenario") {
+        error = name + ": a scenario file cannot include another one";
+        return false;
+      } else if (value.GetType() == WorkJson::BOOL) {
+        text << (value.GetBool() ? "true" : "false");
+      } else if (value.IsNumber()) {
+        text << std::setprecision(15) << value.GetNumber();
+      } else if (value.IsString()) {
+        text << value.GetString();
+      } else {
+        error = name + " is not a string, a number or a boolean";
+        return false;
+      }
+      if (!skipped) {
+        args.push_back(text.str());
+      }
+    }
+  }
+  return true;
+}
+
+WorkScenario::WorkScenario(const WorkScenarioConfig &config)
+    : m_config(config) {
+  NS_LOG_FUNCTION(this);
+}
+
+void WorkScenario::Configure(void) {
+  NS_LOG_FUNCTION(this);
+  // The below value configures the default behavior of global routing.
+  // By default, it is disabled.  To respond to interface events, set to true
+  Config::SetDefault("ns3::Ipv4GlobalRouting::RespondToInterfaceEvents",
+                     BooleanValue(true));
+
+  if (m_config.protocol == "tcp") {
+    m_protocol = TcpSocketFactory::GetTypeId();
+  } else if (m_config.protocol == "udp") {
+    m_protocol = UdpSocketFactory::GetTypeId();
+  } else {
+    NS_FATAL_ERROR("Unknown protocol " << m_config.protocol);
+  }
+  NS_ABORT_MSG_IF(m_config.aggregator && m_config.protocol != "tcp",
+                  "The aggregator only relays tcp connections");
+
+  std::map<string, string> schedulers = {
+      {"map", "ns3::MapScheduler"},
+      {"heap", "ns3::HeapScheduler"},
+      {"list", "ns3::ListScheduler"},
+      {"calendar", "ns3::CalendarScheduler"},
+      {"wheel", "ns3::TimingWheelScheduler"}};
+  NS_ABORT_MSG_IF(m_config.sendDriver != "none" &&
+                      m_config.sendDriver != "global",
+                  "Unknown send driver " << m_config.sendDriver);
+  // The devices of a bucket send in the context of the node that armed it
+  NS_ABORT_MSG_IF(m_config.sendDriver == "global" && m_config.eventProfile,
+                  "The global send driver misattributes the events to "
+                  "nodes, profile without it");
+  NS_ABORT_MSG_IF(schedulers.find(m_config.scheduler) == schedulers.end(),
+                  "Unknown scheduler " << m_config.scheduler);
+  ObjectFactory schedulerFactory;
+  schedulerFactory.SetTypeId(schedulers[m_config.scheduler]);
+  if (m_config.eventProfile) {
+    // The chosen scheduler keeps the events, the profiler times them
+    TypeId schedulerType = schedulerFactory.GetTypeId();
+    schedulerFactory.SetTypeId("ns3::ProfilingScheduler");
+    schedulerFactory.Set("Scheduler", TypeIdValue(schedulerType));
+    ProfilingScheduler::Reset();
+  }
+  Simulator::SetScheduler(schedulerFactory);
+
+  Config::SetDefault("ns3::DeviceEnforcer::RateControl",
+                     StringValue(m_config.rateControl));
+  Config::SetDefault("ns3::DeviceEnforcer::TargetLatency",
+                     TimeValue(MilliSeconds(m_config.targetLatency)));
+  NS_ABORT_MSG_IF(m_config.idleTimeout < 0,
+                  "Negative idle timeout " << m_config.idleTimeout);
+  Config::SetDefault("ns3::DeviceEnforcer::Lazy", BooleanValue(m_config.lazy));
+  Config::SetDefault("ns3::DeviceEnforcer::IdleTimeout",
+                     TimeValue(Seconds(m_config.idleTimeout)));
+
+  GetWifiStandard(m_config.wifiStandard); // Aborts if unknown
+  if (!m_config.profiles.empty()) {
+    NS_ABORT_MSG_IF(m_config.urgentDevices || m_config.bulkDevices,
+                    "With profiles, the message classes are set by the "
+                    "profiles, not by urgentDevices and bulkDevices");
+    LoadProfiles();
+  }
+  NS_ABORT_MSG_IF(m_config.gridWidth == 0, "Empty grid rows");
+
+  /* Configure TCP Options */
+  Config::SetDefault("ns3::TcpSocket::SegmentSize",
+                     UintegerValue(m_config.payloadSize));
+}
+
+void WorkScenario::LoadProfiles(void) {
+  NS_LOG_FUNCTION(this);
+  const string &filename = m_config.profiles;
+  WorkJson file;
+  string error;
+  NS_ABORT_MSG_IF(!WorkJson::ParseFile(filename, file, error),
+                  "Bad profiles file " << filename << ": " << error);
+  const WorkJson &profiles = file["profiles"];
+  NS_ABORT_MSG_IF(!profiles.IsArray() || profiles.GetSize() == 0,
+                  filename << ": no profiles array");
+
+  // Fields and their types, anything else is a mistake
+  static const std::map<string, WorkJson::Type> fields = {
+      {"name", WorkJson::STRING},         {"ratio", WorkJson::NUMBER},
+      {"packetSize", WorkJson::NUMBER},   {"dataRate", WorkJson::STRING},
+      {"interArrival", WorkJson::STRING}, {"onTime", WorkJson::STRING},
+      {"offTime", WorkJson::STRING},      {"messageClass", WorkJson::STRING}};
+  // The attribute values are checked on a device that is never installed
+  Ptr<DeviceEnforcer> checker = CreateObject<DeviceEnforcer>();
+  for (uint32_t i = 0; i < profiles.GetSize(); ++i) {
+    const WorkJson &entry = profiles[i];
+    NS_ABORT_MSG_IF(!entry.IsObject(),
+                    filename << ": profile " << i << " is not an object");
+    for (const auto &member : entry.GetMembers()) {
+      auto field = fields.find(member.first);
+      NS_ABORT_MSG_IF(field == fields.end(),
+                      filename << ": unknown profile field " << member.first);
+      NS_ABORT_MSG_IF(member.second.GetType() != field->second,
+                      filename << ": bad type of " << member.first
+                               << " in profile " << i);
+    }
+    WorkDeviceProfile profile;
+    profile.name = entry["name"].GetString();
+    profile.ratio = entry.Has("ratio") ? entry["ratio"].GetNumber() : 1.0;
+    profile.packetSize = entry["packetSize"].GetNumber();
+    profile.dataRate = entry["dataRate"].GetString();
+    profile.interArrival = entry["interArrival"].GetString();
+    profile.onTime = entry["onTime"].GetString();
+    profile.offTime = entry["offTime"].GetString();
+    if (entry.Has("messageClass")) {
+      profile.messageClass = entry["messageClass"].GetString();
+    }
+    NS_ABORT_MSG_IF(profile.name.empty(),
+                    filename << ": profile " << i << " has no name");
+    for (const WorkDeviceProfile &other : m_profiles) {
+      NS_ABORT_MSG_IF(other.name == profile.name,
+                      filename << ": duplicated profile " << profile.name);
+    }
+    NS_ABORT_MSG_IF(profile.ratio < 0,
+                    filename << ": negative ratio of " << profile.name);
+    bool valid =
+        checker->SetAttributeFailSafe("MessageClass",
+                                      StringValue(profile.messageClass)) &&
+        (profile.dataRate.empty() ||
+         checker->SetAttributeFailSafe("DataRate",
+                                       StringValue(profile.dataRate))) &&
+        (profile.interArrival.empty() ||
+         checker->SetAttributeFailSafe("InterArrival",
+                                       StringValue(profile.interArrival))) &&
+        (profile.onTime.empty() ||
+         checker->SetAttributeFailSafe("OnTime",
+                                       StringValue(profile.onTime))) &&
+        (profile.offTime.empty() ||
+         checker->SetAttributeFailSafe("OffTime",
+                                       StringValue(profile.offTime)));
+    NS_ABORT_MSG_IF(!valid,
+                    filename << ": bad value in profile " << profile.name);
+    m_profiles.push_back(profile);
+  }
+  checker->Dispose();
+
+  const string &assignment = file["assignment"].GetString();
+  if (assignment.empty()) {
+    double totalRatio = 0.0;
+    for (const WorkDeviceProfile &profile : m_profiles) {
+      totalRatio += profile.ratio;
+    }
+    NS_ABORT_MSG_IF(totalRatio <= 0, filename << ": all the ratios are 0");
+    return;
+  }
+  // One profile name per line, '#' starts a comment
+  std::ifstream dataset(assignment);
+  NS_ABORT_MSG_IF(!dataset, "Cannot open the assignment " << assignment);
+  string line;
+  while (std::getline(dataset, line)) {
+    line = line.substr(0, line.find('#'));
+    line.erase(0, line.find_first_not_of(" \t\r"));
+    line.erase(line.find_last_not_of(" \t\r") + 1);
+    if (line.empty()) {
+      continue;
+    }
+    uint32_t index = 0;
+    while (index < m_profiles.size() && m_profiles[index].name != line) {
+      index++;
+    }
+    NS_ABORT_MSG_IF(index == m_profiles.size(),
+                    assignment << ": unknown profile " << line);
+    m_assignment.push_back(index);
+  }
+  NS_ABORT_MSG_IF(m_assignment.empty(), assignment << ": no device");
+}
+
+void WorkScenario::BuildTopology(void) {
+  NS_LOG_FUNCTION(this);
+  // Allocations attributed to each step, with the memory hooks
+  WorkMemoryScope memory(WorkMemoryAccounting::WIFI);
+  WifiMacHelper wifiMac;
+  WifiHelper wifiHelper;
+  wifiHelper.SetStandard(GetWifiStandard(m_config.wifiStandard));
+  Config::SetDefault("ns3::LogDistancePropagationLossModel::ReferenceLoss",
+                     DoubleValue(m_config.referenceLoss));
+
+  /* Set up Legacy Channel */
+  YansWifiChannelHelper wifiChannel = YansWifiChannelHelper::Default();
+
+  /* Setup Physical Layer */
+  YansWifiPhyHelper wifiPhy;
+  wifiPhy.SetChannel(wifiChannel.Create());
+  wifiHelper.SetRemoteStationManager("ns3::ConstantRateWifiManager", "DataMode",
+                                     StringValue(m_config.phyRate),
+                                     "ControlMode",
+                                     StringValue(m_config.controlMode));
+
+  NS_LOG_INFO("Create nodes.");
+  memory.Set(WorkMemoryAccounting::NODES);
+  m_serverNode.Create(1);
+  m_apNode.Create(1);
+  m_staNodes.Create(m_config.nDevices);
+
+  memory.Set(WorkMemoryAccounting::CSMA);
+  CsmaHelper csma;
+  csma.SetChannelAttribute("DataRate", StringValue(m_config.csmaRate));
+  csma.SetChannelAttribute("Delay", StringValue(m_config.csmaDelay));
+  m_serverApDevices =
+      csma.Install(NodeContainer(m_serverNode.Get(0), m_apNode.Get(0)));
+
+  /* Configure AP */
+  NS_LOG_INFO("Configure AP");
+  memory.Set(WorkMemoryAccounting::WIFI);
+  Ssid ssid = Ssid("network");
+  // QoS MACs, the TOS of the messages selects their access category
+  wifiMac.SetType("ns3::ApWifiMac", "Ssid", SsidValue(ssid), "QosSupported",
+                  BooleanValue(true));
+  m_apDevices = wifiHelper.Install(wifiPhy, wifiMac, m_apNode);
+
+  /* Configure STA */
+  NS_LOG_INFO("Configure STA");
+  wifiMac.SetType("ns3::StaWifiMac", "Ssid", SsidValue(ssid), "QosSupported",
+                  BooleanValue(true));
+  m_staDevices = wifiHelper.Install(wifiPhy, wifiMac, m_staNodes);
+
+  Config::Set("/NodeList//DeviceList//$ns3::WifiNetDevice/HtConfiguration/"
+              "ShortGuardIntervalSupported",
+              BooleanValue(true));
+
+  NS_LOG_INFO("Configure Bridge");
+  memory.Set(WorkMemoryAccounting::CSMA);
+  BridgeHelper bridge;
+  NetDeviceContainer bridgeDev = bridge.Install(
+      m_apNode.Get(0),
+      NetDeviceContainer(m_apDevices.Get(0), m_serverApDevices.Get(1)));
+
+  /* Mobility model */
+  NS_LOG_INFO("Configure mobility");
+  memory.Set(WorkMemoryAccounting::MOBILITY);
+  MobilityHelper mobility;
+  if (m_config.positions.empty()) {
+    // gridSpacing apart (2 m), gridWidth nodes per row (ten)
+    mobility.SetPositionAllocator(
+        "ns3::GridPositionAllocator", "DeltaX",
+        DoubleValue(m_config.gridSpacing), "DeltaY",
+        DoubleValue(m_config.gridSpacing), "GridWidth",
+        UintegerValue(m_config.gridWidth), "LayoutType",
+        StringValue("RowFirst"));
+  } else {
+    Ptr<ListPositionAllocator> positionAlloc =
+        CreateObject<ListPositionAllocator>();
+    positionAlloc->Add(m_config.positions);
+    mobility.SetPositionAllocator(positionAlloc);
+  }
+  mobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
+  mobility.Install(GetAllNodes());
+
+  // Install network stacks on the nodes
+  memory.Set(WorkMemoryAccounting::INTERNET);
+  InternetStackHelper internet;
+  internet.Install(GetAllNodes());
+
+  NS_LOG_INFO("Assign IP Addresses.");
+  Ipv4AddressHelper address;
+  // Room for thousands of devices
+  address.SetBase("192.168.0.0", "255.255.0.0");
+  m_serverIf = address.Assign(m_serverApDevices.Get(0));
+  m_apIf = address.Assign(bridgeDev);
+  m_staIfs = address.Assign(m_staDevices);
+}
+
+void WorkScenario::InstallApplications(void) {
+  NS_LOG_FUNCTION(this);
+  WorkMemoryScope memory(WorkMemoryAccounting::APPLICATIONS);
+  NS_ABORT_MSG_IF(m_staNodes.GetN() == 0, "Build the topology first");
+  double start = m_config.start;
+  double stop = m_config.stop;
+
+  // Create a server to receive these packets
+  // Start at 0s
+  // Stop at final
+  Address serverAddress(InetSocketAddress(m_serverIf.GetAddress(0, 0), 50000));
+  m_server = CreateObject<WorkServer>();
+  m_server->SetAttribute("Protocol", TypeIdValue(m_protocol));
+  m_server->SetAttribute("Local", AddressValue(serverAddress));
+  m_server->SetStartTime(Seconds(start));
+  m_server->SetStopTime(Seconds(stop));
+  m_serverNode.Get(0)->AddApplication(m_server);
+
+  // Optionally terminate the device connections at the AP and relay
+  // their requests over a single upstream connection to the server,
+  // answering repeated requests from its decision cache
+  // Start at 0.5s, once the server is listening
+  Address deviceRemote = serverAddress;
+  if (m_config.aggregator) {
+    Address aggregatorAddress(
+        InetSocketAddress(m_apIf.GetAddress(0, 0), 50000));
+    m_aggregator = CreateObject<WorkAggregator>();
+    m_aggregator->SetAttribute("Protocol",
+                               TypeIdValue(TcpSocketFactory::GetTypeId()));
+    m_aggregator->SetAttribute("Local", AddressValue(aggregatorAddress));
+    m_aggregator->SetAttribute("Remote", AddressValue(serverAddress));
+    m_aggregator->SetAttribute("CacheSize",
+                               UintegerValue(m_config.cacheSize));
+    m_aggregator->SetAttribute("CacheTtl",
+                               TimeValue(Seconds(m_config.cacheTtl)));
+    m_aggregator->SetStartTime(Seconds(start + 0.5));
+    m_aggregator->SetStopTime(Seconds(stop));
+    m_apNode.Get(0)->AddApplication(m_aggregator);
+    deviceRemote = aggregatorAddress;
+  }
+
+  // Start at 1s
+  // Each start startInterval apart (0.2s by default)
+  // Stop at final
+  // The first devices send urgent messages, the last ones bulk messages
+  // Optionally coalesce the send events of all the devices, or of the
+  // devices of each node, in a shared driver
+  double startDevice = start + 1.0;
+  uint32_t nDevices = m_staNodes.GetN();
+  uint32_t bulkDevices = std::min(m_config.bulkDevices, nDevices);
+  double totalRatio = 0.0;
+  for (const WorkDeviceProfile &profile : m_profiles) {
+    totalRatio += profile.ratio;
+  }
+  std::vector<uint32_t> assigned(m_profiles.size(), 0);
+  Ptr<WorkSendDriver> globalDriver;
+  if (m_config.sendDriver == "global") {
+    globalDriver = CreateObject<WorkSendDriver>();
+  }
+  for (uint32_t i = 0; i < nDevices; ++i) {
+    Address nodeAddress(InetSocketAddress(m_staIfs.GetAddress(i, 0), 50000));
+    Ptr<DeviceEnforcer> device = CreateObject<DeviceEnforcer>();
+    device->SetAttribute("Protocol", TypeIdValue(m_protocol));
+    device->SetAttribute("Local", AddressValue(nodeAddress));
+    device->SetAttribute("Remote", AddressValue(deviceRemote));
+    device->SetAttribute("DataRate",
+                         DataRateValue(DataRate(m_config.dataRate)));
+    string messageClass = "Normal";
+    if (i < m_config.urgentDevices) {
+      messageClass = "Urgent";
+    } else if (i >= nDevices - bulkDevices) {
+      messageClass = "Bulk";
+    }
+    string profileName = "default";
+    if (!m_profiles.empty()) {
+      // From the dataset, or the profile furthest behind its share, which
+      // interleaves the profiles
+      uint32_t index = 0;
+      if (!m_assignment.empty()) {
+        index = m_assignment[i % m_assignment.size()];
+      } else {
+        double deficit = -1.0;
+        for (uint32_t p = 0; p < m_profiles.size(); ++p) {
+          double behind =
+              m_profiles[p].ratio / totalRatio * (i + 1) - assigned[p];
+          if (behind > deficit) {
+            deficit = behind;
+            index = p;
+          }
+        }
+      }
+      assigned[index]++;
+      const WorkDeviceProfile &profile = m_profiles[index];
+      profileName = profile.name;
+      messageClass = profile.messageClass;
+      if (profile.packetSize > 0) {
+        device->SetAttribute("PacketSize", UintegerValue(profile.packetSize));
+      }
+      if (!profile.dataRate.empty()) {
+        device->SetAttribute("DataRate", StringValue(profile.dataRate));
+      }
+      if (!profile.interArrival.empty()) {
+        device->SetAttribute("InterArrival",
+                             StringValue(profile.interArrival));
+      }
+      if (!profile.onTime.empty()) {
+        device->SetAttribute("OnTime", StringValue(profile.onTime));
+      }
+      if (!profile.offTime.empty()) {
+        device->SetAttribute("OffTime", StringValue(profile.offTime));
+      }
+    }
+    device->SetAttribute("MessageClass", StringValue(messageClass));
+    // The events and statistics of the devices are indexed 0 to n - 1,
+    // without rows for the server and the AP
+    device->SetAttribute("DeviceId", UintegerValue(i));
+    if (m_config.sendDriver == "global") {
+      device->SetAttribute("SendDriver", PointerValue(globalDriver));
+    }
+    device->SetStartTime(Seconds(startDevice));
+    device->SetStopTime(Seconds(stop));
+    startDevice += m_config.startInterval;
+
+    m_staNodes.Get(i)->AddApplication(device);
+    m_devices.push_back(device);
+    m_classes.push_back(messageClass);
+    m_deviceProfiles.push_back(profileName);
+    NS_LOG_INFO("Installed device " << i);
+  }
+}
+
+const WorkScenarioConfig &WorkScenario::GetConfig(void) const {
+  return m_config;
+}
+
+Time WorkScenario::GetStopTime(void) const {
+  return Seconds(m_config.simulationTime + 1);
+}
+
+NodeContainer WorkScenario::GetServerNode(void) const { return m_serverNode; }
+
+NodeContainer WorkScenario::GetApNode(void) const { return m_apNode; }
+
+NodeContainer WorkScenario::GetStaNodes(void) const { return m_staNodes; }
+
+NodeContainer WorkScenario::GetAllNodes(void) const {
+  return NodeContainer(m_serverNode, m_apNode, m_staNodes);
+}
+
+NetDeviceContainer WorkScenario::GetServerApDevices(void) const {
+  return m_serverApDevices;
+}
+
+NetDeviceContainer WorkScenario::GetApDevices(void) const {
+  return m_apDevices;
+}
+
+NetDeviceContainer WorkScenario::GetStaDevices(void) const {
+  return m_staDevices;
+}
+
+Ptr<WorkServer> WorkScenario::GetServer(void) const { return m_server; }
+
+Ptr<WorkAggregator> WorkScenario::GetAggregator(void) const {
+  return m_aggregator;
+}
+
+const std::vector<Ptr<DeviceEnforcer>> &WorkScenario::GetDevices(void) const {
+  return m_devices;
+}
+
+const std::vector<WorkDeviceProfile> &WorkScenario::GetProfiles(void) const {
+  return m_profiles;
+}
+
+const string &WorkScenario::GetDeviceProfile(uint32_t i) const {
+  return m_deviceProfiles.at(i);
+}
+
+WifiStandard WorkScenario::GetWifiStandard(const string &name) {
+  static const std::map<string, WifiStandard> standards = {
+      {"80211a", WIFI_STANDARD_80211a},
+      {"80211b", WIFI_STANDARD_80211b},
+      {"80211g", WIFI_STANDARD_80211g},
+      {"80211n_2_4GHZ", WIFI_STANDARD_80211n_2_4GHZ},
+      {"80211n_5GHZ", WIFI_STANDARD_80211n_5GHZ},
+      {"80211ac", WIFI_STANDARD_80211ac},
+      {"80211ax_2_4GHZ", WIFI_STANDARD_80211ax_2_4GHZ},
+      {"80211ax_5GHZ", WIFI_STANDARD_80211ax_5GHZ}};
+  auto it = standards.find(name);
+  NS_ABORT_MSG_IF(it == standards.end(), "Unknown Wi-Fi standard " << name);
+  return it->second;
+}
+
+const string &WorkScenario::GetDeviceClass(uint32_t i) const {
+  return m_classes.at(i);
+}
+
+} // Namespace ns3
@@ -0,0 +1,309 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#ifndef WORK_SCENARIO_H
+#define WORK_SCENARIO_H
+
+#include "ns3/command-line.h"
+#include "ns3/ipv4-interface-container.h"
+#include "ns3/net-device-container.h"
+#include "ns3/node-container.h"
+#include "ns3/wifi-standards.h"
+#include "ns3/work-aggregator.h"
+#include "ns3/work-device-enforcer.h"
+#include "ns3/work-server.h"
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace ns3 {
+
+/**
+ * \ingroup applications
+ *
+ * A device profile, the traffic of a kind of device, e.g. a sensor or a
+ * camera. The random variables are ns-3 strings such as
+ * "ns3::ExponentialRandomVariable[Mean=10]", in seconds; empty fields keep
+ * the scenario parameters.
+ */
+struct WorkDeviceProfile {
+  string name;                   //!< Name, in the per-profile metrics
+  double ratio{1.0};             //!< Share of the devices, relative
+  uint32_t packetSize{0};        //!< Request size in bytes, 0 for default
+  string dataRate;               //!< Data rate of the requests
+  string interArrival;           //!< Time between two requests
+  string onTime;                 //!< Duration of the sending periods
+  string offTime;                //!< Duration of the silent periods
+  string messageClass{"Normal"}; //!< Urgent, Interactive, Normal or Bulk
+};
+
+/**
+ * \ingroup applications
+ *
+ * Parameters of the work scenario, with the defaults of work-simulator.
+ */
+struct WorkScenarioConfig {
+  uint32_t nDevices{29};        //!< Number of devices in the star
+  uint32_t payloadSize{1448};   //!< Transport layer payload size in bytes
+  string dataRate{"100Mbps"};   //!< Application layer data rate
+  string phyRate{"HtMcs7"};     //!< Physical layer bitrate
+  double start{0.0};            //!< Start of the server in seconds
+  double stop{200.0};           //!< Stop of the applications in seconds
+  double simulationTime{200.0}; //!< Simulated seconds, plus one
+  string protocol{"tcp"};       //!< Request transport, tcp or udp
+  bool aggregator{false};       //!< Relay the devices through the AP
+  uint32_t cacheSize{0};        //!< Decisions cached by the aggregator
+  double cacheTtl{10.0};        //!< Cached decision lifetime in seconds
+  string rateControl{"None"};   //!< Device rate controller
+  double targetLatency{50.0};   //!< Rate controller target RTT in ms
+  uint32_t urgentDevices{0};    //!< Devices sending urgent messages
+  uint32_t bulkDevices{0};      //!< Devices sending bulk messages
+  double startInterval{0.2};    //!< Time between device starts in seconds
+  string scheduler{"map"};      //!< Simulator event scheduler
+  bool eventProfile{false};     //!< Profile the events of the scheduler
+  string sendDriver{"none"};    //!< Shared send events, none or global
+  string profiles{""};          //!< Device profiles file, empty for none
+  bool lazy{false};             //!< Connect on the first request
+  double idleTimeout{0.0};      //!< Idle connection close in s, 0 for never
+  /// Positions of the server, the AP and the devices, reused in a loop,
+  /// empty to place the nodes on a grid
+  string positions{"data/positions.csv"};
+  double gridSpacing{2.0}; //!< Distance between grid positions in m
+  uint32_t gridWidth{10};  //!< Grid positions per row
+
+  string wifiStandard{"80211n_2_4GHZ"};    //!< Wi-Fi standard
+  string controlMode{"ErpOfdmRate24Mbps"}; //!< Wi-Fi control frames mode
+  double referenceLoss{40.046};            //!< Path loss at 1 m in dB
+  string csmaRate{"100Mbps"};              //!< Server to AP link rate
+  string csmaDelay{"1ms"};                 //!< Server to AP link delay
+
+  /**
+   * \brief Add the parameters to a command line
+   * \param cmd the command line
+   */
+  void AddCommandLine(CommandLine &cmd);
+
+  /**
+   * \brief Describe the scenario, e.g. to find the runs of a scenario
+   * \param exclude the names of the options left out
+   * \return the "name=value" options of AddCommandLine, joined by ';'
+   */
+  string GetKey(const std::set<string> &exclude = {}) const;
+
+private:
+  /**
+   * \brief Visit the parameters, the single list of the options shared by
+   *        AddCommandLine and GetKey
+   * \param config the parameters, const or not
+   * \param visitor called with the name, the help and the value of every
+   *        option
+   */
+  template <typename Config, typename Visitor>
+  static void Visit(Config &config, Visitor visitor);
+};
+
+/**
+ * \ingroup applications
+ *
+ * \brief A scenario file, the defaults of the command line options.
+ *
+ * Rebuilding a program for every variation of a scenario is slow, so the
+ * programs take a JSON scenario file with --scenario. The file holds
+ * sections named after what they describe, each mapping option names to
+ * values:
+ *
+ *   {
+ *     "description": "A home with 29 devices",
+ *     "topology": { "nNodes": 29, "wifiStandard": "80211n_2_4GHZ" },
+ *     "traffic": { "protocol": "tcp", "dataRate": "1Mbps" },
+ *     "simulation": { "simulationTime": 60 },
+ *     "tracing": { "pcap": true },
+ *     "outputs": { "flowFile": "flow.csv" }
+ *   }
+ *
+ * The names are the command line options of the program, the options given
+ * on the command line override the file. The programs that only run the
+ * scenario, like work-sweep, skip the tracing and outputs sections of
+ * work-simulator, so one file serves all of them. The whole file is checked
+ * before anything is built: an unknown section, a value that is not a
+ * string, a number or a boolean, an unknown option or an unreadable value
+ * stops the program with the name of the faulty entry.
+ */
+class WorkScenarioFile {
+public:
+  /**
+   * \brief Parse the command line, after the scenario file of --scenario
+   *
+   * The "scenario" option is added to the command line.
+   *
+   * \param cmd the command line, with the options of the program
+   * \param argc the number of arguments
+   * \param argv the arguments
+   * \param outputs false to skip the tracing and outputs sections
+   */
+  void Parse(CommandLine &cmd, int argc, char *argv[], bool outputs = true);
+
+  /**
+   * \return the scenario file, empty if none
+   */
+  const string &GetFilename(void) const;
+
+  /**
+   * \brief Read a scenario file as command line arguments
+   * \param filename the scenario file
+   * \param args the "--name=value" arguments, appended
+   * \param error the error message, if any
+   * \param outputs false to skip the tracing and outputs sections
+   * \return true on success
+   */
+  static bool Load(const string &filename, std::vector<string> &args,
+                   string &error, bool outputs = true);
+
+private:
+  string m_filename; //!< Scenario file
+};
+
+/**
+ * \ingroup applications
+ *
+ * \brief The star scenario of the work simulations.
+ *
+ * A server is connected by CSMA to an access point, bridged to the Wi-Fi
+ * network of the devices. Each device runs a DeviceEnforcer sending
+ * requests to the WorkServer, optionally through a WorkAggregator on the
+ * access point. With a profiles file the devices run the traffic of their
+ * WorkDeviceProfile instead of the same requests:
+ *
+ *   {
+ *     "profiles": [
+ *       { "name": "sensor", "ratio": 3, "packetSize": 64,
+ *         "interArrival": "ns3::ExponentialRandomVariable[Mean=10]" },
+ *       { "name": "camera", "ratio": 1, "dataRate": "2Mbps",
+ *         "onTime": "ns3::ExponentialRandomVariable[Mean=30]",
+ *         "offTime": "ns3::ExponentialRandomVariable[Mean=60]",
+ *         "messageClass": "Bulk" }
+ *     ],
+ *     "assignment": "data/profiles/home-assignment.txt"
+ *   }
+ *
+ * The profiles are spread over the devices by ratio, interleaved, or taken
+ * from the optional assignment dataset, one profile name per device, reused
+ * in a loop. The scenario is built in steps so that callers can time
+ * them or add their own outputs in between:
+ *
+ *   WorkScenario scenario(config);
+ *   scenario.Configure();
+ *   scenario.BuildTopology();
+ *   scenario.InstallApplications();
+ *   Simulator::Stop(scenario.GetStopTime());
+ *   Simulator::Run();
+ */
+class WorkScenario {
+public:
+  /**
+   * \param config the parameters of the scenario
+   */
+  WorkScenario(const WorkScenarioConfig &config);
+
+  /**
+   * \brief Check the parameters, set the defaults and the scheduler
+   */
+  void Configure(void);
+
+  /**
+   * \brief Create the nodes, devices, stacks and addresses
+   */
+  void BuildTopology(void);
+
+  /**
+   * \brief Create the server, the aggregator and the device applications
+   *
+   * The "DeviceId" of each device is its index in GetDevices ().
+   */
+  void InstallApplications(void);
+
+  /**
+   * \return the parameters of the scenario
+   */
+  const WorkScenarioConfig &GetConfig(void) const;
+
+  /**
+   * \return the time to stop the simulation at
+   */
+  Time GetStopTime(void) const;
+
+  NodeContainer GetServerNode(void) const; //!< \return the server node
+  NodeContainer GetApNode(void) const;     //!< \return the AP node
+  NodeContainer GetStaNodes(void) const;   //!< \return the device nodes
+  NodeContainer GetAllNodes(void) const;   //!< \return every node
+  /// \return the CSMA devices of the server and the AP
+  NetDeviceContainer GetServerApDevices(void) const;
+  NetDeviceContainer GetApDevices(void) const;  //!< \return the AP Wi-Fi
+  NetDeviceContainer GetStaDevices(void) const; //!< \return the devices Wi-Fi
+
+  Ptr<WorkServer> GetServer(void) const; //!< \return the server application
+  /// \return the aggregator application, null without aggregator
+  Ptr<WorkAggregator> GetAggregator(void) const;
+  /// \return the device applications, in the order of the device nodes
+  const std::vector<Ptr<DeviceEnforcer>> &GetDevices(void) const;
+
+  /**
+   * \param name the name of a Wi-Fi standard, e.g. 80211n_2_4GHZ
+   * \return the standard, aborts if unknown
+   */
+  static WifiStandard GetWifiStandard(const string &name);
+
+  /**
+   * \param i index of a device
+   * \return the message class of the device, Urgent, Normal or Bulk
+   */
+  const string &GetDeviceClass(uint32_t i) const;
+
+  /**
+   * \return the device profiles, empty without profiles file
+   */
+  const std::vector<WorkDeviceProfile> &GetProfiles(void) const;
+
+  /**
+   * \param i index of a device
+   * \return the profile of the device, "default" without profiles file
+   */
+  const string &GetDeviceProfile(uint32_t i) const;
+
+private:
+  /**
+   * \brief Read and check the profiles file
+   */
+  void LoadProfiles(void);
+
+  WorkScenarioConfig m_config;          //!< Parameters
+  TypeId m_protocol;                    //!< Socket factory of the requests
+  NodeContainer m_serverNode;           //!< Server node
+  NodeContainer m_apNode;               //!< Access point node
+  NodeContainer m_staNodes;             //!< Device nodes
+  NetDeviceContainer m_serverApDevices; //!< CSMA devices
+  NetDeviceContainer m_apDevices;       //!< Access point Wi-Fi device
+  NetDeviceContainer m_staDevices;      //!< Device Wi-Fi devices
+  Ipv4InterfaceContainer m_serverIf;    //!< Server address
+  Ipv4InterfaceContainer m_apIf;        //!< Access point bridge address
+  Ipv4InterfaceContainer m_staIfs;      //!< Device addresses
+  Ptr<WorkServer> m_server;             //!< Server application
+  Ptr<WorkAggregator> m_aggregator;     //!< Aggregator application
+  /// Device applications, in the order of the device nodes
+  std::vector<Ptr<DeviceEnforcer>> m_devices;
+  std::vector<string> m_classes; //!< Message class of each device
+  /// Device profiles, empty without profiles file
+  std::vector<WorkDeviceProfile> m_profiles;
+  /// Profiles of the assignment dataset, by index, reused in a loop
+  std::vector<uint32_t> m_assignment;
+  /// Profile of each device
+  std::vector<string> m_deviceProfiles;
+};
+
+} // namespace ns3
+
+#endif /* WORK_SCENARIO_H */
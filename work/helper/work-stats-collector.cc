@@ -0,0 +1,201 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#include "work-stats-collector.h"
+#include "ns3/callback.h"
+#include "ns3/config.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE("WorkStatsCollector");
+
+const char WorkStatsCollector::MAGIC[8] = {'W', 'O', 'R', 'K',
+                                           'S', 'T', 'S', 0};
+
+/**
+ * \brief Write an array of counters
+ * \param values the counters
+ * \param file the output file
+ */
+template <typename T>
+static void WriteArray(const std::vector<T> &values, FILE *file) {
+  fwrite(values.data(), sizeof(T), values.size(), file);
+}
+
+WorkStatsCollector::WorkStatsCollector()
+    : m_acceptedId(WorkEventTrace::Intern("[Accepted]")), m_file(0),
+      m_format(CSV) {
+  NS_LOG_FUNCTION(this);
+}
+
+WorkStatsCollector::~WorkStatsCollector() {
+  NS_LOG_FUNCTION(this);
+  if (m_file) {
+    fclose(m_file);
+  }
+}
+
+void WorkStatsCollector::Install(uint32_t nDevices) {
+  NS_LOG_FUNCTION(this << nDevices);
+  if (nDevices > 0) {
+    Resize(nDevices - 1);
+  }
+  Config::ConnectWithoutContext(
+      "/NodeList/*/ApplicationList/*/$ns3::DeviceEnforcer/Event",
+      MakeCallback(&WorkStatsCollector::Notify, this));
+}
+
+void WorkStatsCollector::Resize(uint32_t device) {
+  uint32_t n = device + 1;
+  m_sent.resize(n, 0);
+  m_accepted.resize(n, 0);
+  m_refused.resize(n, 0);
+  m_retries.resize(n, 0);
+  m_bytes.resize(n, 0);
+  m_connect.resize(n, 0);
+  m_rttSum.resize(n, 0);
+  m_rttSamples.resize(n, 0);
+}
+
+void WorkStatsCollector::Notify(const WorkEvent &event) {
+  uint32_t device = event.device;
+  if (device >= m_sent.size()) {
+    Resize(device);
+  }
+  switch (event.code) {
+  case WORK_TRACE_DEVICE_CONNECTED:
+    m_connect[device] = event.delay;
+    break;
+  case WORK_TRACE_DEVICE_SEND:
+    m_sent[device]++;
+    m_bytes[device] += event.size;
+    break;
+  case WORK_TRACE_DEVICE_RETRANSMIT:
+    m_retries[device]++;
+    m_bytes[device] += event.size;
+    break;
+  case WORK_TRACE_DEVICE_RESPONSE:
+    if (event.message == m_acceptedId) {
+      m_accepted[device]++;
+    } else {
+      m_refused[device]++;
+    }
+    if (event.delay > 0) {
+      m_rttSum[device] += event.delay;
+      m_rttSamples[device]++;
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+void WorkStatsCollector::Export(const string &filename, Format format,
+                                Time interval) {
+  NS_LOG_FUNCTION(this << filename << format << interval);
+  Close();
+  m_file = fopen(filename.c_str(), format == BINARY ? "wb" : "w");
+  NS_ABORT_MSG_IF(!m_file, "Cannot open statistics file " << filename);
+  m_format = format;
+  m_interval = interval;
+  if (format == BINARY) {
+    uint32_t version = VERSION;
+    fwrite(MAGIC, sizeof(MAGIC), 1, m_file);
+    fwrite(&version, sizeof(version), 1, m_file);
+  } else {
+    fputs("time,device,sent,accepted,refused,retries,bytes,connect,rtt\n",
+          m_file);
+  }
+  if (interval.IsStrictlyPositive()) {
+    m_event = Simulator::Schedule(interval,
+                                  &WorkStatsCollector::PeriodicSnapshot, this);
+  }
+  // The last snapshot is written when the simulation is destroyed
+  Simulator::ScheduleDestroy(&WorkStatsCollector::Close, this);
+}
+
+void WorkStatsCollector::PeriodicSnapshot(void) {
+  Snapshot();
+  m_event = Simulator::Schedule(m_interval,
+                                &WorkStatsCollector::PeriodicSnapshot, this);
+}
+
+void WorkStatsCollector::Snapshot(void) {
+  NS_LOG_FUNCTION(this);
+  if (!m_file) {
+    return;
+  }
+  int64_t now = Simulator::Now().GetTimeStep();
+  uint32_t n = m_sent.size();
+  if (m_format == BINARY) {
+    uint32_t count[2] = {n, 0};
+    fwrite(&now, sizeof(now), 1, m_file);
+    fwrite(count, sizeof(count), 1, m_file);
+    WriteArray(m_sent, m_file);
+    WriteArray(m_accepted, m_file);
+    WriteArray(m_refused, m_file);
+    WriteArray(m_retries, m_file);
+    WriteArray(m_bytes, m_file);
+    WriteArray(m_connect, m_file);
+    WriteArray(m_rttSum, m_file);
+    WriteArray(m_rttSamples, m_file);
+    return;
+  }
+  double seconds = Simulator::Now().GetSeconds();
+  for (uint32_t i = 0; i < n; ++i) {
+    fprintf(m_file, "%.6f,%u,%u,%u,%u,%u,%llu,%.6f,%.3f\n", seconds, i,
+            m_sent[i], m_accepted[i], m_refused[i], m_retries[i],
+            (unsigned long long)m_bytes[i], GetConnectTime(i).GetSeconds(),
+            GetMeanRtt(i).GetSeconds() * 1000);
+  }
+}
+
+void WorkStatsCollector::Close(void) {
+  if (!m_file) {
+    return;
+  }
+  NS_LOG_FUNCTION(this);
+  Simulator::Cancel(m_event);
+  Snapshot();
+  fclose(m_file);
+  m_file = 0;
+}
+
+uint32_t WorkStatsCollector::GetNDevices(void) const { return m_sent.size(); }
+
+uint64_t WorkStatsCollector::GetSent(uint32_t device) const {
+  return device < m_sent.size() ? m_sent[device] : 0;
+}
+
+uint64_t WorkStatsCollector::GetAccepted(uint32_t device) const {
+  return device < m_accepted.size() ? m_accepted[device] : 0;
+}
+
+uint64_t WorkStatsCollector::GetRefused(uint32_t device) const {
+  return device < m_refused.size() ? m_refused[device] : 0;
+}
+
+uint64_t WorkStatsCollector::GetRetries(uint32_t device) const {
+  return device < m_retries.size() ? m_retries[device] : 0;
+}
+
+uint64_t WorkStatsCollector::GetBytes(uint32_t device) const {
+  return device < m_bytes.size() ? m_bytes[device] : 0;
+}
+
+Time WorkStatsCollector::GetConnectTime(uint32_t device) const {
+  return device < m_connect.size() ? TimeStep(m_connect[device]) : Time(0);
+}
+
+Time WorkStatsCollector::GetMeanRtt(uint32_t device) const {
+  if (device >= m_rttSamples.size() || m_rttSamples[device] == 0) {
+    return Time(0);
+  }
+  return TimeStep(m_rttSum[device] / m_rttSamples[device]);
+}
+
+} // Namespace ns3
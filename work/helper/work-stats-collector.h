@@ -0,0 +1,143 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#ifndef WORK_STATS_COLLECTOR_H
+#define WORK_STATS_COLLECTOR_H
+
+#include "ns3/event-id.h"
+#include "ns3/nstime.h"
+#include "ns3/work-event-trace.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace ns3 {
+
+/**
+ * \ingroup applications
+ *
+ * \brief Per-device statistics of the DeviceEnforcer applications.
+ *
+ * The statistics are updated by the "Event" trace source and kept as a
+ * struct of arrays indexed by the device id: one contiguous array per
+ * counter, 44 bytes per device in total, so that tens of thousands of
+ * devices fit in a few megabytes and a snapshot is written array by array.
+ *
+ * Snapshots are written at the end of the simulation (Simulator::Destroy)
+ * and, if an interval is given, periodically. In CSV format every
+ * snapshot appends a line per device:
+ *
+ *   time,device,sent,accepted,refused,retries,bytes,connect,rtt
+ *
+ * with times in seconds and the mean round-trip time in milliseconds. The
+ * binary format starts with the "WORKSTS" magic and the format version
+ * (uint32). Every snapshot is the time (int64, time steps), the device
+ * count n (uint32), a zero uint32 and the arrays of n counters in the
+ * order of the members: sent, accepted, refused, retries (uint32), bytes
+ * (uint64), connection delay, sum of the round-trip times (int64, time
+ * steps) and round-trip time samples (uint32), in host byte order.
+ */
+class WorkStatsCollector {
+public:
+  /// Export formats
+  enum Format {
+    CSV,   //!< A text line per device
+    BINARY //!< Arrays of counters
+  };
+
+  WorkStatsCollector();
+
+  virtual ~WorkStatsCollector();
+
+  /**
+   * \brief Connect to the "Event" trace source of every DeviceEnforcer
+   * \param nDevices the expected number of devices, the arrays grow if
+   *        higher device ids are seen
+   */
+  void Install(uint32_t nDevices = 0);
+
+  /**
+   * \brief Update the statistics of a device, the sink of the "Event" trace
+   *        source
+   * \param event the event
+   */
+  void Notify(const WorkEvent &event);
+
+  /**
+   * \brief Write snapshots of the statistics to a file
+   * \param filename the output file
+   * \param format the file format
+   * \param interval the time between snapshots, zero for a single snapshot
+   *        at the end of the simulation
+   */
+  void Export(const string &filename, Format format,
+              Time interval = Seconds(0));
+
+  /**
+   * \brief Write a snapshot now
+   */
+  void Snapshot(void);
+
+  /**
+   * \brief Write a last snapshot and close the file
+   */
+  void Close(void);
+
+  /**
+   * \return number of devices, the highest device id plus one
+   */
+  uint32_t GetNDevices(void) const;
+
+  uint64_t GetSent(uint32_t device) const;     //!< \return requests sent
+  uint64_t GetAccepted(uint32_t device) const; //!< \return accepted requests
+  uint64_t GetRefused(uint32_t device) const;  //!< \return refused requests
+  uint64_t GetRetries(uint32_t device) const;  //!< \return retransmissions
+  uint64_t GetBytes(uint32_t device) const;    //!< \return bytes sent
+  Time GetConnectTime(uint32_t device) const;  //!< \return connection delay
+  /**
+   * \param device the device id
+   * \return mean round-trip time of the unambiguous samples
+   */
+  Time GetMeanRtt(uint32_t device) const;
+
+  /// Magic at the start of a binary file
+  static const char MAGIC[8];
+  /// Version of the binary file format
+  static const uint32_t VERSION = 1;
+
+private:
+  /**
+   * \brief Grow the arrays to hold a device
+   * \param device the device id
+   */
+  void Resize(uint32_t device);
+
+  /**
+   * \brief Write a snapshot and schedule the next one
+   */
+  void PeriodicSnapshot(void);
+
+  std::vector<uint32_t> m_sent;       //!< Requests sent
+  std::vector<uint32_t> m_accepted;   //!< Accepted responses
+  std::vector<uint32_t> m_refused;    //!< Other responses
+  std::vector<uint32_t> m_retries;    //!< Retransmissions
+  std::vector<uint64_t> m_bytes;      //!< Bytes sent
+  std::vector<int64_t> m_connect;     //!< Connection delay, in time steps
+  std::vector<int64_t> m_rttSum;      //!< Sum of the round-trip times
+  std::vector<uint32_t> m_rttSamples; //!< Number of round-trip times
+  uint32_t m_acceptedId;              //!< Interned "[Accepted]" message
+
+  FILE *m_file;    //!< Output file
+  Format m_format; //!< Output format
+  Time m_interval; //!< Time between snapshots
+  EventId m_event; //!< Next periodic snapshot
+};
+
+} // namespace ns3
+
+#endif /* WORK_STATS_COLLECTOR_H */
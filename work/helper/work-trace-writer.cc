@@ -0,0 +1,244 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#include "work-trace-writer.h"
+#include "ns3/callback.h"
+#include "ns3/log.h"
+#include "ns3/node.h"
+#include "ns3/pointer.h"
+#include "ns3/simulator.h"
+#include <chrono>
+#include <sstream>
+#include <stdio.h>
+#include <sys/stat.h>
+#ifdef WORK_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE("WorkTraceWriter");
+
+WorkTraceWriter::WorkTraceWriter()
+    : m_compression(NONE), m_file(0), m_events(ALL), m_bufferSize(1 << 16),
+      m_maxBuffers(8), m_closing(false), m_lines(0), m_bytesTraced(0),
+      m_bytesWritten(0), m_stallTime(0) {
+  NS_LOG_FUNCTION(this);
+}
+
+WorkTraceWriter::~WorkTraceWriter() {
+  NS_LOG_FUNCTION(this);
+  Close();
+}
+
+bool WorkTraceWriter::HasCompression(void) {
+#ifdef WORK_HAVE_ZLIB
+  return true;
+#else
+  return false;
+#endif
+}
+
+void WorkTraceWriter::Open(const string &filename, Compression compression,
+                           int level, uint32_t bufferSize, uint32_t buffers) {
+  NS_LOG_FUNCTION(this << filename << compression << level << bufferSize
+                       << buffers);
+  NS_ABORT_MSG_IF(buffers == 0 || bufferSize == 0,
+                  "The trace writer needs buffers");
+  Close();
+  if (compression == GZIP) {
+#ifdef WORK_HAVE_ZLIB
+    string mode = "wb" + to_string(std::min(std::max(level, 1), 9));
+    m_file = gzopen(filename.c_str(), mode.c_str());
+#else
+    NS_FATAL_ERROR("The work module is built without zlib, use an "
+                   "uncompressed trace");
+#endif
+  } else {
+    m_file = fopen(filename.c_str(), "w");
+  }
+  NS_ABORT_MSG_IF(!m_file, "Cannot open trace file " << filename);
+
+  m_filename = filename;
+  m_compression = compression;
+  m_bufferSize = bufferSize;
+  m_maxBuffers = buffers;
+  m_buffer.reserve(bufferSize);
+  m_closing = false;
+  m_lines = 0;
+  m_bytesTraced = 0;
+  m_bytesWritten = 0;
+  m_stallTime = 0;
+  m_thread = std::thread(&WorkTraceWriter::Run, this);
+  // The last buffer is written when the simulation is destroyed
+  Simulator::ScheduleDestroy(&WorkTraceWriter::Close, this);
+}
+
+void WorkTraceWriter::SetNodes(const std::set<uint32_t> &nodes) {
+  m_nodes = nodes;
+}
+
+void WorkTraceWriter::SetEvents(uint32_t events) { m_events = events; }
+
+void WorkTraceWriter::SetTimeWindow(Time start, Time stop) {
+  NS_LOG_FUNCTION(this << start << stop);
+  m_start = start;
+  m_stop = stop;
+}
+
+void WorkTraceWriter::Install(const NetDeviceContainer &devices) {
+  NS_LOG_FUNCTION(this);
+  for (auto it = devices.Begin(); it != devices.End(); ++it) {
+    Ptr<NetDevice> device = *it;
+    uint32_t node = device->GetNode()->GetId();
+    if (!m_nodes.empty() && m_nodes.find(node) == m_nodes.end()) {
+      continue;
+    }
+    PointerValue queue;
+    if (!device->GetAttributeFailSafe("TxQueue", queue) ||
+        !queue.Get<Object>()) {
+      NS_LOG_WARN("Device " << device << " has no queue, not traced");
+      continue;
+    }
+    ostringstream os;
+    os << "/NodeList/" << node << "/DeviceList/" << device->GetIfIndex()
+       << "/$" << device->GetInstanceTypeId().GetName();
+    string path = os.str();
+    // Connect only the traced events: the others cost nothing
+    if (m_events & ENQUEUE) {
+      queue.Get<Object>()->TraceConnect(
+          "Enqueue", path + "/TxQueue/Enqueue",
+          MakeCallback(&WorkTraceWriter::Enqueue, this));
+    }
+    if (m_events & DEQUEUE) {
+      queue.Get<Object>()->TraceConnect(
+          "Dequeue", path + "/TxQueue/Dequeue",
+          MakeCallback(&WorkTraceWriter::Dequeue, this));
+    }
+    if (m_events & DROP) {
+      queue.Get<Object>()->TraceConnect(
+          "Drop", path + "/TxQueue/Drop",
+          MakeCallback(&WorkTraceWriter::Drop, this));
+    }
+    if (m_events & RECEIVE) {
+      device->TraceConnect("MacRx", path + "/MacRx",
+                           MakeCallback(&WorkTraceWriter::Receive, this));
+    }
+  }
+}
+
+void WorkTraceWriter::Trace(EventType type, char tag, string context,
+                            Ptr<const Packet> packet) {
+  Time now = Simulator::Now();
+  if (!m_file || !(m_events & type) || now < m_start ||
+      (m_stop.IsStrictlyPositive() && now >= m_stop)) {
+    return;
+  }
+  // Same line as the ASCII trace helpers
+  ostringstream os;
+  os << tag << " " << now.GetSeconds() << " " << context << " " << *packet
+     << "\n";
+  string line = os.str();
+  m_buffer += line;
+  m_lines++;
+  m_bytesTraced += line.size();
+  if (m_buffer.size() >= m_bufferSize) {
+    Submit();
+  }
+}
+
+void WorkTraceWriter::Enqueue(string context, Ptr<const Packet> packet) {
+  Trace(ENQUEUE, '+', context, packet);
+}
+
+void WorkTraceWriter::Dequeue(string context, Ptr<const Packet> packet) {
+  Trace(DEQUEUE, '-', context, packet);
+}
+
+void WorkTraceWriter::Drop(string context, Ptr<const Packet> packet) {
+  Trace(DROP, 'd', context, packet);
+}
+
+void WorkTraceWriter::Receive(string context, Ptr<const Packet> packet) {
+  Trace(RECEIVE, 'r', context, packet);
+}
+
+void WorkTraceWriter::Submit(void) {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  if (m_queue.size() >= m_maxBuffers) {
+    auto start = std::chrono::steady_clock::now();
+    m_cv.wait(lock, [this] { return m_queue.size() < m_maxBuffers; });
+    std::chrono::duration<double> stall =
+        std::chrono::steady_clock::now() - start;
+    m_stallTime += stall.count();
+  }
+  m_queue.push_back(std::move(m_buffer));
+  lock.unlock();
+  m_cv.notify_all();
+  m_buffer = string();
+  m_buffer.reserve(m_bufferSize);
+}
+
+void WorkTraceWriter::Run(void) {
+  while (true) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait(lock, [this] { return !m_queue.empty() || m_closing; });
+    if (m_queue.empty()) {
+      return;
+    }
+    string buffer = std::move(m_queue.front());
+    m_queue.pop_front();
+    lock.unlock();
+    m_cv.notify_all();
+#ifdef WORK_HAVE_ZLIB
+    if (m_compression == GZIP) {
+      gzwrite(static_cast<gzFile>(m_file), buffer.data(), buffer.size());
+      continue;
+    }
+#endif
+    fwrite(buffer.data(), 1, buffer.size(), static_cast<FILE *>(m_file));
+  }
+}
+
+void WorkTraceWriter::Close(void) {
+  if (!m_thread.joinable()) {
+    return;
+  }
+  NS_LOG_FUNCTION(this);
+  if (!m_buffer.empty()) {
+    Submit();
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_closing = true;
+  }
+  m_cv.notify_all();
+  m_thread.join();
+#ifdef WORK_HAVE_ZLIB
+  if (m_compression == GZIP) {
+    gzclose(static_cast<gzFile>(m_file));
+  }
+#endif
+  if (m_compression == NONE) {
+    fclose(static_cast<FILE *>(m_file));
+  }
+  m_file = 0;
+  struct stat st;
+  if (stat(m_filename.c_str(), &st) == 0) {
+    m_bytesWritten = st.st_size;
+  }
+}
+
+uint64_t WorkTraceWriter::GetLines(void) const { return m_lines; }
+
+uint64_t WorkTraceWriter::GetBytesTraced(void) const { return m_bytesTraced; }
+
+uint64_t WorkTraceWriter::GetBytesWritten(void) const {
+  return m_bytesWritten;
+}
+
+double WorkTraceWriter::GetStallTime(void) const { return m_stallTime; }
+
+} // Namespace ns3
@@ -0,0 +1,177 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#ifndef WORK_TRACE_WRITER_H
+#define WORK_TRACE_WRITER_H
+
+#include "ns3/net-device-container.h"
+#include "ns3/nstime.h"
+#include "ns3/packet.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <stdint.h>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+namespace ns3 {
+
+/**
+ * \ingroup applications
+ *
+ * \brief Filtered ASCII device trace, compressed on a background thread.
+ *
+ * Writes the lines of the ASCII trace of the CSMA and point to point
+ * helpers ("+" enqueue, "-" dequeue, "d" drop, "r" receive) for the
+ * devices installed, but only for the selected nodes, event types and
+ * time window: filtered events are discarded before being formatted.
+ *
+ * The lines are appended to a buffer; full buffers are handed over to a
+ * writer thread, which compresses them with gzip (when the module is built
+ * with zlib) and writes them, so the simulation only waits for the disk
+ * when every buffer is in flight. That wait is reported as the stall
+ * time, together with the bytes traced and the bytes written.
+ */
+class WorkTraceWriter {
+public:
+  /// Compression of the trace file
+  enum Compression {
+    NONE, //!< Plain text
+    GZIP  //!< gzip stream, readable with zcat
+  };
+
+  /// Event types, to be combined in a mask
+  enum EventType {
+    ENQUEUE = 1, //!< Packet enqueued in the device queue ("+")
+    DEQUEUE = 2, //!< Packet dequeued for transmission ("-")
+    DROP = 4,    //!< Packet dropped by the queue ("d")
+    RECEIVE = 8, //!< Packet received by the device ("r")
+    ALL = 15     //!< Every event
+  };
+
+  WorkTraceWriter();
+
+  virtual ~WorkTraceWriter();
+
+  /**
+   * \return true if the module is built with zlib, for GZIP traces
+   */
+  static bool HasCompression(void);
+
+  /**
+   * \brief Open the trace file and start the writer thread
+   * \param filename the trace file
+   * \param compression the compression of the file
+   * \param level the gzip compression level, 1 (fast) to 9 (small)
+   * \param bufferSize the size of a buffer handed to the writer thread
+   * \param buffers the number of buffers in flight before the simulation
+   *        waits for the writer thread
+   */
+  void Open(const string &filename, Compression compression, int level = 6,
+            uint32_t bufferSize = 1 << 16, uint32_t buffers = 8);
+
+  /**
+   * \brief Trace only some nodes, to be called before Install
+   * \param nodes the node ids, empty for every node
+   */
+  void SetNodes(const std::set<uint32_t> &nodes);
+
+  /**
+   * \param events the traced events, a mask of EventType
+   */
+  void SetEvents(uint32_t events);
+
+  /**
+   * \brief Trace only an interval of the simulation
+   * \param start the first time traced
+   * \param stop the end of the interval, zero for the end of the simulation
+   */
+  void SetTimeWindow(Time start, Time stop);
+
+  /**
+   * \brief Trace devices with a "TxQueue" attribute, such as the CSMA and
+   *        point to point devices
+   * \param devices the devices
+   */
+  void Install(const NetDeviceContainer &devices);
+
+  /**
+   * \brief Write the last buffer, stop the writer thread and close the file
+   */
+  void Close(void);
+
+  /**
+   * \return number of lines traced
+   */
+  uint64_t GetLines(void) const;
+
+  /**
+   * \return number of bytes traced, before compression
+   */
+  uint64_t GetBytesTraced(void) const;
+
+  /**
+   * \return number of bytes written to the file, known once closed
+   */
+  uint64_t GetBytesWritten(void) const;
+
+  /**
+   * \return wall clock seconds the simulation waited for the writer thread
+   */
+  double GetStallTime(void) const;
+
+private:
+  /**
+   * \brief Format a line, if the event passes the filters
+   * \param type the event type
+   * \param tag the character of the event type
+   * \param context the trace context
+   * \param packet the packet
+   */
+  void Trace(EventType type, char tag, string context,
+             Ptr<const Packet> packet);
+
+  void Enqueue(string context, Ptr<const Packet> packet); //!< "+" sink
+  void Dequeue(string context, Ptr<const Packet> packet); //!< "-" sink
+  void Drop(string context, Ptr<const Packet> packet);    //!< "d" sink
+  void Receive(string context, Ptr<const Packet> packet); //!< "r" sink
+
+  /**
+   * \brief Hand the current buffer over to the writer thread
+   */
+  void Submit(void);
+
+  /**
+   * \brief Body of the writer thread
+   */
+  void Run(void);
+
+  string m_filename;            //!< Trace file
+  Compression m_compression;    //!< Compression of the file
+  void *m_file;                 //!< FILE or gzFile, used by the thread
+  std::set<uint32_t> m_nodes;   //!< Traced nodes, empty for all
+  uint32_t m_events;            //!< Mask of the traced events
+  Time m_start;                 //!< Start of the traced interval
+  Time m_stop;                  //!< End of the traced interval, or zero
+  string m_buffer;              //!< Lines being formatted
+  uint32_t m_bufferSize;        //!< Size of a full buffer
+  uint32_t m_maxBuffers;        //!< Buffers in flight
+  std::deque<string> m_queue;   //!< Buffers waiting for the thread
+  std::mutex m_mutex;           //!< Protects the queue and m_closing
+  std::condition_variable m_cv; //!< Signals queue changes
+  std::thread m_thread;         //!< Writer thread
+  bool m_closing;               //!< True when the thread must stop
+  uint64_t m_lines;             //!< Lines traced
+  uint64_t m_bytesTraced;       //!< Bytes traced
+  uint64_t m_bytesWritten;      //!< Bytes of the closed file
+  double m_stallTime;           //!< Seconds waited for the thread
+};
+
+} // namespace ns3
+
+#endif /* WORK_TRACE_WRITER_H */
@@ -1,4 +1,6 @@
 #include "work-utils.h"
+#include <algorithm>
+#include <cmath>
 
 namespace ns3 {
 
@@ -79,4 +81,46 @@ string getTimeOfSimulationStart() {
   return convert.str();
 }
 
+double percentile(vector<double> &values, double p) {
+  if (values.empty()) {
+    return 0.0;
+  }
+  double rank = p / 100.0 * (values.size() - 1);
+  size_t lower = static_cast<size_t>(rank);
+  size_t upper = min(lower + 1, values.size() - 1);
+  nth_element(values.begin(), values.begin() + lower, values.end());
+  double low = values[lower];
+  if (upper == lower) {
+    return low;
+  }
+  double high = *min_element(values.begin() + lower + 1, values.end());
+  return low + (high - low) * (rank - lower);
+}
+
+double studentT95(uint32_t df) {
+  static const double quantiles[] = {
+      12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+      2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+      2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+  if (df == 0) {
+    return 0.0;
+  }
+  return df <= 30 ? quantiles[df - 1] : 1.960;
+}
+
+double confidenceInterval(const vector<double> &values, double &mean) {
+  mean = 0.0;
+  for (double value : values) {
+    mean += value / values.size();
+  }
+  if (values.size() < 2) {
+    return 0.0;
+  }
+  double variance = 0.0;
+  for (double value : values) {
+    variance += (value - mean) * (value - mean) / (values.size() - 1);
+  }
+  return studentT95(values.size() - 1) * sqrt(variance / values.size());
+}
+
 } // namespace ns3
\ No newline at end of file
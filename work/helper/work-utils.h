@@ -5,6 +5,8 @@
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <stdint.h>
+#include <vector>
 
 using namespace std;
 
@@ -73,6 +75,30 @@ int extractDay(time_t mtime);
  */
 string getTimeOfSimulationStart();
 
+/*
+ * Compute a percentile of a sample, interpolating between closest ranks
+ * \param values sample, reordered by the call
+ * \param p percentile in [0, 100]
+ * \returns percentile value, zero for an empty sample
+ */
+double percentile(vector<double> &values, double p);
+
+/*
+ * Two-sided 95% quantile of the Student t distribution
+ * \param df degrees of freedom
+ * \returns quantile, the normal one above 30 degrees of freedom
+ */
+double studentT95(uint32_t df);
+
+/*
+ * Compute the mean of a sample and the half-width of its 95% confidence
+ * interval
+ * \param values sample
+ * \param mean mean of the sample
+ * \returns half-width of the confidence interval, zero below two values
+ */
+double confidenceInterval(const vector<double> &values, double &mean);
+
 } // namespace ns3
 
 #endif
\ No newline at end of file
@@ -0,0 +1,440 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#include "work-aggregator.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/inet6-socket-address.h"
+#include "ns3/log.h"
+#include "ns3/node.h"
+#include "ns3/packet.h"
+#include "ns3/simulator.h"
+#include "ns3/socket-factory.h"
+#include "ns3/socket.h"
+#include "ns3/tcp-socket-factory.h"
+#include "ns3/trace-source-accessor.h"
+#include "ns3/uinteger.h"
+#include <algorithm>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE("WorkAggregator");
+
+NS_OBJECT_ENSURE_REGISTERED(WorkAggregator);
+
+TypeId WorkAggregator::GetTypeId(void) {
+  static TypeId tid =
+      TypeId("ns3::WorkAggregator")
+          .SetParent<Application>()
+          .SetGroupName("Applications")
+          .AddConstructor<WorkAggregator>()
+          .AddAttribute("Local",
+                        "The Address on which devices connect to the "
+                        "aggregator.",
+                        AddressValue(),
+                        MakeAddressAccessor(&WorkAggregator::m_local),
+                        MakeAddressChecker())
+          .AddAttribute("Remote", "The address of the WorkServer",
+                        AddressValue(),
+                        MakeAddressAccessor(&WorkAggregator::m_peer),
+                        MakeAddressChecker())
+          .AddAttribute("Protocol",
+                        "The type id of the protocol to use for the device "
+                        "and upstream sockets.",
+                        TypeIdValue(TcpSocketFactory::GetTypeId()),
+                        MakeTypeIdAccessor(&WorkAggregator::m_tid),
+                        MakeTypeIdChecker())
+          .AddAttribute("Upstreams",
+                        "Number of long-lived connections to the server.",
+                        UintegerValue(1),
+                        MakeUintegerAccessor(&WorkAggregator::m_nUpstreams),
+                        MakeUintegerChecker<uint32_t>(1))
+          .AddAttribute("BatchInterval",
+                        "Maximum time a request waits for other requests "
+                        "before being flushed. Zero flushes at the end of "
+                        "every read burst.",
+                        TimeValue(Seconds(0)),
+                        MakeTimeAccessor(&WorkAggregator::m_batchInterval),
+                        MakeTimeChecker())
+          .AddAttribute("MaxBatchSize",
+                        "Size in bytes of a batch that is flushed at once.",
+                        UintegerValue(1400),
+                        MakeUintegerAccessor(&WorkAggregator::m_maxBatchSize),
+                        MakeUintegerChecker<uint32_t>(1))
+          .AddAttribute("CacheSize",
+                        "Maximum number of decisions cached by request "
+                        "content. Zero disables the cache.",
+                        UintegerValue(0),
+                        MakeUintegerAccessor(&WorkAggregator::m_cacheSize),
+                        MakeUintegerChecker<uint32_t>())
+          .AddAttribute("CacheTtl",
+                        "Time to live of a cached decision. Zero keeps "
+                        "decisions until evicted or invalidated.",
+                        TimeValue(Seconds(10)),
+                        MakeTimeAccessor(&WorkAggregator::m_cacheTtl),
+                        MakeTimeChecker())
+          .AddTraceSource("Latency",
+                          "Time between a device request reaching the "
+                          "aggregator and its response being relayed",
+                          MakeTraceSourceAccessor(
+                              &WorkAggregator::m_latencyTrace),
+                          "ns3::Time::TracedCallback")
+          .AddTraceSource("CacheLookup",
+                          "A device request has been answered, from the "
+                          "cache or from the server, after the given time",
+                          MakeTraceSourceAccessor(
+                              &WorkAggregator::m_cacheTrace),
+                          "ns3::WorkAggregator::CacheLookupCallback");
+  return tid;
+}
+
+WorkAggregator::WorkAggregator()
+    : m_socket(0), m_nextUpstream(0), m_nextId(0), m_forwarded(0),
+      m_relayed(0), m_batches(0) {
+  NS_LOG_FUNCTION(this);
+}
+
+WorkAggregator::~WorkAggregator() { NS_LOG_FUNCTION(this); }
+
+uint64_t WorkAggregator::GetForwarded(void) const { return m_forwarded; }
+
+uint64_t WorkAggregator::GetRelayed(void) const { return m_relayed; }
+
+uint64_t WorkAggregator::GetBatches(void) const { return m_batches; }
+
+const WorkDecisionCache &WorkAggregator::GetCache(void) const {
+  return m_cache;
+}
+
+Time WorkAggregator::GetMeanUpstreamLatency(void) const {
+  uint64_t answered = m_forwarded - m_pending.size();
+  return answered == 0
+             ? Seconds(0)
+             : NanoSeconds(m_upstreamLatency.GetNanoSeconds() / answered);
+}
+
+void WorkAggregator::DoDispose(void) {
+  NS_LOG_FUNCTION(this);
+  Simulator::Cancel(m_flushEvent);
+  m_socket = 0;
+  m_socketList.clear();
+  m_framers.clear();
+  m_upstreams.clear();
+  m_pending.clear();
+
+  // chain up
+  Application::DoDispose();
+}
+
+// Application Methods
+void WorkAggregator::StartApplication() // Called at time specified by Start
+{
+  NS_LOG_FUNCTION(this);
+  NS_LOG_INFO("Starting work aggregator...");
+  if (!m_socket) {
+    m_socket = Socket::CreateSocket(GetNode(), m_tid);
+    if (m_socket->Bind(m_local) == -1) {
+      NS_FATAL_ERROR("Failed to bind socket");
+    }
+    m_socket->Listen();
+  }
+  m_cache = WorkDecisionCache(m_cacheSize, m_cacheTtl);
+  m_socket->SetAcceptCallback(
+      MakeNullCallback<bool, Ptr<Socket>, const Address &>(),
+      MakeCallback(&WorkAggregator::HandleAccept, this));
+
+  ConnectUpstreams();
+}
+
+void WorkAggregator::StopApplication() // Called at time specified by Stop
+{
+  NS_LOG_FUNCTION(this);
+  NS_LOG_INFO("Stopping work aggregator...");
+  Simulator::Cancel(m_flushEvent);
+  while (!m_socketList.empty()) {
+    Ptr<Socket> acceptedSocket = m_socketList.front();
+    m_socketList.pop_front();
+    acceptedSocket->Close();
+  }
+  for (Upstream &upstream : m_upstreams) {
+    upstream.socket->Close();
+  }
+  m_upstreams.clear();
+  if (m_socket) {
+    m_socket->Close();
+  }
+}
+
+void WorkAggregator::ConnectUpstreams(void) {
+  NS_LOG_FUNCTION(this);
+  for (uint32_t i = 0; i < m_nUpstreams; ++i) {
+    Upstream upstream;
+    upstream.socket = Socket::CreateSocket(GetNode(), m_tid);
+    upstream.connected = false;
+    upstream.batch = Create<Packet>(0);
+    // The buffer is empty before the connection
+    upstream.capacity = upstream.socket->GetTxAvailable();
+    if (Inet6SocketAddress::IsMatchingType(m_peer)) {
+      upstream.socket->Bind6();
+    } else {
+      upstream.socket->Bind();
+    }
+    upstream.socket->Connect(m_peer);
+    upstream.socket->SetConnectCallback(
+        MakeCallback(&WorkAggregator::UpstreamConnected, this),
+        MakeCallback(&WorkAggregator::UpstreamFailed, this));
+    upstream.socket->SetRecvCallback(
+        MakeCallback(&WorkAggregator::HandleUpstreamRead, this));
+    upstream.socket->SetSendCallback(
+        MakeCallback(&WorkAggregator::UpstreamSendReady, this));
+    m_upstreams.push_back(upstream);
+  }
+}
+
+void WorkAggregator::HandleAccept(Ptr<Socket> s, const Address &from) {
+  NS_LOG_FUNCTION(this << s);
+  s->SetRecvCallback(MakeCallback(&WorkAggregator::HandleDeviceRead, this));
+  s->SetCloseCallbacks(
+      MakeCallback(&WorkAggregator::HandleDeviceClose, this),
+      MakeCallback(&WorkAggregator::HandleDeviceClose, this));
+  m_socketList.push_back(s);
+}
+
+void WorkAggregator::HandleDeviceRead(Ptr<Socket> socket) {
+  NS_LOG_FUNCTION(this << socket);
+  Ptr<Packet> packet;
+  Address from;
+  WorkMessageFramer &framer = m_framers[socket];
+  while ((packet = socket->RecvFrom(from))) {
+    if (packet->GetSize() == 0) { // EOF
+      break;
+    }
+    framer.Append(packet);
+    WorkMessageHeader header;
+    string payload;
+    while (framer.Next(header, payload)) {
+      HandleRequest(socket, header, payload);
+    }
+  }
+
+  if (m_batchInterval.IsZero()) {
+    FlushAll();
+  } else if (!m_flushEvent.IsRunning()) {
+    m_flushEvent =
+        Simulator::Schedule(m_batchInterval, &WorkAggregator::FlushAll, this);
+  }
+}
+
+void WorkAggregator::HandleDeviceClose(Ptr<Socket> socket) {
+  NS_LOG_FUNCTION(this << socket);
+  m_framers.erase(socket);
+  m_socketList.remove(socket);
+}
+
+void WorkAggregator::HandleRequest(Ptr<Socket> socket,
+                                   const WorkMessageHeader &header,
+                                   const string &payload) {
+  NS_LOG_FUNCTION(this << socket << header);
+  if (header.GetType() != WorkMessageHeader::REQUEST) {
+    NS_LOG_WARN("Ignoring unexpected message " << header);
+    return;
+  }
+  Forward(payload, socket, header.GetId(), header.GetClass());
+}
+
+void WorkAggregator::Forward(const string &payload, Ptr<Socket> device,
+                             uint32_t id,
+                             WorkMessageHeader::MessageClass messageClass) {
+  NS_LOG_FUNCTION(this << device << id);
+  string key = WorkMessageFramer::Unwrap(payload);
+  // Padding added by the device is not forwarded, only the message
+  string message = "[" + key + "]";
+
+  string decision;
+  if (m_cache.IsEnabled() && m_cache.Lookup(key, decision)) {
+    NS_LOG_LOGIC("Cache hit for " << message << ": " << decision);
+    Reply(device, id, decision, Simulator::Now(), messageClass);
+    m_cacheTrace(true, Seconds(0));
+    return;
+  }
+
+  uint32_t index = m_nextUpstream;
+  m_nextUpstream = (m_nextUpstream + 1) % m_upstreams.size();
+  Upstream &upstream = m_upstreams[index];
+  uint8_t flags = WorkMessageHeader::GetClassFlags(messageClass);
+  if (m_cache.IsEnabled()) {
+    flags |= WorkMessageHeader::FLAG_CACHING;
+  }
+  uint32_t upstreamId = m_nextId++;
+  Ptr<Packet> request = WorkMessageFramer::Frame(
+      WorkMessageHeader::REQUEST, upstreamId, message, 0, flags);
+  if (upstream.batch->GetSize() + request->GetSize() > upstream.capacity) {
+    // The server does not keep up, a larger batch could never be sent
+    NS_LOG_DEBUG("Batch of upstream " << index << " full, refusing "
+                                      << message);
+    Reply(device, id, "[Refused]", Simulator::Now(), messageClass);
+    return;
+  }
+
+  PendingRequest pending;
+  pending.device = device;
+  pending.id = id;
+  pending.arrival = Simulator::Now();
+  pending.key = key;
+  pending.messageClass = messageClass;
+  m_pending[upstreamId] = pending;
+
+  upstream.batch->AddAtEnd(request);
+  m_forwarded++;
+
+  if (upstream.batch->GetSize() >= m_maxBatchSize) {
+    Flush(index);
+  }
+}
+
+void WorkAggregator::Flush(uint32_t index) {
+  NS_LOG_FUNCTION(this << index);
+  Upstream &upstream = m_upstreams[index];
+  if (!upstream.connected || upstream.batch->GetSize() == 0) {
+    return;
+  }
+  // The socket refuses more than its free buffer: send what fits, the
+  // rest when the buffer drains. A datagram batch always fits whole, it is
+  // never larger than the capacity.
+  uint32_t size = std::min(upstream.batch->GetSize(),
+                           upstream.socket->GetTxAvailable());
+  if (size == 0) {
+    return;
+  }
+  Ptr<Packet> packet = size == upstream.batch->GetSize()
+                           ? upstream.batch
+                           : upstream.batch->CreateFragment(0, size);
+  int actual = upstream.socket->Send(packet);
+  if (actual < 0 || (uint32_t)actual != size) {
+    NS_LOG_DEBUG("Unable to flush batch of " << upstream.batch->GetSize()
+                                             << " bytes; keeping it");
+    return;
+  }
+  NS_LOG_LOGIC("Flushed " << actual << " bytes upstream on " << index);
+  m_batches++;
+  if (size == upstream.batch->GetSize()) {
+    upstream.batch = Create<Packet>(0);
+  } else {
+    upstream.batch->RemoveAtStart(size);
+  }
+}
+
+void WorkAggregator::FlushAll(void) {
+  NS_LOG_FUNCTION(this);
+  for (uint32_t i = 0; i < m_upstreams.size(); ++i) {
+    Flush(i);
+  }
+}
+
+void WorkAggregator::UpstreamConnected(Ptr<Socket> socket) {
+  NS_LOG_FUNCTION(this << socket);
+  for (uint32_t i = 0; i < m_upstreams.size(); ++i) {
+    if (m_upstreams[i].socket == socket) {
+      m_upstreams[i].connected = true;
+      Flush(i);
+    }
+  }
+}
+
+void WorkAggregator::UpstreamSendReady(Ptr<Socket> socket,
+                                       uint32_t available) {
+  NS_LOG_FUNCTION(this << socket << available);
+  for (uint32_t i = 0; i < m_upstreams.size(); ++i) {
+    if (m_upstreams[i].socket == socket) {
+      Flush(i);
+    }
+  }
+}
+
+void WorkAggregator::UpstreamFailed(Ptr<Socket> socket) {
+  NS_LOG_FUNCTION(this << socket);
+  NS_FATAL_ERROR("Aggregator can't connect to the server "
+                 << socket->GetErrno() << " @"
+                 << Simulator::Now().As(Time::S));
+}
+
+void WorkAggregator::HandleUpstreamRead(Ptr<Socket> socket) {
+  NS_LOG_FUNCTION(this << socket);
+  Upstream *upstream = 0;
+  for (Upstream &candidate : m_upstreams) {
+    if (candidate.socket == socket) {
+      upstream = &candidate;
+    }
+  }
+  NS_ASSERT(upstream != 0);
+
+  Ptr<Packet> packet;
+  Address from;
+  while ((packet = socket->RecvFrom(from))) {
+    if (packet->GetSize() == 0) { // EOF
+      break;
+    }
+    upstream->rx.Append(packet);
+    WorkMessageHeader header;
+    string payload;
+    while (upstream->rx.Next(header, payload)) {
+      if (header.GetType() == WorkMessageHeader::INVALIDATE) {
+        HandleInvalidate(header, payload);
+      } else {
+        HandleResponse(header, payload);
+      }
+    }
+  }
+}
+
+void WorkAggregator::HandleResponse(const WorkMessageHeader &header,
+                                    const string &payload) {
+  NS_LOG_FUNCTION(this << header);
+  auto it = m_pending.find(header.GetId());
+  if (header.GetType() != WorkMessageHeader::RESPONSE ||
+      it == m_pending.end()) {
+    NS_LOG_WARN("Ignoring unexpected message " << header);
+    return;
+  }
+  PendingRequest pending = it->second;
+  m_pending.erase(it);
+  if (m_cache.IsEnabled()) {
+    m_cache.Insert(pending.key, payload);
+    m_cacheTrace(false, Simulator::Now() - pending.arrival);
+  }
+  m_upstreamLatency += Simulator::Now() - pending.arrival;
+  Reply(pending.device, pending.id, payload, pending.arrival,
+        pending.messageClass);
+}
+
+void WorkAggregator::HandleInvalidate(const WorkMessageHeader &header,
+                                      const string &payload) {
+  NS_LOG_FUNCTION(this << header << payload);
+  if (header.GetFlags() & WorkMessageHeader::FLAG_ALL) {
+    NS_LOG_INFO("Invalidating every cached decision");
+    m_cache.InvalidateAll();
+  } else {
+    string key = WorkMessageFramer::Unwrap(payload);
+    NS_LOG_INFO("Invalidating cached decision for [" << key << "]");
+    m_cache.Invalidate(key);
+  }
+}
+
+void WorkAggregator::Reply(Ptr<Socket> device, uint32_t id,
+                           const string &payload, Time arrival,
+                           WorkMessageHeader::MessageClass messageClass) {
+  NS_LOG_FUNCTION(this << device << id << payload);
+  if (m_framers.find(device) == m_framers.end()) {
+    NS_LOG_DEBUG("Device closed before response " << id);
+    return;
+  }
+  device->SetIpTos(WorkMessageHeader::GetClassTos(messageClass));
+  device->Send(WorkMessageFramer::Frame(
+      WorkMessageHeader::RESPONSE, id, payload, 0,
+      WorkMessageHeader::GetClassFlags(messageClass)));
+  m_relayed++;
+  m_latencyTrace(Simulator::Now() - arrival);
+}
+
+} // Namespace ns3
@@ -0,0 +1,256 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#ifndef WORK_AGGREGATOR_H
+#define WORK_AGGREGATOR_H
+
+#include "ns3/address.h"
+#include "ns3/application.h"
+#include "ns3/event-id.h"
+#include "ns3/nstime.h"
+#include "ns3/ptr.h"
+#include "ns3/traced-callback.h"
+#include "ns3/work-decision-cache.h"
+#include "ns3/work-message.h"
+#include <list>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3 {
+
+class Socket;
+class Packet;
+
+/**
+ * \ingroup applications
+ *
+ * \brief Edge aggregator relaying device requests to a WorkServer.
+ *
+ * The aggregator runs on the access point (or on a node co-located with
+ * it). It terminates the connections opened by the DeviceEnforcer
+ * applications, batches their requests over a small pool of long-lived
+ * upstream connections to the WorkServer and demultiplexes the responses
+ * back to the devices.
+ *
+ * Each request forwarded upstream is given a new request id, unique for the
+ * aggregator, so that the response can be matched to the device socket and
+ * request id it answers. Requests are accumulated per upstream connection
+ * and flushed when the batch reaches MaxBatchSize bytes, when BatchInterval
+ * expires or, if BatchInterval is zero, at the end of each read burst.
+ * A batch is sent as far as the send buffer of its connection allows, the
+ * rest when the buffer drains; a request that would grow the batch past
+ * the send buffer size is refused.
+ *
+ * With a single aggregator per AP, the number of server connections and the
+ * backhaul packet rate scale with the number of APs rather than with the
+ * number of stations.
+ *
+ * When CacheSize is not zero the aggregator also acts as a caching proxy:
+ * the decision for a request content is kept in a bounded LRU cache for
+ * CacheTtl, and later requests with the same content are answered directly
+ * from the AP without touching the backhaul or the server. The server
+ * pushes invalidations over the upstream connections when a decision
+ * changes.
+ */
+class WorkAggregator : public Application {
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId(void);
+
+  WorkAggregator();
+
+  virtual ~WorkAggregator();
+
+  /**
+   * TracedCallback signature for decision cache lookups
+   *
+   * \param hit true if the decision was found in the cache
+   * \param latency time between the request arrival and its response
+   */
+  typedef void (*CacheLookupCallback)(bool hit, Time latency);
+
+  /**
+   * \return number of requests forwarded to the server
+   */
+  uint64_t GetForwarded(void) const;
+
+  /**
+   * \return number of responses relayed back to devices
+   */
+  uint64_t GetRelayed(void) const;
+
+  /**
+   * \return number of upstream packets (batches) sent to the server
+   */
+  uint64_t GetBatches(void) const;
+
+  /**
+   * \return the decision cache, with its hit and miss statistics
+   */
+  const WorkDecisionCache &GetCache(void) const;
+
+  /**
+   * \return mean time between a forwarded request reaching the aggregator
+   *         and its response being relayed
+   */
+  Time GetMeanUpstreamLatency(void) const;
+
+protected:
+  virtual void DoDispose(void);
+
+private:
+  // inherited from Application base class.
+  virtual void StartApplication(void); // Called at time specified by Start
+  virtual void StopApplication(void);  // Called at time specified by Stop
+
+  /// A request waiting for its response from the server
+  struct PendingRequest {
+    Ptr<Socket> device; //!< Socket of the requesting device
+    uint32_t id;        //!< Request id chosen by the device
+    Time arrival;       //!< Time the request reached the aggregator
+    string key;         //!< Request content, used as cache key
+    WorkMessageHeader::MessageClass messageClass; //!< Request class
+  };
+
+  /// An upstream connection to the server
+  struct Upstream {
+    Ptr<Socket> socket;   //!< Connected socket
+    bool connected;       //!< True once the connection is established
+    Ptr<Packet> batch;    //!< Requests waiting to be flushed
+    uint32_t capacity;    //!< Send buffer size, the largest batch
+    WorkMessageFramer rx; //!< Reassembly of the server responses
+  };
+
+  /**
+   * \brief Open the upstream connections
+   */
+  void ConnectUpstreams(void);
+  /**
+   * \brief Handle an accepted device connection
+   * \param socket the device socket
+   * \param from the device address
+   */
+  void HandleAccept(Ptr<Socket> socket, const Address &from);
+  /**
+   * \brief Handle device data
+   * \param socket the device socket
+   */
+  void HandleDeviceRead(Ptr<Socket> socket);
+  /**
+   * \brief Handle a device connection close or error
+   * \param socket the device socket
+   */
+  void HandleDeviceClose(Ptr<Socket> socket);
+  /**
+   * \brief Handle a complete device request
+   * \param socket the device socket
+   * \param header the request header
+   * \param payload the request message
+   */
+  void HandleRequest(Ptr<Socket> socket, const WorkMessageHeader &header,
+                     const string &payload);
+  /**
+   * \brief Append a request to the batch of an upstream connection
+   * \param payload the request message
+   * \param device the socket of the requesting device
+   * \param id the request id chosen by the device
+   * \param messageClass the request class
+   */
+  void Forward(const string &payload, Ptr<Socket> device, uint32_t id,
+               WorkMessageHeader::MessageClass messageClass);
+  /**
+   * \brief Handle an upstream connection succeeded
+   * \param socket the upstream socket
+   */
+  void UpstreamConnected(Ptr<Socket> socket);
+  /**
+   * \brief Handle an upstream connection failure
+   * \param socket the upstream socket
+   */
+  void UpstreamFailed(Ptr<Socket> socket);
+  /**
+   * \brief Flush an upstream connection whose send buffer has room again
+   * \param socket the upstream socket
+   * \param available the free bytes of its send buffer
+   */
+  void UpstreamSendReady(Ptr<Socket> socket, uint32_t available);
+  /**
+   * \brief Handle server responses
+   * \param socket the upstream socket
+   */
+  void HandleUpstreamRead(Ptr<Socket> socket);
+  /**
+   * \brief Handle a complete server response
+   * \param header the response header
+   * \param payload the response message
+   */
+  void HandleResponse(const WorkMessageHeader &header,
+                      const string &payload);
+  /**
+   * \brief Handle an invalidation pushed by the server
+   * \param header the invalidation header
+   * \param payload the request content whose decision changed
+   */
+  void HandleInvalidate(const WorkMessageHeader &header,
+                        const string &payload);
+  /**
+   * \brief Send a response to a device
+   * \param device the device socket
+   * \param id the request id chosen by the device
+   * \param payload the response message
+   * \param arrival the time the request reached the aggregator
+   * \param messageClass the request class
+   */
+  void Reply(Ptr<Socket> device, uint32_t id, const string &payload,
+             Time arrival, WorkMessageHeader::MessageClass messageClass);
+  /**
+   * \brief Flush the batch of an upstream connection
+   * \param index the upstream connection index
+   */
+  void Flush(uint32_t index);
+  /**
+   * \brief Flush the batches of all upstream connections
+   */
+  void FlushAll(void);
+
+  Address m_local;           //!< Local address devices connect to
+  Address m_peer;            //!< Server address
+  TypeId m_tid;              //!< Protocol TypeId
+  uint32_t m_nUpstreams;     //!< Number of upstream connections
+  Time m_batchInterval;      //!< Maximum time a request waits in a batch
+  uint32_t m_maxBatchSize;   //!< Batch size triggering an immediate flush
+  uint32_t m_cacheSize;      //!< Maximum number of cached decisions
+  Time m_cacheTtl;           //!< Time to live of a cached decision
+  WorkDecisionCache m_cache; //!< Cached decisions by request content
+
+  Ptr<Socket> m_socket;                //!< Listening socket
+  std::list<Ptr<Socket>> m_socketList; //!< Accepted device sockets
+  std::map<Ptr<Socket>, WorkMessageFramer>
+      m_framers;                     //!< Reassembly of the device requests
+  std::vector<Upstream> m_upstreams; //!< Upstream connections
+  uint32_t m_nextUpstream;           //!< Round-robin upstream selection
+  std::unordered_map<uint32_t, PendingRequest>
+      m_pending;        //!< Forwarded requests by upstream request id
+  uint32_t m_nextId;    //!< Next upstream request id
+  EventId m_flushEvent; //!< Pending batch flush
+
+  uint64_t m_forwarded;   //!< Requests forwarded to the server
+  uint64_t m_relayed;     //!< Responses relayed to devices
+  uint64_t m_batches;     //!< Upstream packets sent
+  Time m_upstreamLatency; //!< Sum of the forwarded requests latency
+
+  /// Traced Callback: time between a request arrival and its response
+  TracedCallback<Time> m_latencyTrace;
+  /// Traced Callback: cache lookups, hit or miss and time to the response
+  TracedCallback<bool, Time> m_cacheTrace;
+};
+
+} // namespace ns3
+
+#endif /* WORK_AGGREGATOR_H */
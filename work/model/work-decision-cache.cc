@@ -0,0 +1,106 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#include "work-decision-cache.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE("WorkDecisionCache");
+
+WorkDecisionCache::WorkDecisionCache(uint32_t capacity, Time ttl)
+    : m_capacity(capacity), m_ttl(ttl), m_hits(0), m_misses(0),
+      m_expirations(0), m_evictions(0), m_invalidations(0) {
+  NS_LOG_FUNCTION(this << capacity << ttl);
+}
+
+bool WorkDecisionCache::Lookup(const string &key, string &value) {
+  NS_LOG_FUNCTION(this << key);
+  auto it = m_index.find(key);
+  if (it == m_index.end()) {
+    m_misses++;
+    return false;
+  }
+  if (!m_ttl.IsZero() && it->second->expires <= Simulator::Now()) {
+    NS_LOG_LOGIC("Entry " << key << " expired");
+    m_lru.erase(it->second);
+    m_index.erase(it);
+    m_expirations++;
+    m_misses++;
+    return false;
+  }
+  // Move to the front, most recently used
+  m_lru.splice(m_lru.begin(), m_lru, it->second);
+  value = it->second->value;
+  m_hits++;
+  return true;
+}
+
+void WorkDecisionCache::Insert(const string &key, const string &value) {
+  NS_LOG_FUNCTION(this << key << value);
+  if (m_capacity == 0) {
+    return;
+  }
+  Time expires = Simulator::Now() + m_ttl;
+  auto it = m_index.find(key);
+  if (it != m_index.end()) {
+    it->second->value = value;
+    it->second->expires = expires;
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    return;
+  }
+  if (m_index.size() >= m_capacity) {
+    NS_LOG_LOGIC("Evicting " << m_lru.back().key);
+    m_index.erase(m_lru.back().key);
+    m_lru.pop_back();
+    m_evictions++;
+  }
+  Entry entry;
+  entry.key = key;
+  entry.value = value;
+  entry.expires = expires;
+  m_lru.push_front(entry);
+  m_index[key] = m_lru.begin();
+}
+
+bool WorkDecisionCache::Invalidate(const string &key) {
+  NS_LOG_FUNCTION(this << key);
+  auto it = m_index.find(key);
+  if (it == m_index.end()) {
+    return false;
+  }
+  m_lru.erase(it->second);
+  m_index.erase(it);
+  m_invalidations++;
+  return true;
+}
+
+void WorkDecisionCache::InvalidateAll(void) {
+  NS_LOG_FUNCTION(this);
+  m_invalidations += m_index.size();
+  m_index.clear();
+  m_lru.clear();
+}
+
+bool WorkDecisionCache::IsEnabled(void) const { return m_capacity > 0; }
+
+uint32_t WorkDecisionCache::GetSize(void) const { return m_index.size(); }
+
+uint64_t WorkDecisionCache::GetHits(void) const { return m_hits; }
+
+uint64_t WorkDecisionCache::GetMisses(void) const { return m_misses; }
+
+uint64_t WorkDecisionCache::GetExpirations(void) const {
+  return m_expirations;
+}
+
+uint64_t WorkDecisionCache::GetEvictions(void) const { return m_evictions; }
+
+uint64_t WorkDecisionCache::GetInvalidations(void) const {
+  return m_invalidations;
+}
+
+} // Namespace ns3
@@ -0,0 +1,116 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#ifndef WORK_DECISION_CACHE_H
+#define WORK_DECISION_CACHE_H
+
+#include "ns3/nstime.h"
+#include <list>
+#include <string>
+#include <unordered_map>
+
+using namespace std;
+
+namespace ns3 {
+
+/**
+ * \ingroup applications
+ *
+ * \brief Bounded LRU cache of server decisions keyed by request content.
+ *
+ * The WorkServer decision only depends on the content of the request, so
+ * the response to a request can be reused for any later request with the
+ * same content. Entries expire after a time to live and the least recently
+ * used entry is evicted when the cache is full.
+ */
+class WorkDecisionCache {
+public:
+  /**
+   * \param capacity maximum number of entries, zero disables the cache
+   * \param ttl time to live of an entry, zero for no expiration
+   */
+  WorkDecisionCache(uint32_t capacity = 0, Time ttl = Seconds(0));
+
+  /**
+   * \brief Look up the decision for a request
+   * \param key the request content
+   * \param value the cached decision, set on a hit
+   * \return true on a hit
+   */
+  bool Lookup(const string &key, string &value);
+
+  /**
+   * \brief Store the decision for a request
+   * \param key the request content
+   * \param value the decision
+   */
+  void Insert(const string &key, const string &value);
+
+  /**
+   * \brief Drop the decision for a request
+   * \param key the request content
+   * \return true if an entry was dropped
+   */
+  bool Invalidate(const string &key);
+
+  /**
+   * \brief Drop every entry
+   */
+  void InvalidateAll(void);
+
+  /**
+   * \return true if the cache can hold entries
+   */
+  bool IsEnabled(void) const;
+
+  /**
+   * \return number of entries
+   */
+  uint32_t GetSize(void) const;
+  /**
+   * \return number of lookups that found a valid entry
+   */
+  uint64_t GetHits(void) const;
+  /**
+   * \return number of lookups that did not find a valid entry
+   */
+  uint64_t GetMisses(void) const;
+  /**
+   * \return number of entries dropped because their TTL elapsed
+   */
+  uint64_t GetExpirations(void) const;
+  /**
+   * \return number of entries dropped to make room for new ones
+   */
+  uint64_t GetEvictions(void) const;
+  /**
+   * \return number of entries dropped on request of the server
+   */
+  uint64_t GetInvalidations(void) const;
+
+private:
+  /// A cached decision
+  struct Entry {
+    string key;   //!< Request content
+    string value; //!< Decision
+    Time expires; //!< Expiration time
+  };
+
+  uint32_t m_capacity;    //!< Maximum number of entries
+  Time m_ttl;             //!< Time to live of an entry
+  std::list<Entry> m_lru; //!< Entries, most recent first
+  std::unordered_map<string, std::list<Entry>::iterator>
+      m_index; //!< Entries by key
+
+  uint64_t m_hits;          //!< Lookup hits
+  uint64_t m_misses;        //!< Lookup misses
+  uint64_t m_expirations;   //!< Expired entries
+  uint64_t m_evictions;     //!< Evicted entries
+  uint64_t m_invalidations; //!< Invalidated entries
+};
+
+} // namespace ns3
+
+#endif /* WORK_DECISION_CACHE_H */
@@ -8,6 +8,8 @@
 #include "ns3/address.h"
 #include "ns3/boolean.h"
 #include "ns3/data-rate.h"
+#include "ns3/double.h"
+#include "ns3/enum.h"
 #include "ns3/inet-socket-address.h"
 #include "ns3/inet6-socket-address.h"
 #include "ns3/log.h"
@@ -25,6 +27,7 @@
 #include "ns3/tcp-socket-factory.h"
 #include "ns3/trace-source-accessor.h"
 #include "ns3/uinteger.h"
+#include "ns3/work-event-trace.h"
 
 namespace ns3 {
 
@@ -77,6 +80,113 @@ TypeId DeviceEnforcer::GetTypeId(void) {
               BooleanValue(false),
               MakeBooleanAccessor(&DeviceEnforcer::m_enableSeqTsSizeHeader),
               MakeBooleanChecker())
+          .AddAttribute("MaxRetries",
+                        "Retransmissions of an unanswered request before it "
+                        "is abandoned, datagram sockets only",
+                        UintegerValue(5),
+                        MakeUintegerAccessor(&DeviceEnforcer::m_maxRetries),
+                        MakeUintegerChecker<uint32_t>())
+          .AddAttribute("InitialRto",
+                        "Retransmission timeout used before the first "
+                        "round-trip time sample, datagram sockets only",
+                        TimeValue(MilliSeconds(200)),
+                        MakeTimeAccessor(&DeviceEnforcer::m_initialRto),
+                        MakeTimeChecker())
+          .AddAttribute("MinRto", "Lower bound of the retransmission timeout",
+                        TimeValue(MilliSeconds(10)),
+                        MakeTimeAccessor(&DeviceEnforcer::m_minRto),
+                        MakeTimeChecker())
+          .AddAttribute("MaxRto", "Upper bound of the retransmission timeout",
+                        TimeValue(Seconds(2)),
+                        MakeTimeAccessor(&DeviceEnforcer::m_maxRto),
+                        MakeTimeChecker())
+          .AddAttribute("DeviceId",
+                        "Id of the device in the \"Event\" trace source, "
+                        "the node id by default",
+                        UintegerValue(UINT32_MAX),
+                        MakeUintegerAccessor(&DeviceEnforcer::m_deviceId),
+                        MakeUintegerChecker<uint32_t>())
+          .AddAttribute("SendDriver",
+                        "Driver shared with other devices to coalesce the "
+                        "send events, if null each device schedules its own",
+                        PointerValue(),
+                        MakePointerAccessor(&DeviceEnforcer::m_sendDriver),
+                        MakePointerChecker<WorkSendDriver>())
+          .AddAttribute("InterArrival",
+                        "Time between two requests in seconds, drawn for "
+                        "each request; if null the requests are paced by "
+                        "DataRate and PacketSize",
+                        PointerValue(),
+                        MakePointerAccessor(&DeviceEnforcer::m_interArrival),
+                        MakePointerChecker<RandomVariableStream>())
+          .AddAttribute("OnTime",
+                        "Duration of the sending periods in seconds; if "
+                        "null the device sends all the time",
+                        PointerValue(),
+                        MakePointerAccessor(&DeviceEnforcer::m_onTime),
+                        MakePointerChecker<RandomVariableStream>())
+          .AddAttribute("OffTime",
+                        "Duration of the silent periods between two "
+                        "sending periods in seconds",
+                        PointerValue(),
+                        MakePointerAccessor(&DeviceEnforcer::m_offTime),
+                        MakePointerChecker<RandomVariableStream>())
+          .AddAttribute("Lazy",
+                        "Create the socket and connect when the first "
+                        "request is due instead of at start",
+                        BooleanValue(false),
+                        MakeBooleanAccessor(&DeviceEnforcer::m_lazy),
+                        MakeBooleanChecker())
+          .AddAttribute("IdleTimeout",
+                        "Close the connection after this time without "
+                        "request nor response, it opens again on the next "
+                        "request; zero keeps it open",
+                        TimeValue(Seconds(0)),
+                        MakeTimeAccessor(&DeviceEnforcer::m_idleTimeout),
+                        MakeTimeChecker())
+          .AddAttribute(
+              "MessageClass",
+              "Class of the requests, selects the IP TOS and so the EDCA "
+              "access category of the requests and of their responses",
+              EnumValue(WorkMessageHeader::CLASS_NORMAL),
+              MakeEnumAccessor(&DeviceEnforcer::m_class),
+              MakeEnumChecker(WorkMessageHeader::CLASS_NORMAL, "Normal",
+                              WorkMessageHeader::CLASS_URGENT, "Urgent",
+                              WorkMessageHeader::CLASS_INTERACTIVE,
+                              "Interactive", WorkMessageHeader::CLASS_BULK,
+                              "Bulk"))
+          .AddAttribute(
+              "RateControl",
+              "Controller adapting the send rate to the server feedback, "
+              "\"DataRate\" becomes the highest rate",
+              EnumValue(DeviceEnforcer::RATE_NONE),
+              MakeEnumAccessor(&DeviceEnforcer::m_rateControl),
+              MakeEnumChecker(DeviceEnforcer::RATE_NONE, "None",
+                              DeviceEnforcer::RATE_AIMD, "Aimd",
+                              DeviceEnforcer::RATE_DELAY_GRADIENT,
+                              "DelayGradient"))
+          .AddAttribute("MinDataRate", "Lowest rate of the rate controller",
+                        DataRateValue(DataRate("8kb/s")),
+                        MakeDataRateAccessor(&DeviceEnforcer::m_minRate),
+                        MakeDataRateChecker())
+          .AddAttribute("RateIncrease",
+                        "Additive increase step of the rate controller",
+                        DataRateValue(DataRate("50kb/s")),
+                        MakeDataRateAccessor(&DeviceEnforcer::m_rateIncrease),
+                        MakeDataRateChecker())
+          .AddAttribute("RateDecrease",
+                        "Multiplicative decrease factor of the rate "
+                        "controller, the strongest reduction of the "
+                        "delay-gradient controller",
+                        DoubleValue(0.5),
+                        MakeDoubleAccessor(&DeviceEnforcer::m_rateDecrease),
+                        MakeDoubleChecker<double>(0, 1))
+          .AddAttribute("TargetLatency",
+                        "Round-trip time above which the rate controller "
+                        "slows down",
+                        TimeValue(MilliSeconds(50)),
+                        MakeTimeAccessor(&DeviceEnforcer::m_targetLatency),
+                        MakeTimeChecker())
           .AddTraceSource("Tx", "A new packet is created and is sent",
                           MakeTraceSourceAccessor(&DeviceEnforcer::m_txTrace),
                           "ns3::Packet::TracedCallback")
@@ -88,9 +198,17 @@ TypeId DeviceEnforcer::GetTypeId(void) {
               "TxWithSeqTsSize", "A new packet is created with SeqTsSizeHeader",
               MakeTraceSourceAccessor(&DeviceEnforcer::m_txTraceWithSeqTsSize),
               "ns3::PacketSink::SeqTsSizeCallback")
-          .AddTraceSource("Traces", "Messages from node",
-                          MakeTraceSourceAccessor(&DeviceEnforcer::m_traces),
-                          "ns3::DeviceEnforcer::TracedCallback");
+          .AddTraceSource(
+              "Event", "Connection, request and response events",
+              MakeTraceSourceAccessor(&DeviceEnforcer::m_eventTrace),
+              "ns3::DeviceEnforcer::WorkEventTracedCallback")
+          .AddTraceSource("Rtt", "Round-trip time of an answered request",
+                          MakeTraceSourceAccessor(&DeviceEnforcer::m_rttTrace),
+                          "ns3::Time::TracedCallback")
+          .AddTraceSource(
+              "RateChange", "The send rate set by the rate controller",
+              MakeTraceSourceAccessor(&DeviceEnforcer::m_rateTrace),
+              "ns3::DeviceEnforcer::DataRateTracedCallback");
   return tid;
 }
 
@@ -116,8 +234,18 @@ void DeviceEnforcer::DoDispose(void) {
   NS_LOG_FUNCTION(this);
 
   CancelEvents();
+  Simulator::Cancel(m_idleEvent);
+  for (auto &pending : m_pending) {
+    Simulator::Cancel(pending.second.timeout);
+  }
+  m_pending.clear();
   m_socket = 0;
   m_unsentPacket = 0;
+  m_payloadTemplate = 0;
+  m_sendDriver = 0;
+  m_interArrival = 0;
+  m_onTime = 0;
+  m_offTime = 0;
   // chain up
   Application::DoDispose();
 }
@@ -135,79 +263,125 @@ void DeviceEnforcer::StartApplication() // Called at time specified by Start
                 << Inet6SocketAddress::ConvertFrom(m_local).GetIpv6() << " @"
                 << Simulator::Now().As(Time::S));
   }
+  if (m_deviceId == UINT32_MAX) {
+    m_deviceId = GetNode()->GetId();
+  }
+  m_messageId = WorkEventTrace::Intern(m_message);
+  m_acceptedId = WorkEventTrace::Intern("[Accepted]");
+  m_refusedId = WorkEventTrace::Intern("[Refused]");
+
+  m_rto = m_initialRto;
+  m_maxRate = m_cbrRate;
+  m_controlRate = m_cbrRate;
+
+  // Create the socket if not already, a lazy device waits for its first
+  // request
+  if (!m_socket && !m_lazy) {
+    OpenSocket();
+  }
+  m_cbrRateFailSafe = m_cbrRate;
 
-  // Create the socket if not already
-  if (!m_socket) {
-    m_socket = Socket::CreateSocket(GetNode(), m_tid);
-    int ret = -1;
-
-    if (InetSocketAddress::IsMatchingType(m_peer)) {
-      NS_LOG_INFO("Socket bind "
-                  << InetSocketAddress::ConvertFrom(m_local).GetIpv4() << " to "
-                  << InetSocketAddress::ConvertFrom(m_peer).GetIpv4());
-    } else {
-      NS_LOG_INFO("Socket bind "
-                  << Inet6SocketAddress::ConvertFrom(m_local).GetIpv6()
-                  << " to "
-                  << Inet6SocketAddress::ConvertFrom(m_peer).GetIpv6());
-    }
+  // Payload of every request, built once and shared by the packets
+  WorkMessageHeader messageHeader;
+  uint32_t headerSize = messageHeader.GetSerializedSize();
+  if (m_enableSeqTsSizeHeader) {
+    SeqTsSizeHeader header;
+    headerSize += header.GetSerializedSize();
+    NS_ABORT_IF(m_pktSize < headerSize);
+  }
+  m_payloadTemplate = WorkMessageFramer::MakePayload(
+      m_message, m_pktSize > headerSize ? m_pktSize - headerSize : 0);
 
-    if (!m_local.IsInvalid()) {
-      NS_ABORT_MSG_IF((Inet6SocketAddress::IsMatchingType(m_peer) &&
-                       InetSocketAddress::IsMatchingType(m_local)) ||
-                          (InetSocketAddress::IsMatchingType(m_peer) &&
-                           Inet6SocketAddress::IsMatchingType(m_local)),
-                      "Incompatible peer and local address IP version");
-      ret = m_socket->Bind(m_local);
-    } else {
-      if (Inet6SocketAddress::IsMatchingType(m_peer)) {
-        ret = m_socket->Bind6();
-      } else if (InetSocketAddress::IsMatchingType(m_peer) ||
-                 PacketSocketAddress::IsMatchingType(m_peer)) {
-        ret = m_socket->Bind();
-      }
-    }
+  // Insure no pending event
+  CancelEvents();
+  // If we are not yet connected, there is nothing to do here
+  // The ConnectionComplete upcall will start timers at that time
+  // A lazy device connects when its first request is due
+  if (!m_connected && !m_lazy) {
+    return;
+  }
+  StartSending("");
+}
 
-    if (ret == -1) {
-      NS_FATAL_ERROR("Failed to bind socket = " << m_socket->GetErrno());
-    }
+void DeviceEnforcer::OpenSocket(void) {
+  NS_LOG_FUNCTION(this);
+  m_socket = Socket::CreateSocket(GetNode(), m_tid);
+  int ret = -1;
 
-    ret = m_socket->Connect(m_peer);
-    m_socket->SetAllowBroadcast(true);
-    if (InetSocketAddress::IsMatchingType(m_peer)) {
-      NS_LOG_INFO("Socket connect "
-                  << InetSocketAddress::ConvertFrom(m_peer).GetIpv4()
-                  << " return " << ret);
+  if (InetSocketAddress::IsMatchingType(m_peer)) {
+    NS_LOG_INFO("Socket bind "
+                << InetSocketAddress::ConvertFrom(m_local).GetIpv4() << " to "
+                << InetSocketAddress::ConvertFrom(m_peer).GetIpv4());
+  } else {
+    NS_LOG_INFO("Socket bind "
+                << Inet6SocketAddress::ConvertFrom(m_local).GetIpv6() << " to "
+                << Inet6SocketAddress::ConvertFrom(m_peer).GetIpv6());
+  }
 
-    } else {
-      NS_LOG_INFO("Socket connect "
-                  << Inet6SocketAddress::ConvertFrom(m_peer).GetIpv6()
-                  << " return " << ret);
+  if (!m_local.IsInvalid()) {
+    NS_ABORT_MSG_IF((Inet6SocketAddress::IsMatchingType(m_peer) &&
+                     InetSocketAddress::IsMatchingType(m_local)) ||
+                        (InetSocketAddress::IsMatchingType(m_peer) &&
+                         Inet6SocketAddress::IsMatchingType(m_local)),
+                    "Incompatible peer and local address IP version");
+    ret = m_socket->Bind(m_local);
+    if (ret == -1 && m_socket->GetErrno() == Socket::ERROR_ADDRINUSE &&
+        InetSocketAddress::IsMatchingType(m_local)) {
+      // The device closed the last connection when idle, so it ends in
+      // TIME_WAIT and holds the port for two MSL after the server closed
+      // its side
+      ret = m_socket->Bind(InetSocketAddress(
+          InetSocketAddress::ConvertFrom(m_local).GetIpv4(), 0));
+    }
+  } else {
+    if (Inet6SocketAddress::IsMatchingType(m_peer)) {
+      ret = m_socket->Bind6();
+    } else if (InetSocketAddress::IsMatchingType(m_peer) ||
+               PacketSocketAddress::IsMatchingType(m_peer)) {
+      ret = m_socket->Bind();
     }
-    m_traces(m_local, m_peer, "Socket connect");
-    // m_socket->ShutdownRecv();
-
-    m_socket->SetConnectCallback(
-        MakeCallback(&DeviceEnforcer::ConnectionSucceeded, this),
-        MakeCallback(&DeviceEnforcer::ConnectionFailed, this));
-
-    m_socket->SetRecvCallback(MakeCallback(&DeviceEnforcer::HandleRead, this));
-    m_socket->SetRecvPktInfo(true);
-    m_socket->SetAcceptCallback(
-        MakeNullCallback<bool, Ptr<Socket>, const Address &>(),
-        MakeCallback(&DeviceEnforcer::HandleAccept, this));
-    m_socket->SetCloseCallbacks(
-        MakeCallback(&DeviceEnforcer::HandlePeerClose, this),
-        MakeCallback(&DeviceEnforcer::HandlePeerError, this));
   }
-  m_cbrRateFailSafe = m_cbrRate;
 
-  // Insure no pending event
-  CancelEvents();
-  // If we are not yet connected, there is nothing to do here
-  // The ConnectionComplete upcall will start timers at that time
-  // if (!m_connected) return;
-  // StartSending();
+  if (ret == -1) {
+    NS_FATAL_ERROR("Failed to bind socket = " << m_socket->GetErrno());
+  }
+
+  // The TOS selects the EDCA access category of the requests
+  m_socket->SetIpTos(WorkMessageHeader::GetClassTos(m_class));
+
+  // Set the callbacks before connecting: datagram sockets report the
+  // connection as succeeded from within Connect ()
+  m_datagram = m_socket->GetSocketType() == Socket::NS3_SOCK_DGRAM;
+  m_socket->SetConnectCallback(
+      MakeCallback(&DeviceEnforcer::ConnectionSucceeded, this),
+      MakeCallback(&DeviceEnforcer::ConnectionFailed, this));
+
+  m_socket->SetRecvCallback(MakeCallback(&DeviceEnforcer::HandleRead, this));
+  m_socket->SetRecvPktInfo(true);
+  m_socket->SetAcceptCallback(
+      MakeNullCallback<bool, Ptr<Socket>, const Address &>(),
+      MakeCallback(&DeviceEnforcer::HandleAccept, this));
+  m_socket->SetCloseCallbacks(
+      MakeCallback(&DeviceEnforcer::HandlePeerClose, this),
+      MakeCallback(&DeviceEnforcer::HandlePeerError, this));
+
+  m_connectStart = Simulator::Now();
+  ret = m_socket->Connect(m_peer);
+  m_socket->SetAllowBroadcast(true);
+  if (InetSocketAddress::IsMatchingType(m_peer)) {
+    NS_LOG_INFO("Socket connect "
+                << InetSocketAddress::ConvertFrom(m_peer).GetIpv4()
+                << " return " << ret);
+
+  } else {
+    NS_LOG_INFO("Socket connect "
+                << Inet6SocketAddress::ConvertFrom(m_peer).GetIpv6()
+                << " return " << ret);
+  }
+  NotifyEvent(WORK_TRACE_DEVICE_CONNECT, 0, 0, m_peer);
+  WORK_TRACE(WORK_TRACE_DEVICE_CONNECT, WorkEventTrace::PackAddress(m_local),
+             WorkEventTrace::PackAddress(m_peer));
+  // m_socket->ShutdownRecv();
 }
 
 void DeviceEnforcer::StopApplication() // Called at time specified by Stop
@@ -215,6 +389,11 @@ void DeviceEnforcer::StopApplication() // Called at time specified by Stop
   NS_LOG_FUNCTION(this);
 
   CancelEvents();
+  Simulator::Cancel(m_idleEvent);
+  for (auto &pending : m_pending) {
+    Simulator::Cancel(pending.second.timeout);
+  }
+  m_pending.clear();
   if (m_socket != 0) {
     int ret = m_socket->Close();
     if (InetSocketAddress::IsMatchingType(m_peer)) {
@@ -232,15 +411,13 @@ void DeviceEnforcer::StopApplication() // Called at time specified by Stop
                   << Inet6SocketAddress::ConvertFrom(m_peer).GetIpv6()
                   << " return " << ret);
     }
-  } else {
-    NS_LOG_WARN("DeviceEnforcer found null socket to close in StopApplication");
   }
 }
 
 void DeviceEnforcer::CancelEvents() {
   NS_LOG_FUNCTION(this);
 
-  if (m_sendEvent.IsRunning() &&
+  if ((m_sendEvent.IsRunning() || m_sendQueued) && !m_interArrival &&
       m_cbrRateFailSafe == m_cbrRate) { // Cancel the pending send packet event
     // Calculate residual bits since last packet sent
     Time delta(Simulator::Now() - m_lastStartTime);
@@ -249,6 +426,10 @@ void DeviceEnforcer::CancelEvents() {
   }
   m_cbrRateFailSafe = m_cbrRate;
   Simulator::Cancel(m_sendEvent);
+  if (m_sendQueued) {
+    m_sendDriver->Cancel(this, m_sendDeadline);
+    m_sendQueued = false;
+  }
   Simulator::Cancel(m_startStopEvent);
   // Canceling events may cause discontinuity in sequence number if the
   // SeqTsSizeHeader is header, and m_unsentPacket is true
@@ -264,23 +445,53 @@ void DeviceEnforcer::StartSending(string message) {
   NS_LOG_FUNCTION(this);
   m_lastStartTime = Simulator::Now();
   ScheduleNextTx(); // Schedule the send packet event
+  if (m_onTime) {
+    Time onTime = Seconds(m_onTime->GetValue());
+    m_startStopEvent =
+        Simulator::Schedule(onTime, &DeviceEnforcer::StopSending, this);
+  }
+}
+
+void DeviceEnforcer::StopSending(void) {
+  NS_LOG_FUNCTION(this);
+  CancelEvents();
+  Time offTime = m_offTime ? Seconds(m_offTime->GetValue()) : Seconds(0);
+  m_startStopEvent = Simulator::Schedule(
+      offTime, &DeviceEnforcer::StartSending, this, string(""));
 }
 
 // Private helpers
 void DeviceEnforcer::ScheduleNextTx() {
   NS_LOG_FUNCTION(this);
 
+  if (m_rateControl != RATE_NONE && m_controlRate != m_cbrRate) {
+    NS_LOG_LOGIC("Rate " << m_cbrRate << " -> " << m_controlRate);
+    m_rateTrace(m_cbrRate, m_controlRate);
+    m_cbrRate = m_controlRate;
+    m_cbrRateFailSafe = m_cbrRate;
+  }
+
   if (m_maxBytes == 0 || m_totBytes < m_maxBytes) {
-    NS_ABORT_MSG_IF(m_residualBits > m_pktSize * 8,
-                    "Calculation to compute next send time will overflow");
-    uint32_t bits = m_pktSize * 8 - m_residualBits;
-    NS_LOG_LOGIC("bits = " << bits);
-    Time nextTime(Seconds(
-        bits /
-        static_cast<double>(m_cbrRate.GetBitRate()))); // Time till next packet
+    Time nextTime; // Time till next packet
+    if (m_interArrival) {
+      // Request pattern of the device profile
+      nextTime = Seconds(m_interArrival->GetValue());
+    } else {
+      NS_ABORT_MSG_IF(m_residualBits > m_pktSize * 8,
+                      "Calculation to compute next send time will overflow");
+      uint32_t bits = m_pktSize * 8 - m_residualBits;
+      NS_LOG_LOGIC("bits = " << bits);
+      nextTime = Seconds(bits / static_cast<double>(m_cbrRate.GetBitRate()));
+    }
     NS_LOG_LOGIC("nextTime = " << nextTime.As(Time::S));
-    m_sendEvent =
-        Simulator::Schedule(nextTime, &DeviceEnforcer::SendPacket, this);
+    if (m_sendDriver) {
+      m_sendDeadline = Simulator::Now() + nextTime;
+      m_sendQueued = true;
+      m_sendDriver->Schedule(this, m_sendDeadline);
+    } else {
+      m_sendEvent =
+          Simulator::Schedule(nextTime, &DeviceEnforcer::SendPacket, this);
+    }
   } else { // All done, cancel any pending events
     // StopApplication();
   }
@@ -291,77 +502,77 @@ void DeviceEnforcer::SendPacket() {
 
   NS_ASSERT(m_sendEvent.IsExpired());
 
-  string z_message = "Message!";
-
   Ptr<Packet> packet;
+  uint32_t id = m_requestId;
   if (m_unsentPacket) {
     packet = m_unsentPacket;
-  } else if (m_enableSeqTsSizeHeader) {
-    Address from, to;
-    m_socket->GetSockName(from);
-    m_socket->GetPeerName(to);
-    SeqTsSizeHeader header;
-    header.SetSeq(m_seq++);
-    header.SetSize(m_pktSize);
-    NS_ABORT_IF(m_pktSize < header.GetSerializedSize());
-    packet = Create<Packet>(m_pktSize - header.GetSerializedSize());
-    // Trace before adding header, for consistency with PacketSink
-    m_txTraceWithSeqTsSize(packet, from, to, header);
-    packet->AddHeader(header);
+    id = m_unsentId;
   } else {
-    NS_LOG_INFO("Creating packet with " << z_message.size() << " size and '"
-                                        << z_message << "' message");
-    packet = Create<Packet>(
-        reinterpret_cast<const uint8_t *>(z_message.c_str()), z_message.size());
+    // The payload bytes are shared with the template, only the headers are
+    // written
+    packet = WorkMessageFramer::Frame(
+        WorkMessageHeader::REQUEST, m_requestId++, m_payloadTemplate,
+        WorkMessageHeader::GetClassFlags(m_class));
+    if (m_enableSeqTsSizeHeader) {
+      SeqTsSizeHeader header;
+      header.SetSeq(m_seq++);
+      header.SetSize(m_pktSize);
+      // Trace before adding header, for consistency with PacketSink
+      m_txTraceWithSeqTsSize(packet, m_sockName, m_peerName, header);
+      packet->AddHeader(header);
+    }
   }
 
-  if (InetSocketAddress::IsMatchingType(m_peer)) {
-    NS_LOG_INFO("Sending packet from "
-                << InetSocketAddress::ConvertFrom(m_local).GetIpv4() << " to "
-                << InetSocketAddress::ConvertFrom(m_peer).GetIpv4());
-  } else {
-    NS_LOG_INFO("Sending packet from "
-                << Inet6SocketAddress::ConvertFrom(m_local).GetIpv6() << " to "
-                << Inet6SocketAddress::ConvertFrom(m_peer).GetIpv6());
+  if (!m_connected) {
+    // Lazy, idle or failed connection: the request waits for the
+    // connection, which sends it and restarts the schedule of the next ones
+    m_unsentPacket = packet;
+    m_unsentId = id;
+    if (!m_socket) {
+      OpenSocket();
+    }
+    return;
   }
-
+  ArmIdleTimer();
   int actual = m_socket->Send(packet);
-  if ((unsigned)actual == m_pktSize) {
+  if ((unsigned)actual == packet->GetSize()) {
     m_txTrace(packet);
-    m_totBytes += m_pktSize;
+    m_totBytes += packet->GetSize();
     m_unsentPacket = 0;
-    Address localAddress;
-    m_socket->GetSockName(localAddress);
-    m_traces(m_local, m_peer, z_message);
-    if (InetSocketAddress::IsMatchingType(m_peer)) {
-      NS_LOG_INFO("At time " << Simulator::Now().As(Time::S)
-                             << " on-off application sent " << packet->GetSize()
-                             << " bytes to "
-                             << InetSocketAddress::ConvertFrom(m_peer).GetIpv4()
-                             << " port "
-                             << InetSocketAddress::ConvertFrom(m_peer).GetPort()
-                             << " total Tx " << m_totBytes << " bytes");
-      m_txTraceWithAddresses(packet, localAddress,
-                             InetSocketAddress::ConvertFrom(m_peer));
-    } else if (Inet6SocketAddress::IsMatchingType(m_peer)) {
-      NS_LOG_INFO("At time "
-                  << Simulator::Now().As(Time::S) << " on-off application sent "
-                  << packet->GetSize() << " bytes to "
-                  << Inet6SocketAddress::ConvertFrom(m_peer).GetIpv6()
-                  << " port "
-                  << Inet6SocketAddress::ConvertFrom(m_peer).GetPort()
-                  << " total Tx " << m_totBytes << " bytes");
-      m_txTraceWithAddresses(packet, localAddress,
-                             Inet6SocketAddress::ConvertFrom(m_peer));
+    PendingRequest &pending = m_pending[id];
+    pending.sent = Simulator::Now();
+    pending.retries = 0;
+    if (m_datagram) {
+      // Nothing guarantees the delivery of the request, keep a copy
+      pending.packet = packet->Copy();
+      pending.timeout = Simulator::Schedule(
+          m_rto, &DeviceEnforcer::RequestTimeout, this, id);
     }
+    NotifyEvent(WORK_TRACE_DEVICE_SEND, id, packet->GetSize(), m_peer);
+    WORK_TRACE(WORK_TRACE_DEVICE_SEND, id, packet->GetSize());
+    m_txTraceWithAddresses(packet, m_sockName, m_peer);
   } else {
     NS_LOG_DEBUG("Unable to send packet; actual "
-                 << actual << " size " << m_pktSize
+                 << actual << " size " << packet->GetSize()
                  << "; caching for later attempt");
+    WORK_TRACE(WORK_TRACE_DEVICE_BLOCKED, id, packet->GetSize());
+    AdaptRate(Seconds(0), true);
     m_unsentPacket = packet;
+    m_unsentId = id;
   }
   m_residualBits = 0;
   m_lastStartTime = Simulator::Now();
+  ScheduleNextTx();
+}
+
+void DeviceEnforcer::DriverSend() {
+  NS_LOG_FUNCTION(this);
+  if (!m_sendQueued || m_sendDeadline != Simulator::Now()) {
+    // Cancelled by an earlier device of the same bucket
+    return;
+  }
+  m_sendQueued = false;
+  SendPacket();
 }
 
 void DeviceEnforcer::ConnectionSucceeded(Ptr<Socket> socket) {
@@ -374,19 +585,51 @@ void DeviceEnforcer::ConnectionSucceeded(Ptr<Socket> socket) {
                 << " connected @" << Simulator::Now().As(Time::S));
   }
   m_connected = true;
-  m_traces(m_peer, m_local, "Socket connected");
+  socket->GetSockName(m_sockName);
+  socket->GetPeerName(m_peerName);
+  NotifyEvent(WORK_TRACE_DEVICE_CONNECTED, 0, 0, m_peerName,
+              Simulator::Now() - m_connectStart);
+  WORK_TRACE(WORK_TRACE_DEVICE_CONNECTED,
+             WorkEventTrace::PackAddress(m_sockName),
+             WorkEventTrace::PackAddress(m_peerName));
+  if (m_sendEvent.IsRunning() || m_sendQueued) {
+    return; // Reconnected while the next request is scheduled
+  }
+  if (m_unsentPacket) {
+    SendPacket(); // The request that opened the connection
+  } else if (!m_startStopEvent.IsRunning()) {
+    StartSending("");
+  }
 }
 
 void DeviceEnforcer::ConnectionFailed(Ptr<Socket> socket) {
   NS_LOG_FUNCTION(this << socket);
+  // Reported as an event, so that a failure may trigger a capture
   if (InetSocketAddress::IsMatchingType(m_local)) {
-    NS_FATAL_ERROR(InetSocketAddress::ConvertFrom(m_local).GetIpv4()
-                << " can't connect " << socket->GetErrno() << " @"
-                << Simulator::Now().As(Time::S));
+    NS_LOG_ERROR(InetSocketAddress::ConvertFrom(m_local).GetIpv4()
+                 << " can't connect " << socket->GetErrno() << " @"
+                 << Simulator::Now().As(Time::S));
   } else {
-    NS_FATAL_ERROR(Inet6SocketAddress::ConvertFrom(m_local).GetIpv6()
-                << " can't connect " << socket->GetErrno() << " @"
-                << Simulator::Now().As(Time::S));
+    NS_LOG_ERROR(Inet6SocketAddress::ConvertFrom(m_local).GetIpv6()
+                 << " can't connect " << socket->GetErrno() << " @"
+                 << Simulator::Now().As(Time::S));
+  }
+  NotifyEvent(WORK_TRACE_DEVICE_CONNECT_FAILED, 0, 0, m_peer,
+              Simulator::Now() - m_connectStart);
+  WORK_TRACE(WORK_TRACE_DEVICE_CONNECT_FAILED,
+             WorkEventTrace::PackAddress(m_local),
+             WorkEventTrace::PackAddress(m_peer));
+  // The request is lost, the next one opens a new socket and connects
+  // again, as for a lazy or idle device
+  m_socket = 0;
+  m_unsentPacket = 0;
+  if (m_sendEvent.IsRunning() || m_sendQueued) {
+    return;
+  }
+  if (m_startStopEvent.IsRunning()) {
+    ScheduleNextTx();
+  } else {
+    StartSending(""); // The first connection of the device failed
   }
 }
 
@@ -395,59 +638,225 @@ void DeviceEnforcer::HandleRead(Ptr<Socket> socket) {
   NS_LOG_INFO("Handling read work device...");
   Ptr<Packet> packet;
   Address from;
-  string newBuffer;
   while ((packet = socket->RecvFrom(from))) {
     if (packet->GetSize() == 0) { // EOF
       break;
     }
 
-    newBuffer.clear();
-    uint8_t *buffer = new uint8_t[packet->GetSize()];
-    packet->CopyData(buffer, packet->GetSize());
-    newBuffer = (char *)buffer;
-    size_t endOfMsg = newBuffer.find("]");
-    newBuffer = newBuffer.substr(0, endOfMsg + 1).c_str();
-    m_traces(from, m_local, newBuffer);
-
-    if (InetSocketAddress::IsMatchingType(from)) {
-      NS_LOG_INFO("Received packet from "
-                  << InetSocketAddress::ConvertFrom(from).GetIpv4()
-                  << " with message = " << newBuffer);
-      NS_LOG_INFO("At time "
-                  << Simulator::Now().As(Time::S) << " packet sink received "
-                  << packet->GetSize() << " bytes from "
-                  << InetSocketAddress::ConvertFrom(from).GetIpv4() << " port "
-                  << InetSocketAddress::ConvertFrom(from).GetPort());
-    } else if (Inet6SocketAddress::IsMatchingType(from)) {
-      NS_LOG_INFO("Received packet from "
-                  << Inet6SocketAddress::ConvertFrom(from).GetIpv6()
-                  << " with message = " << newBuffer);
-      NS_LOG_INFO("At time "
-                  << Simulator::Now().As(Time::S) << " packet sink received "
-                  << packet->GetSize() << " bytes from "
-                  << Inet6SocketAddress::ConvertFrom(from).GetIpv6() << " port "
-                  << Inet6SocketAddress::ConvertFrom(from).GetPort());
+    WORK_TRACE(WORK_TRACE_DEVICE_RECEIVE, WorkEventTrace::PackAddress(from),
+               packet->GetSize());
+
+    // Responses may be split or coalesced by the transport
+    m_framer.Append(packet);
+    WorkMessageHeader header;
+    string payload;
+    while (m_framer.Next(header, payload)) {
+      HandleResponse(header, payload, from);
     }
   }
+}
 
-  if (newBuffer == "[Accepted]") {
-    if (InetSocketAddress::IsMatchingType(m_peer)) {
-      NS_LOG_INFO(InetSocketAddress::ConvertFrom(m_local).GetIpv4()
-                  << " has changed!");
-    } else {
-      NS_LOG_INFO(Inet6SocketAddress::ConvertFrom(m_local).GetIpv6()
-                  << " has changed!");
-    }
+void DeviceEnforcer::HandleResponse(const WorkMessageHeader &header,
+                                    const string &payload,
+                                    const Address &from) {
+  NS_LOG_FUNCTION(this << header);
+  if (header.GetType() != WorkMessageHeader::RESPONSE) {
+    NS_LOG_WARN("Ignoring unexpected message " << header);
+    return;
+  }
 
-  } else if (newBuffer == "[Refused]") {
-    if (InetSocketAddress::IsMatchingType(m_peer)) {
-      NS_LOG_INFO(InetSocketAddress::ConvertFrom(m_local).GetIpv4()
-                  << " has NOT changed!");
+  auto it = m_pending.find(header.GetId());
+  if (it == m_pending.end()) {
+    // Response to a retransmitted request that was already answered
+    NS_LOG_LOGIC("Ignoring duplicated response " << header.GetId());
+    return;
+  }
+  Simulator::Cancel(it->second.timeout);
+  Time rtt;
+  if (it->second.retries == 0) {
+    // Karn's algorithm: only requests sent once give unambiguous samples
+    rtt = Simulator::Now() - it->second.sent;
+    UpdateRto(rtt);
+    m_rttTrace(rtt);
+    AdaptRate(rtt, false);
+  }
+  m_pending.erase(it);
+  ArmIdleTimer();
+
+  // The server only accepts or refuses, compared in place: the other
+  // replies are interned on every response
+  size_t begin = payload.find('[');
+  size_t end = payload.find(']', begin);
+  size_t length = end == string::npos ? 0 : end - begin + 1;
+  uint32_t reply;
+  if (length && payload.compare(begin, length, "[Accepted]") == 0) {
+    reply = m_acceptedId;
+  } else if (length && payload.compare(begin, length, "[Refused]") == 0) {
+    reply = m_refusedId;
+  } else {
+    reply = WorkEventTrace::Intern("[" + WorkMessageFramer::Unwrap(payload) +
+                                   "]");
+  }
+  NotifyEvent(WORK_TRACE_DEVICE_RESPONSE, header.GetId(), payload.size(), from,
+              rtt, reply);
+  WORK_TRACE(WORK_TRACE_DEVICE_RESPONSE, header.GetId(),
+             reply == m_acceptedId);
+}
+
+void DeviceEnforcer::ArmIdleTimer(void) {
+  if (m_idleTimeout.IsZero()) {
+    return;
+  }
+  // Called on every request and response: only the time is recorded, the
+  // running timer checks it when it expires
+  m_lastActivity = Simulator::Now();
+  if (!m_idleEvent.IsRunning()) {
+    m_idleEvent =
+        Simulator::Schedule(m_idleTimeout, &DeviceEnforcer::CloseIdle, this);
+  }
+}
+
+void DeviceEnforcer::CloseIdle(void) {
+  NS_LOG_FUNCTION(this);
+  if (!m_pending.empty() || m_unsentPacket) {
+    // Requests in flight, the connection is still in use
+    m_idleEvent =
+        Simulator::Schedule(m_idleTimeout, &DeviceEnforcer::CloseIdle, this);
+    return;
+  }
+  Time idle = Simulator::Now() - m_lastActivity;
+  if (idle < m_idleTimeout) {
+    m_idleEvent = Simulator::Schedule(m_idleTimeout - idle,
+                                      &DeviceEnforcer::CloseIdle, this);
+    return;
+  }
+  NS_LOG_LOGIC("Closing the idle connection of device " << m_deviceId);
+  // Responses can no longer arrive, the socket is released once closed
+  m_socket->SetRecvCallback(MakeNullCallback<void, Ptr<Socket>>());
+  m_socket->SetConnectCallback(
+      MakeNullCallback<void, Ptr<Socket>>(),
+      MakeNullCallback<void, Ptr<Socket>>());
+  m_socket->Close();
+  m_socket = 0;
+  m_connected = false;
+  m_framer = WorkMessageFramer();
+}
+
+void DeviceEnforcer::NotifyEvent(WorkTraceEvent code, uint32_t id,
+                                 uint32_t size, const Address &peer,
+                                 Time delay, uint32_t message) {
+  WorkEvent event;
+  event.code = code;
+  event.device = m_deviceId;
+  event.message = message ? message : m_messageId;
+  event.id = id;
+  event.size = size;
+  event.peer = WorkEventTrace::PackAddress(peer);
+  event.delay = delay.GetTimeStep();
+  m_eventTrace(event);
+}
+
+void DeviceEnforcer::RequestTimeout(uint32_t id) {
+  NS_LOG_FUNCTION(this << id);
+  auto it = m_pending.find(id);
+  if (it == m_pending.end()) {
+    return;
+  }
+  PendingRequest &pending = it->second;
+  if (pending.retries >= m_maxRetries) {
+    NS_LOG_INFO("Request " << id << " abandoned after " << pending.retries
+                           << " retransmissions");
+    NotifyEvent(WORK_TRACE_DEVICE_ABANDON, id, 0, m_peer);
+    WORK_TRACE(WORK_TRACE_DEVICE_ABANDON, id, pending.retries);
+    m_timeouts++;
+    m_pending.erase(it);
+    return;
+  }
+
+  AdaptRate(Seconds(0), true);
+  // Exponential backoff until a new sample is measured
+  m_rto = std::min(m_rto + m_rto, m_maxRto);
+  pending.retries++;
+  pending.sent = Simulator::Now();
+  m_retransmissions++;
+  NotifyEvent(WORK_TRACE_DEVICE_RETRANSMIT, id, pending.packet->GetSize(),
+              m_peer);
+  WORK_TRACE(WORK_TRACE_DEVICE_RETRANSMIT, id, pending.retries);
+  NS_LOG_LOGIC("Retransmitting request " << id << " (" << pending.retries
+                                         << "), next timeout "
+                                         << m_rto.As(Time::MS));
+  m_socket->Send(pending.packet->Copy());
+  pending.timeout =
+      Simulator::Schedule(m_rto, &DeviceEnforcer::RequestTimeout, this, id);
+}
+
+void DeviceEnforcer::UpdateRto(Time rtt) {
+  NS_LOG_FUNCTION(this << rtt);
+  // RFC 6298 estimator, alpha = 1/8 and beta = 1/4
+  int64_t sample = rtt.GetNanoSeconds();
+  int64_t srtt = m_srtt.GetNanoSeconds();
+  int64_t rttvar = m_rttvar.GetNanoSeconds();
+  if (!m_rttSampled) {
+    srtt = sample;
+    rttvar = sample / 2;
+    m_rttSampled = true;
+  } else {
+    rttvar = (3 * rttvar + std::abs(srtt - sample)) / 4;
+    srtt = (7 * srtt + sample) / 8;
+  }
+  m_srtt = NanoSeconds(srtt);
+  m_rttvar = NanoSeconds(rttvar);
+  m_rto = std::min(std::max(NanoSeconds(srtt + 4 * rttvar), m_minRto),
+                   m_maxRto);
+}
+
+void DeviceEnforcer::AdaptRate(Time rtt, bool congestion) {
+  NS_LOG_FUNCTION(this << rtt << congestion);
+  if (m_rateControl == RATE_NONE) {
+    return;
+  }
+
+  if (!congestion && (m_minRtt.IsZero() || rtt < m_minRtt)) {
+    m_minRtt = rtt;
+  }
+  Time now = Simulator::Now();
+  // React at most once per round-trip time, the effect of a change is not
+  // observable earlier
+  Time period = m_rttSampled ? m_srtt : m_targetLatency;
+  if (!m_lastRateChange.IsZero() && now - m_lastRateChange < period) {
+    return;
+  }
+
+  double rate = static_cast<double>(m_controlRate.GetBitRate());
+  double increase = static_cast<double>(m_rateIncrease.GetBitRate());
+  if (congestion) {
+    rate *= m_rateDecrease;
+  } else if (m_rateControl == RATE_AIMD) {
+    rate = rtt > m_targetLatency ? rate * m_rateDecrease : rate + increase;
+  } else {
+    // Gradient over the last round-trip time normalized by the lowest
+    // round-trip time, smoothed with the TIMELY weight
+    double diff = m_prevRtt.IsZero() ? 0 : (rtt - m_prevRtt).GetSeconds();
+    m_prevRtt = rtt;
+    m_rttGradient =
+        0.125 * m_rttGradient + 0.875 * diff / m_minRtt.GetSeconds();
+    double target = m_targetLatency.GetSeconds();
+    double beta = 1 - m_rateDecrease;
+    if (rtt.GetSeconds() < target / 2) {
+      rate += increase;
+    } else if (rtt.GetSeconds() > target) {
+      rate *= 1 - beta * (1 - target / rtt.GetSeconds());
+    } else if (m_rttGradient <= 0) {
+      rate += increase;
     } else {
-      NS_LOG_INFO(Inet6SocketAddress::ConvertFrom(m_local).GetIpv6()
-                  << " has NOT changed!");
+      rate *= 1 - beta * std::min(m_rttGradient, 1.0);
     }
   }
+
+  rate = std::max(rate, static_cast<double>(m_minRate.GetBitRate()));
+  rate = std::min(rate, static_cast<double>(m_maxRate.GetBitRate()));
+  m_controlRate = DataRate(static_cast<uint64_t>(rate));
+  m_lastRateChange = now;
 }
 
 void DeviceEnforcer::HandlePeerClose(Ptr<Socket> socket) {
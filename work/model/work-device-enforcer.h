@@ -11,9 +11,14 @@
 #include "ns3/application.h"
 #include "ns3/data-rate.h"
 #include "ns3/event-id.h"
+#include "ns3/nstime.h"
 #include "ns3/ptr.h"
 #include "ns3/seq-ts-size-header.h"
 #include "ns3/traced-callback.h"
+#include "ns3/work-event-trace.h"
+#include "ns3/work-message.h"
+#include "ns3/work-send-driver.h"
+#include <map>
 #include <string>
 
 using namespace std;
@@ -76,9 +81,75 @@ class Socket;
  * (enable its "EnableSeqTsSizeHeader" attribute), or users may extract
  * the header via trace sources.  Note that the continuity of the sequence
  * number may be disrupted across On/Off cycles.
+ *
+ * Every request carries a request id that the server echoes in its
+ * response, which gives one round-trip time sample per answered request
+ * (see the "Rtt" trace source). When the "Protocol" attribute selects a
+ * datagram socket factory (ns3::UdpSocketFactory) the application provides
+ * its own reliability: a request not answered within the retransmission
+ * timeout is sent again, up to "MaxRetries" times. The timeout adapts to
+ * the observed round-trip times as in RFC 6298 (Karn's algorithm, samples
+ * of retransmitted requests are discarded) and is doubled on every
+ * expiration. Duplicated responses are ignored.
+ *
+ * With the "RateControl" attribute the send rate follows the feedback of
+ * the server instead of staying at "DataRate", which then only bounds it
+ * from above. Every round-trip time sample, retransmission timeout and
+ * refused send (the transmit buffer of the socket is full) is fed to the
+ * controller and the new rate is applied when the next transmission is
+ * scheduled. Two controllers are available:
+ *  - Aimd: the rate grows by "RateIncrease" once per smoothed round-trip
+ *    time while the samples stay below "TargetLatency" and is multiplied by
+ *    "RateDecrease" at most once per round-trip time otherwise;
+ *  - DelayGradient: TIMELY-like, the rate grows additively while the
+ *    round-trip time is low or decreasing and is reduced in proportion to
+ *    the normalized round-trip time gradient when it increases.
+ * The rate trajectory is exported by the "RateChange" trace source.
+ *
+ * Device profiles change the request pattern: with the "InterArrival"
+ * random variable the time between two requests is drawn for each request
+ * instead of following "DataRate" and "PacketSize" (the rate controller
+ * then has no effect), and with the "OnTime" and "OffTime" random
+ * variables the device alternates sending and silent periods, e.g. a
+ * camera streaming in bursts.
+ *
+ * A large population of mostly idle devices does not need a connection
+ * each all the time. With "Lazy" the socket is only created, and the
+ * connection opened, when the first request is due; with "IdleTimeout" the
+ * connection is closed once no request nor response went through it for
+ * that time and opened again by the next request. The request that opens
+ * a connection waits for it, the next ones are scheduled once it is sent.
+ *
+ * When a WorkSendDriver is set with the "SendDriver" attribute the next
+ * transmission is registered in the driver, which fires one event for all
+ * the devices due at the same time, instead of being scheduled by the
+ * device itself. The device then sends in the context of another node, see
+ * WorkSendDriver.
  */
 class DeviceEnforcer : public Application {
 public:
+  /// Send rate controllers
+  enum RateControl {
+    RATE_NONE,          //!< Constant "DataRate"
+    RATE_AIMD,          //!< Additive increase, multiplicative decrease
+    RATE_DELAY_GRADIENT //!< Round-trip time gradient
+  };
+
+  /**
+   * TracedCallback signature for send rate changes.
+   *
+   * \param [in] oldRate the previous send rate
+   * \param [in] newRate the new send rate
+   */
+  typedef void (*DataRateTracedCallback)(DataRate oldRate, DataRate newRate);
+
+  /**
+   * TracedCallback signature for the device events.
+   *
+   * \param [in] event the event
+   */
+  typedef void (*WorkEventTracedCallback)(const WorkEvent &event);
+
   /**
    * \brief Get the type ID.
    * \return the object TypeId
@@ -122,10 +193,32 @@ public:
    * \brief Start an On period
    */
   void StartSending(string message);
+  /**
+   * \brief Start an Off period, until the next On period
+   */
+  void StopSending(void);
   /**
    * \brief Send a packet
    */
   void SendPacket();
+  /**
+   * \brief Send a packet at the deadline registered in the send driver
+   */
+  void DriverSend();
+  /**
+   * \brief Create the socket, bind it and connect to the peer
+   */
+  void OpenSocket(void);
+  /**
+   * \brief Record traffic on the connection and start the idle timer, if
+   *        any and not running
+   */
+  void ArmIdleTimer(void);
+  /**
+   * \brief Close the connection once idle, until the next request, or wait
+   *        for the rest of the idle time
+   */
+  void CloseIdle(void);
 
   Ptr<Socket> m_socket;       //!< Associated socket
   Address m_peer;             //!< Peer address
@@ -140,11 +233,84 @@ public:
   uint64_t m_totBytes;        //!< Total bytes sent so far
   EventId m_startStopEvent;   //!< Event id for next start or stop event
   EventId m_sendEvent;        //!< Event id of pending "send packet" event
+  /// Shared driver of the send events, null to schedule them directly
+  Ptr<WorkSendDriver> m_sendDriver;
+  Time m_sendDeadline;        //!< Next send time registered in the driver
+  bool m_sendQueued{false};   //!< True if a send is registered in the driver
+  /// Time between two requests in seconds, null to pace them by the rate
+  Ptr<RandomVariableStream> m_interArrival;
+  /// Duration of the On periods in seconds, null to send all the time
+  Ptr<RandomVariableStream> m_onTime;
+  /// Duration of the Off periods in seconds, null for none
+  Ptr<RandomVariableStream> m_offTime;
+  /// True to create the socket when the first request is due
+  bool m_lazy;
+  /// Time without traffic before closing the connection, zero for never
+  Time m_idleTimeout;
+  /// Event id of the idle connection close
+  EventId m_idleEvent;
+  /// Time of the last request or response on the connection
+  Time m_lastActivity;
   TypeId m_tid;               //!< Type of the socket used
   uint32_t m_seq{0};          //!< Sequence
+  uint32_t m_requestId{0};    //!< Id of the next request
+  uint32_t m_unsentId{0};     //!< Request id of the unsent packet
+  WorkMessageFramer m_framer; //!< Reassembly of received responses
   Ptr<Packet> m_unsentPacket; //!< Unsent packet cached for future attempt
+  /// Request payload, shared by every packet
+  Ptr<Packet> m_payloadTemplate;
+  /// Message of the requests
+  string m_message{"[Message!]"};
+  uint32_t m_deviceId;        //!< Id of the device in the events
+  uint32_t m_messageId{0};    //!< Interned message of the requests
+  uint32_t m_acceptedId{0};   //!< Interned "[Accepted]" response
+  uint32_t m_refusedId{0};    //!< Interned "[Refused]" response
+  Time m_connectStart;        //!< Time the connection was requested
+  Address m_sockName;         //!< Socket address, cached once connected
+  Address m_peerName;         //!< Peer socket address, cached once connected
   bool m_enableSeqTsSizeHeader{
       false}; //!< Enable or disable the use of SeqTsSizeHeader
+  WorkMessageHeader::MessageClass m_class; //!< Class of the requests
+
+  /// Request waiting for its response
+  struct PendingRequest {
+    Ptr<Packet> packet; //!< Copy of the request, for retransmissions
+    Time sent;          //!< Time of the last transmission
+    uint32_t retries;   //!< Number of retransmissions
+    EventId timeout;    //!< Retransmission timer
+  };
+
+  bool m_datagram{false};   //!< True if the socket is datagram oriented
+  uint32_t m_maxRetries;    //!< Retransmissions before giving up
+  Time m_initialRto;        //!< Retransmission timeout before any sample
+  Time m_minRto;            //!< Lower bound of the retransmission timeout
+  Time m_maxRto;            //!< Upper bound of the retransmission timeout
+  Time m_rto;               //!< Current retransmission timeout
+  Time m_srtt;              //!< Smoothed round-trip time
+  Time m_rttvar;            //!< Round-trip time variation
+  bool m_rttSampled{false}; //!< True once a round-trip time is measured
+  std::map<uint32_t, PendingRequest>
+      m_pending; //!< Requests waiting for a response by id
+  uint64_t m_retransmissions{0}; //!< Number of retransmitted requests
+  uint64_t m_timeouts{0};        //!< Requests abandoned after MaxRetries
+
+  RateControl m_rateControl; //!< Send rate controller
+  DataRate m_minRate;        //!< Lower bound of the controlled rate
+  DataRate m_maxRate;        //!< Upper bound, the configured "DataRate"
+  DataRate m_controlRate;    //!< Rate to apply on the next transmission
+  DataRate m_rateIncrease;   //!< Additive increase step
+  double m_rateDecrease;     //!< Multiplicative decrease factor
+  Time m_targetLatency;      //!< Round-trip time above which to slow down
+  Time m_lastRateChange;     //!< Time of the last rate adjustment
+  Time m_prevRtt;            //!< Previous round-trip time sample
+  Time m_minRtt;             //!< Lowest round-trip time sample
+  double m_rttGradient{0};   //!< Smoothed normalized round-trip gradient
+
+  /// Traced Callback: round-trip time of the answered requests
+  TracedCallback<Time> m_rttTrace;
+
+  /// Traced Callback: send rate changes
+  TracedCallback<DataRate, DataRate> m_rateTrace;
 
   /// Traced Callback: transmitted packets.
   TracedCallback<Ptr<const Packet>> m_txTrace;
@@ -154,8 +320,8 @@ public:
   TracedCallback<Ptr<const Packet>, const Address &, const Address &>
       m_txTraceWithAddresses;
 
-  TracedCallback<Address, Address, string>
-      m_traces; //!< Traced Callback: messages
+  /// Traced Callback: connection, request and response events
+  TracedCallback<const WorkEvent &> m_eventTrace;
 
   /// Callback for tracing the packet Tx events, includes source, destination,
   /// the packet sent, and header
@@ -174,6 +340,10 @@ public:
   void ConnectionSucceeded(Ptr<Socket> socket);
   /**
    * \brief Handle a Connection Failed event
+   *
+   * The socket is dropped and the pending request lost, the next request
+   * opens a new socket.
+   *
    * \param socket the not connected socket
    */
   void ConnectionFailed(Ptr<Socket> socket);
@@ -183,6 +353,42 @@ public:
    * \param socket the receiving socket
    */
   void HandleRead(Ptr<Socket> socket);
+  /**
+   * \brief Handle a complete response received by the application
+   * \param header the response header
+   * \param payload the response message
+   * \param from the address the response is from
+   */
+  void HandleResponse(const WorkMessageHeader &header, const string &payload,
+                      const Address &from);
+  /**
+   * \brief Notify an event to the "Event" trace source
+   * \param code the event
+   * \param id the request id
+   * \param size the bytes sent or received
+   * \param peer the remote address
+   * \param delay the round-trip time or the connection delay, if measured
+   * \param message the interned message, zero for the request message
+   */
+  void NotifyEvent(WorkTraceEvent code, uint32_t id, uint32_t size,
+                   const Address &peer, Time delay = Time(0),
+                   uint32_t message = 0);
+  /**
+   * \brief Retransmit or abandon a request still waiting for its response
+   * \param id the request id
+   */
+  void RequestTimeout(uint32_t id);
+  /**
+   * \brief Update the retransmission timeout with a round-trip time sample
+   * \param rtt the round-trip time of a request sent only once
+   */
+  void UpdateRto(Time rtt);
+  /**
+   * \brief Feed the send rate controller
+   * \param rtt the round-trip time sample, ignored on congestion
+   * \param congestion true on a timeout or a refused send
+   */
+  void AdaptRate(Time rtt, bool congestion);
   /**
    * \brief Handle an incoming connection
    * \param socket the incoming connection socket
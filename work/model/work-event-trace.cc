@@ -0,0 +1,169 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#include "work-event-trace.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include <stdio.h>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE("WorkEventTrace");
+
+/// Description of an event
+struct WorkTraceEventInfo {
+  const char *name;    //!< Event name
+  const char *args[2]; //!< Argument names
+  bool address[2];     //!< True for packed address arguments
+};
+
+/// Descriptions, indexed by event
+static const WorkTraceEventInfo g_events[WORK_TRACE_EVENT_COUNT] = {
+    {"DeviceConnected", {"local", "peer"}, {true, true}},
+    {"DeviceSend", {"id", "size"}, {false, false}},
+    {"DeviceBlocked", {"id", "size"}, {false, false}},
+    {"DeviceReceive", {"from", "size"}, {true, false}},
+    {"DeviceResponse", {"id", "accepted"}, {false, false}},
+    {"DeviceRetransmit", {"id", "retries"}, {false, false}},
+    {"DeviceAbandon", {"id", "retries"}, {false, false}},
+    {"ServerReceive", {"from", "size"}, {true, false}},
+    {"ServerRequest", {"from", "id"}, {true, false}},
+    {"ServerResponse", {"id", "accepted"}, {false, false}},
+    {"ServerDuplicate", {"from", "id"}, {true, false}},
+    {"DeviceConnect", {"local", "peer"}, {true, true}},
+    {"DeviceConnectFailed", {"local", "peer"}, {true, true}},
+};
+
+const char WorkEventTrace::MAGIC[8] = {'W', 'O', 'R', 'K', 'T', 'R', 'C', 0};
+
+bool WorkEventTrace::m_enabled = false;
+
+static FILE *g_file = 0;                      //!< Trace file
+static std::vector<WorkTraceRecord> g_buffer; //!< Buffered records
+static size_t g_next = 0;                     //!< Next record to write
+static bool g_ring = false;                   //!< Keep the last records
+static bool g_wrapped = false;                //!< Ring overwritten
+static uint64_t g_recorded = 0;               //!< Events recorded
+static uint64_t g_overwritten = 0;            //!< Records lost in ring mode
+
+/// Interned messages, by id
+static std::vector<string> g_messages(1, "");
+/// Interned message ids, by message
+static std::unordered_map<string, uint32_t> g_messageIds = {{"", 0}};
+
+void WorkEventTrace::Enable(const string &filename, uint32_t capacity,
+                            bool ring) {
+  NS_LOG_FUNCTION(filename << capacity << ring);
+  NS_ABORT_MSG_IF(capacity == 0, "The event trace needs a buffer");
+  Disable();
+
+  g_file = fopen(filename.c_str(), "wb");
+  NS_ABORT_MSG_IF(!g_file, "Cannot open event trace " << filename);
+  uint32_t header[2] = {VERSION, sizeof(WorkTraceRecord)};
+  fwrite(MAGIC, sizeof(MAGIC), 1, g_file);
+  fwrite(header, sizeof(header), 1, g_file);
+
+  g_buffer.assign(capacity, WorkTraceRecord());
+  g_next = 0;
+  g_ring = ring;
+  g_wrapped = false;
+  g_recorded = 0;
+  g_overwritten = 0;
+  m_enabled = true;
+  // Written at the latest when the simulation is destroyed
+  Simulator::ScheduleDestroy(&WorkEventTrace::Disable);
+}
+
+void WorkEventTrace::Disable(void) {
+  if (!g_file) {
+    return;
+  }
+  NS_LOG_FUNCTION_NOARGS();
+  if (g_ring && g_wrapped) {
+    // Oldest records first
+    fwrite(&g_buffer[g_next], sizeof(WorkTraceRecord),
+           g_buffer.size() - g_next, g_file);
+  }
+  Flush();
+  fclose(g_file);
+  g_file = 0;
+  g_buffer.clear();
+  g_buffer.shrink_to_fit();
+  m_enabled = false;
+}
+
+void WorkEventTrace::Record(WorkTraceEvent event, uint64_t arg0,
+                            uint64_t arg1) {
+  if (g_next == g_buffer.size()) {
+    if (g_ring) {
+      g_wrapped = true;
+      g_next = 0;
+    } else {
+      Flush();
+    }
+  }
+  if (g_wrapped) {
+    g_overwritten++;
+  }
+  WorkTraceRecord &record = g_buffer[g_next++];
+  record.time = Simulator::Now().GetTimeStep();
+  record.node = Simulator::GetContext();
+  record.event = event;
+  record.reserved = 0;
+  record.args[0] = arg0;
+  record.args[1] = arg1;
+  g_recorded++;
+}
+
+void WorkEventTrace::Flush(void) {
+  fwrite(g_buffer.data(), sizeof(WorkTraceRecord), g_next, g_file);
+  g_next = 0;
+}
+
+uint64_t WorkEventTrace::PackAddress(const Address &address) {
+  if (!InetSocketAddress::IsMatchingType(address)) {
+    return 0;
+  }
+  InetSocketAddress inet = InetSocketAddress::ConvertFrom(address);
+  return (uint64_t(inet.GetIpv4().Get()) << 16) | inet.GetPort();
+}
+
+const char *WorkEventTrace::GetEventName(uint16_t event) {
+  return event < WORK_TRACE_EVENT_COUNT ? g_events[event].name : "Unknown";
+}
+
+const char *WorkEventTrace::GetArgName(uint16_t event, uint32_t arg) {
+  return event < WORK_TRACE_EVENT_COUNT && arg < 2 ? g_events[event].args[arg]
+                                                   : "arg";
+}
+
+bool WorkEventTrace::IsAddressArg(uint16_t event, uint32_t arg) {
+  return event < WORK_TRACE_EVENT_COUNT && arg < 2 &&
+         g_events[event].address[arg];
+}
+
+uint32_t WorkEventTrace::Intern(const string &message) {
+  auto it = g_messageIds.find(message);
+  if (it != g_messageIds.end()) {
+    return it->second;
+  }
+  uint32_t id = g_messages.size();
+  g_messages.push_back(message);
+  g_messageIds[message] = id;
+  return id;
+}
+
+const string &WorkEventTrace::GetMessage(uint32_t id) {
+  return id < g_messages.size() ? g_messages[id] : g_messages[0];
+}
+
+uint64_t WorkEventTrace::GetRecorded(void) { return g_recorded; }
+
+uint64_t WorkEventTrace::GetOverwritten(void) { return g_overwritten; }
+
+} // Namespace ns3
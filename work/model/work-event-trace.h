@@ -0,0 +1,199 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#ifndef WORK_EVENT_TRACE_H
+#define WORK_EVENT_TRACE_H
+
+#include "ns3/address.h"
+#include <stdint.h>
+#include <string>
+
+using namespace std;
+
+namespace ns3 {
+
+/**
+ * \ingroup applications
+ *
+ * Events of the binary event trace, with the meaning of their arguments.
+ */
+enum WorkTraceEvent : uint16_t {
+  WORK_TRACE_DEVICE_CONNECTED,      //!< Local address, peer address
+  WORK_TRACE_DEVICE_SEND,           //!< Request id, size
+  WORK_TRACE_DEVICE_BLOCKED,        //!< Request id, size (socket buffer full)
+  WORK_TRACE_DEVICE_RECEIVE,        //!< Source address, size
+  WORK_TRACE_DEVICE_RESPONSE,       //!< Request id, accepted
+  WORK_TRACE_DEVICE_RETRANSMIT,     //!< Request id, retransmissions
+  WORK_TRACE_DEVICE_ABANDON,        //!< Request id, retransmissions
+  WORK_TRACE_SERVER_RECEIVE,        //!< Source address, size
+  WORK_TRACE_SERVER_REQUEST,        //!< Source address, request id
+  WORK_TRACE_SERVER_RESPONSE,       //!< Request id, accepted
+  WORK_TRACE_SERVER_DUPLICATE,      //!< Source address, request id
+  WORK_TRACE_DEVICE_CONNECT,        //!< Local address, peer address
+  WORK_TRACE_DEVICE_CONNECT_FAILED, //!< Local address, peer address
+  WORK_TRACE_EVENT_COUNT            //!< Number of events
+};
+
+/**
+ * \ingroup applications
+ *
+ * A record of the binary event trace, 32 bytes in host byte order.
+ */
+struct WorkTraceRecord {
+  int64_t time;      //!< Simulation time, in time steps
+  uint32_t node;     //!< Context of the event, the node id
+  uint16_t event;    //!< Event, a WorkTraceEvent
+  uint16_t reserved; //!< Padding, zero
+  uint64_t args[2];  //!< Numeric arguments of the event
+};
+
+/**
+ * \ingroup applications
+ *
+ * An event of a device, as reported by the DeviceEnforcer "Event" trace
+ * source. Plain data passed by reference: connecting the trace source
+ * copies no address nor string. Unused fields are zero.
+ */
+struct WorkEvent {
+  WorkTraceEvent code; //!< What happened
+  uint32_t device;     //!< Device id, see the DeviceEnforcer "DeviceId"
+  uint32_t message;    //!< Message, interned by WorkEventTrace::Intern
+  uint32_t id;         //!< Request id
+  uint32_t size;       //!< Bytes sent or received
+  uint64_t peer;       //!< Remote address, see WorkEventTrace::PackAddress
+  /// Round-trip time of a response or delay of a connection, in time
+  /// steps, zero if not measured
+  int64_t delay;
+};
+
+/**
+ * \ingroup applications
+ *
+ * \brief Binary trace of the work application events.
+ *
+ * Logging the hot paths of the applications (a line per packet sent or
+ * received) spends most of the run time formatting addresses and times.
+ * Instead, the WORK_TRACE macro appends a fixed size record with the time,
+ * the node, the event and two numeric arguments to a buffer; addresses are
+ * packed as IPv4 address and port. Nothing is done while the trace is not
+ * enabled, besides testing a flag.
+ *
+ * In file mode the buffer is written to the trace file every time it is
+ * full. In ring mode only the last records are kept and written when the
+ * trace is disabled, which happens at the latest on Simulator::Destroy.
+ * The file starts with a 16 bytes header: the "WORKTRC" magic, the format
+ * version and the record size. The work-trace-decoder example prints a
+ * trace file as text.
+ */
+class WorkEventTrace {
+public:
+  /**
+   * \brief Start recording the events
+   * \param filename the trace file
+   * \param capacity the number of records buffered
+   * \param ring true to keep only the last records
+   */
+  static void Enable(const string &filename, uint32_t capacity = 65536,
+                     bool ring = false);
+
+  /**
+   * \brief Write the buffered records and close the trace file
+   */
+  static void Disable(void);
+
+  /**
+   * \return true if the events are recorded
+   */
+  static bool IsEnabled(void) { return m_enabled; }
+
+  /**
+   * \brief Record an event at the current time and context
+   * \param event the event
+   * \param arg0 the first argument
+   * \param arg1 the second argument
+   */
+  static void Record(WorkTraceEvent event, uint64_t arg0, uint64_t arg1);
+
+  /**
+   * \param address an InetSocketAddress
+   * \return the IPv4 address and port packed in an argument, zero for other
+   *         addresses
+   */
+  static uint64_t PackAddress(const Address &address);
+
+  /**
+   * \param event the event
+   * \return the name of the event
+   */
+  static const char *GetEventName(uint16_t event);
+
+  /**
+   * \param event the event
+   * \param arg the argument index
+   * \return the name of the argument
+   */
+  static const char *GetArgName(uint16_t event, uint32_t arg);
+
+  /**
+   * \param event the event
+   * \param arg the argument index
+   * \return true if the argument is a packed address
+   */
+  static bool IsAddressArg(uint16_t event, uint32_t arg);
+
+  /**
+   * \brief Get the id of a message, registering it if needed
+   * \param message the message, e.g. "[Accepted]"
+   * \return the message id, zero is the empty message
+   */
+  static uint32_t Intern(const string &message);
+
+  /**
+   * \param id a message id returned by Intern
+   * \return the message
+   */
+  static const string &GetMessage(uint32_t id);
+
+  /**
+   * \return number of events recorded
+   */
+  static uint64_t GetRecorded(void);
+
+  /**
+   * \return number of records overwritten in ring mode
+   */
+  static uint64_t GetOverwritten(void);
+
+  /// Magic at the start of a trace file
+  static const char MAGIC[8];
+  /// Version of the trace file format
+  static const uint32_t VERSION = 1;
+
+private:
+  /**
+   * \brief Write the buffered records to the trace file
+   */
+  static void Flush(void);
+
+  static bool m_enabled; //!< True if the events are recorded
+};
+
+} // namespace ns3
+
+/**
+ * \ingroup applications
+ * \brief Record an event in the binary event trace, if enabled
+ * \param event the WorkTraceEvent
+ * \param arg0 the first numeric argument
+ * \param arg1 the second numeric argument
+ */
+#define WORK_TRACE(event, arg0, arg1)                                          \
+  do {                                                                         \
+    if (ns3::WorkEventTrace::IsEnabled()) {                                    \
+      ns3::WorkEventTrace::Record(event, arg0, arg1);                          \
+    }                                                                          \
+  } while (false)
+
+#endif /* WORK_EVENT_TRACE_H */
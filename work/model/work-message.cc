@@ -0,0 +1,196 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#include "work-message.h"
+#include "ns3/log.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE("WorkMessage");
+
+NS_OBJECT_ENSURE_REGISTERED(WorkMessageHeader);
+
+// IP TOS of each message class, the priority derived by Socket::SetIpTos
+// maps to AC_BE, AC_VO, AC_VI and AC_BK respectively
+static uint8_t g_classTos[] = {0x00, 0x10, 0x18, 0x08};
+
+TypeId WorkMessageHeader::GetTypeId(void) {
+  static TypeId tid = TypeId("ns3::WorkMessageHeader")
+                          .SetParent<Header>()
+                          .SetGroupName("Applications")
+                          .AddConstructor<WorkMessageHeader>();
+  return tid;
+}
+
+WorkMessageHeader::WorkMessageHeader()
+    : m_type(REQUEST), m_flags(0), m_payloadSize(0), m_id(0) {}
+
+void WorkMessageHeader::SetType(MessageType type) { m_type = type; }
+
+WorkMessageHeader::MessageType WorkMessageHeader::GetType(void) const {
+  return static_cast<MessageType>(m_type);
+}
+
+void WorkMessageHeader::SetId(uint32_t id) { m_id = id; }
+
+uint32_t WorkMessageHeader::GetId(void) const { return m_id; }
+
+void WorkMessageHeader::SetFlags(uint8_t flags) { m_flags = flags; }
+
+uint8_t WorkMessageHeader::GetFlags(void) const { return m_flags; }
+
+void WorkMessageHeader::SetClass(MessageClass messageClass) {
+  m_flags = (m_flags & ~CLASS_MASK) | GetClassFlags(messageClass);
+}
+
+WorkMessageHeader::MessageClass WorkMessageHeader::GetClass(void) const {
+  return static_cast<MessageClass>((m_flags & CLASS_MASK) >> 2);
+}
+
+uint8_t WorkMessageHeader::GetClassFlags(MessageClass messageClass) {
+  return (messageClass << 2) & CLASS_MASK;
+}
+
+void WorkMessageHeader::SetClassTos(MessageClass messageClass, uint8_t tos) {
+  g_classTos[messageClass & 0x03] = tos;
+}
+
+uint8_t WorkMessageHeader::GetClassTos(MessageClass messageClass) {
+  return g_classTos[messageClass & 0x03];
+}
+
+void WorkMessageHeader::SetPayloadSize(uint16_t size) { m_payloadSize = size; }
+
+uint16_t WorkMessageHeader::GetPayloadSize(void) const {
+  return m_payloadSize;
+}
+
+TypeId WorkMessageHeader::GetInstanceTypeId(void) const { return GetTypeId(); }
+
+void WorkMessageHeader::Print(std::ostream &os) const {
+  os << "(type=" << static_cast<uint32_t>(m_type)
+     << " flags=" << static_cast<uint32_t>(m_flags) << " id=" << m_id
+     << " size=" << m_payloadSize << ")";
+}
+
+uint32_t WorkMessageHeader::GetSerializedSize(void) const { return 8; }
+
+void WorkMessageHeader::Serialize(Buffer::Iterator start) const {
+  Buffer::Iterator i = start;
+  i.WriteU8(m_type);
+  i.WriteU8(m_flags);
+  i.WriteHtonU16(m_payloadSize);
+  i.WriteHtonU32(m_id);
+}
+
+uint32_t WorkMessageHeader::Deserialize(Buffer::Iterator start) {
+  Buffer::Iterator i = start;
+  m_type = i.ReadU8();
+  m_flags = i.ReadU8();
+  m_payloadSize = i.ReadNtohU16();
+  m_id = i.ReadNtohU32();
+  return GetSerializedSize();
+}
+
+WorkMessageFramer::WorkMessageFramer() : m_buffer(Create<Packet>(0)) {}
+
+/**
+ * \brief Prefix a payload with its message header
+ * \param packet the payload, modified
+ * \param type the message type
+ * \param id the request id
+ * \param flags the message flags
+ */
+static void AddMessageHeader(Ptr<Packet> packet,
+                             WorkMessageHeader::MessageType type, uint32_t id,
+                             uint8_t flags) {
+  WorkMessageHeader header;
+  header.SetType(type);
+  header.SetId(id);
+  header.SetFlags(flags);
+  header.SetPayloadSize(static_cast<uint16_t>(packet->GetSize()));
+  packet->AddHeader(header);
+}
+
+Ptr<Packet> WorkMessageFramer::Frame(WorkMessageHeader::MessageType type,
+                                     uint32_t id, const string &payload,
+                                     uint32_t size, uint8_t flags) {
+  Ptr<Packet> packet = MakePayload(payload, size);
+  AddMessageHeader(packet, type, id, flags);
+  return packet;
+}
+
+Ptr<Packet> WorkMessageFramer::Frame(WorkMessageHeader::MessageType type,
+                                     uint32_t id, Ptr<const Packet> payload,
+                                     uint8_t flags) {
+  NS_ABORT_MSG_IF(payload->GetSize() > 0xffff, "Work message too large");
+  // Copy on write: only the first copy can write its header in the free
+  // space before the shared bytes, the next ones reallocate the bytes,
+  // but the padding of MakePayload is not among them
+  Ptr<Packet> packet = payload->Copy();
+  AddMessageHeader(packet, type, id, flags);
+  return packet;
+}
+
+Ptr<Packet> WorkMessageFramer::MakePayload(const string &payload,
+                                           uint32_t size) {
+  uint32_t payloadSize = std::max<uint32_t>(payload.size(), size);
+  NS_ABORT_MSG_IF(payloadSize > 0xffff, "Work message too large");
+
+  Ptr<Packet> packet = Create<Packet>(
+      reinterpret_cast<const uint8_t *>(payload.data()), payload.size());
+  if (payloadSize > payload.size()) {
+    // The padding stays a virtual zero area of the buffer, it takes no
+    // memory and is never copied
+    packet->AddAtEnd(Create<Packet>(payloadSize - payload.size()));
+  }
+  return packet;
+}
+
+string WorkMessageFramer::Unwrap(const string &payload) {
+  size_t begin = payload.find('[');
+  if (begin == string::npos) {
+    return "";
+  }
+  size_t end = payload.find(']', begin);
+  if (end == string::npos) {
+    return "";
+  }
+  return payload.substr(begin + 1, end - begin - 1);
+}
+
+void WorkMessageFramer::Append(Ptr<const Packet> packet) {
+  m_buffer->AddAtEnd(packet);
+}
+
+bool WorkMessageFramer::Next(WorkMessageHeader &header, string &payload) {
+  if (m_buffer->GetSize() < header.GetSerializedSize()) {
+    return false;
+  }
+  m_buffer->PeekHeader(header);
+  uint32_t total = header.GetSerializedSize() + header.GetPayloadSize();
+  if (m_buffer->GetSize() < total) {
+    return false;
+  }
+
+  m_buffer->RemoveAtStart(header.GetSerializedSize());
+  payload.resize(header.GetPayloadSize());
+  if (!payload.empty()) {
+    m_buffer->CopyData(reinterpret_cast<uint8_t *>(&payload[0]),
+                       payload.size());
+    m_buffer->RemoveAtStart(payload.size());
+  }
+  NS_LOG_LOGIC("Extracted message " << header << " leaving "
+                                    << m_buffer->GetSize() << " bytes");
+  return true;
+}
+
+uint32_t WorkMessageFramer::GetBufferedSize(void) const {
+  return m_buffer->GetSize();
+}
+
+void WorkMessageFramer::Clear(void) { m_buffer = Create<Packet>(0); }
+
+} // Namespace ns3
@@ -0,0 +1,243 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#ifndef WORK_MESSAGE_H
+#define WORK_MESSAGE_H
+
+#include "ns3/header.h"
+#include "ns3/packet.h"
+#include "ns3/ptr.h"
+#include <string>
+
+using namespace std;
+
+namespace ns3 {
+
+/**
+ * \ingroup applications
+ *
+ * \brief Header framing every message exchanged by the work applications.
+ *
+ * Requests and responses travel over byte streams (TCP) where several
+ * messages may be coalesced or split across segments, so each message is
+ * prefixed with this header carrying its type, the request id it belongs to
+ * and the size of the payload that follows. The payload is the textual
+ * message, e.g. "[Message!]" for a request or "[Accepted]" for a response.
+ *
+ * The request id is chosen by the sender of the request and echoed back in
+ * the response, which allows proxies to multiplex requests from many devices
+ * over a single upstream connection.
+ *
+ * Invalidations are pushed by the server to the caching proxies when the
+ * decision for a request content ("[Message!]") changes, or for every
+ * content when FLAG_ALL is set.
+ *
+ * Every message also belongs to a class, carried in the flags and echoed in
+ * the response, that selects the IP TOS of its packets. The TOS in turn
+ * selects the socket priority and, on QoS Wi-Fi MACs, the EDCA access
+ * category: with the default TOS values urgent messages use AC_VO,
+ * interactive AC_VI, normal AC_BE and bulk AC_BK.
+ */
+class WorkMessageHeader : public Header {
+public:
+  /// Message types
+  enum MessageType : uint8_t {
+    REQUEST = 0,    //!< Device request
+    RESPONSE = 1,   //!< Server decision
+    INVALIDATE = 2, //!< Cached decision no longer valid
+  };
+
+  /// Message flags
+  enum Flags : uint8_t {
+    FLAG_CACHING = 0x01, //!< Request sent by a caching proxy
+    FLAG_ALL = 0x02,     //!< Invalidation of every cached decision
+    CLASS_MASK = 0x0c,   //!< Bits holding the message class
+  };
+
+  /// Message classes, from the most to the least time critical
+  enum MessageClass : uint8_t {
+    CLASS_NORMAL = 0,      //!< Default class, AC_BE
+    CLASS_URGENT = 1,      //!< Enforcement that cannot wait, AC_VO
+    CLASS_INTERACTIVE = 2, //!< Latency sensitive, AC_VI
+    CLASS_BULK = 3,        //!< Background, AC_BK
+  };
+
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId(void);
+
+  WorkMessageHeader();
+
+  /**
+   * \param type the message type
+   */
+  void SetType(MessageType type);
+  /**
+   * \return the message type
+   */
+  MessageType GetType(void) const;
+
+  /**
+   * \param id the request id
+   */
+  void SetId(uint32_t id);
+  /**
+   * \return the request id
+   */
+  uint32_t GetId(void) const;
+
+  /**
+   * \param flags the message flags
+   */
+  void SetFlags(uint8_t flags);
+  /**
+   * \return the message flags
+   */
+  uint8_t GetFlags(void) const;
+
+  /**
+   * \param messageClass the message class
+   */
+  void SetClass(MessageClass messageClass);
+  /**
+   * \return the message class
+   */
+  MessageClass GetClass(void) const;
+
+  /**
+   * \param messageClass the message class
+   * \return the flags bits selecting the class
+   */
+  static uint8_t GetClassFlags(MessageClass messageClass);
+
+  /**
+   * \brief Set the IP TOS used by the packets of a class
+   * \param messageClass the message class
+   * \param tos the IP TOS
+   */
+  static void SetClassTos(MessageClass messageClass, uint8_t tos);
+  /**
+   * \param messageClass the message class
+   * \return the IP TOS used by the packets of the class
+   */
+  static uint8_t GetClassTos(MessageClass messageClass);
+
+  /**
+   * \param size the size of the payload following the header
+   */
+  void SetPayloadSize(uint16_t size);
+  /**
+   * \return the size of the payload following the header
+   */
+  uint16_t GetPayloadSize(void) const;
+
+  // Inherited
+  virtual TypeId GetInstanceTypeId(void) const;
+  virtual void Print(std::ostream &os) const;
+  virtual uint32_t GetSerializedSize(void) const;
+  virtual void Serialize(Buffer::Iterator start) const;
+  virtual uint32_t Deserialize(Buffer::Iterator start);
+
+private:
+  uint8_t m_type;         //!< Message type
+  uint8_t m_flags;        //!< Message flags
+  uint16_t m_payloadSize; //!< Payload size
+  uint32_t m_id;          //!< Request id
+};
+
+/**
+ * \ingroup applications
+ *
+ * \brief Reassemble work messages out of a received byte stream.
+ *
+ * Received packets are appended to an internal buffer and complete messages
+ * (header plus payload) are extracted one at a time with Next ().
+ */
+class WorkMessageFramer {
+public:
+  WorkMessageFramer();
+
+  /**
+   * \brief Build a framed message ready to be sent
+   * \param type the message type
+   * \param id the request id
+   * \param payload the textual message
+   * \param size the minimum size of the payload, zero-padded if larger
+   * \param flags the message flags
+   * \return the framed packet
+   */
+  static Ptr<Packet> Frame(WorkMessageHeader::MessageType type, uint32_t id,
+                           const string &payload, uint32_t size = 0,
+                           uint8_t flags = 0);
+
+  /**
+   * \brief Build a framed message out of a payload template
+   *
+   * The template is not modified: the framed packet is a copy of it with
+   * the header in front. Only the first copy of a template writes its header
+   * in the free space of the shared buffer; the next ones reallocate the
+   * bytes of the buffer, the header and the text of the payload, but not
+   * its zero padding, which MakePayload keeps as a virtual zero area.
+   *
+   * \param type the message type
+   * \param id the request id
+   * \param payload the payload, as built by MakePayload
+   * \param flags the message flags
+   * \return the framed packet
+   */
+  static Ptr<Packet> Frame(WorkMessageHeader::MessageType type, uint32_t id,
+                           Ptr<const Packet> payload, uint8_t flags = 0);
+
+  /**
+   * \brief Build a payload to be framed many times
+   *
+   * The zero padding takes no memory in the packet buffer.
+   *
+   * \param payload the textual message
+   * \param size the minimum size of the payload, zero-padded if larger
+   * \return the payload packet
+   */
+  static Ptr<Packet> MakePayload(const string &payload, uint32_t size = 0);
+
+  /**
+   * \brief Extract the text between the first pair of brackets
+   * \param payload the textual message, e.g. "[Message!]"
+   * \return the message with brackets and padding removed, e.g. "Message!"
+   */
+  static string Unwrap(const string &payload);
+
+  /**
+   * \brief Append received data to the reassembly buffer
+   * \param packet the received packet
+   */
+  void Append(Ptr<const Packet> packet);
+
+  /**
+   * \brief Extract the next complete message, if any
+   * \param header the header of the extracted message
+   * \param payload the payload of the extracted message
+   * \return true if a complete message was extracted
+   */
+  bool Next(WorkMessageHeader &header, string &payload);
+
+  /**
+   * \return number of bytes waiting for the rest of their message
+   */
+  uint32_t GetBufferedSize(void) const;
+
+  /**
+   * \brief Drop any buffered data
+   */
+  void Clear(void);
+
+private:
+  Ptr<Packet> m_buffer; //!< Bytes received but not yet consumed
+};
+
+} // namespace ns3
+
+#endif /* WORK_MESSAGE_H */
@@ -0,0 +1,360 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#include "work-profiling-scheduler.h"
+#include "ns3/event-impl.h"
+#include "ns3/log.h"
+#include "ns3/map-scheduler.h"
+#include "ns3/object-factory.h"
+#include "ns3/simulator.h"
+#include "ns3/type-id.h"
+#include <algorithm>
+#include <chrono>
+#include <cxxabi.h>
+#include <iomanip>
+#include <stdlib.h>
+#include <typeindex>
+#include <unordered_map>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE("ProfilingScheduler");
+
+NS_OBJECT_ENSURE_REGISTERED(ProfilingScheduler);
+
+namespace {
+
+/// The profile, shared by the schedulers and kept after them
+struct Profile {
+  /// Events by callback type
+  std::vector<ProfilingScheduler::Entry> types;
+  /// Entry of each event type
+  std::unordered_map<std::type_index, uint32_t> indices;
+  /// Events by node id
+  std::vector<ProfilingScheduler::Entry> nodes;
+  /// Events without node
+  ProfilingScheduler::Entry none{"none", "", 0, 0};
+};
+
+/**
+ * \return the profile
+ */
+Profile &GetProfile(void) {
+  static Profile profile;
+  return profile;
+}
+
+/**
+ * An event timing the event it wraps, which it owns.
+ */
+class ProfiledEvent : public EventImpl {
+public:
+  /**
+   * \param event the event, its reference is taken over
+   * \param context the context of the event
+   */
+  ProfiledEvent(EventImpl *event, uint32_t context)
+      : m_event(event), m_context(context) {}
+  virtual ~ProfiledEvent() { m_event->Unref(); }
+
+private:
+  virtual void Notify(void) {
+    if (m_event->IsCancelled()) {
+      return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    m_event->Invoke();
+    std::chrono::duration<double> wall =
+        std::chrono::steady_clock::now() - start;
+    ProfilingScheduler::Record(typeid(*m_event), m_context, wall.count());
+  }
+
+  EventImpl *m_event; //!< The wrapped event
+  uint32_t m_context; //!< The context of the event
+};
+
+/**
+ * \brief Sort entries by decreasing wall time
+ * \param entries the entries
+ */
+void SortByWall(std::vector<ProfilingScheduler::Entry> &entries) {
+  std::stable_sort(entries.begin(), entries.end(),
+                   [](const ProfilingScheduler::Entry &a,
+                      const ProfilingScheduler::Entry &b) {
+                     return a.wall > b.wall;
+                   });
+}
+
+/**
+ * \brief Print entries
+ * \param os the output stream
+ * \param entries the entries, sorted
+ * \param top the number of entries printed
+ * \param total the wall time of all the events
+ */
+void PrintEntries(std::ostream &os,
+                  const std::vector<ProfilingScheduler::Entry> &entries,
+                  uint32_t top, double total) {
+  for (uint32_t i = 0; i < std::min<size_t>(top, entries.size()); ++i) {
+    const ProfilingScheduler::Entry &entry = entries[i];
+    if (entry.count == 0) {
+      break;
+    }
+    os << "    " << std::setw(10) << entry.wall << " s " << std::setw(6)
+       << std::fixed << std::setprecision(1)
+       << (total > 0 ? 100 * entry.wall / total : 0) << "% "
+       << std::setw(12) << entry.count << " events " << std::setw(8)
+       << 1e6 * entry.wall / entry.count << " us  " << entry.name;
+    os.unsetf(std::ios::floatfield);
+    os << std::setprecision(6);
+    if (!entry.layer.empty()) {
+      os << " (" << entry.layer << ")";
+    }
+    os << std::endl;
+  }
+}
+
+/**
+ * \param type a class or an argument type
+ * \return the layer of the type, empty if unknown
+ */
+std::string FindLayer(const std::string &type) {
+  static const std::vector<std::pair<std::string, std::vector<std::string>>>
+      layers = {
+          {"applications",
+           {"DeviceEnforcer", "WorkServer", "WorkAggregator", "WorkSendDriver",
+            "Application"}},
+          {"tcp", {"Tcp", "RttEstimator"}},
+          {"wifi",
+           {"Wifi", "Phy", "Mac", "Txop", "ChannelAccess", "FrameExchange",
+            "BlockAck", "Mpdu", "Ppdu", "Interference"}},
+          {"internet", {"Ipv4", "Ipv6", "Arp", "Udp", "Icmp", "Ndisc"}},
+          {"csma", {"Csma", "Bridge", "Queue", "TrafficControl"}},
+          {"timers", {"Timer", "Watchdog"}},
+          {"work", {"Work"}}};
+  for (const auto &layer : layers) {
+    for (const std::string &keyword : layer.second) {
+      if (type.find(keyword) != std::string::npos) {
+        return layer.first;
+      }
+    }
+  }
+  return "";
+}
+
+} // namespace
+
+TypeId ProfilingScheduler::GetTypeId(void) {
+  static TypeId tid =
+      TypeId("ns3::ProfilingScheduler")
+          .SetParent<Scheduler>()
+          .SetGroupName("Applications")
+          .AddConstructor<ProfilingScheduler>()
+          .AddAttribute("Scheduler", "Scheduler keeping the events",
+                        TypeIdValue(MapScheduler::GetTypeId()),
+                        MakeTypeIdAccessor(
+                            &ProfilingScheduler::m_schedulerType),
+                        MakeTypeIdChecker());
+  return tid;
+}
+
+ProfilingScheduler::ProfilingScheduler() { NS_LOG_FUNCTION(this); }
+
+ProfilingScheduler::~ProfilingScheduler() { NS_LOG_FUNCTION(this); }
+
+Ptr<Scheduler> ProfilingScheduler::GetScheduler(void) const {
+  if (!m_scheduler) {
+    ObjectFactory factory;
+    factory.SetTypeId(m_schedulerType);
+    m_scheduler = factory.Create<Scheduler>();
+  }
+  return m_scheduler;
+}
+
+void ProfilingScheduler::Insert(const Scheduler::Event &ev) {
+  GetScheduler()->Insert(ev);
+}
+
+bool ProfilingScheduler::IsEmpty(void) const {
+  return GetScheduler()->IsEmpty();
+}
+
+Scheduler::Event ProfilingScheduler::PeekNext(void) const {
+  return GetScheduler()->PeekNext();
+}
+
+Scheduler::Event ProfilingScheduler::RemoveNext(void) {
+  Scheduler::Event ev = GetScheduler()->RemoveNext();
+  // The simulator invokes and releases the wrapper like the event
+  ev.impl = new ProfiledEvent(ev.impl, ev.key.m_context);
+  return ev;
+}
+
+void ProfilingScheduler::Remove(const Scheduler::Event &ev) {
+  GetScheduler()->Remove(ev);
+}
+
+void ProfilingScheduler::Record(const std::type_info &type, uint32_t context,
+                                double wall) {
+  Profile &profile = GetProfile();
+  auto it = profile.indices.find(std::type_index(type));
+  if (it == profile.indices.end()) {
+    int status = 0;
+    char *demangled = abi::__cxa_demangle(type.name(), 0, 0, &status);
+    std::string name =
+        GetCallbackName(status == 0 ? demangled : type.name());
+    free(demangled);
+    // Events of different types may share a callback type
+    uint32_t index = 0;
+    while (index < profile.types.size() && profile.types[index].name != name) {
+      index++;
+    }
+    if (index == profile.types.size()) {
+      profile.types.push_back(Entry{name, GetLayer(name), 0, 0});
+    }
+    it = profile.indices.insert(std::make_pair(std::type_index(type), index))
+             .first;
+  }
+  Entry &entry = profile.types[it->second];
+  entry.count++;
+  entry.wall += wall;
+
+  Entry *node = &profile.none;
+  if (context != Simulator::NO_CONTEXT) {
+    while (profile.nodes.size() <= context) {
+      profile.nodes.push_back(
+          Entry{std::to_string(profile.nodes.size()), "", 0, 0});
+    }
+    node = &profile.nodes[context];
+  }
+  node->count++;
+  node->wall += wall;
+}
+
+const std::vector<ProfilingScheduler::Entry> &
+ProfilingScheduler::GetTypes(void) {
+  return GetProfile().types;
+}
+
+std::vector<ProfilingScheduler::Entry> ProfilingScheduler::GetLayers(void) {
+  std::vector<Entry> layers;
+  for (const Entry &type : GetProfile().types) {
+    auto layer = std::find_if(
+        layers.begin(), layers.end(),
+        [&type](const Entry &entry) { return entry.name == type.layer; });
+    if (layer == layers.end()) {
+      layers.push_back(Entry{type.layer, "", 0, 0});
+      layer = layers.end() - 1;
+    }
+    layer->count += type.count;
+    layer->wall += type.wall;
+  }
+  SortByWall(layers);
+  return layers;
+}
+
+std::vector<ProfilingScheduler::Entry> ProfilingScheduler::GetNodes(void) {
+  std::vector<Entry> nodes = GetProfile().nodes;
+  nodes.push_back(GetProfile().none);
+  return nodes;
+}
+
+void ProfilingScheduler::Print(std::ostream &os, uint32_t top) {
+  std::vector<Entry> layers = GetLayers();
+  uint64_t count = 0;
+  double total = 0;
+  for (const Entry &layer : layers) {
+    count += layer.count;
+    total += layer.wall;
+  }
+  os << "Event profile: " << count << " events, " << total
+     << " s of wall time" << std::endl;
+  os << "  Layers:" << std::endl;
+  PrintEntries(os, layers, layers.size(), total);
+  std::vector<Entry> types = GetTypes();
+  SortByWall(types);
+  os << "  Callback types:" << std::endl;
+  PrintEntries(os, types, top, total);
+  std::vector<Entry> nodes = GetNodes();
+  SortByWall(nodes);
+  os << "  Nodes:" << std::endl;
+  PrintEntries(os, nodes, top, total);
+}
+
+void ProfilingScheduler::Reset(void) {
+  Profile &profile = GetProfile();
+  profile.types.clear();
+  profile.indices.clear();
+  profile.nodes.clear();
+  profile.none.count = 0;
+  profile.none.wall = 0;
+}
+
+std::string ProfilingScheduler::GetCallbackName(const std::string &demangled) {
+  // "ns3::EventImpl* ns3::MakeEvent<void (ns3::DeviceEnforcer::*)(),
+  // ns3::DeviceEnforcer*>(...)::EventMemberImpl0": the first template
+  // argument of MakeEvent is the function called
+  std::string name = demangled;
+  size_t start = name.find("MakeEvent<");
+  if (start != std::string::npos) {
+    start += 10;
+    size_t end = start;
+    int depth = 0;
+    for (; end < name.size(); ++end) {
+      char c = name[end];
+      if (c == '<' || c == '(') {
+        depth++;
+      } else if ((c == '>' || c == ')') && depth-- == 0) {
+        break;
+      } else if (c == ',' && depth == 0) {
+        break;
+      }
+    }
+    name = name.substr(start, end - start);
+    // "void (ns3::DeviceEnforcer::*)()" to "ns3::DeviceEnforcer::*()"
+    size_t open = name.find(" (");
+    size_t close = name.find(')', open);
+    if (open != std::string::npos && close != std::string::npos) {
+      name = name.substr(open + 2, close - open - 2) + name.substr(close + 1);
+    }
+  }
+  size_t prefix;
+  while ((prefix = name.find("ns3::")) != std::string::npos) {
+    name.erase(prefix, 5);
+  }
+  return name;
+}
+
+std::string ProfilingScheduler::GetLayer(const std::string &name) {
+  // The class of the callback, before its arguments
+  size_t open = name.find('(');
+  std::string owner = name.substr(0, open);
+  std::string layer = FindLayer(owner);
+  if (layer.empty() && owner == "*" && open != std::string::npos) {
+    // A static or free function has no class, e.g. "*(Ptr<YansWifiPhy>,
+    // Ptr<WifiPpdu>, double)" for YansWifiChannel::Receive: the layer of
+    // the first argument with one, usually the object it works on
+    size_t start = open + 1;
+    int depth = 0;
+    for (size_t i = start; i < name.size() && layer.empty(); ++i) {
+      char c = name[i];
+      if (c == '<' || c == '(') {
+        depth++;
+      } else if (c == '>' || c == ')') {
+        depth--;
+      }
+      if ((c == ',' && depth == 0) || depth < 0) {
+        layer = FindLayer(name.substr(start, i - start));
+        start = i + 1;
+      }
+      if (depth < 0) {
+        break; // The end of the arguments
+      }
+    }
+  }
+  return layer.empty() ? "other" : layer;
+}
+
+} // Namespace ns3
@@ -0,0 +1,135 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#ifndef WORK_PROFILING_SCHEDULER_H
+#define WORK_PROFILING_SCHEDULER_H
+
+#include "ns3/scheduler.h"
+#include <ostream>
+#include <stdint.h>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup scheduler
+ * \brief an event scheduler measuring the events it hands out
+ *
+ * The events are kept by another scheduler, the "Scheduler" attribute.
+ * Every event removed for execution is wrapped in an event that times the
+ * original one with the wall clock and counts it by callback type and by
+ * node, the context of the event. ns-3 events do not keep the name of the
+ * method they call, so the callback type is the class and signature of the
+ * event, e.g. "DeviceEnforcer::*()" for the member functions of
+ * DeviceEnforcer without argument; the types are also grouped by layer
+ * (applications, tcp, wifi, internet, csma, timers) to tell which one
+ * dominates a scenario. The type of a static or free function has no
+ * class, e.g. "*(Ptr<YansWifiPhy>, Ptr<WifiPpdu>, double)": its layer is
+ * the one of its arguments.
+ *
+ * The profile is kept after Simulator::Destroy, until Reset. Each event
+ * costs an allocation and two clock reads more, so the scheduler is only
+ * meant for profiling runs:
+ *
+ *   ObjectFactory factory("ns3::ProfilingScheduler");
+ *   factory.Set("Scheduler", TypeIdValue(MapScheduler::GetTypeId()));
+ *   Simulator::SetScheduler(factory);
+ *   Simulator::Run();
+ *   ProfilingScheduler::Print(std::cout, 10);
+ */
+class ProfilingScheduler : public Scheduler {
+public:
+  /**
+   * Register this type.
+   * \return The object TypeId.
+   */
+  static TypeId GetTypeId(void);
+
+  /** Constructor. */
+  ProfilingScheduler();
+  /** Destructor. */
+  virtual ~ProfilingScheduler();
+
+  // Inherited
+  virtual void Insert(const Scheduler::Event &ev);
+  virtual bool IsEmpty(void) const;
+  virtual Scheduler::Event PeekNext(void) const;
+  virtual Scheduler::Event RemoveNext(void);
+  virtual void Remove(const Scheduler::Event &ev);
+
+  /// Executions and wall time of a kind of event
+  struct Entry {
+    std::string name;  //!< Callback type, node or layer
+    std::string layer; //!< Layer of a callback type
+    uint64_t count;    //!< Events executed
+    double wall;       //!< Wall time of the events in seconds
+  };
+
+  /**
+   * \brief Record an executed event
+   * \param type the type of the event
+   * \param context the context of the event, its node
+   * \param wall the wall time of the event in seconds
+   */
+  static void Record(const std::type_info &type, uint32_t context,
+                     double wall);
+
+  /**
+   * \return the events by callback type, in order of first execution
+   */
+  static const std::vector<Entry> &GetTypes(void);
+
+  /**
+   * \return the events by layer, sorted by wall time
+   */
+  static std::vector<Entry> GetLayers(void);
+
+  /**
+   * \return the events by node id, the last entry for the events without
+   *         node
+   */
+  static std::vector<Entry> GetNodes(void);
+
+  /**
+   * \brief Print the layers, and the callback types and nodes with the
+   *        largest wall time
+   * \param os the output stream
+   * \param top the number of callback types and nodes printed
+   */
+  static void Print(std::ostream &os, uint32_t top);
+
+  /**
+   * \brief Clear the profile
+   */
+  static void Reset(void);
+
+  /**
+   * \param demangled the demangled type of an event
+   * \return the callback type, e.g. "DeviceEnforcer::*()"
+   */
+  static std::string GetCallbackName(const std::string &demangled);
+
+  /**
+   * \param name a callback type
+   * \return its layer, e.g. "wifi", from its class, or from its arguments
+   *         for a function without class
+   */
+  static std::string GetLayer(const std::string &name);
+
+private:
+  /**
+   * \return the scheduler keeping the events, created on first use
+   */
+  Ptr<Scheduler> GetScheduler(void) const;
+
+  TypeId m_schedulerType;             //!< Type of the scheduler
+  mutable Ptr<Scheduler> m_scheduler; //!< Scheduler keeping the events
+};
+
+} // namespace ns3
+
+#endif /* WORK_PROFILING_SCHEDULER_H */
@@ -0,0 +1,101 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#include "work-send-driver.h"
+#include "work-device-enforcer.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include <algorithm>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE("WorkSendDriver");
+
+NS_OBJECT_ENSURE_REGISTERED(WorkSendDriver);
+
+TypeId WorkSendDriver::GetTypeId(void) {
+  static TypeId tid = TypeId("ns3::WorkSendDriver")
+                          .SetParent<Object>()
+                          .SetGroupName("Applications")
+                          .AddConstructor<WorkSendDriver>();
+  return tid;
+}
+
+WorkSendDriver::WorkSendDriver()
+    : m_firing(false), m_fired(0), m_dispatched(0) {
+  NS_LOG_FUNCTION(this);
+}
+
+WorkSendDriver::~WorkSendDriver() { NS_LOG_FUNCTION(this); }
+
+void WorkSendDriver::DoDispose(void) {
+  NS_LOG_FUNCTION(this);
+  Simulator::Cancel(m_event);
+  m_buckets.clear();
+  Object::DoDispose();
+}
+
+void WorkSendDriver::Schedule(DeviceEnforcer *device, Time deadline) {
+  NS_LOG_FUNCTION(this << device << deadline);
+  m_buckets[deadline].push_back(device);
+  // While dispatching, the event is armed once every device is done
+  if (!m_firing && (!m_event.IsRunning() || deadline < m_next)) {
+    Simulator::Cancel(m_event);
+    Arm();
+  }
+}
+
+void WorkSendDriver::Cancel(DeviceEnforcer *device, Time deadline) {
+  NS_LOG_FUNCTION(this << device << deadline);
+  auto it = m_buckets.find(deadline);
+  if (it == m_buckets.end()) {
+    // Bucket being dispatched, the device ignores the call
+    return;
+  }
+  std::vector<DeviceEnforcer *> &devices = it->second;
+  devices.erase(std::remove(devices.begin(), devices.end(), device),
+                devices.end());
+  if (devices.empty()) {
+    bool earliest = it == m_buckets.begin();
+    m_buckets.erase(it);
+    if (earliest && !m_firing) {
+      Simulator::Cancel(m_event);
+      Arm();
+    }
+  }
+}
+
+uint64_t WorkSendDriver::GetFired(void) const { return m_fired; }
+
+uint64_t WorkSendDriver::GetDispatched(void) const { return m_dispatched; }
+
+void WorkSendDriver::Arm(void) {
+  if (m_buckets.empty()) {
+    return;
+  }
+  m_next = m_buckets.begin()->first;
+  m_event = Simulator::Schedule(m_next - Simulator::Now(),
+                                &WorkSendDriver::Fire, this);
+}
+
+void WorkSendDriver::Fire(void) {
+  NS_LOG_FUNCTION(this);
+  auto it = m_buckets.begin();
+  std::vector<DeviceEnforcer *> devices;
+  devices.swap(it->second);
+  m_buckets.erase(it);
+  NS_LOG_LOGIC("Dispatching " << devices.size() << " devices");
+
+  m_fired++;
+  m_firing = true;
+  for (DeviceEnforcer *device : devices) {
+    m_dispatched++;
+    device->DriverSend();
+  }
+  m_firing = false;
+  Arm();
+}
+
+} // Namespace ns3
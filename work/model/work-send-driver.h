@@ -0,0 +1,106 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#ifndef WORK_SEND_DRIVER_H
+#define WORK_SEND_DRIVER_H
+
+#include "ns3/event-id.h"
+#include "ns3/nstime.h"
+#include "ns3/object.h"
+#include <map>
+#include <vector>
+
+namespace ns3 {
+
+class DeviceEnforcer;
+
+/**
+ * \ingroup applications
+ *
+ * \brief Coalesce the send events of many DeviceEnforcer applications.
+ *
+ * Without a driver every device owns the event of its next transmission,
+ * so every packet costs one scheduler insert per device. Devices sharing a
+ * driver (see the DeviceEnforcer "SendDriver" attribute) instead register
+ * the deadline of their next transmission in a bucket of the driver, and
+ * the driver keeps a single simulator event for the earliest bucket. When
+ * it fires, every device of the bucket sends its packet.
+ *
+ * Buckets hold the exact deadlines, so the timing of each device is the
+ * same as with its own event: devices running at the same data rate in
+ * phase share a bucket, the others get a bucket each. The scheduler
+ * operations are divided by the mean bucket occupancy, reported by
+ * GetDispatched () / GetFired ().
+ *
+ * A driver may be shared by every device of the simulation, but its event
+ * runs in the context of the node of the device that armed it: the other
+ * devices of the bucket send, and schedule the events of their sockets and
+ * stacks, under that node. Everything keyed by the context is then
+ * misattributed: the node of the WorkEventTrace records, the nodes of the
+ * ProfilingScheduler and of WorkMemoryAccounting, the node logs. The work
+ * scenario refuses the driver with these tools.
+ */
+class WorkSendDriver : public Object {
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId(void);
+
+  WorkSendDriver();
+
+  virtual ~WorkSendDriver();
+
+  /**
+   * \brief Register the next transmission of a device
+   * \param device the device
+   * \param deadline the absolute time of the transmission
+   */
+  void Schedule(DeviceEnforcer *device, Time deadline);
+
+  /**
+   * \brief Withdraw the next transmission of a device
+   * \param device the device
+   * \param deadline the absolute time the transmission was registered for
+   */
+  void Cancel(DeviceEnforcer *device, Time deadline);
+
+  /**
+   * \return number of simulator events fired, one per bucket
+   */
+  uint64_t GetFired(void) const;
+
+  /**
+   * \return number of transmissions dispatched to the devices
+   */
+  uint64_t GetDispatched(void) const;
+
+protected:
+  virtual void DoDispose(void);
+
+private:
+  /**
+   * \brief Schedule the simulator event of the earliest bucket
+   */
+  void Arm(void);
+
+  /**
+   * \brief Dispatch the earliest bucket to its devices
+   */
+  void Fire(void);
+
+  std::map<Time, std::vector<DeviceEnforcer *>>
+      m_buckets;         //!< Devices by deadline of their next transmission
+  EventId m_event;       //!< Event of the earliest bucket
+  Time m_next;           //!< Deadline of the scheduled event
+  bool m_firing;         //!< True while a bucket is being dispatched
+  uint64_t m_fired;      //!< Simulator events fired
+  uint64_t m_dispatched; //!< Transmissions dispatched
+};
+
+} // namespace ns3
+
+#endif /* WORK_SEND_DRIVER_H */
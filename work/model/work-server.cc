@@ -12,6 +12,7 @@
 #include "ns3/ipv6-packet-info-tag.h"
 #include "ns3/log.h"
 #include "ns3/node.h"
+#include "ns3/nstime.h"
 #include "ns3/packet.h"
 #include "ns3/simulator.h"
 #include "ns3/socket-factory.h"
@@ -19,6 +20,8 @@
 #include "ns3/tcp-socket-factory.h"
 #include "ns3/tcp-socket.h"
 #include "ns3/trace-source-accessor.h"
+#include "ns3/uinteger.h"
+#include "ns3/work-event-trace.h"
 
 namespace ns3 {
 
@@ -47,6 +50,19 @@ TypeId WorkServer::GetTypeId(void) {
               BooleanValue(false),
               MakeBooleanAccessor(&WorkServer::m_enableSeqTsSizeHeader),
               MakeBooleanChecker())
+          .AddAttribute(
+              "InvalidationInterval",
+              "Period at which every decision cached by the proxies is "
+              "invalidated, e.g. to model policy updates. Zero disables it.",
+              TimeValue(Seconds(0)),
+              MakeTimeAccessor(&WorkServer::m_invalidationInterval),
+              MakeTimeChecker())
+          .AddAttribute("DuplicateWindow",
+                        "Number of responses remembered per datagram peer "
+                        "to answer retransmitted requests.",
+                        UintegerValue(64),
+                        MakeUintegerAccessor(&WorkServer::m_duplicateWindow),
+                        MakeUintegerChecker<uint32_t>())
           .AddTraceSource("Rx", "A packet has been received",
                           MakeTraceSourceAccessor(&WorkServer::m_rxTrace),
                           "ns3::Packet::AddressTracedCallback")
@@ -66,6 +82,7 @@ WorkServer::WorkServer() {
   NS_LOG_FUNCTION(this);
   m_socket = 0;
   m_totalRx = 0;
+  m_duplicates = 0;
 }
 
 WorkServer::~WorkServer() { NS_LOG_FUNCTION(this); }
@@ -75,6 +92,11 @@ uint64_t WorkServer::GetTotalRx() const {
   return m_totalRx;
 }
 
+uint64_t WorkServer::GetDuplicates() const {
+  NS_LOG_FUNCTION(this);
+  return m_duplicates;
+}
+
 Ptr<Socket> WorkServer::GetListeningSocket(void) const {
   NS_LOG_FUNCTION(this);
   return m_socket;
@@ -87,8 +109,12 @@ std::list<Ptr<Socket>> WorkServer::GetAcceptedSockets(void) const {
 
 void WorkServer::DoDispose(void) {
   NS_LOG_FUNCTION(this);
+  Simulator::Cancel(m_invalidationEvent);
   m_socket = 0;
   m_socketList.clear();
+  m_framers.clear();
+  m_cachingSockets.clear();
+  m_sentResponses.clear();
 
   // chain up
   Application::DoDispose();
@@ -123,12 +149,19 @@ void WorkServer::StartApplication() // Called at time specified by Start
       MakeCallback(&WorkServer::HandleAccept, this));
   m_socket->SetCloseCallbacks(MakeCallback(&WorkServer::HandlePeerClose, this),
                               MakeCallback(&WorkServer::HandlePeerError, this));
+
+  if (!m_invalidationInterval.IsZero()) {
+    m_invalidationEvent = Simulator::Schedule(
+        m_invalidationInterval, &WorkServer::InvalidateAll, this);
+  }
 }
 
 void WorkServer::StopApplication() // Called at time specified by Stop
 {
   NS_LOG_FUNCTION(this);
   NS_LOG_INFO("Stopping work packet sink...");
+  Simulator::Cancel(m_invalidationEvent);
+  m_cachingSockets.clear();
   while (!m_socketList.empty()) // these are accepted sockets, close them
   {
     Ptr<Socket> acceptedSocket = m_socketList.front();
@@ -147,48 +180,17 @@ void WorkServer::HandleRead(Ptr<Socket> socket) {
   Ptr<Packet> packet;
   Address from;
   Address localAddress;
-  string newBuffer;
   while ((packet = socket->RecvFrom(from))) {
     if (packet->GetSize() == 0) { // EOF
       break;
     }
 
-    newBuffer.clear();
-    uint8_t *buffer = new uint8_t[packet->GetSize()];
-    packet->CopyData(buffer, packet->GetSize());
-    newBuffer = (char *)buffer;
-    size_t endOfMsg = newBuffer.find("]");
-    newBuffer = newBuffer.substr(0, endOfMsg + 1).c_str();
-
-    if (InetSocketAddress::IsMatchingType(from)) {
-      NS_LOG_INFO("Received packet from "
-                  << InetSocketAddress::ConvertFrom(from).GetIpv4()
-                  << " with message = " << newBuffer);
-    } else {
-      NS_LOG_INFO("Received packet from "
-                  << Inet6SocketAddress::ConvertFrom(from).GetIpv6()
-                  << " with message = " << newBuffer);
-    }
-
     m_totalRx += packet->GetSize();
-    if (InetSocketAddress::IsMatchingType(from)) {
-      NS_LOG_INFO("At time "
-                  << Simulator::Now().As(Time::S) << " packet sink received "
-                  << packet->GetSize() << " bytes from "
-                  << InetSocketAddress::ConvertFrom(from).GetIpv4() << " port "
-                  << InetSocketAddress::ConvertFrom(from).GetPort()
-                  << " total Rx " << m_totalRx << " bytes");
-    } else if (Inet6SocketAddress::IsMatchingType(from)) {
-      NS_LOG_INFO("At time "
-                  << Simulator::Now().As(Time::S) << " packet sink received "
-                  << packet->GetSize() << " bytes from "
-                  << Inet6SocketAddress::ConvertFrom(from).GetIpv6() << " port "
-                  << Inet6SocketAddress::ConvertFrom(from).GetPort()
-                  << " total Rx " << m_totalRx << " bytes");
-    }
+    WORK_TRACE(WORK_TRACE_SERVER_RECEIVE, WorkEventTrace::PackAddress(from),
+               packet->GetSize());
 
     if (!m_rxTrace.IsEmpty() || !m_rxTraceWithAddresses.IsEmpty() ||
-        (!m_rxTraceWithSeqTsSize.IsEmpty() && m_enableSeqTsSizeHeader)) {
+        m_enableSeqTsSizeHeader) {
       Ipv4PacketInfoTag interfaceInfo;
       Ipv6PacketInfoTag interface6Info;
       if (packet->RemovePacketTag(interfaceInfo)) {
@@ -202,17 +204,32 @@ void WorkServer::HandleRead(Ptr<Socket> socket) {
       }
       m_rxTrace(packet, from);
       m_rxTraceWithAddresses(packet, from, localAddress);
+    }
 
-      if (!m_rxTraceWithSeqTsSize.IsEmpty() && m_enableSeqTsSizeHeader) {
-        PacketReceived(packet, from, localAddress);
-      }
+    // Requests may be split or coalesced by the transport, only complete
+    // messages are handed over. Datagrams carry whole messages and are
+    // shared by every peer on the listening socket.
+    WorkMessageFramer datagramFramer;
+    WorkMessageFramer &framer =
+        socket->GetSocketType() == Socket::NS3_SOCK_DGRAM ? datagramFramer
+                                                          : m_framers[socket];
+    if (m_enableSeqTsSizeHeader) {
+      PacketReceived(packet, from, localAddress, framer);
+    } else {
+      framer.Append(packet);
+    }
+
+    WorkMessageHeader header;
+    string buffer;
+    while (framer.Next(header, buffer)) {
+      HandlePacket(header, buffer, socket, from);
     }
   }
-  HandlePacket(newBuffer, socket);
 }
 
 void WorkServer::PacketReceived(const Ptr<Packet> &p, const Address &from,
-                                const Address &localAddress) {
+                                const Address &localAddress,
+                                WorkMessageFramer &framer) {
   SeqTsSizeHeader header;
   Ptr<Packet> buffer;
 
@@ -223,6 +240,9 @@ void WorkServer::PacketReceived(const Ptr<Packet> &p, const Address &from,
 
   buffer = itBuffer->second;
   buffer->AddAtEnd(p);
+  if (buffer->GetSize() < header.GetSerializedSize()) {
+    return;
+  }
   buffer->PeekHeader(header);
 
   NS_ABORT_IF(header.GetSize() == 0);
@@ -238,6 +258,7 @@ void WorkServer::PacketReceived(const Ptr<Packet> &p, const Address &from,
     complete->RemoveHeader(header);
 
     m_rxTraceWithSeqTsSize(complete, from, localAddress, header);
+    framer.Append(complete);
 
     if (buffer->GetSize() > header.GetSerializedSize()) {
       buffer->PeekHeader(header);
@@ -249,10 +270,25 @@ void WorkServer::PacketReceived(const Ptr<Packet> &p, const Address &from,
 
 void WorkServer::HandlePeerClose(Ptr<Socket> socket) {
   NS_LOG_FUNCTION(this << socket);
+  // The device closed the connection, e.g. when idle: close our side too,
+  // or the socket stays in CLOSE_WAIT and the peer in FIN_WAIT_2
+  socket->Close();
+  ReleaseSocket(socket);
 }
 
 void WorkServer::HandlePeerError(Ptr<Socket> socket) {
   NS_LOG_FUNCTION(this << socket);
+  ReleaseSocket(socket);
+}
+
+void WorkServer::ReleaseSocket(Ptr<Socket> socket) {
+  NS_LOG_FUNCTION(this << socket);
+  socket->SetRecvCallback(MakeNullCallback<void, Ptr<Socket>>());
+  socket->SetCloseCallbacks(MakeNullCallback<void, Ptr<Socket>>(),
+                            MakeNullCallback<void, Ptr<Socket>>());
+  m_framers.erase(socket);
+  m_cachingSockets.erase(socket);
+  m_socketList.remove(socket);
 }
 
 bool WorkServer::HandleConnectRequest(Ptr<Socket> socket, const Address &from) {
@@ -276,22 +312,91 @@ void WorkServer::HandleAccept(Ptr<Socket> s, const Address &from) {
                          << Inet6SocketAddress::ConvertFrom(from).GetIpv6());
   }
   s->SetRecvCallback(MakeCallback(&WorkServer::HandleRead, this));
+  s->SetCloseCallbacks(MakeCallback(&WorkServer::HandlePeerClose, this),
+                       MakeCallback(&WorkServer::HandlePeerError, this));
   m_socketList.push_back(s);
 }
 
-void WorkServer::HandlePacket(string buffer, Ptr<Socket> socket) {
-  NS_LOG_FUNCTION(this << buffer);
-  if (!buffer.empty()) {
-    buffer = buffer.substr(1);
-    buffer = buffer.substr(0, buffer.size() - 1);
+void WorkServer::HandlePacket(const WorkMessageHeader &header, string buffer,
+                              Ptr<Socket> socket, const Address &from) {
+  NS_LOG_FUNCTION(this << header << socket);
+  if (header.GetType() != WorkMessageHeader::REQUEST) {
+    NS_LOG_WARN("Ignoring unexpected message " << header);
+    return;
+  }
 
-    string respStr = buffer.size() > 0 ? "[Accepted]" : "[Refused]";
+  if (header.GetFlags() & WorkMessageHeader::FLAG_CACHING) {
+    // The sender caches decisions and must be told when they change
+    m_cachingSockets.insert(socket);
+  }
 
-    Ptr<Packet> packet = Create<Packet>(
-        reinterpret_cast<const uint8_t *>(respStr.c_str()), respStr.size());
+  string request = WorkMessageFramer::Unwrap(buffer);
+  WORK_TRACE(WORK_TRACE_SERVER_REQUEST, WorkEventTrace::PackAddress(from),
+             header.GetId());
+
+  // Responses travel with the access category of their request
+  uint8_t classFlags = header.GetFlags() & WorkMessageHeader::CLASS_MASK;
+  socket->SetIpTos(WorkMessageHeader::GetClassTos(header.GetClass()));
+
+  bool datagram = socket->GetSocketType() == Socket::NS3_SOCK_DGRAM;
+  if (datagram) {
+    // A retransmitted request is answered again, not processed twice
+    SentResponses &sent = m_sentResponses[from];
+    auto it = sent.byId.find(header.GetId());
+    if (it != sent.byId.end()) {
+      WORK_TRACE(WORK_TRACE_SERVER_DUPLICATE,
+                 WorkEventTrace::PackAddress(from), header.GetId());
+      m_duplicates++;
+      socket->SendTo(WorkMessageFramer::Frame(WorkMessageHeader::RESPONSE,
+                                              header.GetId(), it->second, 0,
+                                              classFlags),
+                     0, from);
+      return;
+    }
+  }
 
+  string respStr = request.size() > 0 ? "[Accepted]" : "[Refused]";
+  WORK_TRACE(WORK_TRACE_SERVER_RESPONSE, header.GetId(), request.size() > 0);
+
+  Ptr<Packet> packet = WorkMessageFramer::Frame(
+      WorkMessageHeader::RESPONSE, header.GetId(), respStr, 0, classFlags);
+
+  if (datagram) {
+    SentResponses &sent = m_sentResponses[from];
+    sent.order.push_back(header.GetId());
+    sent.byId[header.GetId()] = respStr;
+    if (sent.order.size() > m_duplicateWindow) {
+      sent.byId.erase(sent.order.front());
+      sent.order.pop_front();
+    }
+    // The listening socket is not connected, reply to the sender
+    socket->SendTo(packet, 0, from);
+  } else {
     socket->Send(packet);
-    // NS_LOG_INFO(response);
+  }
+}
+
+void WorkServer::InvalidateDecision(const string &request) {
+  NS_LOG_FUNCTION(this << request);
+  for (Ptr<Socket> socket : m_cachingSockets) {
+    socket->Send(WorkMessageFramer::Frame(WorkMessageHeader::INVALIDATE, 0,
+                                          "[" + request + "]"));
+  }
+}
+
+void WorkServer::InvalidateAll(void) {
+  NS_LOG_FUNCTION(this);
+  NS_LOG_INFO("Invalidating every decision on " << m_cachingSockets.size()
+                                                << " caching proxies");
+  for (Ptr<Socket> socket : m_cachingSockets) {
+    socket->Send(WorkMessageFramer::Frame(WorkMessageHeader::INVALIDATE, 0,
+                                          "", 0,
+                                          WorkMessageHeader::FLAG_ALL));
+  }
+  Simulator::Cancel(m_invalidationEvent);
+  if (!m_invalidationInterval.IsZero()) {
+    m_invalidationEvent = Simulator::Schedule(
+        m_invalidationInterval, &WorkServer::InvalidateAll, this);
   }
 }
 
@@ -10,10 +10,15 @@
 #include "ns3/application.h"
 #include "ns3/event-id.h"
 #include "ns3/inet-socket-address.h"
+#include "ns3/nstime.h"
 #include "ns3/ptr.h"
 #include "ns3/seq-ts-size-header.h"
 #include "ns3/traced-callback.h"
+#include <deque>
+#include <map>
+#include <set>
 #include <unordered_map>
+#include "ns3/work-message.h"
 #include "ns3/work-utils.h"
 
 namespace ns3 {
@@ -53,6 +58,15 @@ class Packet;
  * as a callback on the receiving socket.  By default, when logging is
  * enabled, it prints out the size of packets and their address.
  * A tracing source to Receive() is also available.
+ *
+ * With a datagram socket factory (ns3::UdpSocketFactory) responses are sent
+ * back to the address each request came from. Devices retransmit requests
+ * that are not answered in time, so the last "DuplicateWindow" responses
+ * sent to every peer are remembered and a retransmitted request is answered
+ * again from this record instead of being processed twice.
+ *
+ * A response is sent with the IP TOS of the class of its request (see
+ * WorkMessageHeader::GetClassTos), so it gets the same access category.
  */
 class WorkServer : public Application {
 public:
@@ -70,6 +84,12 @@ public:
    */
   uint64_t GetTotalRx() const;
 
+  /**
+   * \return number of retransmitted requests answered from the record of
+   *         sent responses
+   */
+  uint64_t GetDuplicates() const;
+
   /**
    * \return pointer to listening socket
    */
@@ -80,6 +100,18 @@ public:
    */
   std::list<Ptr<Socket>> GetAcceptedSockets(void) const;
 
+  /**
+   * \brief Push an invalidation to the caching proxies
+   * \param request the request content whose decision changed, e.g.
+   *        "Message!"
+   */
+  void InvalidateDecision(const string &request);
+
+  /**
+   * \brief Push an invalidation of every decision to the caching proxies
+   */
+  void InvalidateAll(void);
+
   /**
    * TracedCallback signature for a reception with addresses and SeqTsSizeHeader
    *
@@ -104,10 +136,14 @@ public:
    */
   void HandleRead(Ptr<Socket> socket);
   /**
-   * \brief Handle a packet received by the application
+   * \brief Handle a complete message received by the application
+   * \param header the message header
+   * \param buffer the message payload
    * \param socket the receiving socket
+   * \param from the address the message is from
    */
-  virtual void HandlePacket(string buffer, Ptr<Socket> socket);
+  virtual void HandlePacket(const WorkMessageHeader &header, string buffer,
+                            Ptr<Socket> socket, const Address &from);
   bool HandleConnectRequest(Ptr<Socket> socket, const Address &from);
   /**
    * \brief Handle an incoming connection
@@ -125,18 +161,24 @@ public:
    * \param socket the connected socket
    */
   void HandlePeerError(Ptr<Socket> socket);
+  /**
+   * \brief Forget an accepted socket whose connection has ended
+   * \param socket the connected socket
+   */
+  void ReleaseSocket(Ptr<Socket> socket);
 
   /**
    * \brief Packet received: assemble byte stream to extract SeqTsSizeHeader
    * \param p received packet
    * \param from from address
    * \param localAddress local address
+   * \param framer the message framer fed with the stripped payloads
    *
    * The method assembles a received byte stream and extracts SeqTsSizeHeader
    * instances from the stream to export in a trace source.
    */
   void PacketReceived(const Ptr<Packet> &p, const Address &from,
-                      const Address &localAddress);
+                      const Address &localAddress, WorkMessageFramer &framer);
 
   /**
    * \brief Hashing for the Address class
@@ -166,6 +208,21 @@ public:
   // listening socket is stored separately from the accepted sockets
   Ptr<Socket> m_socket;                //!< Listening socket
   std::list<Ptr<Socket>> m_socketList; //!< the accepted sockets
+  std::map<Ptr<Socket>, WorkMessageFramer>
+      m_framers; //!< Message reassembly per receiving socket
+  std::set<Ptr<Socket>> m_cachingSockets; //!< Sockets of the caching proxies
+  Time m_invalidationInterval; //!< Period of the decision invalidations
+  EventId m_invalidationEvent; //!< Next invalidation of every decision
+
+  /// Responses recently sent to a datagram peer
+  struct SentResponses {
+    std::deque<uint32_t> order;                //!< Request ids, oldest first
+    std::unordered_map<uint32_t, string> byId; //!< Responses by request id
+  };
+  std::map<Address, SentResponses>
+      m_sentResponses;        //!< Recent responses by datagram peer
+  uint32_t m_duplicateWindow; //!< Responses remembered per datagram peer
+  uint64_t m_duplicates;      //!< Retransmitted requests answered again
 
   Address m_local;      //!< Local address to bind to (address and port)
   uint16_t m_localPort; //!< Local port to bind to
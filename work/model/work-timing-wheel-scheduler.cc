@@ -0,0 +1,241 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#include "work-timing-wheel-scheduler.h"
+#include "ns3/assert.h"
+#include "ns3/event-impl.h"
+#include "ns3/log.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE("TimingWheelScheduler");
+
+NS_OBJECT_ENSURE_REGISTERED(TimingWheelScheduler);
+
+TypeId TimingWheelScheduler::GetTypeId(void) {
+  static TypeId tid =
+      TypeId("ns3::TimingWheelScheduler")
+          .SetParent<Scheduler>()
+          .SetGroupName("Applications")
+          .AddConstructor<TimingWheelScheduler>()
+          .AddAttribute("Granularity",
+                        "Duration of a tick of the lowest wheel, events of "
+                        "the same tick are sorted on insertion in the tick",
+                        TimeValue(MicroSeconds(1)),
+                        MakeTimeAccessor(&TimingWheelScheduler::m_granularity),
+                        MakeTimeChecker(TimeStep(1)));
+  return tid;
+}
+
+TimingWheelScheduler::TimingWheelScheduler()
+    : m_tickSize(0), m_current(0), m_size(0), m_inWheels(0) {
+  NS_LOG_FUNCTION(this);
+  for (uint32_t level = 0; level < LEVELS; level++) {
+    for (uint32_t slot = 0; slot < SLOTS; slot++) {
+      m_slots[level][slot] = 0;
+    }
+    for (uint32_t word = 0; word < SLOTS / 64; word++) {
+      m_occupied[level][word] = 0;
+    }
+  }
+}
+
+TimingWheelScheduler::~TimingWheelScheduler() {
+  NS_LOG_FUNCTION(this);
+  for (auto &entry : m_nodes) {
+    delete entry.second;
+  }
+  for (Node *node : m_free) {
+    delete node;
+  }
+}
+
+void TimingWheelScheduler::Insert(const Scheduler::Event &ev) {
+  NS_LOG_FUNCTION(this << ev.impl << ev.key.m_ts << ev.key.m_uid);
+  Node *node = Allocate();
+  node->ev = ev;
+  node->tick = GetTick(ev.key.m_ts);
+  Place(node);
+  m_nodes[ev.key.m_uid] = node;
+  m_size++;
+}
+
+bool TimingWheelScheduler::IsEmpty(void) const { return m_size == 0; }
+
+Scheduler::Event TimingWheelScheduler::PeekNext(void) const {
+  NS_LOG_FUNCTION(this);
+  NS_ASSERT(!IsEmpty());
+  // Moving the current tick forward does not change the scheduled events
+  const_cast<TimingWheelScheduler *>(this)->Advance();
+  return m_ready.begin()->second->ev;
+}
+
+Scheduler::Event TimingWheelScheduler::RemoveNext(void) {
+  NS_LOG_FUNCTION(this);
+  NS_ASSERT(!IsEmpty());
+  Advance();
+  auto it = m_ready.begin();
+  Node *node = it->second;
+  m_ready.erase(it);
+  Scheduler::Event ev = node->ev;
+  m_nodes.erase(ev.key.m_uid);
+  Release(node);
+  m_size--;
+  return ev;
+}
+
+void TimingWheelScheduler::Remove(const Scheduler::Event &ev) {
+  NS_LOG_FUNCTION(this << ev.impl << ev.key.m_ts << ev.key.m_uid);
+  auto it = m_nodes.find(ev.key.m_uid);
+  NS_ASSERT(it != m_nodes.end());
+  Node *node = it->second;
+  m_nodes.erase(it);
+
+  switch (node->location) {
+  case IN_READY:
+    m_ready.erase(node->ev.key);
+    break;
+  case IN_WHEEL:
+    Unlink(node);
+    m_inWheels--;
+    break;
+  case IN_OVERFLOW: {
+    auto range = m_overflow.equal_range(node->tick);
+    for (auto far = range.first; far != range.second; ++far) {
+      if (far->second == node) {
+        m_overflow.erase(far);
+        break;
+      }
+    }
+    break;
+  }
+  }
+  Release(node);
+  m_size--;
+}
+
+uint64_t TimingWheelScheduler::GetTick(uint64_t ts) {
+  if (m_tickSize == 0) {
+    // Resolved on first use, once the time resolution is fixed
+    m_tickSize = std::max<int64_t>(m_granularity.GetTimeStep(), 1);
+  }
+  return ts / m_tickSize;
+}
+
+void TimingWheelScheduler::Place(Node *node) {
+  if (node->tick <= m_current) {
+    node->location = IN_READY;
+    m_ready[node->ev.key] = node;
+    return;
+  }
+  uint64_t diff = node->tick ^ m_current;
+  if (diff >> (8 * LEVELS)) {
+    node->location = IN_OVERFLOW;
+    m_overflow.insert(std::make_pair(node->tick, node));
+    return;
+  }
+
+  // The wheel of the most significant byte that differs
+  uint32_t level = 0;
+  while (diff >> (8 * (level + 1))) {
+    level++;
+  }
+  uint32_t slot = (node->tick >> (8 * level)) & (SLOTS - 1);
+  node->location = IN_WHEEL;
+  node->level = level;
+  node->slot = slot;
+  node->prev = 0;
+  node->next = m_slots[level][slot];
+  if (node->next) {
+    node->next->prev = node;
+  }
+  m_slots[level][slot] = node;
+  m_occupied[level][slot / 64] |= uint64_t(1) << (slot % 64);
+  m_inWheels++;
+}
+
+void TimingWheelScheduler::Unlink(Node *node) {
+  if (node->prev) {
+    node->prev->next = node->next;
+  } else {
+    m_slots[node->level][node->slot] = node->next;
+    if (!node->next) {
+      m_occupied[node->level][node->slot / 64] &=
+          ~(uint64_t(1) << (node->slot % 64));
+    }
+  }
+  if (node->next) {
+    node->next->prev = node->prev;
+  }
+}
+
+uint32_t TimingWheelScheduler::NextSlot(uint32_t level, uint32_t start) const {
+  uint32_t slot = start;
+  while (slot < SLOTS) {
+    uint32_t word = slot / 64;
+    uint64_t bits = m_occupied[level][word] >> (slot % 64);
+    if (bits) {
+      return slot + __builtin_ctzll(bits);
+    }
+    slot = (word + 1) * 64;
+  }
+  return SLOTS;
+}
+
+void TimingWheelScheduler::Advance(void) {
+  while (m_ready.empty()) {
+    NS_ASSERT(m_size > 0);
+    if (m_inWheels == 0) {
+      // Jump to the first far event and bring the events now in the range
+      // of the wheels back
+      auto far = m_overflow.begin();
+      m_current = far->first;
+      while (far != m_overflow.end() &&
+             ((far->first ^ m_current) >> (8 * LEVELS)) == 0) {
+        Node *node = far->second;
+        far = m_overflow.erase(far);
+        Place(node);
+      }
+      continue;
+    }
+
+    // The slot of the current tick is always empty in every wheel, events
+    // due at the current tick are ready
+    for (uint32_t level = 0; level < LEVELS; level++) {
+      uint32_t shift = 8 * level;
+      uint32_t slot = NextSlot(level, ((m_current >> shift) & (SLOTS - 1)) + 1);
+      if (slot == SLOTS) {
+        continue;
+      }
+      m_current = ((m_current >> (shift + 8)) << (shift + 8)) |
+                  (uint64_t(slot) << shift);
+      NS_LOG_LOGIC("Cascading wheel " << level << " slot " << slot
+                                      << ", tick " << m_current);
+      Node *node = m_slots[level][slot];
+      m_slots[level][slot] = 0;
+      m_occupied[level][slot / 64] &= ~(uint64_t(1) << (slot % 64));
+      while (node) {
+        Node *next = node->next;
+        m_inWheels--;
+        Place(node);
+        node = next;
+      }
+      break;
+    }
+  }
+}
+
+TimingWheelScheduler::Node *TimingWheelScheduler::Allocate(void) {
+  if (m_free.empty()) {
+    return new Node;
+  }
+  Node *node = m_free.back();
+  m_free.pop_back();
+  return node;
+}
+
+void TimingWheelScheduler::Release(Node *node) { m_free.push_back(node); }
+
+} // Namespace ns3
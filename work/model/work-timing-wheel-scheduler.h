@@ -0,0 +1,139 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
+
+#ifndef WORK_TIMING_WHEEL_SCHEDULER_H
+#define WORK_TIMING_WHEEL_SCHEDULER_H
+
+#include "ns3/nstime.h"
+#include "ns3/scheduler.h"
+#include <map>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup scheduler
+ * \brief a hierarchical timing wheel event scheduler
+ *
+ * Time is divided in ticks of "Granularity" and events are hashed in four
+ * wheels of 256 slots each: an event goes to the wheel of the most
+ * significant byte in which its tick differs from the current tick, in the
+ * slot given by that byte. Events further than 2^32 ticks away wait in an
+ * overflow map. When the current tick has no more events, the next
+ * occupied slot of the lowest wheel becomes current; if the lowest wheel is
+ * empty, the next occupied slot of a higher wheel is cascaded into the
+ * lower ones.
+ *
+ * Insert and Remove are O(1). The events of the current tick are kept in a
+ * small ordered map so they are still dispatched in timestamp and uid
+ * order, as with the other schedulers. This suits the work scenario where
+ * every device reschedules its next transmission a few milliseconds ahead:
+ * with the default 1 us granularity only the devices transmitting in the
+ * same microsecond share a tick.
+ *
+ * This class uses the following memory: each event is held in a node of
+ * 56 bytes (on 64 bit systems) indexed by uid in a hash map, plus 4 * 256
+ * slot pointers.
+ */
+class TimingWheelScheduler : public Scheduler {
+public:
+  /**
+   * Register this type.
+   * \return The object TypeId.
+   */
+  static TypeId GetTypeId(void);
+
+  /** Constructor. */
+  TimingWheelScheduler();
+  /** Destructor. */
+  virtual ~TimingWheelScheduler();
+
+  // Inherited
+  virtual void Insert(const Scheduler::Event &ev);
+  virtual bool IsEmpty(void) const;
+  virtual Scheduler::Event PeekNext(void) const;
+  virtual Scheduler::Event RemoveNext(void);
+  virtual void Remove(const Scheduler::Event &ev);
+
+private:
+  /// Number of wheels
+  static const uint32_t LEVELS = 4;
+  /// Slots per wheel
+  static const uint32_t SLOTS = 256;
+
+  /// Location of a scheduled event
+  enum Location : uint8_t {
+    IN_WHEEL,    //!< In a wheel slot
+    IN_READY,    //!< Due at the current tick
+    IN_OVERFLOW, //!< Too far in the future for the wheels
+  };
+
+  /// A scheduled event
+  struct Node {
+    Scheduler::Event ev; //!< The event
+    uint64_t tick;       //!< Tick of the event
+    Node *prev;          //!< Previous node in the slot
+    Node *next;          //!< Next node in the slot
+    Location location;   //!< Where the node is stored
+    uint8_t level;       //!< Wheel, if in a wheel slot
+    uint8_t slot;        //!< Slot, if in a wheel slot
+  };
+
+  /**
+   * \brief Convert a timestamp to a tick
+   * \param ts the timestamp
+   * \return the tick
+   */
+  uint64_t GetTick(uint64_t ts);
+  /**
+   * \brief Store a node where its tick belongs relative to the current tick
+   * \param node the node
+   */
+  void Place(Node *node);
+  /**
+   * \brief Unlink a node from its wheel slot
+   * \param node the node
+   */
+  void Unlink(Node *node);
+  /**
+   * \brief Find the next occupied slot of a wheel
+   * \param level the wheel
+   * \param start the first slot to consider
+   * \return the slot, or SLOTS if none
+   */
+  uint32_t NextSlot(uint32_t level, uint32_t start) const;
+  /**
+   * \brief Move the current tick forward until events are due
+   */
+  void Advance(void);
+  /**
+   * \brief Get a node from the free list or allocate it
+   * \return the node
+   */
+  Node *Allocate(void);
+  /**
+   * \brief Return a node to the free list
+   * \param node the node
+   */
+  void Release(Node *node);
+
+  Time m_granularity;                            //!< Duration of a tick
+  uint64_t m_tickSize;                           //!< Tick in time steps
+  uint64_t m_current;                            //!< Current tick
+  uint32_t m_size;                               //!< Number of scheduled events
+  uint32_t m_inWheels;                           //!< Events in the wheels
+  Node *m_slots[LEVELS][SLOTS];                  //!< Slot lists of every wheel
+  uint64_t m_occupied[LEVELS][SLOTS / 64];       //!< Non empty slots bitmaps
+  std::map<Scheduler::EventKey, Node *> m_ready; //!< Events of the tick
+  std::multimap<uint64_t, Node *> m_overflow;    //!< Far events by tick
+  std::unordered_map<uint32_t, Node *> m_nodes;  //!< Events by uid
+  std::vector<Node *> m_free;                    //!< Released nodes
+};
+
+} // namespace ns3
+
+#endif /* WORK_TIMING_WHEEL_SCHEDULER_H */
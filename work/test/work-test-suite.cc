@@ -1,68 +1,924 @@
 /* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Author:  Giovanni Rosa (giovanni_rosa4@hotmail.com)
+ */
 
-// Include a header file from your module to test.
-// #include "ns3/work.h"
+// Performance regression tests of the work module.
+//
+// The scenarios are small and deterministic, so the number of requests,
+// the goodput, the round-trip time and the number of simulator events are
+// known in advance. A change that sends fewer requests, delays them or
+// spends more events per delivered message fails the suite instead of
+// showing up in the long runs. The microbenchmarks of the framer check that
+// the reassembly cost per message does not grow with the stream.
 
-// An essential include is test.h
+#include "ns3/core-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/network-module.h"
 #include "ns3/test.h"
+#include "ns3/work-device-enforcer.h"
+#include "ns3/work-event-counters.h"
+#include "ns3/work-decision-cache.h"
+#include "ns3/work-message.h"
+#include "ns3/work-profiling-scheduler.h"
+#include "ns3/work-scenario.h"
+#include "ns3/work-send-driver.h"
+#include "ns3/work-server.h"
+#include "ns3/work-timing-wheel-scheduler.h"
+#include <chrono>
+#include <iterator>
+#include <random>
+#include <set>
 
 // Do not put your test classes in namespace ns3.  You may find it useful
 // to use the using directive to access the ns3 namespace directly
 using namespace ns3;
 
-// This is an example TestCase.
-class WorkTestCase1 : public TestCase
-{
+NS_LOG_COMPONENT_DEFINE("WorkTestSuite");
+
+/**
+ * \ingroup applications
+ *
+ * Totals of a scenario run, filled by the trace sinks.
+ */
+struct WorkRunTotals {
+  uint64_t serverBytes{0}; //!< Bytes received by the server
+  uint64_t rttSamples{0};  //!< Round-trip times measured
+  Time rttSum{0};          //!< Sum of the round-trip times
+
+  /**
+   * \param packet a packet received by the server
+   * \param from its source
+   */
+  void ServerRx(Ptr<const Packet> packet, const Address &from) {
+    serverBytes += packet->GetSize();
+  }
+
+  /**
+   * \param rtt the round-trip time of a response
+   */
+  void Rtt(Time rtt) {
+    rttSamples++;
+    rttSum += rtt;
+  }
+
+  /**
+   * \return the mean round-trip time
+   */
+  Time GetMeanRtt(void) const {
+    return rttSamples ? rttSum / int64_t(rttSamples) : Time(0);
+  }
+};
+
+/**
+ * \ingroup applications
+ *
+ * \brief Devices and a server on a single simple channel.
+ *
+ * Without Wi-Fi nor contention the outcome is known exactly: every device
+ * sends DataRate / (8 * PacketSize) requests per second, each answered
+ * after two channel delays and the transmission times.
+ */
+class WorkSimpleScenarioTestCase : public TestCase {
 public:
-  WorkTestCase1 ();
-  virtual ~WorkTestCase1 ();
+  /**
+   * \param protocol the request transport, tcp or udp
+   * \param nDevices the number of devices
+   */
+  WorkSimpleScenarioTestCase(string protocol, uint32_t nDevices);
 
 private:
-  virtual void DoRun (void);
+  virtual void DoRun(void);
+
+  string m_protocol;   //!< Request transport
+  uint32_t m_nDevices; //!< Number of devices
 };
 
-// Add some help text to this case to describe what it is intended to test
-WorkTestCase1::WorkTestCase1 ()
-  : TestCase ("Work test case (does nothing)")
-{
+WorkSimpleScenarioTestCase::WorkSimpleScenarioTestCase(string protocol,
+                                                       uint32_t nDevices)
+    : TestCase("Requests, goodput, RTT and events of " +
+               std::to_string(nDevices) + " " + protocol +
+               " devices on a simple channel"),
+      m_protocol(protocol), m_nDevices(nDevices) {}
+
+void WorkSimpleScenarioTestCase::DoRun(void) {
+  const uint32_t packetSize = 500;    // Request size in bytes
+  const DataRate rate("100kbps");     // Rate of each device
+  const DataRate linkRate("10Mbps");  // Rate of the net devices
+  const Time delay = MilliSeconds(2); // Channel delay
+  const Time start = Seconds(1);      // Start of the devices
+  const Time active = Seconds(10);    // Sending time of the devices
+  bool datagram = m_protocol == "udp";
+  TypeId protocol = datagram ? UdpSocketFactory::GetTypeId()
+                             : TcpSocketFactory::GetTypeId();
+
+  NodeContainer nodes;
+  nodes.Create(m_nDevices + 1);
+  SimpleNetDeviceHelper simple;
+  simple.SetChannelAttribute("Delay", TimeValue(delay));
+  simple.SetDeviceAttribute("DataRate", DataRateValue(linkRate));
+  NetDeviceContainer devices = simple.Install(nodes);
+  InternetStackHelper internet;
+  internet.Install(nodes);
+  Ipv4AddressHelper address;
+  address.SetBase("10.0.0.0", "255.255.255.0");
+  Ipv4InterfaceContainer interfaces = address.Assign(devices);
+
+  WorkRunTotals totals;
+  Address serverAddress(InetSocketAddress(interfaces.GetAddress(0), 50000));
+  Ptr<WorkServer> server = CreateObject<WorkServer>();
+  server->SetAttribute("Protocol", TypeIdValue(protocol));
+  server->SetAttribute("Local", AddressValue(serverAddress));
+  server->TraceConnectWithoutContext(
+      "Rx", MakeCallback(&WorkRunTotals::ServerRx, &totals));
+  nodes.Get(0)->AddApplication(server);
+
+  for (uint32_t i = 1; i <= m_nDevices; ++i) {
+    Ptr<DeviceEnforcer> device = CreateObject<DeviceEnforcer>();
+    device->SetAttribute("Protocol", TypeIdValue(protocol));
+    device->SetAttribute("Local", AddressValue(InetSocketAddress(
+                                      interfaces.GetAddress(i), 50000)));
+    device->SetAttribute("Remote", AddressValue(serverAddress));
+    device->SetAttribute("DataRate", DataRateValue(rate));
+    device->SetAttribute("PacketSize", UintegerValue(packetSize));
+    device->SetStartTime(start);
+    device->SetStopTime(start + active);
+    device->TraceConnectWithoutContext(
+        "Rtt", MakeCallback(&WorkRunTotals::Rtt, &totals));
+    nodes.Get(i)->AddApplication(device);
+  }
+  WorkEventCounters counters;
+  counters.Install();
+
+  Simulator::Stop(start + active + Seconds(1));
+  Simulator::Run();
+  uint64_t events = Simulator::GetEventCount();
+  Simulator::Destroy();
+
+  // The first request is sent one interval after the start
+  double perDevice = active.GetSeconds() * rate.GetBitRate() /
+                     (8.0 * packetSize);
+  uint64_t sent = counters.GetTotal(WORK_TRACE_DEVICE_SEND);
+  uint64_t responses = counters.GetTotal(WORK_TRACE_DEVICE_RESPONSE);
+  NS_TEST_ASSERT_MSG_EQ_TOL(double(sent), perDevice * m_nDevices,
+                            m_nDevices, "Unexpected number of requests");
+  NS_TEST_ASSERT_MSG_EQ(counters.GetTotal(WORK_TRACE_DEVICE_RETRANSMIT), 0u,
+                        "Requests retransmitted on a lossless channel");
+  // Only the requests sent as the devices stop may stay unanswered
+  NS_TEST_ASSERT_MSG_EQ_TOL(double(responses), double(sent), m_nDevices,
+                            "Requests left unanswered");
+
+  // Goodput of the requests at the server, the message headers included
+  double goodput = totals.serverBytes * 8.0 / active.GetSeconds();
+  double offered = double(rate.GetBitRate()) * m_nDevices;
+  NS_TEST_ASSERT_MSG_EQ_TOL(goodput, offered, offered * 0.02,
+                            "Unexpected goodput");
+
+  // Two channel delays, the request and the small response on the links
+  Time expectedRtt = delay * 2 + linkRate.CalculateBytesTxTime(packetSize);
+  NS_TEST_ASSERT_MSG_EQ(totals.rttSamples, responses,
+                        "Responses without RTT sample");
+  NS_TEST_ASSERT_MSG_EQ_TOL(totals.GetMeanRtt(), expectedRtt,
+                            MilliSeconds(1), "Unexpected mean RTT");
+
+  if (datagram) {
+    // Per request: the send event, its retransmission timer, then for the
+    // request and the response one end of transmission and one reception
+    // by each other device of the channel. ARP and the start of the
+    // applications are covered by the 25% margin.
+    double budget = 1.25 * (2 + 2 * (1 + m_nDevices));
+    double perResponse = double(events) / std::max<uint64_t>(responses, 1);
+    NS_LOG_INFO(perResponse << " events per response, budget " << budget);
+    NS_TEST_ASSERT_MSG_LT_OR_EQ(perResponse, budget,
+                                "More simulator events per response");
+  }
 }
 
-// This destructor does nothing but we include it as a reminder that
-// the test case should clean up after itself
-WorkTestCase1::~WorkTestCase1 ()
-{
+/**
+ * \ingroup applications
+ *
+ * \brief TCP devices closing their connection when idle.
+ *
+ * The devices send one request per second and close the connection after
+ * 200 ms without request in flight, so every request opens a connection.
+ * The requests must still be answered, and the server must release the
+ * sockets of the closed connections instead of accumulating them.
+ */
+class WorkIdleScenarioTestCase : public TestCase {
+public:
+  /**
+   * \param nDevices the number of devices
+   */
+  WorkIdleScenarioTestCase(uint32_t nDevices);
+
+private:
+  virtual void DoRun(void);
+
+  /**
+   * \brief Record the number of sockets accepted by the server
+   * \param server the server
+   */
+  void CountSockets(Ptr<WorkServer> server);
+
+  uint32_t m_nDevices;   //!< Number of devices
+  uint32_t m_maxSockets; //!< Most accepted sockets seen at once
+};
+
+WorkIdleScenarioTestCase::WorkIdleScenarioTestCase(uint32_t nDevices)
+    : TestCase("Requests and server sockets of " + std::to_string(nDevices) +
+               " tcp devices closing their connection when idle"),
+      m_nDevices(nDevices), m_maxSockets(0) {}
+
+void WorkIdleScenarioTestCase::CountSockets(Ptr<WorkServer> server) {
+  m_maxSockets = std::max<uint32_t>(m_maxSockets,
+                                    server->GetAcceptedSockets().size());
 }
 
-//
-// This method is the pure virtual method from class TestCase that every
-// TestCase must implement
-//
-void
-WorkTestCase1::DoRun (void)
-{
-  // A wide variety of test macros are available in src/core/test.h
-  NS_TEST_ASSERT_MSG_EQ (true, true, "true doesn't equal true for some reason");
-  // Use this one for floating point comparisons
-  NS_TEST_ASSERT_MSG_EQ_TOL (0.01, 0.01, 0.001, "Numbers are not equal within tolerance");
-}
-
-// The TestSuite class names the TestSuite, identifies what type of TestSuite,
-// and enables the TestCases to be run.  Typically, only the constructor for
-// this class must be defined
-//
-class WorkTestSuite : public TestSuite
-{
+void WorkIdleScenarioTestCase::DoRun(void) {
+  const uint32_t packetSize = 500;            // Request size in bytes
+  const DataRate rate("4kbps");               // One request per second
+  const Time idleTimeout = MilliSeconds(200); // Idle time before closing
+  const Time start = Seconds(1);              // Start of the devices
+  const Time active = Seconds(10);            // Sending time of the devices
+
+  NodeContainer nodes;
+  nodes.Create(m_nDevices + 1);
+  SimpleNetDeviceHelper simple;
+  simple.SetChannelAttribute("Delay", TimeValue(MilliSeconds(2)));
+  simple.SetDeviceAttribute("DataRate", DataRateValue(DataRate("10Mbps")));
+  NetDeviceContainer devices = simple.Install(nodes);
+  InternetStackHelper internet;
+  internet.Install(nodes);
+  Ipv4AddressHelper address;
+  address.SetBase("10.0.0.0", "255.255.255.0");
+  Ipv4InterfaceContainer interfaces = address.Assign(devices);
+
+  Address serverAddress(InetSocketAddress(interfaces.GetAddress(0), 50000));
+  Ptr<WorkServer> server = CreateObject<WorkServer>();
+  server->SetAttribute("Protocol", TypeIdValue(TcpSocketFactory::GetTypeId()));
+  server->SetAttribute("Local", AddressValue(serverAddress));
+  nodes.Get(0)->AddApplication(server);
+
+  for (uint32_t i = 1; i <= m_nDevices; ++i) {
+    Ptr<DeviceEnforcer> device = CreateObject<DeviceEnforcer>();
+    device->SetAttribute("Protocol",
+                         TypeIdValue(TcpSocketFactory::GetTypeId()));
+    device->SetAttribute("Local", AddressValue(InetSocketAddress(
+                                      interfaces.GetAddress(i), 50000)));
+    device->SetAttribute("Remote", AddressValue(serverAddress));
+    device->SetAttribute("DataRate", DataRateValue(rate));
+    device->SetAttribute("PacketSize", UintegerValue(packetSize));
+    device->SetAttribute("IdleTimeout", TimeValue(idleTimeout));
+    device->SetStartTime(start);
+    device->SetStopTime(start + active);
+    nodes.Get(i)->AddApplication(device);
+  }
+  WorkEventCounters counters;
+  counters.Install();
+  // Half-way between two requests, when the connections are closed
+  for (Time t = start + MilliSeconds(500); t < start + active;
+       t += Seconds(1)) {
+    Simulator::Schedule(t, &WorkIdleScenarioTestCase::CountSockets, this,
+                        server);
+  }
+
+  Simulator::Stop(start + active + Seconds(1));
+  Simulator::Run();
+  Simulator::Destroy();
+
+  double perDevice = active.GetSeconds() * rate.GetBitRate() /
+                     (8.0 * packetSize);
+  uint64_t sent = counters.GetTotal(WORK_TRACE_DEVICE_SEND);
+  uint64_t responses = counters.GetTotal(WORK_TRACE_DEVICE_RESPONSE);
+  NS_TEST_ASSERT_MSG_EQ_TOL(double(sent), perDevice * m_nDevices,
+                            m_nDevices, "Unexpected number of requests");
+  NS_TEST_ASSERT_MSG_EQ_TOL(double(responses), double(sent), m_nDevices,
+                            "Requests left unanswered");
+  // One connection per device at most, the closed ones are released
+  NS_TEST_ASSERT_MSG_LT_OR_EQ(m_maxSockets, m_nDevices,
+                              "Server sockets of closed connections kept");
+}
+
+/**
+ * \ingroup applications
+ *
+ * \brief The Wi-Fi star of work-simulator, at light load.
+ *
+ * Every device must get its answers at the offered rate with a short RTT,
+ * and the events spent per response stay within a budget. Most of them are
+ * the receptions of every frame by every station.
+ */
+class WorkWifiScenarioTestCase : public TestCase {
+public:
+  /**
+   * \param protocol the request transport, tcp or udp
+   */
+  WorkWifiScenarioTestCase(string protocol);
+
+private:
+  virtual void DoRun(void);
+
+  string m_protocol; //!< Request transport
+};
+
+WorkWifiScenarioTestCase::WorkWifiScenarioTestCase(string protocol)
+    : TestCase("Requests, RTT and events of the " + protocol +
+               " Wi-Fi scenario"),
+      m_protocol(protocol) {}
+
+void WorkWifiScenarioTestCase::DoRun(void) {
+  WorkScenarioConfig config;
+  config.nDevices = 10;
+  config.dataRate = "200kbps";
+  config.protocol = m_protocol;
+  config.simulationTime = 20;
+  config.stop = 20;
+  config.positions = ""; // Grid, no data file needed
+  WorkScenario scenario(config);
+  scenario.Configure();
+  scenario.BuildTopology();
+  scenario.InstallApplications();
+
+  WorkRunTotals totals;
+  for (Ptr<DeviceEnforcer> device : scenario.GetDevices()) {
+    device->TraceConnectWithoutContext(
+        "Rtt", MakeCallback(&WorkRunTotals::Rtt, &totals));
+  }
+  WorkEventCounters counters;
+  counters.Install();
+  Simulator::Stop(scenario.GetStopTime());
+  Simulator::Run();
+  uint64_t events = Simulator::GetEventCount();
+  Simulator::Destroy();
+
+  // Devices start 0.2 s apart from 1 s and stop at 20 s
+  UintegerValue packetSize;
+  scenario.GetDevices()[0]->GetAttribute("PacketSize", packetSize);
+  double perSecond =
+      DataRate(config.dataRate).GetBitRate() / (8.0 * packetSize.Get());
+  for (uint32_t i = 0; i < config.nDevices; ++i) {
+    double active = config.stop - 1.0 - i * config.startInterval;
+    uint64_t responses = counters.Get(i, WORK_TRACE_DEVICE_RESPONSE);
+    NS_TEST_ASSERT_MSG_EQ_TOL(double(responses), active * perSecond,
+                              active * perSecond * 0.05,
+                              "Device " << i << " answered off rate");
+  }
+  uint64_t responses = counters.GetTotal(WORK_TRACE_DEVICE_RESPONSE);
+  NS_TEST_ASSERT_MSG_LT(totals.GetMeanRtt(), MilliSeconds(20),
+                        "Mean RTT too high at light load");
+  double perResponse = double(events) / std::max<uint64_t>(responses, 1);
+  NS_LOG_INFO(perResponse << " events per response");
+  NS_TEST_ASSERT_MSG_LT_OR_EQ(perResponse, 1000.0,
+                              "More simulator events per response");
+}
+
+/**
+ * \ingroup applications
+ *
+ * \brief UDP devices in phase sharing a WorkSendDriver.
+ *
+ * The devices start together at the same rate, so their transmissions fall
+ * in the same buckets of the driver: every request must still be sent and
+ * answered, and the driver must fire one event per bucket, not per device.
+ */
+class WorkSendDriverTestCase : public TestCase {
+public:
+  /**
+   * \param nDevices the number of devices
+   */
+  WorkSendDriverTestCase(uint32_t nDevices);
+
+private:
+  virtual void DoRun(void);
+
+  uint32_t m_nDevices; //!< Number of devices
+};
+
+WorkSendDriverTestCase::WorkSendDriverTestCase(uint32_t nDevices)
+    : TestCase("Requests of " + std::to_string(nDevices) +
+               " udp devices sharing a send driver"),
+      m_nDevices(nDevices) {}
+
+void WorkSendDriverTestCase::DoRun(void) {
+  const uint32_t packetSize = 500; // Request size in bytes
+  const DataRate rate("100kbps");  // Rate of each device
+  const Time start = Seconds(1);   // Start of the devices
+  const Time active = Seconds(10); // Sending time of the devices
+
+  NodeContainer nodes;
+  nodes.Create(m_nDevices + 1);
+  SimpleNetDeviceHelper simple;
+  simple.SetChannelAttribute("Delay", TimeValue(MilliSeconds(2)));
+  simple.SetDeviceAttribute("DataRate", DataRateValue(DataRate("10Mbps")));
+  NetDeviceContainer devices = simple.Install(nodes);
+  InternetStackHelper internet;
+  internet.Install(nodes);
+  Ipv4AddressHelper address;
+  address.SetBase("10.0.0.0", "255.255.255.0");
+  Ipv4InterfaceContainer interfaces = address.Assign(devices);
+
+  Address serverAddress(InetSocketAddress(interfaces.GetAddress(0), 50000));
+  Ptr<WorkServer> server = CreateObject<WorkServer>();
+  server->SetAttribute("Protocol", TypeIdValue(UdpSocketFactory::GetTypeId()));
+  server->SetAttribute("Local", AddressValue(serverAddress));
+  nodes.Get(0)->AddApplication(server);
+
+  Ptr<WorkSendDriver> driver = CreateObject<WorkSendDriver>();
+  for (uint32_t i = 1; i <= m_nDevices; ++i) {
+    Ptr<DeviceEnforcer> device = CreateObject<DeviceEnforcer>();
+    device->SetAttribute("Protocol",
+                         TypeIdValue(UdpSocketFactory::GetTypeId()));
+    device->SetAttribute("Local", AddressValue(InetSocketAddress(
+                                      interfaces.GetAddress(i), 50000)));
+    device->SetAttribute("Remote", AddressValue(serverAddress));
+    device->SetAttribute("DataRate", DataRateValue(rate));
+    device->SetAttribute("PacketSize", UintegerValue(packetSize));
+    device->SetAttribute("SendDriver", PointerValue(driver));
+    device->SetStartTime(start);
+    device->SetStopTime(start + active);
+    nodes.Get(i)->AddApplication(device);
+  }
+  WorkEventCounters counters;
+  counters.Install();
+
+  Simulator::Stop(start + active + Seconds(1));
+  Simulator::Run();
+  uint64_t fired = driver->GetFired();
+  uint64_t dispatched = driver->GetDispatched();
+  Simulator::Destroy();
+
+  double perDevice = active.GetSeconds() * rate.GetBitRate() /
+                     (8.0 * packetSize);
+  uint64_t sent = counters.GetTotal(WORK_TRACE_DEVICE_SEND);
+  uint64_t responses = counters.GetTotal(WORK_TRACE_DEVICE_RESPONSE);
+  NS_TEST_ASSERT_MSG_EQ_TOL(double(sent), perDevice * m_nDevices,
+                            m_nDevices, "Unexpected number of requests");
+  NS_TEST_ASSERT_MSG_EQ_TOL(double(responses), double(sent), m_nDevices,
+                            "Requests left unanswered");
+  // Every transmission goes through the driver, one event per bucket
+  NS_TEST_ASSERT_MSG_EQ(dispatched, sent, "Requests sent past the driver");
+  NS_TEST_ASSERT_MSG_EQ_TOL(double(fired), perDevice, 1,
+                            "Devices in phase not sharing a bucket");
+}
+
+/**
+ * \ingroup applications
+ *
+ * \brief LRU order, expiry and invalidation of the WorkDecisionCache.
+ */
+class WorkDecisionCacheTestCase : public TestCase {
+public:
+  WorkDecisionCacheTestCase();
+
+private:
+  virtual void DoRun(void);
+
+  /**
+   * \brief Look up an entry of the cache
+   * \param cache the cache
+   * \param key the request content
+   * \param expected true if the entry must be found
+   */
+  void CheckLookup(WorkDecisionCache *cache, string key, bool expected);
+};
+
+WorkDecisionCacheTestCase::WorkDecisionCacheTestCase()
+    : TestCase("Eviction, expiry and invalidation of the decision cache") {}
+
+void WorkDecisionCacheTestCase::CheckLookup(WorkDecisionCache *cache,
+                                            string key, bool expected) {
+  string value;
+  NS_TEST_EXPECT_MSG_EQ(cache->Lookup(key, value), expected,
+                        "Lookup of " << key << " at "
+                                     << Simulator::Now().As(Time::S));
+  if (expected) {
+    NS_TEST_EXPECT_MSG_EQ(value, "[" + key + "]", "Wrong decision");
+  }
+}
+
+void WorkDecisionCacheTestCase::DoRun(void) {
+  // A zero capacity disables the cache
+  WorkDecisionCache disabled;
+  disabled.Insert("a", "[a]");
+  NS_TEST_ASSERT_MSG_EQ(disabled.IsEnabled(), false, "Cache enabled");
+  NS_TEST_ASSERT_MSG_EQ(disabled.GetSize(), 0u, "Entry stored when disabled");
+
+  // The least recently used entry is evicted, a lookup refreshes its entry
+  WorkDecisionCache lru(3);
+  lru.Insert("a", "[a]");
+  lru.Insert("b", "[b]");
+  lru.Insert("c", "[c]");
+  CheckLookup(&lru, "a", true);
+  lru.Insert("d", "[d]");
+  NS_TEST_ASSERT_MSG_EQ(lru.GetEvictions(), 1u, "No eviction when full");
+  CheckLookup(&lru, "b", false);
+  CheckLookup(&lru, "c", true);
+  CheckLookup(&lru, "d", true);
+  // An update refreshes the entry without eviction
+  lru.Insert("a", "[a]");
+  lru.Insert("e", "[e]");
+  NS_TEST_ASSERT_MSG_EQ(lru.GetEvictions(), 2u, "No eviction when full");
+  CheckLookup(&lru, "c", false);
+  CheckLookup(&lru, "a", true);
+  NS_TEST_ASSERT_MSG_EQ(lru.GetSize(), 3u, "Capacity exceeded");
+  NS_TEST_ASSERT_MSG_EQ(lru.GetHits(), 4u, "Unexpected hits");
+  NS_TEST_ASSERT_MSG_EQ(lru.GetMisses(), 2u, "Unexpected misses");
+
+  // Invalidation of one entry, then of all of them
+  NS_TEST_ASSERT_MSG_EQ(lru.Invalidate("d"), true, "Entry not dropped");
+  NS_TEST_ASSERT_MSG_EQ(lru.Invalidate("d"), false, "Entry dropped twice");
+  CheckLookup(&lru, "d", false);
+  lru.InvalidateAll();
+  NS_TEST_ASSERT_MSG_EQ(lru.GetSize(), 0u, "Entries left");
+  NS_TEST_ASSERT_MSG_EQ(lru.GetInvalidations(), 3u,
+                        "Unexpected invalidations");
+  CheckLookup(&lru, "a", false);
+
+  // Entries inserted at 0 s live for one second, b is refreshed at 0.5 s
+  WorkDecisionCache ttl(2, Seconds(1));
+  ttl.Insert("a", "[a]");
+  ttl.Insert("b", "[b]");
+  Simulator::Schedule(MilliSeconds(500), &WorkDecisionCache::Insert, &ttl,
+                      string("b"), string("[b]"));
+  Simulator::Schedule(MilliSeconds(900),
+                      &WorkDecisionCacheTestCase::CheckLookup, this, &ttl,
+                      string("a"), true);
+  Simulator::Schedule(Seconds(1), &WorkDecisionCacheTestCase::CheckLookup,
+                      this, &ttl, string("a"), false);
+  Simulator::Schedule(MilliSeconds(1400),
+                      &WorkDecisionCacheTestCase::CheckLookup, this, &ttl,
+                      string("b"), true);
+  Simulator::Schedule(MilliSeconds(1500),
+                      &WorkDecisionCacheTestCase::CheckLookup, this, &ttl,
+                      string("b"), false);
+  Simulator::Run();
+  Simulator::Destroy();
+
+  NS_TEST_ASSERT_MSG_EQ(ttl.GetExpirations(), 2u, "Entries not expired");
+  NS_TEST_ASSERT_MSG_EQ(ttl.GetSize(), 0u, "Expired entries left");
+}
+
+/**
+ * \ingroup applications
+ *
+ * \brief Order of the events of the TimingWheelScheduler.
+ *
+ * The events are checked against a sorted multiset of their keys. With one
+ * tick per time step, the wheels cover 2^8, 2^16, 2^24 and 2^32 ticks, so
+ * the timestamps below land in every wheel and in the overflow map.
+ */
+class WorkTimingWheelTestCase : public TestCase {
 public:
-  WorkTestSuite ();
+  WorkTimingWheelTestCase();
+
+private:
+  virtual void DoRun(void);
+
+  /**
+   * \brief Start again with an empty scheduler
+   */
+  void Reset(void);
+
+  /**
+   * \brief Insert an event with the next uid
+   * \param ts the timestamp
+   * \return the key of the event
+   */
+  Scheduler::EventKey Insert(uint64_t ts);
+
+  /**
+   * \brief Insert an event
+   * \param ts the timestamp
+   * \param uid the uid
+   * \return the key of the event
+   */
+  Scheduler::EventKey Insert(uint64_t ts, uint32_t uid);
+
+  /**
+   * \brief Cancel an event
+   * \param key the key of the event
+   */
+  void Remove(const Scheduler::EventKey &key);
+
+  /**
+   * \brief Remove the earliest event and check it is the expected one
+   */
+  void RemoveNext(void);
+
+  /**
+   * \brief Remove every event in order
+   */
+  void Drain(void);
+
+  Ptr<TimingWheelScheduler> m_scheduler;         //!< Scheduler under test
+  std::multiset<Scheduler::EventKey> m_expected; //!< Scheduled events
+  uint64_t m_now;                                //!< Last timestamp removed
+  uint32_t m_uid;                                //!< Next uid
 };
 
-WorkTestSuite::WorkTestSuite ()
-  : TestSuite ("work", UNIT)
-{
-  // TestDuration for TestCase can be QUICK, EXTENSIVE or TAKES_FOREVER
-  AddTestCase (new WorkTestCase1, TestCase::QUICK);
+WorkTimingWheelTestCase::WorkTimingWheelTestCase()
+    : TestCase("Event order of the timing wheel scheduler"), m_now(0),
+      m_uid(0) {}
+
+void WorkTimingWheelTestCase::Reset(void) {
+  m_scheduler = CreateObject<TimingWheelScheduler>();
+  m_scheduler->SetAttribute("Granularity", TimeValue(TimeStep(1)));
+  m_expected.clear();
+  m_now = 0;
+  m_uid = 0;
+}
+
+Scheduler::EventKey WorkTimingWheelTestCase::Insert(uint64_t ts) {
+  return Insert(ts, m_uid++);
+}
+
+Scheduler::EventKey WorkTimingWheelTestCase::Insert(uint64_t ts,
+                                                    uint32_t uid) {
+  Scheduler::Event ev;
+  ev.impl = 0;
+  ev.key.m_ts = ts;
+  ev.key.m_uid = uid;
+  ev.key.m_context = 0;
+  m_scheduler->Insert(ev);
+  m_expected.insert(ev.key);
+  return ev.key;
+}
+
+void WorkTimingWheelTestCase::Remove(const Scheduler::EventKey &key) {
+  Scheduler::Event ev;
+  ev.impl = 0;
+  ev.key = key;
+  m_scheduler->Remove(ev);
+  m_expected.erase(m_expected.find(key));
+}
+
+void WorkTimingWheelTestCase::RemoveNext(void) {
+  Scheduler::EventKey expected = *m_expected.begin();
+  m_expected.erase(m_expected.begin());
+  Scheduler::Event next = m_scheduler->PeekNext();
+  Scheduler::Event ev = m_scheduler->RemoveNext();
+  NS_TEST_EXPECT_MSG_EQ(next.key.m_uid, ev.key.m_uid,
+                        "PeekNext and RemoveNext disagree");
+  NS_TEST_EXPECT_MSG_EQ(ev.key.m_ts, expected.m_ts, "Event out of order");
+  NS_TEST_EXPECT_MSG_EQ(ev.key.m_uid, expected.m_uid, "Event out of order");
+  m_now = ev.key.m_ts;
+}
+
+void WorkTimingWheelTestCase::Drain(void) {
+  while (!m_expected.empty()) {
+    RemoveNext();
+  }
+  NS_TEST_EXPECT_MSG_EQ(m_scheduler->IsEmpty(), true, "Events left");
 }
 
-// Do not forget to allocate an instance of this TestSuite
-static WorkTestSuite workTestSuite;
+void WorkTimingWheelTestCase::DoRun(void) {
+  // Equal timestamps come out in uid order, whatever the insertion order
+  // and the wheel they wait in
+  Reset();
+  const uint64_t stamps[] = {0, 3, 0x1234, 0x123456, 0x12345678, 0x123456789};
+  for (uint64_t ts : stamps) {
+    for (uint32_t uid : {5u, 1u, 4u, 2u, 3u}) {
+      Insert(ts, m_uid + uid);
+    }
+    m_uid += 6;
+  }
+  Drain();
+
+  // One event per wheel, the one of the fourth wheel cascades through the
+  // three others, plus the edges of the slots
+  Reset();
+  Insert(0x01020304);
+  Insert(0x00020304);
+  Insert(0x00000304);
+  Insert(0x00000004);
+  Insert(0x000000ff);
+  Insert(0x00000100);
+  Insert(0xffffffff);
+  RemoveNext();
+  Insert(m_now);
+  Insert(m_now + 0x01000000);
+  Drain();
+
+  // Events beyond 2^32 ticks wait in the overflow map, equal ticks included
+  Reset();
+  Insert(1);
+  Insert(0x100000000);
+  Scheduler::EventKey cancelled = Insert(0x100000000);
+  Insert(0x100000005);
+  Insert(0x700000000);
+  Insert(0x700000000);
+  Remove(cancelled);
+  RemoveNext();
+  Insert(0x100000000);
+  Drain();
+
+  // Random inserts, cancellations and removals, with delays in the range of
+  // every wheel and of the overflow map
+  Reset();
+  std::mt19937_64 random(1);
+  for (uint32_t i = 0; i < 100000; i++) {
+    uint32_t operation = random() % 8;
+    if (operation < 4 || m_expected.empty()) {
+      uint32_t level = random() % 5; // The last one is the overflow map
+      Insert(m_now + random() % (uint64_t(1) << (8 * (level + 1))));
+    } else if (operation < 6) {
+      Remove(*std::next(m_expected.begin(), random() % m_expected.size()));
+    } else {
+      RemoveNext();
+    }
+  }
+  Drain();
+}
+
+/**
+ * \ingroup applications
+ *
+ * \brief Microbenchmark of the framing and reassembly of a request stream.
+ *
+ * A stream of framed requests is split in segments that do not follow the
+ * message boundaries, then reassembled. Every message must come out intact,
+ * and the time per message of a long stream must stay close to the one of
+ * a short stream: reassembly must not copy the whole buffer per message.
+ */
+class WorkFramerTestCase : public TestCase {
+public:
+  WorkFramerTestCase();
+
+private:
+  virtual void DoRun(void);
+
+  /**
+   * \brief Frame, split and reassemble a stream of requests
+   * \param count the number of requests
+   * \return the time per request in nanoseconds
+   */
+  double RunStream(uint32_t count);
+};
+
+WorkFramerTestCase::WorkFramerTestCase()
+    : TestCase("Framing and reassembly of a request stream") {}
+
+double WorkFramerTestCase::RunStream(uint32_t count) {
+  const uint32_t segmentSize = 536; // Not a multiple of the message size
+  Ptr<Packet> payload = WorkMessageFramer::MakePayload("[Message!]", 1000);
+  auto start = std::chrono::steady_clock::now();
+
+  Ptr<Packet> stream = Create<Packet>();
+  for (uint32_t i = 0; i < count; ++i) {
+    stream->AddAtEnd(
+        WorkMessageFramer::Frame(WorkMessageHeader::REQUEST, i, payload));
+  }
+  WorkMessageFramer framer;
+  WorkMessageHeader header;
+  string message;
+  uint32_t next = 0;
+  for (uint32_t offset = 0; offset < stream->GetSize();
+       offset += segmentSize) {
+    uint32_t size = std::min(segmentSize, stream->GetSize() - offset);
+    framer.Append(stream->CreateFragment(offset, size));
+    while (framer.Next(header, message)) {
+      NS_TEST_EXPECT_MSG_EQ(header.GetId(), next, "Message out of order");
+      NS_TEST_EXPECT_MSG_EQ(WorkMessageFramer::Unwrap(message), "Message!",
+                            "Corrupted payload");
+      next++;
+    }
+  }
+  NS_TEST_EXPECT_MSG_EQ(next, count, "Messages lost in reassembly");
+  NS_TEST_EXPECT_MSG_EQ(framer.GetBufferedSize(), 0u, "Bytes left over");
+
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() * 1e9 / count;
+}
+
+void WorkFramerTestCase::DoRun(void) {
+  RunStream(100); // Warm up
+  double shortStream = RunStream(1000);
+  double longStream = RunStream(16000);
+  NS_LOG_INFO("Framing and reassembly: " << shortStream << " ns per message ("
+                                         << "1000), " << longStream
+                                         << " ns per message (16000)");
+  // Linear in the stream length, with room for the timing noise
+  NS_TEST_ASSERT_MSG_LT(longStream, 4 * shortStream,
+                        "Reassembly cost grows with the stream length");
+}
+
+/**
+ * \ingroup applications
+ *
+ * \brief Callback types and layers of the event profiler.
+ *
+ * The events of member functions are classified by their class, the ones of
+ * static or free functions by their arguments and the lambdas by the
+ * function defining them.
+ */
+class WorkProfilingTestCase : public TestCase {
+public:
+  WorkProfilingTestCase();
+
+private:
+  virtual void DoRun(void);
+
+  /**
+   * \brief Check the callback type and the layer of an event type
+   * \param demangled the demangled type of the event
+   * \param name the expected callback type
+   * \param layer the expected layer
+   */
+  void Check(const string &demangled, const string &name,
+             const string &layer);
+
+  /**
+   * \brief A static function scheduled as an event
+   * \param ipv4 the IPv4 stack
+   * \param delay a delay
+   */
+  static void Forward(Ptr<Ipv4> ipv4, double delay) {}
+};
+
+WorkProfilingTestCase::WorkProfilingTestCase()
+    : TestCase("Callback types and layers of the event profiler") {}
+
+void WorkProfilingTestCase::Check(const string &demangled, const string &name,
+                                  const string &layer) {
+  string callback = ProfilingScheduler::GetCallbackName(demangled);
+  NS_TEST_EXPECT_MSG_EQ(callback, name, "Unexpected callback type");
+  NS_TEST_EXPECT_MSG_EQ(ProfilingScheduler::GetLayer(callback), layer,
+                        "Unexpected layer of " << callback);
+}
+
+void WorkProfilingTestCase::DoRun(void) {
+  // Member function
+  Check("ns3::EventImpl* ns3::MakeEvent<void (ns3::DeviceEnforcer::*)(), "
+        "ns3::DeviceEnforcer*>(void (ns3::DeviceEnforcer::*)(), "
+        "ns3::DeviceEnforcer*)::EventMemberImpl0",
+        "DeviceEnforcer::*()", "applications");
+  // Static function, YansWifiChannel::Receive
+  Check("ns3::EventImpl* ns3::MakeEvent<void (*)(ns3::Ptr<ns3::YansWifiPhy>, "
+        "ns3::Ptr<ns3::WifiPpdu>, double), ns3::Ptr<ns3::YansWifiPhy>, "
+        "ns3::Ptr<ns3::WifiPpdu>, double>(void (*)(ns3::Ptr<ns3::YansWifiPhy>, "
+        "ns3::Ptr<ns3::WifiPpdu>, double), ns3::Ptr<ns3::YansWifiPhy>, "
+        "ns3::Ptr<ns3::WifiPpdu>, double)::EventFunctionImpl",
+        "*(Ptr<YansWifiPhy>, Ptr<WifiPpdu>, double)", "wifi");
+  // Static function whose first argument has no layer
+  Check("ns3::EventImpl* ns3::MakeEvent<void (*)(unsigned int, "
+        "ns3::Ptr<ns3::Ipv4L3Protocol>), unsigned int, "
+        "ns3::Ptr<ns3::Ipv4L3Protocol> >(void (*)(unsigned int, "
+        "ns3::Ptr<ns3::Ipv4L3Protocol>), unsigned int, "
+        "ns3::Ptr<ns3::Ipv4L3Protocol>)::EventFunctionImpl",
+        "*(unsigned int, Ptr<Ipv4L3Protocol>)", "internet");
+  // Lambda, named after the function defining it
+  Check("ns3::EventImpl* ns3::MakeEvent<ns3::WorkServer::HandleRead(ns3::Ptr<"
+        "ns3::Socket>)::{lambda()#1}>(ns3::WorkServer::HandleRead(ns3::Ptr<"
+        "ns3::Socket>)::{lambda()#1})::EventFunctionImpl",
+        "WorkServer::HandleRead(Ptr<Socket>)::{lambda()#1}", "applications");
+  // Function without any known type
+  Check("ns3::EventImpl* ns3::MakeEvent<void (*)(ns3::Ptr<ns3::Packet>), "
+        "ns3::Ptr<ns3::Packet> >(void (*)(ns3::Ptr<ns3::Packet>), "
+        "ns3::Ptr<ns3::Packet>)::EventFunctionImpl",
+        "*(Ptr<Packet>)", "other");
+
+  // The types of real events, as named by the compiler
+  ProfilingScheduler::Reset();
+  EventImpl *member = MakeEvent(&DeviceEnforcer::SetMaxBytes,
+                                static_cast<DeviceEnforcer *>(0), 0);
+  ProfilingScheduler::Record(typeid(*member), Simulator::NO_CONTEXT, 0);
+  member->Unref();
+  EventImpl *function =
+      MakeEvent(&WorkProfilingTestCase::Forward, Ptr<Ipv4>(), 0.0);
+  ProfilingScheduler::Record(typeid(*function), Simulator::NO_CONTEXT, 0);
+  function->Unref();
+  const std::vector<ProfilingScheduler::Entry> &types =
+      ProfilingScheduler::GetTypes();
+  NS_TEST_ASSERT_MSG_EQ(types.size(), 2u, "Events of different types merged");
+  NS_TEST_EXPECT_MSG_EQ(types[0].layer, "applications",
+                        "Unexpected layer of " << types[0].name);
+  NS_TEST_EXPECT_MSG_EQ(types[1].layer, "internet",
+                        "Unexpected layer of " << types[1].name);
+  ProfilingScheduler::Reset();
+}
+
+/**
+ * \ingroup applications
+ *
+ * \brief The test suite of the work module.
+ */
+class WorkTestSuite : public TestSuite {
+public:
+  WorkTestSuite();
+};
+
+WorkTestSuite::WorkTestSuite() : TestSuite("work", UNIT) {
+  AddTestCase(new WorkFramerTestCase, TestCase::QUICK);
+  AddTestCase(new WorkProfilingTestCase, TestCase::QUICK);
+  AddTestCase(new WorkSimpleScenarioTestCase("udp", 3), TestCase::QUICK);
+  AddTestCase(new WorkSimpleScenarioTestCase("tcp", 3), TestCase::QUICK);
+  AddTestCase(new WorkIdleScenarioTestCase(3), TestCase::QUICK);
+  AddTestCase(new WorkSendDriverTestCase(3), TestCase::QUICK);
+  AddTestCase(new WorkDecisionCacheTestCase, TestCase::QUICK);
+  AddTestCase(new WorkTimingWheelTestCase, TestCase::QUICK);
+  AddTestCase(new WorkWifiScenarioTestCase("udp"), TestCase::EXTENSIVE);
+  AddTestCase(new WorkWifiScenarioTestCase("tcp"), TestCase::EXTENSIVE);
+}
 
+static WorkTestSuite g_workTestSuite; //!< Static variable for registration